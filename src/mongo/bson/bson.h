@@ -67,6 +67,7 @@
 #include "mongo/bson/bsonobjiterator.h"
 #include "mongo/bson/bsontypes.h"
 #include "mongo/bson/bson-inl.h"
+#include "mongo/bson/mutable_document.h"
 #include "mongo/bson/oid.h"
 #include "mongo/bson/util/builder.h"
 
@@ -77,7 +77,7 @@ namespace mongo {
         BSONArray arr = BSON_ARRAY( "hello" << 1 << BSON( "foo" << BSON_ARRAY( "bar" << "baz" << "qux" ) ) );
 
      */
-#define BSON_ARRAY(x) (( ::mongo::BSONArrayBuilder() << x ).arr())
+#define BSON_ARRAY(x) (( ::mongo::BSONArrayBuilder(64) << x ).arr())
 
     /* Utility class to auto assign object IDs.
        Example:
@@ -33,6 +33,7 @@
 #include "mongo/bson/bsonmisc.h"
 #include "mongo/bson/bson_field.h"
 #include "mongo/client/export_macros.h"
+#include "mongo/platform/atomic_word.h"
 
 #if defined(_DEBUG) && defined(MONGO_EXPOSE_MACROS)
 #include "mongo/util/log.h"
@@ -573,6 +574,9 @@ namespace mongo {
             bool own = owned();
             massert( 10335 , "builder does not own memory", own );
             doneFast();
+            const int threshold = shrinkThreshold.loadRelaxed();
+            if ( threshold >= 0 && _b.getSize() - _b.len() > threshold )
+                _b.shrinkToFit();
             BSONObj::Holder* h = (BSONObj::Holder*)_b.buf();
             decouple(); // sets _b.buf() to NULL
             return BSONObj(h);
@@ -618,6 +622,16 @@ namespace mongo {
             _b.decouple();    // post done() call version.  be sure jsobj frees...
         }
 
+        /** Builders grow their buffer by doubling, so an object returned by obj() can pin up
+            to twice its size (or the initial size hint, if that was too generous). When the
+            unused part of the buffer exceeds 'bytes', obj() hands it back to the allocator
+            first, which pays off when many built objects are retained. Negative (the
+            default) never shrinks. See client::Options::setBSONShrinkThresholdBytes.
+        */
+        static void MONGO_CLIENT_FUNC setShrinkThreshold( int bytes ) {
+            shrinkThreshold.store( bytes );
+        }
+
         void appendKeys( const BSONObj& keyPattern , const BSONObj& values );
 
         static std::string MONGO_CLIENT_FUNC numStr( int i ) {
@@ -699,6 +713,8 @@ namespace mongo {
 
         static const std::string numStrs[100]; // cache of 0 to 99 inclusive
         static bool numStrsReady; // for static init safety. see comments in db/jsobj.cpp
+
+        static AtomicInt32 shrinkThreshold; // see setShrinkThreshold
     };
 
     class BSONArrayBuilder : boost::noncopyable {
@@ -248,4 +248,37 @@ namespace {
         ASSERT_FALSE(opTime.isNull());
     }
 
+    TEST(BSONObjBuilderTest, BufBuilderShrinkToFit) {
+        mongo::BufBuilder b(512);
+        b.appendStr("seventy bytes or so");
+        b.shrinkToFit();
+        ASSERT_EQUALS(b.len(), b.getSize());
+        ASSERT_EQUALS(string("seventy bytes or so"), b.buf());
+
+        // Growing again after shrinking still works
+        b.appendStr(string(1000, 'x'));
+        ASSERT_EQUALS(1021, b.len());
+    }
+
+    TEST(BSONObjBuilderTest, ShrinkThresholdKeepsObjectsIntact) {
+        BSONObjBuilder::setShrinkThreshold(0);
+
+        BSONObjBuilder small;
+        small.append("ping", 1);
+        const BSONObj smallObj = small.obj();
+
+        BSONObjBuilder large;
+        for (int i = 0; i < 100; i++)
+            large.append(BSONObjBuilder::numStr(i), string(i, 'y'));
+        const BSONObj largeObj = large.obj();
+
+        BSONObjBuilder::setShrinkThreshold(-1);
+
+        ASSERT_EQUALS(BSON("ping" << 1), smallObj);
+        ASSERT_EQUALS(100, largeObj.nFields());
+        ASSERT_EQUALS(string(99, 'y'), largeObj["99"].String());
+        ASSERT_TRUE(largeObj.isOwned());
+    }
+
 } // unnamed namespace
+
@@ -0,0 +1,523 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bson/mutable_document.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <list>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    /**
+     * A stretch of a container's elements: a run of elements left as they were in the
+     * buffer they came from, a single edited element, or an object or array element whose
+     * own elements are being edited.
+     */
+    struct MutableDocument::Node {
+        enum Kind {
+            kRun,
+            kElement,
+            kContainer
+        };
+
+        // A fixed size value overwritten within a run
+        struct Patch {
+            int offset;         // of the element from the start of the run
+            std::string value;
+        };
+
+        Node() : kind(kRun), begin(NULL), end(NULL) {}
+
+        Kind kind;
+
+        // kRun
+        const char* begin;
+        const char* end;
+        std::vector<Patch> patches;
+
+        // kElement: type, field name and value
+        std::string element;
+
+        // kContainer
+        boost::shared_ptr<Container> container;
+    };
+
+    struct MutableDocument::Container {
+        Container(BSONType type_, const std::string& fieldName_)
+            : type(type_), fieldName(fieldName_), renumber(false) {}
+
+        const BSONType type;
+        const std::string fieldName;
+
+        // Holds an edited element that has since been opened up, as its nodes point into it
+        std::string storage;
+
+        std::list<Node> nodes;
+
+        // Set when an array had elements inserted or removed: the field names of all of its
+        // elements have to be rewritten
+        bool renumber;
+    };
+
+    namespace {
+
+        typedef std::list<MutableDocument::Node> Nodes;
+
+        // Where a field was found: either a node of its own, or an element within a run
+        struct Position {
+            Position() : element(NULL) {}
+            Nodes::iterator node;
+            const char* element;
+        };
+
+        std::vector<std::string> splitPath(const StringData& path) {
+            std::vector<std::string> components;
+            size_t start = 0;
+            while (true) {
+                const size_t dot = path.find('.', start);
+                const size_t end = dot == std::string::npos ? path.size() : dot;
+                uassert(17408,
+                        mongoutils::str::stream() << "empty component in path '" << path << "'",
+                        end > start);
+                components.push_back(path.substr(start, end - start).toString());
+                if (dot == std::string::npos)
+                    return components;
+                start = dot + 1;
+            }
+        }
+
+        int arrayIndex(const std::string& component) {
+            bool valid = !component.empty() && component.size() <= 9;
+            for (size_t i = 0; valid && i < component.size(); i++)
+                valid = component[i] >= '0' && component[i] <= '9';
+            uassert(17409,
+                    mongoutils::str::stream() << "'" << component << "' is not an array index",
+                    valid);
+            return std::atoi(component.c_str());
+        }
+
+        // Values that can be overwritten without changing the size of the element
+        bool fixedSize(BSONType type) {
+            switch (type) {
+            case NumberDouble:
+            case NumberInt:
+            case NumberLong:
+            case Date:
+            case Timestamp:
+            case Bool:
+            case jstOID:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        std::string makeElement(BSONType type,
+                                const StringData& fieldName,
+                                const char* value,
+                                int valueSize) {
+            std::string element;
+            element.reserve(1 + fieldName.size() + 1 + valueSize);
+            element += static_cast<char>(type);
+            element.append(fieldName.rawData(), fieldName.size());
+            element += '\0';
+            element.append(value, valueSize);
+            return element;
+        }
+
+        MutableDocument::Node elementNode(const StringData& fieldName, const BSONElement& value) {
+            MutableDocument::Node node;
+            node.kind = MutableDocument::Node::kElement;
+            node.element = makeElement(value.type(), fieldName, value.value(), value.valuesize());
+            return node;
+        }
+
+        MutableDocument::Node nullNode(int index) {
+            MutableDocument::Node node;
+            node.kind = MutableDocument::Node::kElement;
+            node.element = makeElement(jstNULL, BSONObjBuilder::numStr(index), NULL, 0);
+            return node;
+        }
+
+        MutableDocument::Node runNode(const char* begin, const char* end) {
+            MutableDocument::Node node;
+            node.begin = begin;
+            node.end = end;
+            return node;
+        }
+
+        const char* fieldName(const MutableDocument::Node& node) {
+            return node.kind == MutableDocument::Node::kElement ?
+                node.element.data() + 1 : node.container->fieldName.c_str();
+        }
+
+        int length(const Nodes& nodes) {
+            int n = 0;
+            for (Nodes::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+                if (it->kind != MutableDocument::Node::kRun) {
+                    n++;
+                    continue;
+                }
+                for (const char* p = it->begin; p < it->end; p += BSONElement(p).size())
+                    n++;
+            }
+            return n;
+        }
+
+        bool find(Nodes& nodes, bool isArray, const std::string& component, Position* pos) {
+            int index = isArray ? arrayIndex(component) : 0;
+
+            for (Nodes::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+                if (it->kind != MutableDocument::Node::kRun) {
+                    if (isArray ? index-- == 0 : component == fieldName(*it)) {
+                        pos->node = it;
+                        pos->element = NULL;
+                        return true;
+                    }
+                    continue;
+                }
+
+                for (const char* p = it->begin; p < it->end; ) {
+                    const BSONElement e(p);
+                    if (isArray ? index-- == 0 : component == e.fieldName()) {
+                        pos->node = it;
+                        pos->element = p;
+                        return true;
+                    }
+                    p += e.size();
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * Splits the run holding the element at 'pos' so that the element is a run of its
+         * own, and returns that run.
+         */
+        Nodes::iterator isolate(Nodes& nodes, const Position& pos) {
+            if (pos.element == NULL)
+                return pos.node;
+
+            MutableDocument::Node& run = *pos.node;
+            const char* const element = pos.element;
+            const char* const next = element + BSONElement(element).size();
+            const int offset = element - run.begin;
+            const int nextOffset = next - run.begin;
+
+            MutableDocument::Node before = runNode(run.begin, element);
+            MutableDocument::Node after = runNode(next, run.end);
+            std::vector<MutableDocument::Node::Patch> patches;
+            for (size_t i = 0; i < run.patches.size(); i++) {
+                MutableDocument::Node::Patch patch = run.patches[i];
+                if (patch.offset < offset) {
+                    before.patches.push_back(patch);
+                }
+                else if (patch.offset >= nextOffset) {
+                    patch.offset -= nextOffset;
+                    after.patches.push_back(patch);
+                }
+                else {
+                    patch.offset = 0;
+                    patches.push_back(patch);
+                }
+            }
+
+            if (element > run.begin)
+                nodes.insert(pos.node, before);
+            if (next < run.end) {
+                Nodes::iterator following = pos.node;
+                nodes.insert(++following, after);
+            }
+
+            run.begin = element;
+            run.end = next;
+            run.patches.swap(patches);
+            return pos.node;
+        }
+
+        void write(BufBuilder& b, const MutableDocument::Container& container);
+
+        void writeRun(BufBuilder& b, const MutableDocument::Node& run, bool renumber, int* index) {
+            if (!renumber) {
+                const int at = b.len();
+                b.appendBuf(run.begin, run.end - run.begin);
+                for (size_t i = 0; i < run.patches.size(); i++) {
+                    const MutableDocument::Node::Patch& patch = run.patches[i];
+                    const BSONElement e(run.begin + patch.offset);
+                    std::memcpy(b.buf() + at + patch.offset + (e.value() - e.rawdata()),
+                                patch.value.data(),
+                                patch.value.size());
+                }
+                return;
+            }
+
+            for (const char* p = run.begin; p < run.end; ) {
+                const BSONElement e(p);
+                b.appendNum(static_cast<char>(e.type()));
+                b.appendStr(BSONObjBuilder::numStr((*index)++));
+                const int at = b.len();
+                b.appendBuf(e.value(), e.valuesize());
+                for (size_t i = 0; i < run.patches.size(); i++) {
+                    const MutableDocument::Node::Patch& patch = run.patches[i];
+                    if (run.begin + patch.offset == p)
+                        std::memcpy(b.buf() + at, patch.value.data(), patch.value.size());
+                }
+                p += e.size();
+            }
+        }
+
+        void write(BufBuilder& b, const MutableDocument::Container& container) {
+            const bool renumber = container.renumber;
+            int index = 0;
+
+            for (Nodes::const_iterator it = container.nodes.begin();
+                 it != container.nodes.end(); ++it) {
+                switch (it->kind) {
+                case MutableDocument::Node::kRun:
+                    writeRun(b, *it, renumber, &index);
+                    break;
+                case MutableDocument::Node::kElement:
+                    if (!renumber) {
+                        b.appendBuf(it->element.data(), it->element.size());
+                    }
+                    else {
+                        const BSONElement e(it->element.data());
+                        b.appendNum(static_cast<char>(e.type()));
+                        b.appendStr(BSONObjBuilder::numStr(index));
+                        b.appendBuf(e.value(), e.valuesize());
+                    }
+                    index++;
+                    break;
+                case MutableDocument::Node::kContainer: {
+                    const MutableDocument::Container& child = *it->container;
+                    b.appendNum(static_cast<char>(child.type));
+                    b.appendStr(renumber ? BSONObjBuilder::numStr(index) : child.fieldName);
+                    const int at = b.len();
+                    b.skip(sizeof(int));
+                    write(b, child);
+                    b.appendNum(static_cast<char>(EOO));
+                    const int size = b.len() - at;
+                    std::memcpy(b.buf() + at, &size, sizeof(size));
+                    index++;
+                    break;
+                }
+                }
+            }
+        }
+
+    } // namespace
+
+    MutableDocument::MutableDocument(const BSONObj& doc) {
+        _rebase(doc);
+    }
+
+    MutableDocument::~MutableDocument() {}
+
+    void MutableDocument::_rebase(const BSONObj& doc) {
+        _doc = doc;
+        _root.reset(new Container(Object, ""));
+        const char* const begin = _doc.objdata() + sizeof(int);
+        const char* const end = _doc.objdata() + _doc.objsize() - 1;
+        if (begin < end)
+            _root->nodes.push_back(runNode(begin, end));
+        _modified = false;
+    }
+
+    MutableDocument::Container* MutableDocument::_parent(const std::vector<std::string>& path,
+                                                          bool create) {
+        Container* container = _root.get();
+
+        for (size_t i = 0; i + 1 < path.size(); i++) {
+            const bool isArray = container->type == Array;
+
+            Position pos;
+            if (!find(container->nodes, isArray, path[i], &pos)) {
+                if (!create)
+                    return NULL;
+
+                // Intermediate fields are created as objects, padding arrays as needed
+                std::string fieldName = path[i];
+                if (isArray) {
+                    const int index = arrayIndex(path[i]);
+                    for (int n = length(container->nodes); n < index; n++)
+                        container->nodes.push_back(nullNode(n));
+                    fieldName = BSONObjBuilder::numStr(index);
+                }
+
+                Node node;
+                node.kind = Node::kContainer;
+                node.container.reset(new Container(Object, fieldName));
+                container->nodes.push_back(node);
+                container = node.container.get();
+                continue;
+            }
+
+            Nodes::iterator it = isolate(container->nodes, pos);
+            if (it->kind == Node::kContainer) {
+                container = it->container.get();
+                continue;
+            }
+
+            const BSONElement e(it->kind == Node::kRun ? it->begin : it->element.data());
+            if (e.type() != Object && e.type() != Array) {
+                if (!create)
+                    return NULL;
+                uasserted(17408, mongoutils::str::stream() << "cannot create field '"
+                                                           << path[i + 1] << "' in "
+                                                           << e.toString());
+            }
+
+            // Open the element up, keeping its contents where they are
+            boost::shared_ptr<Container> child(new Container(e.type(), e.fieldName()));
+            const char* body = e.value();
+            if (it->kind == Node::kElement) {
+                const ptrdiff_t offset = e.value() - e.rawdata();
+                child->storage.swap(it->element);
+                body = child->storage.data() + offset;
+            }
+            const int size = *reinterpret_cast<const int*>(body);
+            if (size > static_cast<int>(sizeof(int)) + 1)
+                child->nodes.push_back(runNode(body + sizeof(int), body + size - 1));
+
+            it->kind = Node::kContainer;
+            it->container = child;
+            it->patches.clear();
+            container = child.get();
+        }
+
+        return container;
+    }
+
+    void MutableDocument::set(const StringData& path, const BSONElement& value) {
+        uassert(17411, "cannot set a field to EOO", !value.eoo());
+
+        const std::vector<std::string> components = splitPath(path);
+        Container* const parent = _parent(components, true);
+        const std::string& last = components.back();
+        const bool isArray = parent->type == Array;
+        _modified = true;
+
+        Position pos;
+        if (find(parent->nodes, isArray, last, &pos)) {
+            if (pos.element != NULL) {
+                const BSONElement e(pos.element);
+                if (e.type() == value.type() && fixedSize(e.type())) {
+                    Node::Patch patch;
+                    patch.offset = pos.element - pos.node->begin;
+                    patch.value.assign(value.value(), value.valuesize());
+
+                    std::vector<Node::Patch>& patches = pos.node->patches;
+                    for (size_t i = 0; i < patches.size(); i++) {
+                        if (patches[i].offset == patch.offset) {
+                            patches[i].value.swap(patch.value);
+                            return;
+                        }
+                    }
+                    patches.push_back(patch);
+                    return;
+                }
+            }
+
+            Nodes::iterator it = isolate(parent->nodes, pos);
+            const std::string name =
+                it->kind == Node::kRun ? std::string(BSONElement(it->begin).fieldName())
+                                       : std::string(fieldName(*it));
+            *it = elementNode(name, value);
+            return;
+        }
+
+        if (!isArray) {
+            parent->nodes.push_back(elementNode(last, value));
+            return;
+        }
+
+        const int index = arrayIndex(last);
+        for (int n = length(parent->nodes); n < index; n++)
+            parent->nodes.push_back(nullNode(n));
+        parent->nodes.push_back(elementNode(BSONObjBuilder::numStr(index), value));
+    }
+
+    bool MutableDocument::remove(const StringData& path) {
+        const std::vector<std::string> components = splitPath(path);
+        Container* const parent = _parent(components, false);
+        if (parent == NULL)
+            return false;
+
+        Position pos;
+        if (!find(parent->nodes, parent->type == Array, components.back(), &pos))
+            return false;
+
+        parent->nodes.erase(isolate(parent->nodes, pos));
+        if (parent->type == Array)
+            parent->renumber = true;
+        _modified = true;
+        return true;
+    }
+
+    void MutableDocument::insert(const StringData& path, const BSONElement& value) {
+        uassert(17411, "cannot insert EOO", !value.eoo());
+
+        const std::vector<std::string> components = splitPath(path);
+        Container* const parent = _parent(components, true);
+        const std::string& last = components.back();
+
+        Position pos;
+        if (parent->type != Array) {
+            uassert(17410,
+                    mongoutils::str::stream() << "field '" << path << "' already exists",
+                    !find(parent->nodes, false, last, &pos));
+            parent->nodes.push_back(elementNode(last, value));
+            _modified = true;
+            return;
+        }
+
+        const int index = arrayIndex(last);
+        const int size = length(parent->nodes);
+        uassert(17409,
+                mongoutils::str::stream() << "cannot insert at " << path << ", the array has "
+                                          << size << " elements",
+                index <= size);
+
+        if (index == size) {
+            parent->nodes.push_back(elementNode(BSONObjBuilder::numStr(index), value));
+        }
+        else {
+            find(parent->nodes, true, last, &pos);
+            parent->nodes.insert(isolate(parent->nodes, pos), elementNode("", value));
+            parent->renumber = true;
+        }
+        _modified = true;
+    }
+
+    BSONObj MutableDocument::obj() {
+        if (!_modified)
+            return _doc;
+
+        BSONObjBuilder b(_doc.objsize() + 64);
+        write(b.bb(), *_root);
+        const BSONObj result = b.obj();
+        _rebase(result);
+        return result;
+    }
+
+} // namespace mongo
@@ -0,0 +1,109 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bsonelement.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/client/export_macros.h"
+
+namespace mongo {
+
+    /**
+     * A document that can be edited in place of rebuilding a BSONObj for every change:
+     *
+     *   MutableDocument doc(big);
+     *   doc.set("stats.views", 10);
+     *   doc.remove("draft");
+     *   doc.insert("tags.0", "featured");
+     *   BSONObj updated = doc.obj();
+     *
+     * Paths are dotted; numeric components index into arrays. The document keeps referring
+     * to the original BSONObj and only records what changed: edited fields split the region
+     * around them, and a fixed size value (a number, date, bool...) replaced by one of the
+     * same type is patched over the original bytes without splitting anything. obj() stitches
+     * the untouched regions and the edits together in a single pass.
+     *
+     * Finding a field still walks the elements before it, but nothing is copied until obj().
+     * The original BSONObj is retained; if it does not own its buffer, the buffer must
+     * outlive the document. Not thread safe.
+     */
+    class MONGO_CLIENT_API MutableDocument : boost::noncopyable {
+    public:
+        explicit MutableDocument(const BSONObj& doc);
+        ~MutableDocument();
+
+        /**
+         * Sets the field at 'path' to the value of 'value', whose field name is ignored.
+         * Missing fields are appended to their parent, creating missing intermediate objects;
+         * setting an array element past the end pads the array with nulls.
+         */
+        void set(const StringData& path, const BSONElement& value);
+
+        template <typename T>
+        void set(const StringData& path, const T& value) {
+            BSONObjBuilder b;
+            b.append("", value);
+            set(path, b.done().firstElement());
+        }
+
+        /**
+         * Removes the field at 'path'. Array elements after a removed one move down.
+         * Returns false if there was no such field.
+         */
+        bool remove(const StringData& path);
+
+        /**
+         * Inserts 'value' at 'path'. In an array, the element currently at that index and
+         * those after it move up; the index may be the length of the array. In an object the
+         * field is appended and must not already exist.
+         */
+        void insert(const StringData& path, const BSONElement& value);
+
+        template <typename T>
+        void insert(const StringData& path, const T& value) {
+            BSONObjBuilder b;
+            b.append("", value);
+            insert(path, b.done().firstElement());
+        }
+
+        /**
+         * The document with every edit applied. Further edits start from the returned object,
+         * so calling obj() again without edits is free.
+         */
+        BSONObj obj();
+
+        // Defined in mutable_document.cpp
+        struct Node;
+        struct Container;
+
+    private:
+
+        Container* _parent(const std::vector<std::string>& path, bool create);
+        void _rebase(const BSONObj& doc);
+
+        BSONObj _doc;
+        boost::shared_ptr<Container> _root;
+        bool _modified;
+    };
+
+} // namespace mongo
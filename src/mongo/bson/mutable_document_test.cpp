@@ -0,0 +1,136 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/bson/mutable_document.h"
+
+#include <string>
+
+#include "mongo/db/json.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using mongo::BSONObj;
+    using mongo::MutableDocument;
+    using mongo::UserException;
+    using mongo::fromjson;
+    using std::string;
+
+    TEST(MutableDocumentTest, UnmodifiedIsTheSameObject) {
+        const BSONObj doc = fromjson("{a: 1, b: {c: [1, 2]}}");
+        MutableDocument mutableDoc(doc);
+        ASSERT_EQUALS(doc.objdata(), mutableDoc.obj().objdata());
+    }
+
+    TEST(MutableDocumentTest, SetTopLevelFields) {
+        const BSONObj doc = fromjson("{a: 1, b: 'two', c: 3.5}");
+        MutableDocument mutableDoc(doc);
+
+        mutableDoc.set("a", 2);
+        mutableDoc.set("b", "a longer string");
+        mutableDoc.set("d", true);
+
+        ASSERT_EQUALS(fromjson("{a: 2, b: 'a longer string', c: 3.5, d: true}"),
+                      mutableDoc.obj());
+        ASSERT_EQUALS(fromjson("{a: 1, b: 'two', c: 3.5}"), doc);
+    }
+
+    TEST(MutableDocumentTest, FixedSizeValuesArePatched) {
+        const BSONObj doc = fromjson("{a: 1, b: 2.5, c: 3}");
+        MutableDocument mutableDoc(doc);
+
+        mutableDoc.set("a", 10);
+        mutableDoc.set("b", 7.5);
+        mutableDoc.set("a", 20);
+
+        // Changing the type replaces the element
+        mutableDoc.set("c", 4LL);
+
+        const BSONObj result = mutableDoc.obj();
+        ASSERT_EQUALS(fromjson("{a: 20, b: 7.5, c: 4}"), result);
+        ASSERT_EQUALS(mongo::NumberLong, result["c"].type());
+    }
+
+    TEST(MutableDocumentTest, NestedPaths) {
+        const BSONObj doc = fromjson("{a: {b: {c: 1, d: 2}, e: 3}, f: 4}");
+        MutableDocument mutableDoc(doc);
+
+        mutableDoc.set("a.b.c", 5);
+        mutableDoc.set("a.b.x", "new");
+        ASSERT_TRUE(mutableDoc.remove("a.e"));
+        mutableDoc.set("g.h.i", 6);
+        ASSERT_FALSE(mutableDoc.remove("f.missing"));
+        ASSERT_FALSE(mutableDoc.remove("missing.field"));
+
+        ASSERT_EQUALS(fromjson("{a: {b: {c: 5, d: 2, x: 'new'}}, f: 4, g: {h: {i: 6}}}"),
+                      mutableDoc.obj());
+    }
+
+    TEST(MutableDocumentTest, EditsInsideReplacedElements) {
+        MutableDocument mutableDoc(fromjson("{a: 1}"));
+
+        mutableDoc.set("a", fromjson("{b: {c: 1}}"));
+        mutableDoc.set("a.b.d", 2);
+
+        ASSERT_EQUALS(fromjson("{a: {b: {c: 1, d: 2}}}"), mutableDoc.obj());
+    }
+
+    TEST(MutableDocumentTest, ArrayElements) {
+        MutableDocument mutableDoc(fromjson("{a: [0, 1, 2, 3]}"));
+
+        mutableDoc.set("a.1", 10);
+        ASSERT_TRUE(mutableDoc.remove("a.2"));
+        mutableDoc.insert("a.0", "first");
+        mutableDoc.insert("a.4", "last");
+
+        const BSONObj result = mutableDoc.obj();
+        ASSERT_EQUALS(fromjson("{a: ['first', 0, 10, 3, 'last']}"), result);
+
+        // Field names are renumbered
+        ASSERT_EQUALS(string("4"), result["a"].Obj()["4"].fieldName());
+        ASSERT_EQUALS("last", result["a"].Obj()["4"].String());
+    }
+
+    TEST(MutableDocumentTest, SetPastTheEndOfAnArrayPads) {
+        MutableDocument mutableDoc(fromjson("{a: [0]}"));
+        mutableDoc.set("a.3", 3);
+        mutableDoc.set("a.5.b", 5);
+        ASSERT_EQUALS(fromjson("{a: [0, null, null, 3, null, {b: 5}]}"), mutableDoc.obj());
+    }
+
+    TEST(MutableDocumentTest, EditsContinueAfterObj) {
+        MutableDocument mutableDoc(fromjson("{a: 1, b: [1]}"));
+
+        mutableDoc.set("a", 2);
+        ASSERT_EQUALS(fromjson("{a: 2, b: [1]}"), mutableDoc.obj());
+
+        mutableDoc.insert("b.1", 2);
+        mutableDoc.set("a", 3);
+        ASSERT_EQUALS(fromjson("{a: 3, b: [1, 2]}"), mutableDoc.obj());
+    }
+
+    TEST(MutableDocumentTest, InvalidEdits) {
+        MutableDocument mutableDoc(fromjson("{a: 1, b: [1]}"));
+
+        ASSERT_THROWS(mutableDoc.set("a.b", 1), UserException);
+        ASSERT_THROWS(mutableDoc.set("b.x", 1), UserException);
+        ASSERT_THROWS(mutableDoc.set("a..b", 1), UserException);
+        ASSERT_THROWS(mutableDoc.insert("a", 1), UserException);
+        ASSERT_THROWS(mutableDoc.insert("b.3", 1), UserException);
+
+        ASSERT_EQUALS(fromjson("{a: 1, b: [1]}"), mutableDoc.obj());
+    }
+
+} // namespace
@@ -196,4 +196,6 @@ namespace mongo {
     // numStrsReady will be 0 until after numStrs is initialized because it is a static variable
     bool BSONObjBuilder::numStrsReady = (numStrs[0].size() > 0);
 
+    AtomicInt32 BSONObjBuilder::shrinkThreshold(-1);
+
 }
@@ -146,6 +146,18 @@ namespace mongo {
         /* assume ownership of the buffer - you must then free() it */
         void decouple() { data = 0; }
 
+        /** give back the capacity past len(). the buffer may move. */
+        void shrinkToFit() {
+            if ( data && l > 0 && l < size ) {
+                char* shrunk = (char*) al.Realloc(data, l);
+                // keep the old buffer if the allocator can't do it
+                if ( shrunk ) {
+                    data = shrunk;
+                    size = l;
+                }
+            }
+        }
+
         void appendUChar(unsigned char j) {
             *((unsigned char*)grow(sizeof(unsigned char))) = j;
         }
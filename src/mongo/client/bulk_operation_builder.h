@@ -15,7 +15,7 @@
 
 #pragma once
 
-#include <vector>
+#include <boost/shared_ptr.hpp>
 
 #include "mongo/bson/bsonobj.h"
 #include "mongo/client/bulk_update_builder.h"
@@ -25,7 +25,7 @@ namespace mongo {
 
     class DBClientBase;
     class WriteConcern;
-    class WriteOperation;
+    class WriteOperationQueue;
 
     /**
      * Class for constructing and executing bulk operations against MongoDB via a
@@ -59,6 +59,9 @@ namespace mongo {
         /* Enable operations of this type to append themselves to enqueue themselves */
         friend class BulkUpsertBuilder;
 
+        /* Executes one builder per namespace, each on a pooled connection */
+        friend class MultiBulkOperationBuilder;
+
     public:
         /**
          * BulkOperationBuilder constructor
@@ -72,9 +75,6 @@ namespace mongo {
          */
         BulkOperationBuilder(DBClientBase* const client, const std::string& ns, bool ordered);
 
-        /* Deletes all of the WriteOperations that were created during the Builder's lifetime */
-        ~BulkOperationBuilder();
-
         /**
          * Supplies a filter to select a subset of documents on which to apply an operation.
          * The operation that is ultimately enqueued as part of this bulk operation depends on
@@ -92,6 +92,18 @@ namespace mongo {
          */
         void insert(const BSONObj& doc);
 
+        /**
+         * Lets execute() merge updates that apply the same modifier document to different
+         * values of one field (for example { _id: <value> }) into multi-updates with an $in
+         * selector, so that thousands of them cost the server a few updates. Only unordered
+         * bulks are rewritten, and upserts never are. Off by default.
+         *
+         * nMatched and nModified add up the same either way. A write error on a merged update
+         * is reported for every operation it was merged from, since it isn't known which of
+         * them were applied.
+         */
+        void setCoalesceUpdates(bool coalesceUpdates);
+
         /**
          * Executes the bulk operation.
          *
@@ -101,14 +113,17 @@ namespace mongo {
         void execute(const WriteConcern* writeConcern, WriteResult* writeResult);
 
     private:
-        void enqueue(WriteOperation* const operation);
+        void _execute(DBClientBase* client, const WriteConcern* writeConcern,
+                      WriteResult* writeResult);
 
         DBClientBase* const _client;
         const std::string _ns;
         const bool _ordered;
         bool _executed;
-        size_t _currentIndex;
-        std::vector<WriteOperation*> _write_operations;
+        bool _coalesceUpdates;
+
+        // Owns the queued operations and a copy of their documents
+        boost::shared_ptr<WriteOperationQueue> _operations;
     };
 
 } // namespace mongo
@@ -0,0 +1,95 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/bulk_operation_builder.h"
+#include "mongo/client/dbclientinterface.h"
+#include "mongo/client/write_concern.h"
+#include "mongo/client/write_result.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/dbtests/mock/mock_dbclient_connection.h"
+#include "mongo/dbtests/mock/mock_remote_db_server.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using mongo::BSONObj;
+    using mongo::BulkOperationBuilder;
+    using mongo::MockDBClientConnection;
+    using mongo::MockRemoteDBServer;
+    using mongo::OperationException;
+    using mongo::WriteConcern;
+    using mongo::WriteResult;
+
+    const char kNs[] = "test.bulk";
+
+    class CoalescedBulkTest : public mongo::unittest::Test {
+    protected:
+        CoalescedBulkTest() : _server("$test:27017"), _conn(&_server) {
+            // Use write commands
+            _conn.setWireVersions(0, 2);
+        }
+
+        // Queues updates of _ids 0..n-1 setting the same status, and a final insert.
+        void queue(BulkOperationBuilder* bulk, int n) {
+            for (int i = 0; i < n; i++)
+                bulk->find(BSON("_id" << i)).updateOne(BSON("$set" << BSON("status" << "done")));
+            bulk->insert(BSON("_id" << n));
+        }
+
+        MockRemoteDBServer _server;
+        MockDBClientConnection _conn;
+    };
+
+    TEST_F(CoalescedBulkTest, MatchedCountsAddUp) {
+        _server.setCommandReply("update", BSON("ok" << 1 << "n" << 3 << "nModified" << 2));
+        _server.setCommandReply("insert", BSON("ok" << 1 << "n" << 1));
+
+        BulkOperationBuilder bulk(&_conn, kNs, false);
+        bulk.setCoalesceUpdates(true);
+        queue(&bulk, 3);
+
+        WriteResult result;
+        bulk.execute(&WriteConcern::acknowledged, &result);
+
+        // One insert and a single update command for the three updates
+        ASSERT_EQUALS(2U, _server.getCmdCount());
+        ASSERT_EQUALS(3, result.nMatched());
+        ASSERT_EQUALS(2, result.nModified());
+        ASSERT_EQUALS(1, result.nInserted());
+    }
+
+    TEST_F(CoalescedBulkTest, ErrorsAreReportedForEveryCoalescedOperation) {
+        _server.setCommandReply("update", BSON("ok" << 1 << "n" << 1 << "nModified" << 1
+            << "writeErrors" << BSON_ARRAY(BSON("index" << 0 << "code" << 2 << "errmsg" << "x"))));
+        _server.setCommandReply("insert", BSON("ok" << 1 << "n" << 1));
+
+        BulkOperationBuilder bulk(&_conn, kNs, false);
+        bulk.setCoalesceUpdates(true);
+        queue(&bulk, 3);
+
+        WriteResult result;
+        ASSERT_THROWS(bulk.execute(&WriteConcern::acknowledged, &result), OperationException);
+
+        ASSERT_EQUALS(3U, result.writeErrors().size());
+        for (int i = 0; i < 3; i++) {
+            const BSONObj error = result.writeErrors()[i];
+            ASSERT_EQUALS(i, error["index"].numberInt());
+            ASSERT_EQUALS(BSON("_id" << i), error["op"]["q"].Obj());
+        }
+    }
+
+} // namespace
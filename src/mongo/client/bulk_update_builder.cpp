@@ -18,8 +18,7 @@
 #include "mongo/client/bulk_update_builder.h"
 
 #include "mongo/client/bulk_operation_builder.h"
-#include "mongo/client/delete_write_operation.h"
-#include "mongo/client/update_write_operation.h"
+#include "mongo/client/write_operation_queue.h"
 #include "mongo/client/write_options.h"
 
 namespace mongo {
@@ -35,8 +34,7 @@ namespace mongo {
         uassert(0, "update object must consist of $-prefixed modifiers",
             update.firstElementFieldName()[0] == '$');
 
-        UpdateWriteOperation* update_op = new UpdateWriteOperation(_selector, update, 0);
-        _builder->enqueue(update_op);
+        _builder->_operations->update(_selector, update, 0);
     }
 
     void BulkUpdateBuilder::update(const BSONObj& update) {
@@ -45,9 +43,7 @@ namespace mongo {
         uassert(0, "update object must consist of $-prefixed modifiers",
             update.firstElementFieldName()[0] == '$');
 
-        UpdateWriteOperation* update_op = new UpdateWriteOperation(
-            _selector, update, UpdateOption_Multi);
-        _builder->enqueue(update_op);
+        _builder->_operations->update(_selector, update, UpdateOption_Multi);
     }
 
     void BulkUpdateBuilder::replaceOne(const BSONObj& replacement) {
@@ -55,19 +51,15 @@ namespace mongo {
             uassert(0, "replacement object must not include $ operators",
                 replacement.firstElementFieldName()[0] != '$');
 
-        UpdateWriteOperation* update_op = new UpdateWriteOperation(
-            _selector, replacement, 0);
-        _builder->enqueue(update_op);
+        _builder->_operations->update(_selector, replacement, 0);
     }
 
     void BulkUpdateBuilder::remove() {
-        DeleteWriteOperation* delete_op = new DeleteWriteOperation(_selector, 0);
-        _builder->enqueue(delete_op);
+        _builder->_operations->remove(_selector, 0);
     }
 
     void BulkUpdateBuilder::removeOne() {
-        DeleteWriteOperation* delete_op = new DeleteWriteOperation(_selector, RemoveOption_JustOne);
-        _builder->enqueue(delete_op);
+        _builder->_operations->remove(_selector, RemoveOption_JustOne);
     }
 
     BulkUpsertBuilder BulkUpdateBuilder::upsert() {
@@ -18,7 +18,7 @@
 #include "mongo/client/bulk_upsert_builder.h"
 
 #include "mongo/client/bulk_operation_builder.h"
-#include "mongo/client/update_write_operation.h"
+#include "mongo/client/write_operation_queue.h"
 #include "mongo/client/write_options.h"
 
 namespace mongo {
@@ -34,9 +34,7 @@ namespace mongo {
         uassert(0, "update object must consist of $-prefixed modifiers",
             update.firstElementFieldName()[0] == '$');
 
-        UpdateWriteOperation* update_op = new UpdateWriteOperation(
-            _selector, update, UpdateOption_Upsert);
-        _builder->enqueue(update_op);
+        _builder->_operations->update(_selector, update, UpdateOption_Upsert);
     }
 
     void BulkUpsertBuilder::update(const BSONObj& update) {
@@ -45,9 +43,8 @@ namespace mongo {
         uassert(0, "update object must consist of $-prefixed modifiers",
             update.firstElementFieldName()[0] == '$');
 
-        UpdateWriteOperation* update_op = new UpdateWriteOperation(
+        _builder->_operations->update(
             _selector, update, UpdateOption_Upsert + UpdateOption_Multi);
-        _builder->enqueue(update_op);
     }
 
     void BulkUpsertBuilder::replaceOne(const BSONObj& replacement) {
@@ -55,9 +52,7 @@ namespace mongo {
             uassert(0, "replacement object must not include $ operators",
                 replacement.firstElementFieldName()[0] != '$');
 
-        UpdateWriteOperation* update_op = new UpdateWriteOperation(
-            _selector, replacement, UpdateOption_Upsert);
-        _builder->enqueue(update_op);
+        _builder->_operations->update(_selector, replacement, UpdateOption_Upsert);
     }
 
 } // namespace mongo
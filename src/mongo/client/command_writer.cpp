@@ -16,6 +16,7 @@
 #include "mongo/client/command_writer.h"
 
 #include "mongo/client/dbclientinterface.h"
+#include "mongo/client/operation_trace.h"
 #include "mongo/client/write_result.h"
 #include "mongo/db/namespace_string.h"
 
@@ -34,6 +35,8 @@ namespace mongo {
         const WriteConcern* writeConcern,
         WriteResult* writeResult
     ) {
+        const OperationTrace::Scope trace("writeCommand", ns);
+
         // Effectively a map of batch relative indexes to WriteOperations
         std::vector<WriteOperation*> batchOps;
 
@@ -92,6 +95,12 @@ namespace mongo {
             // End the command for this batch.
             _endCommand(batch.get(), *batch_iter, ordered, command.get());
 
+            // The batch and the command it was copied into are both held until the reply
+            // arrives, so account for their buffers while the command is in flight.
+            const MemoryBudget::Charge inFlight(
+                _client->getMemoryBudget().get(),
+                batch->bb().getSize() + command->bb().getSize());
+
             // Issue the complete command.
             BSONObj batchResult = _send(command.get(), writeConcern, ns);
 
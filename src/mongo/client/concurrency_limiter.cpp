@@ -0,0 +1,187 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/concurrency_limiter.h"
+
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+#include <cmath>
+#include <map>
+
+#include "mongo/client/options.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+    using boost::shared_ptr;
+    using std::map;
+    using std::string;
+
+    namespace {
+
+        typedef map<string, shared_ptr<ConcurrencyLimiter> > LimiterMap;
+
+        // Both are leaked so that connections destroyed during shutdown can still return
+        // their slots.
+        boost::mutex* const limitersMutex = new boost::mutex();
+        LimiterMap* const limiters = new LimiterMap();
+
+    } // namespace
+
+    const int ConcurrencyLimiter::kMinLimit(1);
+    const int ConcurrencyLimiter::kMinRttWindow(100);
+
+    ConcurrencyLimiter::ConcurrencyLimiter(int initialLimit, int maxLimit)
+        : _maxLimit(std::max(kMinLimit, maxLimit))
+        , _limit(std::min(std::max(kMinLimit, initialLimit), _maxLimit))
+        , _inFlight(0)
+        , _minRttMicros(0)
+        , _windowMinRttMicros(0)
+        , _lastRttMicros(0)
+        , _samplesInWindow(0)
+        , _accepted(0)
+        , _rejected(0)
+        , _failed(0) {
+    }
+
+    shared_ptr<ConcurrencyLimiter> ConcurrencyLimiter::forHost(const string& host) {
+        const client::Options& options = client::Options::current();
+        if (!options.concurrencyLimiting())
+            return shared_ptr<ConcurrencyLimiter>();
+
+        boost::lock_guard<boost::mutex> lk(*limitersMutex);
+        shared_ptr<ConcurrencyLimiter>& limiter = (*limiters)[host];
+        if (!limiter) {
+            limiter.reset(new ConcurrencyLimiter(options.initialConcurrencyLimit(),
+                                                 options.maxConcurrencyLimit()));
+        }
+        return limiter;
+    }
+
+    void ConcurrencyLimiter::appendAllInfo(BSONObjBuilder& b) {
+        boost::lock_guard<boost::mutex> lk(*limitersMutex);
+        for (LimiterMap::const_iterator i = limiters->begin(); i != limiters->end(); ++i) {
+            BSONObjBuilder hostBuilder(b.subobjStart(i->first));
+            i->second->appendInfo(hostBuilder);
+            hostBuilder.done();
+        }
+    }
+
+    void ConcurrencyLimiter::clearAll() {
+        boost::lock_guard<boost::mutex> lk(*limitersMutex);
+        limiters->clear();
+    }
+
+    bool ConcurrencyLimiter::tryAcquire() {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        if (_inFlight >= static_cast<int>(_limit)) {
+            _rejected++;
+            return false;
+        }
+        _inFlight++;
+        _accepted++;
+        return true;
+    }
+
+    void ConcurrencyLimiter::onSuccess(long long rttMicros) {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        const int inFlight = _inFlight--;
+
+        rttMicros = std::max(1LL, rttMicros);
+        _lastRttMicros = rttMicros;
+
+        if (_windowMinRttMicros == 0 || rttMicros < _windowMinRttMicros)
+            _windowMinRttMicros = rttMicros;
+        if (_minRttMicros == 0 || rttMicros < _minRttMicros)
+            _minRttMicros = rttMicros;
+        if (++_samplesInWindow >= kMinRttWindow) {
+            _minRttMicros = _windowMinRttMicros;
+            _windowMinRttMicros = 0;
+            _samplesInWindow = 0;
+        }
+
+        const double gradient =
+            std::max(0.5, std::min(1.0, double(_minRttMicros) / double(rttMicros)));
+        double newLimit = _limit * gradient + std::sqrt(_limit);
+
+        // Only a limit that is actually being used has earned the right to grow
+        if (newLimit > _limit && inFlight < _limit / 2)
+            newLimit = _limit;
+
+        _limit = _limit * 0.8 + newLimit * 0.2;
+        _limit = std::min(double(_maxLimit), std::max(double(kMinLimit), _limit));
+    }
+
+    void ConcurrencyLimiter::onFailure() {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        _inFlight--;
+        _failed++;
+        _limit = std::max(double(kMinLimit), _limit * 0.9);
+    }
+
+    int ConcurrencyLimiter::getLimit() const {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        return static_cast<int>(_limit);
+    }
+
+    int ConcurrencyLimiter::getInFlight() const {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        return _inFlight;
+    }
+
+    void ConcurrencyLimiter::appendInfo(BSONObjBuilder& b) const {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        b.append("limit", static_cast<int>(_limit));
+        b.append("maxLimit", _maxLimit);
+        b.append("inFlight", _inFlight);
+        b.appendNumber("minRttMicros", _minRttMicros);
+        b.appendNumber("lastRttMicros", _lastRttMicros);
+        b.appendNumber("accepted", _accepted);
+        b.appendNumber("rejected", _rejected);
+        b.appendNumber("failed", _failed);
+    }
+
+    // ------ ConcurrencyLimiter::Permit ------
+
+    ConcurrencyLimiter::Permit::Permit(const shared_ptr<ConcurrencyLimiter>& limiter,
+                                       const string& host)
+        : _limiter(limiter)
+        , _startMicros(curTimeMicros64())
+        , _done(!limiter) {
+        if (_limiter && !_limiter->tryAcquire()) {
+            uasserted(17400, mongoutils::str::stream() << "too many requests in flight to "
+                                                       << host << " (limit "
+                                                       << _limiter->getLimit() << ")");
+        }
+    }
+
+    ConcurrencyLimiter::Permit::~Permit() {
+        if (!_done)
+            _limiter->onFailure();
+    }
+
+    void ConcurrencyLimiter::Permit::succeeded() {
+        if (_done)
+            return;
+        _done = true;
+        _limiter->onSuccess(static_cast<long long>(curTimeMicros64() - _startMicros));
+    }
+
+} // namespace mongo
@@ -0,0 +1,120 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+#include <string>
+
+#include "mongo/client/export_macros.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /**
+     * Adaptive limit on the number of requests in flight to one host.
+     *
+     * The limit follows the ratio between the lowest round trip time seen recently and the
+     * latest one: while requests come back as fast as the best case, the limit grows by
+     * roughly its square root per sample; as queueing on the server inflates round trip
+     * times, the gradient drops below one and the limit shrinks towards the concurrency the
+     * host actually sustains. Failed requests cut the limit multiplicatively.
+     *
+     * Requests over the limit are rejected immediately rather than queued, so a slow host
+     * sheds load instead of accumulating it. DBClientReplicaSet treats a rejected secondary
+     * like an unreachable one and selects another node.
+     *
+     * Thread safety: all methods may be called concurrently.
+     */
+    class MONGO_CLIENT_API ConcurrencyLimiter : boost::noncopyable {
+    public:
+
+        // The limit never drops below this, so an idle host can always be probed
+        static const int kMinLimit;
+
+        ConcurrencyLimiter(int initialLimit, int maxLimit);
+
+        /**
+         * Returns the limiter for 'host', creating it on first use, or NULL when limiting is
+         * disabled through client::Options::setConcurrencyLimiting.
+         */
+        static boost::shared_ptr<ConcurrencyLimiter> MONGO_CLIENT_FUNC forHost(
+            const std::string& host);
+
+        /** Appends the state of every per-host limiter, keyed by host. */
+        static void MONGO_CLIENT_FUNC appendAllInfo(BSONObjBuilder& b);
+
+        /** Forgets all per-host limiters. */
+        static void MONGO_CLIENT_FUNC clearAll();
+
+        /**
+         * Reserves a slot for one request.
+         *
+         * @return false, without reserving anything, if the limit has been reached.
+         */
+        bool tryAcquire();
+
+        /** Returns a slot after a request completed in 'rttMicros'. */
+        void onSuccess(long long rttMicros);
+
+        /** Returns a slot after a request failed. */
+        void onFailure();
+
+        int getLimit() const;
+        int getInFlight() const;
+
+        void appendInfo(BSONObjBuilder& b) const;
+
+        /**
+         * Holds a slot for the lifetime of the object. Call succeeded() once the reply has
+         * been received; a Permit destroyed without it counts as a failure. Throws if no slot
+         * is available.
+         */
+        class MONGO_CLIENT_API Permit : boost::noncopyable {
+        public:
+            Permit(const boost::shared_ptr<ConcurrencyLimiter>& limiter,
+                   const std::string& host);
+            ~Permit();
+
+            void succeeded();
+
+        private:
+            const boost::shared_ptr<ConcurrencyLimiter> _limiter;
+            const unsigned long long _startMicros;
+            bool _done;
+        };
+
+    private:
+        // Samples after which the minimum round trip time is re-measured, so the baseline
+        // follows lasting changes in the network or the host
+        static const int kMinRttWindow;
+
+        mutable boost::mutex _mutex;
+        const int _maxLimit;
+        double _limit;
+        int _inFlight;
+        long long _minRttMicros;
+        long long _windowMinRttMicros;
+        long long _lastRttMicros;
+        int _samplesInWindow;
+        long long _accepted;
+        long long _rejected;
+        long long _failed;
+    };
+
+} // namespace mongo
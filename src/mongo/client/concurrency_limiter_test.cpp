@@ -0,0 +1,117 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/concurrency_limiter.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using boost::shared_ptr;
+    using mongo::BSONObj;
+    using mongo::BSONObjBuilder;
+    using mongo::ConcurrencyLimiter;
+
+    // Keeps 'n' requests in flight and completes them all in 'rttMicros', 'rounds' times.
+    void runRounds(ConcurrencyLimiter* limiter, int n, long long rttMicros, int rounds) {
+        for (int round = 0; round < rounds; round++) {
+            int acquired = 0;
+            while (acquired < n && limiter->tryAcquire())
+                acquired++;
+            for (int i = 0; i < acquired; i++)
+                limiter->onSuccess(rttMicros);
+        }
+    }
+
+    TEST(ConcurrencyLimiterTest, RejectsOverLimit) {
+        ConcurrencyLimiter limiter(2, 10);
+        ASSERT_TRUE(limiter.tryAcquire());
+        ASSERT_TRUE(limiter.tryAcquire());
+        ASSERT_FALSE(limiter.tryAcquire());
+        ASSERT_EQUALS(2, limiter.getInFlight());
+
+        limiter.onSuccess(100);
+        ASSERT_TRUE(limiter.tryAcquire());
+        limiter.onSuccess(100);
+        limiter.onSuccess(100);
+        ASSERT_EQUALS(0, limiter.getInFlight());
+    }
+
+    TEST(ConcurrencyLimiterTest, GrowsWhileLatencyIsStable) {
+        ConcurrencyLimiter limiter(4, 100);
+        runRounds(&limiter, 1000, 100, 50);
+        ASSERT_GREATER_THAN(limiter.getLimit(), 20);
+        ASSERT_LESS_THAN_OR_EQUALS(limiter.getLimit(), 100);
+    }
+
+    TEST(ConcurrencyLimiterTest, DoesNotGrowWhenUnderused) {
+        ConcurrencyLimiter limiter(10, 100);
+        runRounds(&limiter, 1, 100, 100);
+        ASSERT_EQUALS(10, limiter.getLimit());
+    }
+
+    TEST(ConcurrencyLimiterTest, ShrinksWhenLatencyRises) {
+        ConcurrencyLimiter limiter(50, 100);
+        runRounds(&limiter, 1000, 100, 5);
+        const int before = limiter.getLimit();
+
+        // The host slowed down ten times over
+        runRounds(&limiter, 1000, 1000, 20);
+        ASSERT_LESS_THAN(limiter.getLimit(), before / 2);
+        ASSERT_GREATER_THAN_OR_EQUALS(limiter.getLimit(), ConcurrencyLimiter::kMinLimit);
+    }
+
+    TEST(ConcurrencyLimiterTest, FailuresBackOff) {
+        ConcurrencyLimiter limiter(100, 100);
+        for (int i = 0; i < 10; i++) {
+            ASSERT_TRUE(limiter.tryAcquire());
+            limiter.onFailure();
+        }
+        ASSERT_LESS_THAN(limiter.getLimit(), 40);
+        ASSERT_EQUALS(0, limiter.getInFlight());
+    }
+
+    TEST(ConcurrencyLimiterTest, PermitReleasesSlot) {
+        shared_ptr<ConcurrencyLimiter> limiter(new ConcurrencyLimiter(1, 1));
+        {
+            ConcurrencyLimiter::Permit permit(limiter, "host:27017");
+            ASSERT_EQUALS(1, limiter->getInFlight());
+            ASSERT_THROWS(ConcurrencyLimiter::Permit(limiter, "host:27017"),
+                          mongo::UserException);
+            permit.succeeded();
+        }
+        ASSERT_EQUALS(0, limiter->getInFlight());
+
+        {
+            ConcurrencyLimiter::Permit permit(limiter, "host:27017");
+        }
+
+        BSONObjBuilder b;
+        limiter->appendInfo(b);
+        const BSONObj info = b.obj();
+        ASSERT_EQUALS(0, info["inFlight"].numberInt());
+        ASSERT_EQUALS(2, info["accepted"].numberLong());
+        ASSERT_EQUALS(1, info["rejected"].numberLong());
+        ASSERT_EQUALS(1, info["failed"].numberLong());
+    }
+
+    TEST(ConcurrencyLimiterTest, PermitWithoutLimiter) {
+        ConcurrencyLimiter::Permit permit(shared_ptr<ConcurrencyLimiter>(), "host:27017");
+        permit.succeeded();
+    }
+
+} // namespace
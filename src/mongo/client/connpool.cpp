@@ -20,9 +20,17 @@
 
 #include "mongo/client/connpool.h"
 
+#include <algorithm>
 #include <boost/thread/locks.hpp>
+#include <boost/thread/thread_time.hpp>
 
+#include "mongo/client/concurrency_limiter.h"
+#include "mongo/client/operation_trace.h"
+#include "mongo/client/query_shape_profiler.h"
 #include "mongo/client/replica_set_monitor.h"
+#include "mongo/util/concurrency/task_executor.h"
+#include "mongo/util/memory_budget.h"
+#include "mongo/util/operation_deadline.h"
 
 namespace mongo {
 
@@ -72,7 +80,7 @@ namespace mongo {
         if (microSec != DBClientBase::INVALID_SOCK_CREATION_TIME &&
                 microSec > _minValidCreationTimeMicroSec) {
             _minValidCreationTimeMicroSec = microSec;
-            log() << "Detected bad connection created at " << _minValidCreationTimeMicroSec
+            LOG(0) << "Detected bad connection created at " << _minValidCreationTimeMicroSec
                     << " microSec, clearing pool for " << _hostName
                     << " of " << _pool.size() << " connections" << endl;
             clear();
@@ -177,19 +185,155 @@ namespace mongo {
         }
     }
 
+    int PoolForHost::_inUse(const string& trafficClass) const {
+        map<string, ClassStats>::const_iterator i = _classes.find(trafficClass);
+        return i == _classes.end() ? 0 : i->second.inUse;
+    }
+
+    bool PoolForHost::canCheckOut(const string& trafficClass,
+                                  const TrafficClassMap& classes,
+                                  int maxInUse) const {
+        TrafficClassOptions options;
+        TrafficClassMap::const_iterator found = classes.find(trafficClass);
+        if (found != classes.end())
+            options = found->second;
+
+        const int inUse = _inUse(trafficClass);
+
+        if (options.maxInUse >= 0 && inUse >= options.maxInUse)
+            return false;
+
+        // Capacity reserved for this class is always available to it
+        if (inUse < options.reserved)
+            return true;
+
+        if (maxInUse < 0)
+            return true;
+
+        // Anything else is borrowed, and must leave room for the unused reservations of the
+        // other classes
+        int reservedElsewhere = 0;
+        for (TrafficClassMap::const_iterator i = classes.begin(); i != classes.end(); ++i) {
+            if (i->first == trafficClass)
+                continue;
+            reservedElsewhere += std::max(0, i->second.reserved - _inUse(i->first));
+        }
+
+        return _totalInUse + reservedElsewhere < maxInUse;
+    }
+
+    void PoolForHost::checkedOut(const string& trafficClass) {
+        ClassStats& stats = _classes[trafficClass];
+        stats.inUse++;
+        stats.checkouts++;
+        _totalInUse++;
+    }
+
+    void PoolForHost::checkedIn(const string& trafficClass) {
+        ClassStats& stats = _classes[trafficClass];
+        verify(stats.inUse > 0);
+        stats.inUse--;
+        _totalInUse--;
+    }
+
+    void PoolForHost::appendTrafficClassInfo(BSONObjBuilder& b) const {
+        for (map<string, ClassStats>::const_iterator i = _classes.begin();
+                i != _classes.end(); ++i) {
+            BSONObjBuilder classBuilder(b.subobjStart(i->first));
+            classBuilder.append("inUse", i->second.inUse);
+            classBuilder.appendNumber("checkouts", i->second.checkouts);
+            classBuilder.appendNumber("waits", i->second.waits);
+            classBuilder.appendNumber("timeouts", i->second.timeouts);
+            classBuilder.done();
+        }
+    }
+
     // ------ DBConnectionPool ------
 
     DBConnectionPool pool;
 
     const int PoolForHost::kPoolSizeUnlimited(-1);
 
+    const int TrafficClassOptions::kDefaultMaxWaitMillis(5000);
+
+    const char DBConnectionPool::kDefaultTrafficClass[] = "default";
+
     DBConnectionPool::DBConnectionPool() 
         : _mutex(),
           _name( "dbconnectionpool" ) , 
           _maxPoolSize(PoolForHost::kPoolSizeUnlimited) ,
+          _maxInUsePerHost(PoolForHost::kPoolSizeUnlimited) ,
           _hooks( new list<DBConnectionHook*>() ) {
     }
 
+    void DBConnectionPool::setTrafficClass(const string& name,
+                                           const TrafficClassOptions& options) {
+        boost::lock_guard<boost::mutex> L(_mutex);
+        _trafficClasses[name] = options;
+        // Raised limits may admit waiters
+        _slotReleased.notify_all();
+    }
+
+    void DBConnectionPool::setMaxInUsePerHost(int maxInUse) {
+        boost::lock_guard<boost::mutex> L(_mutex);
+        _maxInUsePerHost = maxInUse;
+        _slotReleased.notify_all();
+    }
+
+    int DBConnectionPool::getMaxInUsePerHost() {
+        boost::lock_guard<boost::mutex> L(_mutex);
+        return _maxInUsePerHost;
+    }
+
+    void DBConnectionPool::_acquireSlot(const string& ident,
+                                        double socketTimeout,
+                                        const string& trafficClass) {
+        boost::unique_lock<boost::mutex> lk(_mutex);
+        PoolForHost& p = _pools[PoolKey(ident,socketTimeout)];
+        p.initializeHostName(ident);
+
+        if (!p.canCheckOut(trafficClass, _trafficClasses, _maxInUsePerHost)) {
+            p.noteWaited(trafficClass);
+
+            TrafficClassOptions options;
+            PoolForHost::TrafficClassMap::const_iterator found =
+                _trafficClasses.find(trafficClass);
+            if (found != _trafficClasses.end())
+                options = found->second;
+
+            // Never wait past the deadline of the operation the connection is for
+            long long waitMillis = options.maxWaitMillis;
+            const long long deadlineMillis = OperationDeadline::remainingMillis();
+            if (deadlineMillis >= 0 && deadlineMillis < waitMillis)
+                waitMillis = deadlineMillis;
+
+            const boost::system_time deadline =
+                boost::get_system_time() + boost::posix_time::milliseconds(waitMillis);
+
+            while (!p.canCheckOut(trafficClass, _trafficClasses, _maxInUsePerHost)) {
+                if (!_slotReleased.timed_wait(lk, deadline) &&
+                        !p.canCheckOut(trafficClass, _trafficClasses, _maxInUsePerHost)) {
+                    p.noteTimedOut(trafficClass);
+                    uasserted(ErrorCodes::ExceededTimeLimit,
+                              str::stream() << _name << ": timed out after "
+                                            << waitMillis << "ms waiting for a "
+                                            << trafficClass << " connection to " << ident
+                                            << " (" << p.numInUse() << " in use)");
+                }
+            }
+        }
+
+        p.checkedOut(trafficClass);
+    }
+
+    void DBConnectionPool::releaseSlot(const string& host,
+                                       double socketTimeout,
+                                       const string& trafficClass) {
+        boost::lock_guard<boost::mutex> L(_mutex);
+        _pools[PoolKey(host,socketTimeout)].checkedIn(trafficClass);
+        _slotReleased.notify_all();
+    }
+
     DBClientBase* DBConnectionPool::_get(const string& ident , double socketTimeout ) {
         boost::lock_guard<boost::mutex> L(_mutex);
         PoolForHost& p = _pools[PoolKey(ident,socketTimeout)];
@@ -220,6 +364,8 @@ namespace mongo {
     }
 
     DBClientBase* DBConnectionPool::get(const ConnectionString& url, double socketTimeout) {
+        OperationDeadline::check("connection pool checkout");
+        const OperationTrace::Timer checkoutTimer(OperationTrace::kCheckout);
         DBClientBase * c = _get( url.toString() , socketTimeout );
         if ( c ) {
             try {
@@ -240,6 +386,8 @@ namespace mongo {
     }
 
     DBClientBase* DBConnectionPool::get(const string& host, double socketTimeout) {
+        OperationDeadline::check("connection pool checkout");
+        const OperationTrace::Timer checkoutTimer(OperationTrace::kCheckout);
         DBClientBase * c = _get( host , socketTimeout );
         if ( c ) {
             try {
@@ -262,6 +410,34 @@ namespace mongo {
         return _finishCreate( host , socketTimeout , c );
     }
 
+    DBClientBase* DBConnectionPool::get(const ConnectionString& url,
+                                        double socketTimeout,
+                                        const string& trafficClass) {
+        const OperationTrace::Timer checkoutTimer(OperationTrace::kCheckout);
+        _acquireSlot(url.toString(), socketTimeout, trafficClass);
+        try {
+            return get(url, socketTimeout);
+        }
+        catch (...) {
+            releaseSlot(url.toString(), socketTimeout, trafficClass);
+            throw;
+        }
+    }
+
+    DBClientBase* DBConnectionPool::get(const string& host,
+                                        double socketTimeout,
+                                        const string& trafficClass) {
+        const OperationTrace::Timer checkoutTimer(OperationTrace::kCheckout);
+        _acquireSlot(host, socketTimeout, trafficClass);
+        try {
+            return get(host, socketTimeout);
+        }
+        catch (...) {
+            releaseSlot(host, socketTimeout, trafficClass);
+            throw;
+        }
+    }
+
     void DBConnectionPool::release(const string& host, DBClientBase *c) {
         boost::lock_guard<boost::mutex> L(_mutex);
         _pools[PoolKey(host,c->getSoTimeout())].done(this,c);
@@ -334,6 +510,7 @@ namespace mongo {
     void DBConnectionPool::appendInfo( BSONObjBuilder& b ) {
 
         int avail = 0;
+        int inUse = 0;
         long long created = 0;
 
 
@@ -351,9 +528,16 @@ namespace mongo {
                 BSONObjBuilder temp( bb.subobjStart( s ) );
                 temp.append( "available" , i->second.numAvailable() );
                 temp.appendNumber( "created" , i->second.numCreated() );
+                temp.append( "inUse" , i->second.numInUse() );
+                {
+                    BSONObjBuilder classes( temp.subobjStart( "trafficClasses" ) );
+                    i->second.appendTrafficClassInfo( classes );
+                    classes.done();
+                }
                 temp.done();
 
                 avail += i->second.numAvailable();
+                inUse += i->second.numInUse();
                 created += i->second.numCreated();
 
                 long long& x = createdByType[i->second.type()];
@@ -389,7 +573,26 @@ namespace mongo {
         }
 
         b.append( "totalAvailable" , avail );
+        b.append( "totalInUse" , inUse );
         b.appendNumber( "totalCreated" , created );
+
+        BSONObjBuilder memoryBuilder( b.subobjStart( "memory" ) );
+        MemoryBudget::global()->appendInfo( memoryBuilder );
+        memoryBuilder.done();
+
+        BSONObjBuilder executorBuilder( b.subobjStart( "taskExecutor" ) );
+        TaskExecutor::global()->appendInfo( executorBuilder );
+        executorBuilder.done();
+
+        BSONObjBuilder limitsBuilder( b.subobjStart( "concurrencyLimits" ) );
+        ConcurrencyLimiter::appendAllInfo( limitsBuilder );
+        limitsBuilder.done();
+
+        if ( QueryShapeProfiler* profiler = QueryShapeProfiler::global() ) {
+            BSONObjBuilder shapesBuilder( b.subobjStart( "queryShapes" ) );
+            profiler->appendInfo( shapesBuilder, 10 );
+            shapesBuilder.done();
+        }
     }
 
     bool DBConnectionPool::serverNameCompare::operator()( const string& a , const string& b ) const{
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <boost/thread/condition_variable.hpp>
+#include <map>
 #include <stack>
 
 #include "mongo/client/dbclientinterface.h"
@@ -30,6 +32,26 @@ namespace mongo {
     class Shard;
     class DBConnectionPool;
 
+    /**
+     * Limits applied to one traffic class (e.g. "interactive", "batch", "monitoring") within
+     * each host pool. See DBConnectionPool::setTrafficClass.
+     */
+    struct MONGO_CLIENT_API TrafficClassOptions {
+        TrafficClassOptions() : maxInUse(-1), reserved(0), maxWaitMillis(kDefaultMaxWaitMillis) {}
+
+        static const int kDefaultMaxWaitMillis;
+
+        // The most connections this class may have checked out per host, -1 for no limit
+        int maxInUse;
+
+        // Connections per host kept available for this class: other classes may only borrow
+        // them while the per-host limit leaves room for every outstanding reservation
+        int reserved;
+
+        // How long a checkout waits for a free slot before throwing
+        int maxWaitMillis;
+    };
+
     /**
      * not thread safe
      * thread safety is handled by DBConnectionPool
@@ -40,20 +62,25 @@ namespace mongo {
         // Sentinel value indicating pool has no cleanup limit
         static const int kPoolSizeUnlimited;
 
+        typedef std::map<std::string, TrafficClassOptions> TrafficClassMap;
+
         PoolForHost() :
             _created(0),
             _minValidCreationTimeMicroSec(0),
             _type(ConnectionString::INVALID),
-            _maxPoolSize(kPoolSizeUnlimited) {
+            _maxPoolSize(kPoolSizeUnlimited),
+            _totalInUse(0) {
         }
 
         PoolForHost(const PoolForHost& other) :
             _created(other._created),
             _minValidCreationTimeMicroSec(other._minValidCreationTimeMicroSec),
             _type(other._type),
-            _maxPoolSize(other._maxPoolSize) {
+            _maxPoolSize(other._maxPoolSize),
+            _totalInUse(other._totalInUse) {
             verify(_created == 0);
             verify(other._pool.size() == 0);
+            verify(other._totalInUse == 0);
         }
 
         ~PoolForHost();
@@ -106,8 +133,37 @@ namespace mongo {
          */
         void initializeHostName(const std::string& hostName);
 
+        /**
+         * @return true if a connection of the given traffic class may be checked out now,
+         *     given the per-class limits and the per-host limit 'maxInUse' (-1 for none).
+         */
+        bool canCheckOut(const std::string& trafficClass,
+                         const TrafficClassMap& classes,
+                         int maxInUse) const;
+
+        void checkedOut(const std::string& trafficClass);
+        void checkedIn(const std::string& trafficClass);
+
+        void noteWaited(const std::string& trafficClass) { _classes[trafficClass].waits++; }
+        void noteTimedOut(const std::string& trafficClass) { _classes[trafficClass].timeouts++; }
+
+        int numInUse() const { return _totalInUse; }
+
+        void appendTrafficClassInfo(BSONObjBuilder& b) const;
+
     private:
 
+        struct ClassStats {
+            ClassStats() : inUse(0), checkouts(0), waits(0), timeouts(0) {}
+
+            int inUse;
+            long long checkouts;
+            long long waits;
+            long long timeouts;
+        };
+
+        int _inUse(const std::string& trafficClass) const;
+
         struct StoredConnection {
             StoredConnection( DBClientBase * c );
 
@@ -126,6 +182,10 @@ namespace mongo {
 
         // The maximum number of connections we'll save in the pool
         int _maxPoolSize;
+
+        // Connections handed out through a traffic class and not yet returned
+        std::map<std::string, ClassStats> _classes;
+        int _totalInUse;
     };
 
     class DBConnectionHook {
@@ -177,6 +237,23 @@ namespace mongo {
          */
         void setMaxPoolSize( int maxPoolSize ) { _maxPoolSize = maxPoolSize; }
 
+        // The traffic class used when none is given
+        static const char kDefaultTrafficClass[];
+
+        /**
+         * Defines or replaces the limits of a traffic class. Classes that were never set use
+         * default TrafficClassOptions: no limit of their own and no reservation.
+         */
+        void setTrafficClass( const std::string& name, const TrafficClassOptions& options );
+
+        /**
+         * Sets the maximum number of connections per-host that may be checked out through
+         * traffic classes at the same time. PoolForHost::kPoolSizeUnlimited (the default)
+         * means no limit, in which case only per-class maxInUse limits apply.
+         */
+        void setMaxInUsePerHost( int maxInUse );
+        int getMaxInUsePerHost();
+
         void onCreate( DBClientBase * conn );
         void onHandedOut( DBClientBase * conn );
         void onDestroy( DBClientBase * conn );
@@ -188,6 +265,24 @@ namespace mongo {
 
         void release(const std::string& host, DBClientBase *c);
 
+        /**
+         * Like get(), but counts the connection against a traffic class until releaseSlot()
+         * is called with the same host, socketTimeout and class. Blocks up to the class'
+         * maxWaitMillis when the class or host limit is reached, then throws
+         * ExceededTimeLimit.
+         */
+        DBClientBase *get(const std::string& host, double socketTimeout,
+                          const std::string& trafficClass);
+        DBClientBase *get(const ConnectionString& host, double socketTimeout,
+                          const std::string& trafficClass);
+
+        /**
+         * Returns a traffic class slot taken by get(). The connection itself is handed back
+         * separately with release(), or destroyed by the caller.
+         */
+        void releaseSlot(const std::string& host, double socketTimeout,
+                         const std::string& trafficClass);
+
         void addHook( DBConnectionHook * hook ); // we take ownership
         void appendInfo( BSONObjBuilder& b );
 
@@ -225,6 +320,9 @@ namespace mongo {
 
         DBClientBase* _finishCreate( const std::string& ident , double socketTimeout, DBClientBase* conn );
 
+        void _acquireSlot( const std::string& ident, double socketTimeout,
+                           const std::string& trafficClass );
+
         struct PoolKey {
             PoolKey( const std::string& i , double t ) : ident( i ) , timeout( t ) {}
             std::string ident;
@@ -247,6 +345,13 @@ namespace mongo {
 
         PoolMap _pools;
 
+        // Limits per traffic class, and the per-host limit on checked out connections
+        PoolForHost::TrafficClassMap _trafficClasses;
+        int _maxInUsePerHost;
+
+        // Signalled, under _mutex, whenever a traffic class slot is returned
+        boost::condition_variable _slotReleased;
+
         // pointers owned by me, right now they leak on shutdown
         // _hooks itself also leaks because it creates a shutdown race condition
         std::list<DBConnectionHook*> * _hooks;
@@ -287,17 +392,30 @@ namespace mongo {
         /** the main constructor you want to use
             throws UserException if can't connect
             */
-        explicit ScopedDbConnection(const std::string& host, double socketTimeout = 0) : _host(host), _conn( pool.get(host, socketTimeout) ), _socketTimeout( socketTimeout ) {
+        explicit ScopedDbConnection(const std::string& host, double socketTimeout = 0,
+                                    const std::string& trafficClass =
+                                        DBConnectionPool::kDefaultTrafficClass)
+            : _host(host),
+              _conn( pool.get(host, socketTimeout, trafficClass) ),
+              _socketTimeout( socketTimeout ),
+              _trafficClass( trafficClass ) {
             _setSocketTimeout();
         }
 
-        explicit ScopedDbConnection(const ConnectionString& host, double socketTimeout = 0) : _host(host.toString()), _conn( pool.get(host, socketTimeout) ), _socketTimeout( socketTimeout ) {
+        explicit ScopedDbConnection(const ConnectionString& host, double socketTimeout = 0,
+                                    const std::string& trafficClass =
+                                        DBConnectionPool::kDefaultTrafficClass)
+            : _host(host.toString()),
+              _conn( pool.get(host, socketTimeout, trafficClass) ),
+              _socketTimeout( socketTimeout ),
+              _trafficClass( trafficClass ) {
             _setSocketTimeout();
         }
 
         ScopedDbConnection() : _host( "" ) , _conn(0), _socketTimeout( 0 ) {}
 
-        /* @param conn - bind to an existing connection */
+        /* @param conn - bind to an existing connection, which is not counted against any
+                         traffic class */
         ScopedDbConnection(const std::string& host, DBClientBase* conn, double socketTimeout = 0 ) : _host( host ) , _conn( conn ), _socketTimeout( socketTimeout ) {
             _setSocketTimeout();
         }
@@ -334,6 +452,7 @@ namespace mongo {
         void kill() {
             delete _conn;
             _conn = 0;
+            _releaseSlot();
         }
 
         /** Call this when you are done with the connection.
@@ -353,16 +472,27 @@ namespace mongo {
             */
             pool.release(_host, _conn);
             _conn = 0;
+            _releaseSlot();
         }
 
     private:
 
         void _setSocketTimeout();
 
+        void _releaseSlot() {
+            if ( _trafficClass.empty() )
+                return;
+            pool.releaseSlot(_host, _socketTimeout, _trafficClass);
+            _trafficClass.clear();
+        }
+
         const std::string _host;
         DBClientBase *_conn;
         const double _socketTimeout;
 
+        // Empty once the connection no longer counts against a traffic class
+        std::string _trafficClass;
+
     };
 
 } // namespace mongo
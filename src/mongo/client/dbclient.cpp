@@ -27,18 +27,18 @@
 #include "mongo/client/dbclientcursorshimarray.h"
 #include "mongo/client/dbclientcursorshimcursorid.h"
 #include "mongo/client/dbclient_writer.h"
-#include "mongo/client/insert_write_operation.h"
+#include "mongo/client/operation_trace.h"
 #include "mongo/client/options.h"
-#include "mongo/client/update_write_operation.h"
-#include "mongo/client/delete_write_operation.h"
 #include "mongo/client/sasl_client_authenticate.h"
 #include "mongo/client/wire_protocol_writer.h"
+#include "mongo/client/write_operation_queue.h"
 #include "mongo/client/write_result.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/json.h"
 #include "mongo/db/namespace_string.h"
 #include "mongo/util/assert_util.h"
 #include "mongo/util/net/ssl_manager.h"
+#include "mongo/util/operation_deadline.h"
 #include "mongo/util/password_digest.h"
 
 #include <boost/algorithm/string/classification.hpp>
@@ -605,6 +605,7 @@ namespace mongo {
                                           const BSONObj& cmd,
                                           BSONObj &info,
                                           int options) {
+        const OperationTrace::Scope trace("command", dbname);
         string ns = dbname + ".$cmd";
         if (_runCommandHook) {
             BSONObjBuilder cmdObj;
@@ -733,6 +734,7 @@ namespace mongo {
     }
 
     void DBClientWithCommands::_auth(const BSONObj& params) {
+        const OperationTrace::Timer authTimer(OperationTrace::kAuth);
         std::string mechanism;
 
         uassertStatusOK(bsonExtractStringField(params,
@@ -1279,13 +1281,13 @@ namespace mongo {
     }
 
     bool DBClientConnection::_connect( string& errmsg ) {
+        const OperationTrace::Timer connectTimer( OperationTrace::kConnect );
         _serverString = _server.toString();
         _serverAddrString.clear();
 
-        // we keep around SockAddr for connection life -- maybe MessagingPort
-        // requires that?
-        server.reset(new SockAddr(_server.host().c_str(), _server.port()));
         p.reset(new MessagingPort( _so_timeout, _logLevel ));
+        p->setMemoryBudget( _memoryBudget );
+        _concurrencyLimiter = ConcurrencyLimiter::forHost( _serverString );
 
         if (_server.host().empty() ) {
             errmsg = str::stream() << "couldn't connect to server " << toString()
@@ -1293,6 +1295,27 @@ namespace mongo {
             return false;
         }
 
+        // Prefer the unix domain socket of a server on this machine, falling back to TCP
+        const client::Options& options = client::Options::current();
+        if ( options.localUnixSocket() ) {
+            const string path = localUnixSocketPath( _server.host(), _server.port(),
+                                                     options.unixSocketPrefix() );
+            if ( !path.empty() ) {
+                server.reset(new SockAddr(path.c_str(), _server.port()));
+                if ( p->connect(*server) ) {
+                    _serverAddrString = path;
+                    LOG( 1 ) << "connected to server " << toString() << " over its unix socket"
+                             << endl;
+                    return _finishConnect();
+                }
+                LOG( 1 ) << "couldn't connect to " << path << ", connecting to "
+                         << _serverString << " over TCP" << endl;
+            }
+        }
+
+        // we keep around SockAddr for connection life -- maybe MessagingPort
+        // requires that?
+        server.reset(new SockAddr(_server.host().c_str(), _server.port()));
         _serverAddrString = server->getAddr();
 
         if ( _serverAddrString == "0.0.0.0" ) {
@@ -1311,6 +1334,13 @@ namespace mongo {
             LOG( 1 ) << "connected to server " << toString() << endl;
         }
 
+        return _finishConnect();
+    }
+
+    bool DBClientConnection::_finishConnect() {
+        if ( client::Options::current().ioUring() )
+            p->psock->enableIoUring();
+
 #ifdef MONGO_SSL
         if (client::Options::current().SSLEnabled())
             return p->secure( sslManager(), _server.host() );
@@ -1416,6 +1446,8 @@ namespace mongo {
         _maxBsonObjectSize = defaultMaxBsonObjectSize;
         _maxMessageSizeBytes = defaultMaxMessageSizeBytes;
         _maxWriteBatchSize = defaultMaxWriteBatchSize;
+        _memoryBudget.reset(new MemoryBudget(
+            MemoryBudget::global(), client::Options::current().connectionMemoryBudgetBytes()));
     }
 
     DBClientBase::~DBClientBase() {
@@ -1666,19 +1698,6 @@ namespace mongo {
 
     }
 
-    namespace {
-        struct ScopedWriteOperations {
-            ScopedWriteOperations() { }
-            ~ScopedWriteOperations() {
-                vector<WriteOperation*>::const_iterator it;
-                for ( it = ops.begin(); it != ops.end(); ++it )
-                    delete *it;
-            }
-            void enqueue(WriteOperation* op) { ops.push_back(op); }
-            std::vector<WriteOperation*> ops;
-        };
-    }
-
     void DBClientBase::insert( const string & ns , BSONObj obj , int flags, const WriteConcern* wc ) {
         vector<BSONObj> toInsert;
         toInsert.push_back( obj );
@@ -1687,19 +1706,20 @@ namespace mongo {
 
     // prefer using the bulk API for this
     void DBClientBase::insert( const string & ns, const vector< BSONObj >& v, int flags , const WriteConcern* wc ) {
-        ScopedWriteOperations inserts;
+        // The documents outlive the write, so the queue only refers to them
+        WriteOperationQueue inserts(false);
 
         vector<BSONObj>::const_iterator bsonObjIter;
         for (bsonObjIter = v.begin(); bsonObjIter != v.end(); ++bsonObjIter) {
             uassert(0, "document to be inserted exceeds maxBsonObjectSize",
                     (*bsonObjIter).objsize() <= getMaxBsonObjectSize());
-            inserts.enqueue( new InsertWriteOperation(*bsonObjIter) );
+            inserts.insert( *bsonObjIter );
         }
 
         bool ordered = !(flags & InsertOption_ContinueOnError);
 
         WriteResult writeResult;
-        _write( ns, inserts.ops, ordered, wc, &writeResult );
+        _write( ns, inserts.operations(), ordered, wc, &writeResult );
     }
 
     void DBClientBase::remove( const string & ns , Query obj , bool justOne, const WriteConcern* wc ) {
@@ -1707,13 +1727,13 @@ namespace mongo {
     }
 
     void DBClientBase::remove( const string & ns , Query obj , int flags, const WriteConcern* wc ) {
-        ScopedWriteOperations deletes;
+        WriteOperationQueue deletes(false);
         uassert(0, "remove selector exceeds maxBsonObjectSize",
                 obj.obj.objsize() <= getMaxBsonObjectSize());
-        deletes.enqueue( new DeleteWriteOperation(obj.obj, flags) );
+        deletes.remove( obj.obj, flags );
 
         WriteResult writeResult;
-        _write( ns, deletes.ops, true, wc, &writeResult );
+        _write( ns, deletes.operations(), true, wc, &writeResult );
     }
 
     void DBClientBase::update( const string & ns , Query query , BSONObj obj , bool upsert, bool multi, const WriteConcern* wc ) {
@@ -1724,15 +1744,15 @@ namespace mongo {
     }
 
     void DBClientBase::update( const string & ns , Query query , BSONObj obj, int flags, const WriteConcern* wc ) {
-        ScopedWriteOperations updates;
+        WriteOperationQueue updates(false);
         uassert(0, "update selector exceeds maxBsonObjectSize",
                 query.obj.objsize() <= getMaxBsonObjectSize());
         uassert(0, "update document exceeds maxBsonObjectSize",
                 obj.objsize() <= getMaxBsonObjectSize());
-        updates.enqueue( new UpdateWriteOperation(query.obj, obj, flags) );
+        updates.update( query.obj, obj, flags );
 
         WriteResult writeResult;
-        _write( ns, updates.ops, true, wc, &writeResult );
+        _write( ns, updates.operations(), true, wc, &writeResult );
     }
 
     BulkOperationBuilder DBClientBase::initializeOrderedBulkOp(const std::string& ns) {
@@ -1868,13 +1888,44 @@ namespace mongo {
         toSend.setData(dbQuery, b.buf(), b.len());
     }
 
+    namespace {
+        /**
+         * Narrows the socket timeout of a connection to the time left before the current
+         * OperationDeadline for the duration of one request, then restores it.
+         */
+        class DeadlineSocketTimeout : boost::noncopyable {
+        public:
+            DeadlineSocketTimeout( MessagingPort& port, double soTimeout, const char* context )
+                : _port( NULL ), _soTimeout( soTimeout ) {
+                if ( !OperationDeadline::active() )
+                    return;
+                OperationDeadline::check( context );
+                _port = &port;
+                _port->setSocketTimeout( OperationDeadline::clampTimeout( soTimeout ) );
+            }
+
+            ~DeadlineSocketTimeout() {
+                if ( _port )
+                    _port->setSocketTimeout( _soTimeout );
+            }
+
+        private:
+            MessagingPort* _port;
+            const double _soTimeout;
+        };
+    } // namespace
+
     void DBClientConnection::say( Message &toSend, bool isRetry , string * actualServer ) {
         checkConnection();
+        const DeadlineSocketTimeout deadlineTimeout( port(), _so_timeout, "sending request" );
+        OperationTrace::noteHost( _serverString );
+        OperationTrace::noteBytes( toSend.size(), 0 );
         try {
             port().say( toSend );
         }
         catch( SocketException & ) {
             _failed = true;
+            OperationDeadline::check( "request was sent" );
             throw;
         }
     }
@@ -1884,11 +1935,14 @@ namespace mongo {
     }
 
     bool DBClientConnection::recv( Message &m ) {
+        const DeadlineSocketTimeout deadlineTimeout( port(), _so_timeout, "receiving reply" );
         if (port().recv(m)) {
+            OperationTrace::noteBytes( 0, m.size() );
             return true;
         }
 
         _failed = true;
+        OperationDeadline::check( "reply was received" );
         return false;
     }
 
@@ -1898,9 +1952,14 @@ namespace mongo {
                  it fails
         */
         checkConnection();
+        const DeadlineSocketTimeout deadlineTimeout( port(), _so_timeout, "sending request" );
+        ConcurrencyLimiter::Permit permit( _concurrencyLimiter, _serverString );
+        OperationTrace::noteHost( _serverString );
+        OperationTrace::noteBytes( toSend.size(), 0 );
         try {
             if ( !port().call(toSend, response) ) {
                 _failed = true;
+                OperationDeadline::check( "reply was received" );
                 if ( assertOk )
                     uasserted( 10278 , str::stream() << "dbclient error communicating with server: " << getServerAddress() );
 
@@ -1909,8 +1968,11 @@ namespace mongo {
         }
         catch( SocketException & ) {
             _failed = true;
+            OperationDeadline::check( "reply was received" );
             throw;
         }
+        permit.succeeded();
+        OperationTrace::noteBytes( 0, response.size() );
         return true;
     }
 
@@ -17,10 +17,19 @@
 
 #include "mongo/client/dbclientcursor.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "mongo/client/connpool.h"
+#include "mongo/client/operation_trace.h"
+#include "mongo/client/options.h"
+#include "mongo/client/query_shape_profiler.h"
 #include "mongo/db/dbmessage.h"
 #include "mongo/db/namespace_string.h"
 #include "mongo/util/debug_util.h"
+#include "mongo/util/memory_budget.h"
+#include "mongo/util/operation_deadline.h"
+#include "mongo/util/time_support.h"
 #include "mongo/client/dbclientcursorshim.h"
 
 namespace mongo {
@@ -44,7 +53,11 @@ namespace mongo {
         resultFlags(0),
         cursorId(),
         _ownCursor( true ),
-        wasError( false ) {
+        wasError( false ),
+        _putBackBytes( 0 ),
+        _lastBatchBytes( 0 ),
+        _lastBatchDocs( 0 ),
+        _queryShapeKey( 0 ) {
         _finishConsInit();
     }
 
@@ -60,7 +73,11 @@ namespace mongo {
         resultFlags(0),
         cursorId(_cursorId),
         _ownCursor(true),
-        wasError(false) {
+        wasError(false),
+        _putBackBytes(0),
+        _lastBatchBytes(0),
+        _lastBatchDocs(0),
+        _queryShapeKey(0) {
         _finishConsInit();
     }
 
@@ -68,6 +85,7 @@ namespace mongo {
 
     void DBClientCursor::_finishConsInit() {
         _originalHost = _client->getServerAddress();
+        _memoryBudget = _client->getMemoryBudget();
     }
 
     int DBClientCursor::nextBatchSize() {
@@ -83,9 +101,109 @@ namespace mongo {
         return batchSize;
     }
 
+    int DBClientCursor::_budgetedBatchSize() {
+        const int wanted = nextBatchSize();
+
+        MemoryBudget* const budget = _memoryBudget.get();
+        long long available = budget->available();
+        if ( available == MemoryBudget::kUnlimited )
+            return wanted;
+
+        if ( available == 0 ) {
+            // Over budget: give other consumers a chance to release memory before asking the
+            // server for more. We never wait forever, as the memory may be held by our caller.
+            budget->noteThrottled();
+            const int maxWaitMillis =
+                client::Options::current().memoryBackpressureMaxWaitMillis();
+            int waited = 0;
+            int sleep = 1;
+            while ( available == 0 && waited < maxWaitMillis ) {
+                sleepmillis( sleep );
+                waited += sleep;
+                sleep = std::min( sleep * 2, 100 );
+                available = budget->available();
+            }
+            if ( available == 0 ) {
+                LOG(1) << "memory budget exhausted for " << waited << "ms, requesting more "
+                       << "from " << ns << " anyway" << endl;
+            }
+        }
+
+        if ( _lastBatchDocs <= 0 )
+            return wanted;
+
+        // Estimate how many documents fit in what is left of the budget from the size of the
+        // previous batch. Never ask for 1 as the server would close the cursor.
+        const long long docBytes = std::max( 1LL, _lastBatchBytes / _lastBatchDocs );
+        const long long fits = std::max( 2LL, available / docBytes );
+        const long long wantedDocs = wanted < 0 ? -wanted : wanted;
+        if ( wantedDocs == 0 || wantedDocs > fits ) {
+            budget->noteShrunk();
+            return static_cast<int>( std::min<long long>( fits, 0x7fffffff ) );
+        }
+
+        return wanted;
+    }
+
+    namespace {
+        /**
+         * Returns 'query' carrying the time left before the current OperationDeadline as
+         * maxTimeMS, unless the caller set one already.
+         */
+        BSONObj withDeadline( const string& ns, const BSONObj& query ) {
+            const long long remaining = OperationDeadline::remainingMillis();
+            if ( remaining < 0 )
+                return query;
+
+            const int maxTimeMS = static_cast<int>(
+                std::max( 1LL, std::min( remaining,
+                                         (long long)std::numeric_limits<int>::max() ) ) );
+
+            if ( !NamespaceString( ns ).isCommand() ) {
+                if ( query.hasField( "$maxTimeMS" ) )
+                    return query;
+                Query q( query );
+                q.maxTimeMs( maxTimeMS );
+                return q.obj;
+            }
+
+            // Commands take maxTimeMS as a field of their own, and may be wrapped in $query
+            // to carry a read preference
+            const BSONElement wrapped = query["$query"];
+            if ( wrapped.type() != Object ) {
+                if ( query.hasField( "maxTimeMS" ) )
+                    return query;
+                BSONObjBuilder b;
+                b.appendElements( query );
+                b.append( "maxTimeMS", maxTimeMS );
+                return b.obj();
+            }
+
+            if ( wrapped.Obj().hasField( "maxTimeMS" ) )
+                return query;
+
+            BSONObjBuilder b;
+            BSONObjIterator i( query );
+            while ( i.more() ) {
+                const BSONElement e = i.next();
+                if ( e.fieldNameStringData() == "$query" ) {
+                    BSONObjBuilder inner( b.subobjStart( "$query" ) );
+                    inner.appendElements( e.Obj() );
+                    inner.append( "maxTimeMS", maxTimeMS );
+                    inner.done();
+                }
+                else {
+                    b.append( e );
+                }
+            }
+            return b.obj();
+        }
+    } // namespace
+
     void DBClientCursor::_assembleInit( Message& toSend ) {
         if ( !cursorId ) {
-            assembleRequest( ns, query, nextBatchSize() , nToSkip, fieldsToReturn, opts, toSend );
+            assembleRequest( ns, withDeadline( ns, query ), nextBatchSize() , nToSkip,
+                             fieldsToReturn, opts, toSend );
         }
         else {
             BufBuilder b;
@@ -98,12 +216,21 @@ namespace mongo {
     }
 
     bool DBClientCursor::init() {
+        const OperationTrace::Scope trace( cursorId ? "getMore" : "query", ns );
+        QueryShapeProfiler* const profiler = cursorId ? NULL : QueryShapeProfiler::global();
+        BSONObj shape;
+        if ( profiler ) {
+            shape = QueryShapeProfiler::shapeOf( ns, query, fieldsToReturn );
+            _queryShapeKey = QueryShapeProfiler::keyOf( shape );
+        }
+
         Message toSend;
         _assembleInit( toSend );
         verify( _client );
+        const unsigned long long startMicros = curTimeMicros64();
         if ( !_client->call( toSend, *batch.m, false, &_originalHost ) ) {
             // log msg temp?
-            log() << "DBClientCursor::init call() failed" << endl;
+            LOG(0) << "DBClientCursor::init call() failed" << endl;
             return false;
         }
         if ( batch.m->empty() ) {
@@ -112,6 +239,10 @@ namespace mongo {
             return false;
         }
         dataReceived();
+        if ( profiler ) {
+            profiler->recordQuery( _queryShapeKey, shape, curTimeMicros64() - startMicros,
+                                   batch.nReturned, batch.m->size() );
+        }
         return true;
     }
     
@@ -173,16 +304,22 @@ namespace mongo {
 
     void DBClientCursor::requestMore() {
         verify( cursorId && batch.pos == batch.nReturned );
+        const OperationTrace::Scope trace( "getMore", ns );
+
+        // The current batch has been consumed, give its memory back before deciding how much
+        // we can afford to ask for.
+        batch.m->reset();
 
         BufBuilder b;
         b.appendNum(opts);
         b.appendStr(ns);
-        b.appendNum(nextBatchSize());
+        b.appendNum(_budgetedBatchSize());
         b.appendNum(cursorId);
 
         Message toSend;
         toSend.setData(dbGetMore, b.buf(), b.len());
         auto_ptr<Message> response(new Message());
+        const unsigned long long startMicros = curTimeMicros64();
 
         if ( _client ) {
             _client->call( toSend, *response );
@@ -199,22 +336,35 @@ namespace mongo {
             _client = 0;
             conn.done();
         }
+        _recordGetMore( startMicros );
+    }
+
+    void DBClientCursor::_recordGetMore( unsigned long long startMicros ) {
+        QueryShapeProfiler* const profiler = QueryShapeProfiler::global();
+        if ( _queryShapeKey && profiler ) {
+            profiler->recordGetMore( _queryShapeKey, curTimeMicros64() - startMicros,
+                                     batch.nReturned, batch.m->size() );
+        }
     }
 
     /** with QueryOption_Exhaust, the server just blasts data at us (marked at end with cursorid==0). */
     void DBClientCursor::exhaustReceiveMore() {
         verify( cursorId && batch.pos == batch.nReturned );
         verify( !nToReturn );
+        const OperationTrace::Scope trace( "getMore", ns );
         auto_ptr<Message> response(new Message());
         verify( _client );
+        const unsigned long long startMicros = curTimeMicros64();
         if (!_client->recv(*response)) {
             uasserted(16465, "recv failed while exhausting cursor");
         }
         batch.m = response;
         dataReceived();
+        _recordGetMore( startMicros );
     }
 
     void DBClientCursor::dataReceived( bool& retry, string& host ) {
+        const OperationTrace::Timer decodeTimer( OperationTrace::kDecode );
 
         QueryResult *qr = (QueryResult *) batch.m->singleData();
         resultFlags = qr->resultFlags();
@@ -240,6 +390,12 @@ namespace mongo {
         batch.nReturned = qr->nReturned;
         batch.pos = 0;
         batch.data = qr->data();
+        OperationTrace::noteBatch( batch.nReturned );
+
+        if ( batch.nReturned > 0 ) {
+            _lastBatchBytes = batch.m->size();
+            _lastBatchDocs = batch.nReturned;
+        }
 
         _client->checkResponse( batch.data, batch.nReturned, &retry, &host ); // watches for "not master"
 
@@ -297,6 +453,8 @@ namespace mongo {
         if ( !_putBack.empty() ) {
             BSONObj ret = _putBack.top();
             _putBack.pop();
+            _putBackBytes -= ret.objsize();
+            _memoryBudget->release( ret.objsize() );
             return ret;
         }
 
@@ -306,6 +464,13 @@ namespace mongo {
         return rawNext();
     }
 
+    void DBClientCursor::putBack( const BSONObj &o ) {
+        BSONObj owned = o.getOwned();
+        _putBackBytes += owned.objsize();
+        _memoryBudget->charge( owned.objsize() );
+        _putBack.push( owned );
+    }
+
     void DBClientCursor::peek(vector<BSONObj>& v, int atMost) {
         int m = atMost;
 
@@ -377,6 +542,8 @@ namespace mongo {
         if (!this)
             return;
 
+        _memoryBudget->release( _putBackBytes );
+
         DESTRUCTOR_GUARD (
 
         if ( cursorId && _ownCursor ) {
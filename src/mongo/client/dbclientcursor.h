@@ -73,7 +73,7 @@ namespace mongo {
         /**
             restore an object previously returned by next() to the cursor
          */
-        void putBack( const BSONObj &o ) { _putBack.push( o.getOwned() ); }
+        void putBack( const BSONObj &o );
 
         /** throws AssertionException if get back { $err : ... } */
         BSONObj nextSafe() {
@@ -190,6 +190,7 @@ namespace mongo {
         friend class DBClientCursorShimArray;
 
         int nextBatchSize();
+        int _budgetedBatchSize();
         void _finishConsInit();
 
         BSONObj rawNext();
@@ -216,10 +217,20 @@ namespace mongo {
         std::string _lazyHost;
         bool wasError;
 
+        // memory accounting, see MemoryBudget
+        boost::shared_ptr<MemoryBudget> _memoryBudget;
+        long long _putBackBytes;
+        long long _lastBatchBytes;
+        int _lastBatchDocs;
+
+        // QueryShapeProfiler key of the query that opened the cursor, 0 if not profiled
+        unsigned long long _queryShapeKey;
+
         void dataReceived() { bool retry; std::string lazyHost; dataReceived( retry, lazyHost ); }
         void dataReceived( bool& retry, std::string& lazyHost );
         void requestMore();
         void exhaustReceiveMore(); // for exhaust
+        void _recordGetMore( unsigned long long startMicros );
 
         // Don't call from a virtual function
         void _assertIfNull() const { uassert(13348, "connection died", this); }
@@ -26,6 +26,7 @@
 
 #include "mongo/base/string_data.h"
 #include "mongo/client/bulk_operation_builder.h"
+#include "mongo/client/concurrency_limiter.h"
 #include "mongo/client/exceptions.h"
 #include "mongo/client/export_macros.h"
 #include "mongo/client/index_spec.h"
@@ -1269,6 +1270,7 @@ namespace mongo {
         int _maxWireVersion;
         int _maxMessageSizeBytes;
         int _maxWriteBatchSize;
+        boost::shared_ptr<MemoryBudget> _memoryBudget;
         void _write(
             const std::string& ns,
             const std::vector<WriteOperation*>& writes,
@@ -1301,6 +1303,13 @@ namespace mongo {
         int getMaxMessageSizeBytes() { return _maxMessageSizeBytes; }
         int getMaxWriteBatchSize() { return _maxWriteBatchSize; }
 
+        /**
+         * The budget charged for replies received and writes sent on this connection. Its
+         * parent is MemoryBudget::global() and its limit defaults to
+         * client::Options::connectionMemoryBudgetBytes().
+         */
+        const boost::shared_ptr<MemoryBudget>& getMemoryBudget() const { return _memoryBudget; }
+
         /** send a query to the database.
          @param ns namespace to query, format is <dbname>.<collectname>[.<collectname>]*
          @param query query to perform on the collection.  this is a BSONObj (binary JSON)
@@ -1584,6 +1593,12 @@ namespace mongo {
 
         std::string getServerAddress() const { return _serverString; }
 
+        /**
+         * @return true if connected over the unix domain socket of a server on this machine
+         *     rather than TCP. See client::Options::setLocalUnixSocket.
+         */
+        bool usesUnixSocket() const { return server && server->getType() == AF_UNIX; }
+
         virtual void killCursor( long long cursorID );
         virtual bool callRead( Message& toSend , Message& response ) { return call( toSend , response ); }
         virtual void say( Message &toSend, bool isRetry = false , std::string * actualServer = 0 );
@@ -1632,12 +1647,17 @@ namespace mongo {
         std::string _serverAddrString; // resolved ip of server
         void _checkConnection();
 
+        // Caps requests in flight to _server, NULL unless concurrency limiting is enabled
+        boost::shared_ptr<ConcurrencyLimiter> _concurrencyLimiter;
+
         // throws SocketException if in failed state and not reconnecting or if waiting to reconnect
         void checkConnection() { if( _failed ) _checkConnection(); }
 
         std::map<std::string, BSONObj> authCache;
         double _so_timeout;
         bool _connect( std::string& errmsg );
+        // the handshake once the socket is connected, over either transport
+        bool _finishConnect();
 
         static AtomicInt32 _numConnections;
         static bool _lazyKillCursor; // lazy means we piggy back kill cursors on next op
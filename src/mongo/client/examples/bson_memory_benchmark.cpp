@@ -0,0 +1,113 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Measures the memory retained by a cache of built BSONObjs.
+ *
+ *   bsonMemoryBenchmark [shrinkThresholdBytes] [documents]
+ *
+ * Documents follow a mix seen in caches of query results and commands: 60% small
+ * (a handful of scalar fields), 30% medium (nested sub-document and a short array) and 10%
+ * large (a few KB of text). Each is built with a default BSONObjBuilder and kept. Resident
+ * memory is read from /proc, so the retained figure is only reported on Linux. Run once
+ * with -1 (never shrink) and once with a threshold to compare.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+#include "mongo/client/dbclient.h"
+
+using namespace std;
+using namespace mongo;
+
+namespace {
+
+    long long residentBytes() {
+        ifstream statm("/proc/self/statm");
+        long long pages = 0;
+        long long resident = 0;
+        if (!(statm >> pages >> resident))
+            return -1;
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+
+    BSONObj build(int i) {
+        BSONObjBuilder b;
+        b.append("_id", i);
+
+        const int kind = i % 10;
+        if (kind < 6) {
+            b.append("status", "active");
+            b.append("score", i * 0.5);
+        }
+        else if (kind < 9) {
+            b.append("name", "customer name");
+            b.append("email", "someone@example.com");
+            BSONObjBuilder address(b.subobjStart("address"));
+            address.append("street", "123 Some Street");
+            address.append("city", "Springfield");
+            address.append("zip", "12345");
+            address.done();
+            BSONArrayBuilder tags(b.subarrayStart("tags"));
+            for (int t = 0; t < 5; t++)
+                tags.append(t);
+            tags.done();
+        }
+        else {
+            b.append("body", string(2000 + (i % 7) * 500, 'x'));
+        }
+
+        return b.obj();
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int threshold = argc > 1 ? atoi(argv[1]) : -1;
+    const int documents = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    client::Options options;
+    options.setBSONShrinkThresholdBytes(threshold);
+    Status status = client::initialize(options);
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<BSONObj> cache;
+    cache.reserve(documents);
+
+    const long long before = residentBytes();
+    long long logical = 0;
+    for (int i = 0; i < documents; i++) {
+        cache.push_back(build(i));
+        logical += cache.back().objsize();
+    }
+    const long long after = residentBytes();
+
+    cout << "shrink threshold: " << threshold << endl;
+    cout << "documents: " << documents << ", BSON bytes: " << logical << endl;
+    if (before >= 0 && after >= 0) {
+        const long long retained = after - before;
+        cout << "resident growth: " << retained << " bytes, "
+             << double(retained) / logical << "x the BSON size" << endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Measures the client side cost of queueing and executing a large unordered bulk operation.
+ *
+ *   bulkBenchmark [port] [operations]
+ *
+ * Enqueue cost is measured without touching the server. Execute cost is measured against
+ * the mongod (or any stand-in speaking the write commands) on localhost:port, using a
+ * w:0 write concern so that the server's apply time doesn't dominate.
+ */
+
+#include <cstdlib>
+#include <iostream>
+
+#include "mongo/client/dbclient.h"
+#include "mongo/util/time_support.h"
+
+using namespace std;
+using namespace mongo;
+
+namespace {
+
+    const char kNs[] = "test.bulk_benchmark";
+
+    void enqueue(BulkOperationBuilder* bulk, int operations) {
+        for (int i = 0; i < operations; i++) {
+            switch (i % 4) {
+            case 0:
+            case 1:
+                bulk->insert(BSON("_id" << i << "x" << i << "s" << "some string payload"));
+                break;
+            case 2:
+                bulk->find(BSON("_id" << i - 2)).updateOne(BSON("$inc" << BSON("x" << 1)));
+                break;
+            case 3:
+                bulk->find(BSON("_id" << i - 2)).removeOne();
+                break;
+            }
+        }
+    }
+
+    void report(const char* phase, int operations, unsigned long long micros) {
+        cout << phase << ": " << operations << " ops in " << micros / 1000 << " ms, "
+             << (micros * 1000.0) / operations << " ns/op" << endl;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Status status = client::initialize();
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    const string port = argc > 1 ? argv[1] : "27017";
+    const int operations = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    try {
+        DBClientConnection c;
+
+        {
+            BulkOperationBuilder bulk(&c, kNs, false);
+            const unsigned long long start = curTimeMicros64();
+            enqueue(&bulk, operations);
+            report("enqueue", operations, curTimeMicros64() - start);
+        }
+
+        c.connect(string("localhost:") + port);
+        c.dropCollection(kNs);
+
+        BulkOperationBuilder bulk(&c, kNs, false);
+        const unsigned long long start = curTimeMicros64();
+        enqueue(&bulk, operations);
+
+        WriteResult result;
+        bulk.execute(&WriteConcern::unacknowledged, &result);
+        c.getLastError();
+        report("enqueue+execute", operations, curTimeMicros64() - start);
+    }
+    catch(DBException& e) {
+        cout << "caught DBException " << e.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
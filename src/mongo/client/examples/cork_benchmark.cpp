@@ -0,0 +1,166 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Measures the cost of pipelining small unacknowledged inserts with and without corking:
+ *
+ *   corkBenchmark [messages]
+ *
+ * Messages go over loopback TCP to a thread that reads and discards them. For each pipeline
+ * depth the port is either left alone, so every say() is a send, or corked and flushed after
+ * each run of 'depth' messages. Send syscalls are counted by the socket; packets are the TCP
+ * segments the host sent in both directions, from /proc/net/snmp (Linux only).
+ */
+
+#include <arpa/inet.h>
+#include <boost/thread/thread.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mongo/client/dbclient.h"
+#include "mongo/util/net/message_port.h"
+#include "mongo/util/timer.h"
+
+using namespace std;
+using namespace mongo;
+
+namespace {
+
+    // Total TCP segments sent by this host, or -1 if not available
+    long long tcpOutSegments() {
+        ifstream snmp("/proc/net/snmp");
+        string header;
+        string line;
+        while (getline(snmp, line)) {
+            if (line.compare(0, 4, "Tcp:") != 0)
+                continue;
+            if (header.empty()) {
+                header = line;
+                continue;
+            }
+
+            istringstream names(header);
+            istringstream values(line);
+            string name;
+            string value;
+            while (names >> name && values >> value) {
+                if (name == "OutSegs")
+                    return atoll(value.c_str());
+            }
+        }
+        return -1;
+    }
+
+    void drain(int listenFd) {
+        const int fd = ::accept(listenFd, NULL, NULL);
+        char buf[64 * 1024];
+        while (::recv(fd, buf, sizeof(buf), 0) > 0) {
+        }
+        ::close(fd);
+    }
+
+    void makeInsert(const BSONObj& doc, Message* m) {
+        BufBuilder b;
+        b.appendNum(0);
+        b.appendStr("test.cork");
+        doc.appendSelfToBufBuilder(b);
+
+        m->setData(dbInsert, b.buf(), b.len());
+    }
+
+    void run(MessagingPort& port, int messages, int depth, bool corked, const BSONObj& doc) {
+        port.psock->clearCounters();
+        const long long segmentsBefore = tcpOutSegments();
+
+        Timer t;
+        for (int sent = 0; sent < messages; sent += depth) {
+            if (corked)
+                port.cork();
+            for (int i = 0; i < depth; i++) {
+                Message m;
+                makeInsert(doc, &m);
+                port.say(m);
+            }
+            if (corked)
+                port.uncork();
+        }
+        const long long micros = t.micros();
+
+        const long long segmentsAfter = tcpOutSegments();
+        cout << (corked ? "corked  " : "uncorked") << " depth " << depth << ": "
+             << (micros * 1000.0 / messages) << " ns/op, "
+             << (double(port.psock->getSendCalls()) / messages) << " sends/op, ";
+        if (segmentsBefore < 0)
+            cout << "packets/op n/a" << endl;
+        else
+            cout << (double(segmentsAfter - segmentsBefore) / messages) << " packets/op" << endl;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int messages = argc > 1 ? atoi(argv[1]) : 200000;
+
+    Status status = client::initialize();
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    const int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd, 1) != 0 ||
+        ::getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+        cout << "can't listen on loopback" << endl;
+        return EXIT_FAILURE;
+    }
+    boost::thread sink(drain, listenFd);
+
+    MessagingPort port;
+    SockAddr server("127.0.0.1", ntohs(addr.sin_port));
+    if (!port.connect(server)) {
+        cout << "can't connect to the sink" << endl;
+        return EXIT_FAILURE;
+    }
+
+    const BSONObj doc = BSON("_id" << OID::gen() << "name" << "corked" << "n" << 12345
+                                   << "tags" << BSON_ARRAY("a" << "b" << "c"));
+    Message sample;
+    makeInsert(doc, &sample);
+    cout << messages << " inserts of " << sample.size() << " bytes" << endl;
+
+    const int depths[] = { 1, 16, 128 };
+    for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+        run(port, messages, depths[i], false, doc);
+        run(port, messages, depths[i], true, doc);
+    }
+
+    port.shutdown();
+    sink.join();
+    ::close(listenFd);
+    return EXIT_SUCCESS;
+}
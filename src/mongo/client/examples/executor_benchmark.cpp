@@ -0,0 +1,155 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Compares dispatching tasks to the driver's task executor with starting a thread for each,
+ * as BackgroundJob used to:
+ *
+ *   executorBenchmark [tasks]
+ *
+ * Latency is the time from scheduling a task to it starting, for tasks scheduled one at a
+ * time. Throughput is for many empty tasks scheduled at once, from outside the executor and
+ * from inside a task.
+ */
+
+#include <algorithm>
+#include <boost/thread/thread.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "mongo/client/dbclient.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/synchronization.h"
+#include "mongo/util/concurrency/task_executor.h"
+#include "mongo/util/time_support.h"
+
+using namespace std;
+using namespace mongo;
+
+namespace {
+
+    void recordStart(unsigned long long scheduled, unsigned long long* latency,
+                     Notification* done) {
+        *latency = curTimeMicros64() - scheduled;
+        done->notifyOne();
+    }
+
+    void recordStartOnThread(unsigned long long scheduled, unsigned long long* latency) {
+        *latency = curTimeMicros64() - scheduled;
+    }
+
+    void reportLatency(const char* name, vector<unsigned long long>& latencies) {
+        sort(latencies.begin(), latencies.end());
+        unsigned long long total = 0;
+        for (size_t i = 0; i < latencies.size(); i++)
+            total += latencies[i];
+
+        cout << name << " latency: mean " << total / latencies.size() << " us, median "
+             << latencies[latencies.size() / 2] << " us, 99th percentile "
+             << latencies[latencies.size() * 99 / 100] << " us" << endl;
+    }
+
+    void executorLatency(int tasks) {
+        vector<unsigned long long> latencies(tasks);
+        for (int i = 0; i < tasks; i++) {
+            Notification done;
+            TaskExecutor::global()->schedule(
+                stdx::bind(recordStart, curTimeMicros64(), &latencies[i], &done));
+            done.waitToBeNotified();
+        }
+        reportLatency("executor", latencies);
+    }
+
+    void threadLatency(int tasks) {
+        vector<unsigned long long> latencies(tasks);
+        for (int i = 0; i < tasks; i++) {
+            boost::thread t(stdx::bind(recordStartOnThread, curTimeMicros64(), &latencies[i]));
+            t.join();
+        }
+        reportLatency("thread per task", latencies);
+    }
+
+    void countDown(AtomicInt32* remaining, Notification* done) {
+        if (remaining->subtractAndFetch(1) == 0)
+            done->notifyOne();
+    }
+
+    // Retries while the queues are full, which is what a producer faster than the workers does
+    void scheduleAll(int tasks, AtomicInt32* remaining, Notification* done) {
+        for (int i = 0; i < tasks; i++) {
+            const TaskExecutor::Task task = stdx::bind(countDown, remaining, done);
+            while (!TaskExecutor::global()->schedule(task).isOK())
+                boost::this_thread::yield();
+        }
+    }
+
+    void reportThroughput(const char* name, int tasks, unsigned long long micros) {
+        cout << name << " throughput: " << tasks << " tasks in " << micros / 1000 << " ms, "
+             << (tasks * 1000000.0) / (micros + 1) << " tasks/s" << endl;
+    }
+
+    void executorThroughput(int tasks, bool fromTask) {
+        AtomicInt32 remaining(tasks);
+        Notification done;
+
+        const unsigned long long start = curTimeMicros64();
+        if (fromTask) {
+            TaskExecutor::global()->schedule(
+                stdx::bind(scheduleAll, tasks, &remaining, &done));
+        }
+        else {
+            scheduleAll(tasks, &remaining, &done);
+        }
+        done.waitToBeNotified();
+
+        reportThroughput(fromTask ? "executor, scheduled from a task" : "executor",
+                         tasks, curTimeMicros64() - start);
+    }
+
+    void nothing() {}
+
+    void threadThroughput(int tasks) {
+        const unsigned long long start = curTimeMicros64();
+        boost::thread_group threads;
+        for (int i = 0; i < tasks; i++)
+            threads.create_thread(nothing);
+        threads.join_all();
+
+        reportThroughput("thread per task", tasks, curTimeMicros64() - start);
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Status status = client::initialize();
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    const int tasks = argc > 1 ? atoi(argv[1]) : 10000;
+
+    cout << TaskExecutor::global()->workers() << " workers" << endl;
+
+    executorLatency(tasks);
+    threadLatency(tasks);
+
+    executorThroughput(tasks * 100, false);
+    executorThroughput(tasks * 100, true);
+    threadThroughput(tasks);
+
+    return EXIT_SUCCESS;
+}
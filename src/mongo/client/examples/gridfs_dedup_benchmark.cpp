@@ -0,0 +1,102 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Compares storing near-identical files in GridFS with and without chunk deduplication:
+ *
+ *   gridfsDedupBenchmark [port] [files] [chunksPerFile]
+ *
+ * Every file is the same random content with one chunk changed, like successive builds of
+ * an artifact. Each mode stores all the files into its own prefix of the database
+ * "gridfs_dedup_benchmark" on localhost:port, and the time taken and the size of the
+ * collections holding chunk data are reported.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mongo/client/dbclient.h"
+#include "mongo/util/time_support.h"
+
+using namespace std;
+using namespace mongo;
+
+namespace {
+
+    const char kDb[] = "gridfs_dedup_benchmark";
+    const unsigned kChunkSize = 255 * 1024;
+
+    long long dataSize(DBClientConnection& c, const string& collection) {
+        BSONObj stats;
+        c.runCommand(kDb, BSON("collstats" << collection), stats);
+        return stats["size"].numberLong();
+    }
+
+    void run(DBClientConnection& c, bool deduplicate, int files, vector<char> content) {
+        const string prefix = deduplicate ? "dedup" : "plain";
+        GridFS grid(c, kDb, prefix);
+        grid.setChunkSize(kChunkSize);
+        grid.setDeduplicateChunks(deduplicate);
+
+        const int chunksPerFile = content.size() / kChunkSize;
+        const unsigned long long start = curTimeMicros64();
+        for (int i = 0; i < files; i++) {
+            // This file's change
+            content[(i % chunksPerFile) * kChunkSize + i / chunksPerFile]++;
+            grid.storeFile(&content[0], content.size(), str::stream() << "file" << i);
+        }
+        const unsigned long long micros = curTimeMicros64() - start;
+
+        const long long stored = dataSize(c, prefix + ".chunks") + dataSize(c, prefix + ".blobs");
+        cout << prefix << ": " << files << " files of " << content.size() / 1024 << "KB in "
+             << micros / 1000 << " ms, " << (content.size() * files) / (micros + 1.0)
+             << " MB/s, " << stored / 1024 << "KB of chunk data stored" << endl;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Status status = client::initialize();
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    const string port = argc > 1 ? argv[1] : "27017";
+    const int files = argc > 2 ? atoi(argv[2]) : 20;
+    const int chunksPerFile = argc > 3 ? atoi(argv[3]) : 40;
+
+    vector<char> content(chunksPerFile * kChunkSize);
+    srand(1);
+    for (size_t i = 0; i < content.size(); i++)
+        content[i] = static_cast<char>(rand());
+
+    try {
+        DBClientConnection c;
+        c.connect(string("localhost:") + port);
+        c.dropDatabase(kDb);
+
+        run(c, false, files, content);
+        run(c, true, files, content);
+    }
+    catch(DBException& e) {
+        cout << "caught DBException " << e.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
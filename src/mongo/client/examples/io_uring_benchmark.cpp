@@ -0,0 +1,152 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Compares request/response round trips over plain socket calls and over io_uring:
+ *
+ *   ioUringBenchmark [roundTrips]
+ *
+ * A thread on loopback TCP answers each message with a reply of a fixed size. The client
+ * makes its round trips with MessagingPort::call, the way DBClientConnection does, and
+ * reports system calls per round trip as counted by the socket.
+ */
+
+#include <arpa/inet.h>
+#include <boost/thread/thread.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mongo/client/dbclient.h"
+#include "mongo/util/net/io_uring.h"
+#include "mongo/util/net/message_port.h"
+#include "mongo/util/timer.h"
+
+using namespace std;
+using namespace mongo;
+
+namespace {
+
+    bool readFully(int fd, char* buf, int len) {
+        while (len > 0) {
+            const int n = ::recv(fd, buf, len, 0);
+            if (n <= 0)
+                return false;
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // Answers every message on each accepted connection with 'replyBytes' bytes of reply
+    void serve(int listenFd, int replyBytes) {
+        int fd;
+        while ((fd = ::accept(listenFd, NULL, NULL)) >= 0) {
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            Message reply;
+            reply.setData(opReply, string(replyBytes - 17, 'r').c_str());
+            vector<char> request;
+            MSGHEADER header;
+            while (readFully(fd, reinterpret_cast<char*>(&header), sizeof(header))) {
+                request.resize(header.messageLength - sizeof(header));
+                if (!readFully(fd, &request[0], request.size()))
+                    break;
+                reply.header()->responseTo = header.requestID;
+                ::send(fd, reply.singleData(), reply.size(), MSG_NOSIGNAL);
+            }
+            ::close(fd);
+        }
+    }
+
+    void run(const SockAddr& server, int roundTrips, int replyBytes, bool ioUring) {
+        MessagingPort port;
+        SockAddr addr = server;
+        if (!port.connect(addr)) {
+            cout << "can't connect" << endl;
+            return;
+        }
+        port.psock->setHandshakeReceived();
+        if (ioUring && !port.psock->enableIoUring()) {
+            cout << "io_uring not available" << endl;
+            return;
+        }
+
+        Timer t;
+        for (int i = 0; i < roundTrips; i++) {
+            Message request;
+            request.setData(dbQuery, "find me something");
+            Message response;
+            if (!port.call(request, response)) {
+                cout << "round trip failed" << endl;
+                return;
+            }
+        }
+        const long long micros = t.micros();
+
+        cout << (ioUring ? "io_uring" : "sockets ") << " reply " << replyBytes << " bytes: "
+             << (roundTrips * 1000000.0 / micros) << " round trips/s, "
+             << (double(port.psock->getSendCalls() + port.psock->getRecvCalls()) / roundTrips)
+             << " syscalls/op" << endl;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int roundTrips = argc > 1 ? atoi(argv[1]) : 50000;
+
+    Status status = client::initialize();
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!IoUring::isSupported())
+        cout << "io_uring isn't supported here, only plain sockets will be measured" << endl;
+
+    const int replySizes[] = { 100, 4 * 1024, 48 * 1024 };
+    for (size_t i = 0; i < sizeof(replySizes) / sizeof(replySizes[0]); i++) {
+        const int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrLen = sizeof(addr);
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listenFd, 2) != 0 ||
+            ::getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+            cout << "can't listen on loopback" << endl;
+            return EXIT_FAILURE;
+        }
+        boost::thread server(serve, listenFd, replySizes[i]);
+
+        const SockAddr serverAddr("127.0.0.1", ntohs(addr.sin_port));
+        run(serverAddr, roundTrips, replySizes[i], false);
+        if (IoUring::isSupported())
+            run(serverAddr, roundTrips, replySizes[i], true);
+
+        ::shutdown(listenFd, SHUT_RDWR);
+        ::close(listenFd);
+        server.join();
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Measures what a disabled LOG(n) (MONGO_LOG(n) outside the driver) costs in a hot loop:
+ *
+ *   logLevelBenchmark [iterations]
+ *
+ * The loop is run without logging, with a LOG(1) that is compiled in but disabled at runtime,
+ * as every LOG(n) was before MONGO_LOG_MAX_DEBUG_LEVEL, and with a LOG(2) above the maximum
+ * debug level this file is compiled with, which should cost the same as no logging at all.
+ */
+
+// Unless the build sets a lower one, so that LOG(2) is compiled out below
+#if !defined(MONGO_LOG_MAX_DEBUG_LEVEL)
+#define MONGO_LOG_MAX_DEBUG_LEVEL 1
+#endif
+
+#include <cstdlib>
+#include <iostream>
+
+#include "mongo/client/dbclient.h"
+#include "mongo/util/log.h"
+#include "mongo/util/time_support.h"
+
+using namespace std;
+using namespace mongo;
+
+namespace {
+
+    enum Logging { kNone, kRuntimeChecked, kCompiledOut };
+
+    // Something cheap for the loop to do, that the compiler can't throw away
+    unsigned long long step(unsigned long long total, long long i) {
+        return total * 31 + i;
+    }
+
+    void run(const char* name, Logging logging, long long iterations) {
+        unsigned long long total = 0;
+        const unsigned long long start = curTimeMicros64();
+        for (long long i = 0; i < iterations; i++) {
+            total = step(total, i);
+            if (logging == kRuntimeChecked)
+                MONGO_LOG(1) << "iteration " << i << " total " << total;
+            else if (logging == kCompiledOut)
+                MONGO_LOG(2) << "iteration " << i << " total " << total;
+        }
+        const unsigned long long micros = curTimeMicros64() - start;
+
+        cout << name << ": " << iterations << " iterations in " << micros / 1000 << " ms, "
+             << (micros * 1000.0) / iterations << " ns each (" << total % 10 << ")" << endl;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Status status = client::initialize();
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    const long long iterations = argc > 1 ? atoll(argv[1]) : 100 * 1000 * 1000;
+
+    run("no logging", kNone, iterations);
+    run("LOG(1), disabled at runtime", kRuntimeChecked, iterations);
+    run("LOG(2), compiled out", kCompiledOut, iterations);
+
+    return EXIT_SUCCESS;
+}
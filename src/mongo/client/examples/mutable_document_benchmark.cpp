@@ -0,0 +1,148 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Compares ways of making repeated small edits to a ~100KB document:
+ *
+ *   mutableDocumentBenchmark [edits]
+ *
+ * - rebuild: a new BSONObj per edit, copying every other field with a BSONObjBuilder
+ * - mutable: MutableDocument with obj() after every edit
+ * - mutable batched: MutableDocument with obj() after every 100 edits
+ *
+ * Edits cycle between incrementing a counter near the end of the document (a same size
+ * patch), replacing a string with one of a different length and appending to an array.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "mongo/client/dbclient.h"
+#include "mongo/bson/mutable_document.h"
+#include "mongo/util/timer.h"
+
+using namespace std;
+using namespace mongo;
+
+namespace {
+
+    const int kFields = 1000;
+
+    BSONObj makeDocument() {
+        BSONObjBuilder b;
+        b.append("_id", 1);
+        for (int i = 0; i < kFields; i++)
+            b.append(BSONObjBuilder::numStr(i) + "_field", string(90, 'x'));
+        b.append("status", "new");
+        b.append("counter", 0);
+        b.append("history", BSONArray());
+        return b.obj();
+    }
+
+    // One edit made by copying the rest of the document
+    BSONObj rebuild(const BSONObj& doc, int edit) {
+        BSONObjBuilder b(doc.objsize() + 64);
+        BSONObjIterator it(doc);
+        while (it.more()) {
+            const BSONElement e = it.next();
+            const StringData name = e.fieldNameStringData();
+
+            if (edit % 3 == 0 && name == "counter") {
+                b.append("counter", e.numberInt() + 1);
+            }
+            else if (edit % 3 == 1 && name == "status") {
+                b.append("status", edit % 2 ? "in progress" : "done");
+            }
+            else if (edit % 3 == 2 && name == "history") {
+                BSONArrayBuilder history(b.subarrayStart("history"));
+                BSONObjIterator entries(e.Obj());
+                while (entries.more())
+                    history.append(entries.next());
+                history.append(edit);
+            }
+            else {
+                b.append(e);
+            }
+        }
+        return b.obj();
+    }
+
+    void edit(MutableDocument* doc, int edit, int* counter, int* historyLength) {
+        if (edit % 3 == 0)
+            doc->set("counter", ++*counter);
+        else if (edit % 3 == 1)
+            doc->set("status", edit % 2 ? "in progress" : "done");
+        else
+            doc->insert("history." + BSONObjBuilder::numStr((*historyLength)++), edit);
+    }
+
+    void report(const char* name, int edits, long long micros, const BSONObj& result) {
+        cout << name << ": " << (micros * 1000.0 / edits) << " ns/edit, result "
+             << result.objsize() << " bytes" << endl;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int edits = argc > 1 ? atoi(argv[1]) : 30000;
+
+    Status status = client::initialize();
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    const BSONObj original = makeDocument();
+    cout << "document: " << original.objsize() << " bytes, " << edits << " edits" << endl;
+
+    {
+        BSONObj doc = original;
+        Timer t;
+        for (int i = 0; i < edits; i++)
+            doc = rebuild(doc, i);
+        report("rebuild", edits, t.micros(), doc);
+    }
+
+    {
+        MutableDocument doc(original);
+        int counter = 0;
+        int historyLength = 0;
+        BSONObj result;
+        Timer t;
+        for (int i = 0; i < edits; i++) {
+            edit(&doc, i, &counter, &historyLength);
+            result = doc.obj();
+        }
+        report("mutable", edits, t.micros(), result);
+    }
+
+    {
+        MutableDocument doc(original);
+        int counter = 0;
+        int historyLength = 0;
+        BSONObj result;
+        Timer t;
+        for (int i = 0; i < edits; i++) {
+            edit(&doc, i, &counter, &historyLength);
+            if (i % 100 == 99)
+                result = doc.obj();
+        }
+        result = doc.obj();
+        report("mutable batched", edits, t.micros(), result);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Measures SSL send throughput over loopback with and without kernel TLS:
+ *
+ *   sslOffloadBenchmark <pemKeyFile> [offload] [megabytes]
+ *
+ * A thread accepts one TLS connection with OpenSSL, using the certificate and key in
+ * 'pemKeyFile', and discards what it reads. The client secures a Socket the way the driver
+ * does and sends 'megabytes' in 48KB writes. Pass 'offload' to set
+ * Options::setSSLKernelOffload; run once with and once without to compare, since the SSL
+ * options are fixed when the driver is initialized.
+ */
+
+#include <arpa/inet.h>
+#include <boost/thread/thread.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mongo/client/dbclient.h"
+#include "mongo/util/net/sock.h"
+#include "mongo/util/net/ssl_manager.h"
+#include "mongo/util/timer.h"
+
+using namespace std;
+using namespace mongo;
+
+#ifdef MONGO_SSL
+
+namespace {
+
+    const int kWriteBytes = 48 * 1024;
+
+    void drain(int listenFd, SSL_CTX* context) {
+        const int fd = ::accept(listenFd, NULL, NULL);
+        if (fd < 0)
+            return;
+
+        SSL* ssl = SSL_new(context);
+        SSL_set_fd(ssl, fd);
+        if (SSL_accept(ssl) == 1) {
+            char buf[64 * 1024];
+            while (SSL_read(ssl, buf, sizeof(buf)) > 0) {
+            }
+        }
+        SSL_free(ssl);
+        ::close(fd);
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cout << "usage: " << argv[0] << " <pemKeyFile> [offload] [megabytes]" << endl;
+        return EXIT_FAILURE;
+    }
+    const string pemKeyFile = argv[1];
+    const bool offload = argc > 2 && string(argv[2]) == "offload";
+    const int megabytes = argc > 3 ? atoi(argv[3]) : 2048;
+
+    client::Options options;
+    options.setSSLMode(client::Options::kSSLRequired);
+    options.setSSLAllowInvalidCertificates();
+    options.setSSLKernelOffload(offload);
+    Status status = client::initialize(options);
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    SSL_CTX* serverContext = SSL_CTX_new(SSLv23_server_method());
+    if (SSL_CTX_use_certificate_chain_file(serverContext, pemKeyFile.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(serverContext, pemKeyFile.c_str(), SSL_FILETYPE_PEM) != 1) {
+        cout << "can't load a certificate and key from " << pemKeyFile << endl;
+        return EXIT_FAILURE;
+    }
+#ifdef SSL_OP_ENABLE_KTLS
+    // Let the receiving side decrypt in the kernel too, so it keeps up with the sender
+    SSL_CTX_set_options(serverContext, SSL_OP_ENABLE_KTLS);
+#endif
+
+    const int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd, 1) != 0 ||
+        ::getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+        cout << "can't listen on loopback" << endl;
+        return EXIT_FAILURE;
+    }
+    boost::thread sink(drain, listenFd, serverContext);
+
+    Socket sock;
+    SockAddr server("127.0.0.1", ntohs(addr.sin_port));
+    if (!sock.connect(server) || !sock.secure(getSSLManager(), "localhost")) {
+        cout << "can't make an SSL connection to the sink" << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "kernel TLS: send " << (sock.usesKernelTLSSend() ? "on" : "off")
+         << ", receive " << (sock.usesKernelTLSRecv() ? "on" : "off") << endl;
+
+    const string data(kWriteBytes, 'x');
+    const long long total = megabytes * 1024LL * 1024LL;
+    Timer t;
+    for (long long sent = 0; sent < total; sent += kWriteBytes)
+        sock.send(data.data(), data.size(), "sslOffloadBenchmark");
+    const long long micros = t.micros();
+
+    cout << (offload ? "offload " : "openssl ") << megabytes << "MB: "
+         << (megabytes * 1000000.0 / micros) << " MB/s" << endl;
+
+    sock.close();
+    sink.join();
+    ::close(listenFd);
+    SSL_CTX_free(serverContext);
+    return EXIT_SUCCESS;
+}
+
+#else
+
+int main() {
+    cout << "this driver was built without SSL support" << endl;
+    return EXIT_FAILURE;
+}
+
+#endif
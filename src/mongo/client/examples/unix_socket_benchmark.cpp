@@ -0,0 +1,178 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/**
+ * Compares DBClientConnection round trips to a server on this machine over loopback TCP and
+ * over its unix domain socket:
+ *
+ *   unixSocketBenchmark [roundTrips]
+ *
+ * A thread stands in for the server, answering every message with a small command reply.
+ * It listens on a loopback port and, for the second run, on "<prefix>/mongodb-<port>.sock"
+ * too. Both runs connect to "localhost:<port>" with client::Options::setLocalUnixSocket
+ * enabled; the first finds no socket and falls back to TCP.
+ */
+
+#include <arpa/inet.h>
+#include <boost/thread/thread.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "mongo/client/dbclient.h"
+#include "mongo/util/net/message.h"
+#include "mongo/util/timer.h"
+
+using namespace std;
+using namespace mongo;
+
+namespace {
+
+    bool readFully(int fd, char* buf, int len) {
+        while (len > 0) {
+            const int n = ::recv(fd, buf, len, 0);
+            if (n <= 0)
+                return false;
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // Answers every message on each accepted connection with {ok: 1, ismaster: true}
+    void serve(int listenFd) {
+        BufBuilder body;
+        body.appendNum(0);          // responseFlags
+        body.appendNum(0LL);        // cursorId
+        body.appendNum(0);          // startingFrom
+        body.appendNum(1);          // nReturned
+        const BSONObj doc = BSON("ok" << 1 << "ismaster" << true << "maxWireVersion" << 2);
+        body.appendBuf(doc.objdata(), doc.objsize());
+
+        int fd;
+        while ((fd = ::accept(listenFd, NULL, NULL)) >= 0) {
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            Message reply;
+            reply.setData(opReply, body.buf(), body.len());
+            vector<char> request;
+            MSGHEADER header;
+            while (readFully(fd, reinterpret_cast<char*>(&header), sizeof(header))) {
+                request.resize(header.messageLength - sizeof(header));
+                if (!readFully(fd, &request[0], request.size()))
+                    break;
+                reply.header()->responseTo = header.requestID;
+                ::send(fd, reply.singleData(), reply.size(), MSG_NOSIGNAL);
+            }
+            ::close(fd);
+        }
+    }
+
+    void run(const string& host, int roundTrips) {
+        DBClientConnection conn;
+        string errmsg;
+        if (!conn.connect(HostAndPort(host), errmsg)) {
+            cout << "can't connect: " << errmsg << endl;
+            return;
+        }
+
+        Timer t;
+        for (int i = 0; i < roundTrips; i++) {
+            Message request;
+            request.setData(dbQuery, "find me something");
+            Message response;
+            if (!conn.call(request, response)) {
+                cout << "round trip failed" << endl;
+                return;
+            }
+        }
+        const long long micros = t.micros();
+
+        cout << (conn.usesUnixSocket() ? "unix socket " : "TCP         ") << conn.toString()
+             << ": " << (double(micros) / roundTrips) << " us/round trip, "
+             << (roundTrips * 1000000.0 / micros) << " round trips/s" << endl;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int roundTrips = argc > 1 ? atoi(argv[1]) : 50000;
+
+    char prefix[] = "/tmp/unix_socket_benchmark_XXXXXX";
+    if (!::mkdtemp(prefix)) {
+        cout << "can't create a directory for the socket" << endl;
+        return EXIT_FAILURE;
+    }
+
+    client::Options options;
+    options.setLocalUnixSocket(true);
+    options.setUnixSocketPrefix(prefix);
+    Status status = client::initialize(options);
+    if ( !status.isOK() ) {
+        cout << "failed to initialize the client driver: " << status.toString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    const int tcpFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    if (::bind(tcpFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(tcpFd, 2) != 0 ||
+        ::getsockname(tcpFd, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+        cout << "can't listen on loopback" << endl;
+        return EXIT_FAILURE;
+    }
+    const int port = ntohs(addr.sin_port);
+    const string host = str::stream() << "localhost:" << port;
+    boost::thread tcpServer(serve, tcpFd);
+
+    run(host, roundTrips);
+
+    const string path = str::stream() << prefix << "/mongodb-" << port << ".sock";
+    const int unixFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un unixAddr;
+    memset(&unixAddr, 0, sizeof(unixAddr));
+    unixAddr.sun_family = AF_UNIX;
+    strncpy(unixAddr.sun_path, path.c_str(), sizeof(unixAddr.sun_path) - 1);
+    if (::bind(unixFd, reinterpret_cast<sockaddr*>(&unixAddr), sizeof(unixAddr)) != 0 ||
+        ::listen(unixFd, 2) != 0) {
+        cout << "can't listen on " << path << endl;
+        return EXIT_FAILURE;
+    }
+    boost::thread unixServer(serve, unixFd);
+
+    run(host, roundTrips);
+
+    ::shutdown(tcpFd, SHUT_RDWR);
+    ::close(tcpFd);
+    ::shutdown(unixFd, SHUT_RDWR);
+    ::close(unixFd);
+    tcpServer.join();
+    unixServer.join();
+    ::unlink(path.c_str());
+    ::rmdir(prefix);
+
+    return EXIT_SUCCESS;
+}
@@ -18,16 +18,30 @@
 #include "mongo/client/gridfs.h"
 
 #include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/smart_ptr.hpp>
+#include <boost/thread/thread.hpp>
 #include <fcntl.h>
 #include <fstream>
+#include <set>
 #include <utility>
+#include <vector>
 
 #if defined(_WIN32)
 #include <io.h>
 #endif
 
+#ifdef MONGO_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "mongo/base/error_codes.h"
+#include "mongo/client/bulk_operation_builder.h"
 #include "mongo/client/dbclientcursor.h"
+#include "mongo/client/exceptions.h"
+#include "mongo/client/write_result.h"
+#include "mongo/util/md5.hpp"
 
 #ifndef MIN
 #define MIN(a,b) ( (a) < (b) ? (a) : (b) )
@@ -46,6 +60,311 @@ namespace mongo {
 
     const unsigned DEFAULT_CHUNK_SIZE = 255 * 1024;
 
+    namespace {
+
+        // Chunks held back and stored together when deduplicating or compressing, 4MB at
+        // the default size
+        const size_t kBatchChunks = 16;
+
+        const size_t kCompressionThreads = 4;
+
+        const char kZlib[] = "zlib";
+
+        // Identifies the content of a shared chunk: its MD5 digest and its length
+        string chunkKey(const char* data, int len) {
+            md5digest digest;
+            md5(data, len, digest);
+            string key(reinterpret_cast<const char*>(digest), sizeof(digest));
+            for (int i = 0; i < 4; i++)
+                key += static_cast<char>((len >> (8 * i)) & 0xff);
+            return key;
+        }
+
+        BSONBinData binData(const string& s) {
+            return BSONBinData(s.data(), s.size(), BinDataGeneral);
+        }
+
+        // The chunk with its data decompressed, see GridFS::setCompressChunks
+        BSONObj decompressed(const BSONObj& chunk, int maxLen) {
+            const string compression = chunk["compression"].str();
+#ifdef MONGO_HAVE_ZLIB
+            const bool supported = compression == kZlib;
+#else
+            const bool supported = false;
+#endif
+            uassert(17417, "can't decompress GridFS chunks compressed with " + compression,
+                    supported);
+
+#ifdef MONGO_HAVE_ZLIB
+            int len;
+            const char* data = chunk["data"].binDataClean(len);
+            string out(maxLen, '\0');
+            uLongf outLen = out.size();
+            uassert(17418, "couldn't decompress GridFS chunk",
+                    uncompress(reinterpret_cast<Bytef*>(&out[0]), &outLen,
+                               reinterpret_cast<const Bytef*>(data), len) == Z_OK);
+
+            BSONObjBuilder b;
+            b.appendAs(chunk["files_id"], "files_id");
+            b.appendAs(chunk["n"], "n");
+            b.appendBinData("data", outLen, BinDataGeneral, out.data());
+            return b.obj();
+#else
+            return chunk;
+#endif
+        }
+
+        // A chunk held back to be stored with others
+        struct PendingChunk {
+            int n;
+            string key;
+            string data;
+            bool compressed;
+        };
+
+        // Compresses every step'th chunk from first
+        void compressChunks(std::vector<PendingChunk>* chunks, size_t first, size_t step) {
+#ifdef MONGO_HAVE_ZLIB
+            for (size_t i = first; i < chunks->size(); i += step) {
+                PendingChunk& chunk = (*chunks)[i];
+                uLongf len = compressBound(chunk.data.size());
+                string out(len, '\0');
+                if (compress2(reinterpret_cast<Bytef*>(&out[0]), &len,
+                              reinterpret_cast<const Bytef*>(chunk.data.data()),
+                              chunk.data.size(), Z_DEFAULT_COMPRESSION) != Z_OK ||
+                        len >= chunk.data.size())
+                    continue;
+
+                out.resize(len);
+                chunk.data.swap(out);
+                chunk.compressed = true;
+            }
+#endif
+        }
+
+        void compressChunks(std::vector<PendingChunk>* chunks) {
+            const size_t threads = std::min(chunks->size(), kCompressionThreads);
+            if (threads <= 1) {
+                compressChunks(chunks, 0, 1);
+                return;
+            }
+
+            void (*compressEvery)(std::vector<PendingChunk>*, size_t, size_t) = compressChunks;
+            boost::thread_group workers;
+            for (size_t t = 0; t < threads; t++)
+                workers.create_thread(boost::bind(compressEvery, chunks, t, threads));
+            workers.join_all();
+        }
+
+        void appendChunkData(BSONObjBuilder* b, const PendingChunk& chunk) {
+            b->append("data", binData(chunk.data));
+            if (chunk.compressed)
+                b->append("compression", kZlib);
+        }
+
+        string md5Of(const string& data) {
+            md5_state_t st;
+            md5_init(&st);
+            for (size_t i = 0; i < data.size(); i += DEFAULT_CHUNK_SIZE) {
+                const size_t len = std::min<size_t>(DEFAULT_CHUNK_SIZE, data.size() - i);
+                md5_append(&st, reinterpret_cast<const md5_byte_t*>(data.data() + i), len);
+            }
+            md5digest digest;
+            md5_finish(&st, digest);
+            return digestToString(digest);
+        }
+
+        /**
+         * Executes the inserts of a GridFileBatch, where the document at each bulk index
+         * belongs to fileOf[index]. Any file a document couldn't be stored for gets the
+         * reason in 'statuses'.
+         */
+        void executeFor(BulkOperationBuilder* bulk,
+                        const std::vector<size_t>& fileOf,
+                        std::vector<Status>* statuses) {
+            WriteResult result;
+            try {
+                bulk->execute(NULL, &result);
+            }
+            catch (const OperationException&) {
+                // The errors are in the result
+            }
+            catch (const DBException& e) {
+                for (size_t i = 0; i < fileOf.size(); i++)
+                    (*statuses)[fileOf[i]] = e.toStatus();
+                return;
+            }
+
+            for (size_t i = 0; i < result.writeErrors().size(); i++) {
+                const BSONObj& error = result.writeErrors()[i];
+                Status& status = (*statuses)[fileOf[error["index"].numberInt()]];
+                if (status.isOK())
+                    status = Status(ErrorCodes::fromInt(error["code"].numberInt()),
+                                    error["errmsg"].str());
+            }
+
+            // The writes may not last
+            if (result.hasWriteConcernErrors()) {
+                const BSONObj& error = result.writeConcernErrors().front();
+                for (size_t i = 0; i < fileOf.size(); i++) {
+                    Status& status = (*statuses)[fileOf[i]];
+                    if (status.isOK())
+                        status = Status(ErrorCodes::WriteConcernFailed, error["errmsg"].str());
+                }
+            }
+        }
+
+    } // namespace
+
+    /**
+     * Takes the chunks of one file in order and stores them. Plain chunks are inserted as
+     * they come. Otherwise chunks are held back in batches, which are compressed in parallel
+     * if asked to. Then when deduplicating, one query finds which of a batch's chunks are
+     * already in the blobs collection, the others are inserted there, and then the file's
+     * chunk documents referring to them.
+     */
+    class GridFS::ChunkSink : boost::noncopyable {
+    public:
+        ChunkSink(GridFS* grid, const BSONObj& fileIdObj)
+            : _grid(grid)
+            , _fileIdObj(fileIdObj)
+            , _deduplicate(grid->_deduplicateChunks)
+            , _compress(grid->_compressChunks) {
+            md5_init(&_md5);
+        }
+
+        void append(int n, const char* data, int len) {
+            if (!_deduplicate && !_compress) {
+                GridFSChunk c(_fileIdObj, n, data, len);
+                _grid->_client.insert(_grid->_chunksNS.c_str(), c._data);
+                return;
+            }
+
+            md5_append(&_md5, reinterpret_cast<const md5_byte_t*>(data), len);
+
+            PendingChunk pending;
+            pending.n = n;
+            if (_deduplicate)
+                pending.key = chunkKey(data, len);
+            pending.data.assign(data, len);
+            pending.compressed = false;
+            _pending.push_back(pending);
+
+            if (_pending.size() == kBatchChunks)
+                _flush();
+        }
+
+        /**
+         * Stores the chunks still held back.
+         * @return the MD5 of the file if computed here, or "" for the server to compute it
+         */
+        string finish() {
+            // The server's filemd5 would only see what is in the chunks collection
+            if (!_deduplicate && !_compress)
+                return "";
+
+            _flush();
+            md5digest digest;
+            md5_finish(&_md5, digest);
+            return digestToString(digest);
+        }
+
+    private:
+        void _flush();
+        void _flushShared();
+
+        GridFS* const _grid;
+        const BSONObj _fileIdObj;
+        const bool _deduplicate;
+        const bool _compress;
+        md5_state_t _md5;
+        std::vector<PendingChunk> _pending;
+    };
+
+    void GridFS::ChunkSink::_flush() {
+        if (_pending.empty())
+            return;
+
+        if (_compress)
+            compressChunks(&_pending);
+
+        if (_deduplicate) {
+            _flushShared();
+        }
+        else {
+            std::vector<BSONObj> chunks;
+            for (size_t i = 0; i < _pending.size(); i++) {
+                BSONObjBuilder chunk;
+                chunk.appendAs(_fileIdObj["_id"], "files_id");
+                chunk.append("n", _pending[i].n);
+                appendChunkData(&chunk, _pending[i]);
+                chunks.push_back(chunk.obj());
+            }
+            _grid->_client.insert(_grid->_chunksNS, chunks);
+        }
+
+        _pending.clear();
+    }
+
+    void GridFS::ChunkSink::_flushShared() {
+        BSONArrayBuilder keys;
+        for (size_t i = 0; i < _pending.size(); i++)
+            keys.append(binData(_pending[i].key));
+
+        const BSONObj keyOnly = BSON("_id" << 1);
+        auto_ptr<DBClientCursor> cursor = _grid->_client.query(
+            _grid->_blobsNS, BSON("_id" << BSON("$in" << keys.arr())), 0, 0, &keyOnly);
+        uassert(17415, "couldn't look up shared GridFS chunks", cursor.get());
+
+        std::set<string> stored;
+        while (cursor->more()) {
+            int len;
+            const char* key = cursor->next()["_id"].binData(len);
+            stored.insert(string(key, len));
+        }
+
+        BulkOperationBuilder blobs(&_grid->_client, _grid->_blobsNS, false);
+        bool storing = false;
+        std::vector<BSONObj> refs;
+
+        for (size_t i = 0; i < _pending.size(); i++) {
+            const PendingChunk& pending = _pending[i];
+
+            if (stored.insert(pending.key).second) {
+                BSONObjBuilder blob;
+                blob.append("_id", binData(pending.key));
+                appendChunkData(&blob, pending);
+                blobs.insert(blob.obj());
+                storing = true;
+            }
+
+            BSONObjBuilder ref;
+            ref.appendAs(_fileIdObj["_id"], "files_id");
+            ref.append("n", pending.n);
+            ref.append("blob", binData(pending.key));
+            refs.push_back(ref.obj());
+        }
+
+        if (storing) {
+            WriteResult result;
+            try {
+                blobs.execute(NULL, &result);
+            }
+            catch (const OperationException&) {
+                // Fine if another upload stored the same chunks in the meantime
+                if (result.hasWriteConcernErrors() || !result.hasWriteErrors())
+                    throw;
+                for (size_t i = 0; i < result.writeErrors().size(); i++) {
+                    if (result.writeErrors()[i]["code"].numberInt() != ErrorCodes::DuplicateKey)
+                        throw;
+                }
+            }
+        }
+
+        // The blobs are all in, so the file never refers to a chunk that isn't
+        _grid->_client.insert(_grid->_chunksNS, refs);
+    }
+
     GridFSChunk::GridFSChunk( BSONObj o ) {
         _data = o;
     }
@@ -62,7 +381,10 @@ namespace mongo {
     GridFS::GridFS( DBClientBase& client , const string& dbName , const string& prefix ) : _client( client ) , _dbName( dbName ) , _prefix( prefix ) {
         _filesNS = dbName + "." + prefix + ".files";
         _chunksNS = dbName + "." + prefix + ".chunks";
+        _blobsNS = dbName + "." + prefix + ".blobs";
         _chunkSize = DEFAULT_CHUNK_SIZE;
+        _deduplicateChunks = false;
+        _compressChunks = false;
 
         client.createIndex( _filesNS , BSON( "filename" << 1 ) );
         client.createIndex( _chunksNS , IndexSpec().addKeys(BSON( "files_id" << 1 << "n" << 1 )).unique() );
@@ -81,24 +403,45 @@ namespace mongo {
         return _chunkSize;
     }
 
+    void GridFS::setDeduplicateChunks(bool deduplicate) {
+        _deduplicateChunks = deduplicate;
+    }
+
+    bool GridFS::getDeduplicateChunks() const {
+        return _deduplicateChunks;
+    }
+
+    void GridFS::setCompressChunks(bool compress) {
+#ifndef MONGO_HAVE_ZLIB
+        uassert(17419, "the driver was built without zlib, can't compress GridFS chunks",
+                !compress);
+#endif
+        _compressChunks = compress;
+    }
+
+    bool GridFS::getCompressChunks() const {
+        return _compressChunks;
+    }
+
     BSONObj GridFS::storeFile( const char* data , size_t length , const string& remoteName , const string& contentType) {
         char const * const end = data + length;
 
         OID id;
         id.init();
         BSONObj idObj = BSON("_id" << id);
+        ChunkSink sink(this, idObj);
 
         int chunkNumber = 0;
         while (data < end) {
             int chunkLen = MIN(_chunkSize, (unsigned)(end-data));
-            GridFSChunk c(idObj, chunkNumber, data, chunkLen);
-            _client.insert( _chunksNS.c_str() , c._data );
+            sink.append(chunkNumber, data, chunkLen);
 
             chunkNumber++;
             data += chunkLen;
         }
 
-        return insertFile(remoteName, id, length, contentType);
+        const string md5 = sink.finish();
+        return insertFile(remoteName, id, length, contentType, md5);
     }
 
 
@@ -113,6 +456,7 @@ namespace mongo {
         OID id;
         id.init();
         BSONObj idObj = BSON("_id" << id);
+        ChunkSink sink(this, idObj);
 
         int chunkNumber = 0;
         gridfs_offset length = 0;
@@ -129,8 +473,7 @@ namespace mongo {
                 verify(chunkLen <= _chunkSize);
             }
 
-            GridFSChunk c(idObj, chunkNumber, buf, chunkLen);
-            _client.insert( _chunksNS.c_str() , c._data );
+            sink.append(chunkNumber, buf, chunkLen);
 
             length += chunkLen;
             chunkNumber++;
@@ -140,10 +483,12 @@ namespace mongo {
         if (fd != stdin)
             fclose( fd );
 
-        return insertFile((remoteName.empty() ? fileName : remoteName), id, length, contentType);
+        const string md5 = sink.finish();
+        return insertFile((remoteName.empty() ? fileName : remoteName), id, length, contentType, md5);
     }
 
-    BSONObj GridFS::insertFile(const string& name, const OID& id, gridfs_offset length, const string& contentType) {
+    BSONObj GridFS::insertFile(const string& name, const OID& id, gridfs_offset length,
+                               const string& contentType, const string& md5) {
         // Wait for any pending writebacks to finish
         BSONObj errObj = _client.getLastErrorDetailed();
         uassert( 16428,
@@ -151,16 +496,28 @@ namespace mongo {
                                << ", error: " << errObj,
                  DBClientWithCommands::getLastErrorString(errObj) == "" );
 
-        BSONObj res;
-        if ( ! _client.runCommand( _dbName.c_str() , BSON( "filemd5" << id << "root" << _prefix ) , res ) )
-            throw UserException( 9008 , "filemd5 failed" );
+        string fileMD5 = md5;
+        if ( fileMD5.empty() ) {
+            BSONObj res;
+            if ( ! _client.runCommand( _dbName.c_str() , BSON( "filemd5" << id << "root" << _prefix ) , res ) )
+                throw UserException( 9008 , "filemd5 failed" );
+            fileMD5 = res["md5"].str();
+        }
 
+        BSONObj ret = _fileObject(name, id, length, contentType, fileMD5);
+        _client.insert(_filesNS.c_str(), ret);
+
+        return ret;
+    }
+
+    BSONObj GridFS::_fileObject(const string& name, const OID& id, gridfs_offset length,
+                                const string& contentType, const string& md5) const {
         BSONObjBuilder file;
         file << "_id" << id
              << "filename" << name
              << "chunkSize" << _chunkSize
              << "uploadDate" << DATENOW
-             << "md5" << res["md5"]
+             << "md5" << md5
              ;
 
         if (length < 1024*1024*1024) { // 2^30
@@ -173,10 +530,7 @@ namespace mongo {
         if (!contentType.empty())
             file << "contentType" << contentType;
 
-        BSONObj ret = file.obj();
-        _client.insert(_filesNS.c_str(), ret);
-
-        return ret;
+        return file.obj();
     }
 
     void GridFS::removeFile( const string& fileName ) {
@@ -211,10 +565,6 @@ namespace mongo {
         return _client.query( _filesNS.c_str() , o );
     }
 
-    void GridFS::_insertChunk( const GridFSChunk& chunk ) {
-        _client.insert( _chunksNS.c_str() , chunk._data );
-    }
-
     BSONObj GridFile::getMetadata() const {
         BSONElement meta_element = _obj["metadata"];
         if( meta_element.eoo() ) {
@@ -232,6 +582,15 @@ namespace mongo {
 
         BSONObj o = _grid->_client.findOne( _grid->_chunksNS.c_str() , b.obj() );
         uassert( 10014 ,  "chunk is empty!" , ! o.isEmpty() );
+
+        // A deduplicated chunk, its data is shared, see GridFS::setDeduplicateChunks
+        if ( o["data"].eoo() && o["blob"].type() == BinData ) {
+            o = _grid->_client.findOne( _grid->_blobsNS.c_str() , BSON( "_id" << o["blob"] ) );
+            uassert( 17416 , "shared chunk is missing" , ! o.isEmpty() );
+        }
+
+        if ( o["compression"].type() == String )
+            o = decompressed( o , getChunkSize() );
         return GridFSChunk(o);
     }
 
@@ -275,6 +634,10 @@ namespace mongo {
         _fileLength( 0 ) {
         _fileId.init();
         _fileIdObj = BSON( "_id" << _fileId );
+        _sink.reset( new GridFS::ChunkSink( _grid, _fileIdObj ) );
+    }
+
+    GridFileBuilder::~GridFileBuilder() {
     }
     
     const char* GridFileBuilder::_appendChunk( const char* data,
@@ -287,8 +650,7 @@ namespace mongo {
             // necessary
             if ((chunkLen < _chunkSize) && (!forcePendingInsert))
                 break;
-            GridFSChunk chunk( _fileIdObj, _currentChunk, data, chunkLen );
-            _grid->_insertChunk( chunk );
+            _sink->append( _currentChunk, data, chunkLen );
             ++_currentChunk;
             data += chunkLen;
             _fileLength += chunkLen;
@@ -336,15 +698,122 @@ namespace mongo {
     BSONObj GridFileBuilder::buildFile( const string& remoteName,
                                         const string& contentType ) {
         _appendPendingData();
+        const string md5 = _sink->finish();
         BSONObj ret = _grid->insertFile( remoteName, _fileId, _fileLength,
-                                         contentType );
+                                         contentType, md5 );
         // resets the object to allow more data append for a GridFile
         _currentChunk = 0;
         _pendingDataSize = 0;
         _fileLength = 0;
         _fileId.init();
         _fileIdObj = BSON( "_id" << _fileId );
+        _sink.reset( new GridFS::ChunkSink( _grid, _fileIdObj ) );
         return ret;
     }
-    
+
+    GridFileBatch::GridFileBatch( GridFS* const grid ) :
+        _grid( grid ),
+        _queuedBytes( 0 ) {
+    }
+
+    void GridFileBatch::add( const char* data, size_t length, const string& remoteName,
+                             const string& contentType ) {
+        _data.push_back( string( data, length ) );
+
+        OID id;
+        id.init();
+        _files.push_back( _grid->_fileObject( remoteName, id, length, contentType,
+                                              md5Of( _data.back() ) ) );
+
+        _queuedBytes += length;
+        if (_queuedBytes >= kMaxQueuedBytes)
+            _write();
+    }
+
+    void GridFileBatch::execute( std::vector<StatusWith<BSONObj> >* results ) {
+        _write();
+        results->insert( results->end(), _results.begin(), _results.end() );
+        _results.clear();
+    }
+
+    void GridFileBatch::_write() {
+        if (_files.empty())
+            return;
+
+        std::vector<PendingChunk> chunks;
+        std::vector<size_t> chunkFile;
+        for (size_t f = 0; f < _files.size(); f++) {
+            const size_t chunkSize = _files[f]["chunkSize"].numberInt();
+            string& data = _data[f];
+            for (size_t offset = 0, n = 0; offset < data.size(); offset += chunkSize, n++) {
+                PendingChunk chunk;
+                chunk.n = n;
+                if (data.size() <= chunkSize)
+                    chunk.data.swap(data);
+                else
+                    chunk.data.assign(data, offset, chunkSize);
+                chunk.compressed = false;
+                chunks.push_back(chunk);
+                chunkFile.push_back(f);
+            }
+        }
+        _data.clear();
+
+        if (_grid->_compressChunks)
+            compressChunks(&chunks);
+
+        std::vector<Status> statuses(_files.size(), Status::OK());
+
+        if (!chunks.empty()) {
+            BulkOperationBuilder bulk(&_grid->_client, _grid->_chunksNS, false);
+            for (size_t i = 0; i < chunks.size(); i++) {
+                BSONObjBuilder chunk;
+                chunk.appendAs(_files[chunkFile[i]]["_id"], "files_id");
+                chunk.append("n", chunks[i].n);
+                appendChunkData(&chunk, chunks[i]);
+                bulk.insert(chunk.obj());
+            }
+            std::vector<PendingChunk>().swap(chunks);
+
+            executeFor(&bulk, chunkFile, &statuses);
+        }
+
+        // Only the files with all their chunks in
+        std::vector<size_t> fileOf;
+        BulkOperationBuilder files(&_grid->_client, _grid->_filesNS, false);
+        for (size_t f = 0; f < _files.size(); f++) {
+            if (statuses[f].isOK()) {
+                files.insert(_files[f]);
+                fileOf.push_back(f);
+            }
+        }
+        if (!fileOf.empty())
+            executeFor(&files, fileOf, &statuses);
+
+        // Remove what was stored of the files that failed
+        BSONArrayBuilder failed;
+        for (size_t f = 0; f < _files.size(); f++) {
+            if (!statuses[f].isOK())
+                failed.append(_files[f]["_id"]);
+        }
+        if (failed.arrSize() > 0) {
+            const BSONObj ids = BSON("$in" << failed.arr());
+            try {
+                _grid->_client.remove(_grid->_filesNS, BSON("_id" << ids));
+                _grid->_client.remove(_grid->_chunksNS, BSON("files_id" << ids));
+            }
+            catch (const DBException& e) {
+                log() << "couldn't remove what was stored of GridFS files that failed: "
+                      << e.what() << std::endl;
+            }
+        }
+
+        for (size_t f = 0; f < _files.size(); f++) {
+            _results.push_back(statuses[f].isOK() ? StatusWith<BSONObj>(_files[f])
+                                                  : StatusWith<BSONObj>(statuses[f]));
+        }
+        _files.clear();
+        _queuedBytes = 0;
+    }
+
 }
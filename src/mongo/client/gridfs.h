@@ -17,6 +17,12 @@
 
 #pragma once
 
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <string>
+#include <vector>
+
+#include "mongo/base/status_with.h"
 #include "mongo/bson/bsonelement.h"
 #include "mongo/bson/bsonobj.h"
 #include "mongo/client/dbclientinterface.h"
@@ -28,6 +34,7 @@ namespace mongo {
 
     class GridFS;
     class GridFile;
+    class GridFileBatch;
     class GridFileBuilder;
 
     class MONGO_CLIENT_API GridFSChunk {
@@ -72,6 +79,38 @@ namespace mongo {
 
         unsigned int getChunkSize() const;
 
+        /**
+         * Store the content of chunks once, however many files or places in a file it appears
+         * in. Files stored with this on are uploaded with less bandwidth and take less space
+         * when they repeat content already in GridFS, whatever the setting when they are read.
+         *
+         * Each distinct chunk goes in <prefix>.blobs, keyed by its MD5 digest and length, and
+         * the documents in <prefix>.chunks refer to it instead of holding the data. Such files
+         * can't be read by drivers unaware of this, and as the digest identifies the content,
+         * it should only be used where the content comes from trusted sources. removeFile
+         * leaves the shared chunks in place, since other files may still refer to them.
+         *
+         * Default: false
+         */
+        void setDeduplicateChunks(bool deduplicate);
+
+        bool getDeduplicateChunks() const;
+
+        /**
+         * Compress the data of each chunk with zlib as files are stored, on as many as four
+         * threads. Chunks that don't get smaller are stored as they are. Compressed chunks are
+         * marked with a "compression" field, and are decompressed when read whatever the
+         * setting; the file's length remains that of its content.
+         *
+         * Compressed files can't be read by drivers unaware of this. Throws if the driver was
+         * built without zlib.
+         *
+         * Default: false
+         */
+        void setCompressChunks(bool compress);
+
+        bool getCompressChunks() const;
+
         /**
          * puts the file reference by fileName into the db
          * @param fileName local filename relative to process
@@ -127,16 +166,24 @@ namespace mongo {
         std::string _prefix;
         std::string _filesNS;
         std::string _chunksNS;
+        std::string _blobsNS;
         unsigned int _chunkSize;
+        bool _deduplicateChunks;
+        bool _compressChunks;
+
+        // Stores the chunks of one file, see ChunkSink in gridfs.cpp
+        class ChunkSink;
 
         // insert fileobject. All chunks must be in DB.
-        BSONObj insertFile(const std::string& name, const OID& id, gridfs_offset length, const std::string& contentType);
+        // The md5 is computed by the server unless given.
+        BSONObj insertFile(const std::string& name, const OID& id, gridfs_offset length,
+                           const std::string& contentType, const std::string& md5 = "");
 
-        // Insert a chunk into DB, this method is intended to be used by
-        // GridFileBuilder to incrementally insert chunks
-        void _insertChunk(const GridFSChunk& chunk);
+        BSONObj _fileObject(const std::string& name, const OID& id, gridfs_offset length,
+                            const std::string& contentType, const std::string& md5) const;
 
         friend class GridFile;
+        friend class GridFileBatch;
         friend class GridFileBuilder;
     };
 
@@ -219,6 +266,8 @@ namespace mongo {
          * @param grid - gridfs instance
          */
         GridFileBuilder( GridFS* const grid );
+
+        ~GridFileBuilder();
         
         /**
          * Appends a chunk of data. Data will be split as many times as
@@ -251,6 +300,7 @@ namespace mongo {
         boost::scoped_array<char> _pendingData; // pointer with _chunkSize space
         size_t _pendingDataSize;
         gridfs_offset _fileLength;
+        boost::scoped_ptr<GridFS::ChunkSink> _sink;
 
         const char* _appendChunk( const char* data, size_t length,
                                   bool forcePendingInsert );
@@ -258,5 +308,69 @@ namespace mongo {
         void _appendPendingData();
     };
 
+    /**
+     * Stores many small files in few round trips.
+     *
+     * Files are queued with add() and written with execute(). The chunks of the queued files
+     * go to the chunks collection in large unordered batches, and their file documents then go
+     * to the files collection the same way, so a thousand small files take a couple of round
+     * trips rather than three each. The MD5 of each file is computed here rather than with the
+     * filemd5 command.
+     *
+     * Example Usage:
+     *
+     * GridFileBatch batch(&gridFS);
+     * batch.add(data, length, "thumbnail.png", "image/png");
+     * ...
+     * std::vector<StatusWith<BSONObj> > results;
+     * batch.execute(&results);
+     *
+     * Chunks are compressed if the GridFS compresses them, but never deduplicated.
+     */
+    class MONGO_CLIENT_API GridFileBatch : boost::noncopyable {
+    public:
+        /**
+         * Queued files are written by add() once they hold this much data, to bound the
+         * memory used.
+         */
+        static const size_t kMaxQueuedBytes = 32 * 1024 * 1024;
+
+        /**
+         * @param grid - gridfs instance
+         */
+        explicit GridFileBatch( GridFS* const grid );
+
+        /**
+         * Queues a copy of the file represented by data.
+         * @param data pointer to buffer to store in GridFS
+         * @param length length of buffer
+         * @param remoteName filename to use for file stored in GridFS
+         * @param contentType optional MIME type for this object.
+         *                    (default is to omit)
+         */
+        void add( const char* data, size_t length, const std::string& remoteName,
+                  const std::string& contentType="" );
+
+        /**
+         * Writes the queued files.
+         * @param results gets the outcome of every file added since the last execute, in the
+         *                order added: the file object, or why the file couldn't be stored.
+         *                Nothing is left of a file that couldn't be stored.
+         */
+        void execute( std::vector<StatusWith<BSONObj> >* results );
+
+    private:
+        GridFS* const _grid;
+
+        // The file objects and data of the queued files
+        std::vector<BSONObj> _files;
+        std::vector<std::string> _data;
+        size_t _queuedBytes;
+
+        // Of the files written since the last execute
+        std::vector<StatusWith<BSONObj> > _results;
+
+        void _write();
+    };
 
 }
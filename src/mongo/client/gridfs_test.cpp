@@ -0,0 +1,115 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <string>
+#include <vector>
+
+#include "mongo/client/gridfs.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/dbtests/mock/mock_dbclient_connection.h"
+#include "mongo/dbtests/mock/mock_remote_db_server.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/md5.hpp"
+
+namespace {
+
+    using mongo::BSONObj;
+    using mongo::GridFS;
+    using mongo::GridFileBatch;
+    using mongo::MockDBClientConnection;
+    using mongo::MockRemoteDBServer;
+    using mongo::StatusWith;
+    using std::vector;
+
+    class GridFileBatchTest : public mongo::unittest::Test {
+    protected:
+        GridFileBatchTest() : _server("$test:27017"), _conn(&_server) {
+            // Use write commands
+            _conn.setWireVersions(0, 2);
+            _server.setCommandReply("createIndexes", BSON("ok" << 1));
+        }
+
+        MockRemoteDBServer _server;
+        MockDBClientConnection _conn;
+    };
+
+    TEST_F(GridFileBatchTest, FilesAreWrittenTogether) {
+        _server.setCommandReply("insert", BSON("ok" << 1 << "n" << 2));
+        GridFS grid(_conn, "test");
+        _server.clearCounters();
+
+        GridFileBatch batch(&grid);
+        batch.add("first", 5, "a.txt", "text/plain");
+        batch.add("second", 6, "b.txt");
+
+        vector<StatusWith<BSONObj> > results;
+        batch.execute(&results);
+
+        // One insert for the chunks and one for the file objects
+        ASSERT_EQUALS(2U, _server.getCmdCount());
+        ASSERT_EQUALS(2U, results.size());
+        ASSERT_TRUE(results[0].isOK());
+        ASSERT_EQUALS("a.txt", results[0].getValue()["filename"].str());
+        ASSERT_EQUALS("text/plain", results[0].getValue()["contentType"].str());
+        ASSERT_EQUALS(5, results[0].getValue()["length"].numberInt());
+        ASSERT_EQUALS(mongo::md5simpledigest("first", 5), results[0].getValue()["md5"].str());
+        ASSERT_TRUE(results[1].isOK());
+        ASSERT_EQUALS("b.txt", results[1].getValue()["filename"].str());
+    }
+
+    TEST_F(GridFileBatchTest, ChunkErrorsFailTheirFile) {
+        vector<BSONObj> inserts;
+        // The second chunk of the first file couldn't be stored
+        inserts.push_back(BSON("ok" << 1 << "n" << 2 << "writeErrors" << BSON_ARRAY(
+            BSON("index" << 1 << "code" << 11000 << "errmsg" << "duplicate key"))));
+        inserts.push_back(BSON("ok" << 1 << "n" << 1));
+        _server.setCommandReply("insert", inserts);
+
+        GridFS grid(_conn, "test");
+        grid.setChunkSize(4);
+        _server.clearCounters();
+
+        GridFileBatch batch(&grid);
+        batch.add("two chunks", 8, "a.txt");
+        batch.add("one", 3, "b.txt");
+
+        vector<StatusWith<BSONObj> > results;
+        batch.execute(&results);
+
+        ASSERT_EQUALS(2U, results.size());
+        ASSERT_FALSE(results[0].isOK());
+        ASSERT_EQUALS(mongo::ErrorCodes::DuplicateKey, results[0].getStatus().code());
+        ASSERT_TRUE(results[1].isOK());
+
+        // Only the second file's object was inserted
+        ASSERT_EQUALS(2U, _server.getCmdCount());
+    }
+
+    TEST_F(GridFileBatchTest, ResultsAreOnlyReportedOnce) {
+        _server.setCommandReply("insert", BSON("ok" << 1 << "n" << 1));
+        GridFS grid(_conn, "test");
+
+        GridFileBatch batch(&grid);
+        batch.add("first", 5, "a.txt");
+
+        vector<StatusWith<BSONObj> > results;
+        batch.execute(&results);
+        batch.execute(&results);
+        ASSERT_EQUALS(1U, results.size());
+    }
+
+} // namespace
@@ -0,0 +1,613 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/hash_aggregator.h"
+
+#include <boost/bind.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <third_party/murmurhash3/MurmurHash3.h>
+
+#include "mongo/client/dbclientcursor.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/platform/process_id.h"
+#include "mongo/platform/unordered_map.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    using boost::shared_ptr;
+    using std::string;
+    using std::vector;
+
+    namespace {
+
+        // HyperLogLog precision: 2^10 one byte registers per group and accumulator
+        const int kHllPrecision = 10;
+        const size_t kHllRegisters = size_t(1) << kHllPrecision;
+
+        AtomicUInt32 runCounter;
+
+        void hllAdd(string* registers, const BSONElement& e) {
+            if (registers->empty())
+                registers->assign(kHllRegisters, '\0');
+
+            uint64_t hash[2];
+            MurmurHash3_x64_128(e.value(), e.valuesize(), e.canonicalType(), hash);
+
+            const size_t index = static_cast<size_t>(hash[0] >> (64 - kHllPrecision));
+            uint64_t rest = hash[0] << kHllPrecision;
+            char rank = 1;
+            while (rank <= 64 - kHllPrecision && !(rest & (uint64_t(1) << 63))) {
+                rank++;
+                rest <<= 1;
+            }
+
+            if ((*registers)[index] < rank)
+                (*registers)[index] = rank;
+        }
+
+        long long hllEstimate(const string& registers) {
+            if (registers.empty())
+                return 0;
+
+            const double m = double(kHllRegisters);
+            double sum = 0;
+            int zeros = 0;
+            for (size_t i = 0; i < kHllRegisters; i++) {
+                sum += std::ldexp(1.0, -registers[i]);
+                if (registers[i] == 0)
+                    zeros++;
+            }
+
+            const double alpha = 0.7213 / (1 + 1.079 / m);
+            double estimate = alpha * m * m / sum;
+
+            // Small range correction
+            if (estimate <= 2.5 * m && zeros > 0)
+                estimate = m * std::log(m / zeros);
+
+            return static_cast<long long>(estimate + 0.5);
+        }
+
+        void writeRecord(std::ofstream& out, const BSONObj& record, const string& file) {
+            out.write(record.objdata(), record.objsize());
+            uassert(17402, str::stream() << "error writing aggregation spill file " << file,
+                    out.good());
+        }
+
+        bool readRecord(std::ifstream& in, vector<char>* buffer, const string& file) {
+            int size = 0;
+            in.read(reinterpret_cast<char*>(&size), sizeof(size));
+            if (in.gcount() == 0 && in.eof())
+                return false;
+
+            uassert(17403, str::stream() << "corrupt aggregation spill file " << file,
+                    in.gcount() == sizeof(size) && size >= 5);
+
+            buffer->resize(size);
+            std::memcpy(&(*buffer)[0], &size, sizeof(size));
+            in.read(&(*buffer)[sizeof(size)], size - sizeof(size));
+            uassert(17403, str::stream() << "corrupt aggregation spill file " << file,
+                    in.gcount() == static_cast<std::streamsize>(size - sizeof(size)));
+            return true;
+        }
+
+    } // namespace
+
+    const int HashAggregator::kSpillPartitions(16);
+
+    struct HashAggregator::State {
+        State() : count(0), longSum(0), doubleSum(0), sawDouble(false) {}
+
+        long long count;
+        long long longSum;
+        double doubleSum;
+        bool sawDouble;
+
+        // min and max: the best value so far, as the only element of the object
+        BSONObj extreme;
+
+        // distinctCount: HyperLogLog registers, empty until the first value
+        string registers;
+    };
+
+    class HashAggregator::Table {
+    public:
+        // Key is the raw BSON of the group's _id
+        typedef unordered_map<string, vector<State> > Groups;
+        Groups groups;
+    };
+
+    struct HashAggregator::Worker {
+        Worker(DBClientCursorInterface* c) : cursor(c), documents(0), spills(0), errorCode(0) {}
+
+        DBClientCursorInterface* cursor;
+        Table table;
+
+        // One file per partition, written once the table outgrows _maxGroupsInMemory
+        vector<string> spillFiles;
+
+        long long documents;
+        long long spills;
+
+        // Set when draining the cursor failed
+        string error;
+        int errorCode;
+    };
+
+    HashAggregator::HashAggregator()
+        : _maxGroupsInMemory(0)
+        , _documents(0)
+        , _groups(0)
+        , _spills(0)
+        , _workers(0) {
+        const char* tmp = std::getenv("TMPDIR");
+        _spillDirectory = (tmp && *tmp) ? tmp : "/tmp";
+    }
+
+    HashAggregator::Path HashAggregator::_compile(const string& path, const string& as) {
+        Path compiled;
+        compiled.as = as.empty() ? path : as;
+
+        size_t start = 0;
+        while (true) {
+            const size_t dot = path.find('.', start);
+            compiled.components.push_back(path.substr(start, dot - start));
+            if (dot == string::npos)
+                break;
+            start = dot + 1;
+        }
+        return compiled;
+    }
+
+    HashAggregator& HashAggregator::groupBy(const string& path, const string& as) {
+        _keys.push_back(_compile(path, as));
+        return *this;
+    }
+
+    HashAggregator& HashAggregator::_add(Op op, const string& as, const string& path) {
+        Accumulator accumulator;
+        accumulator.op = op;
+        accumulator.path = _compile(path, as);
+        _accumulators.push_back(accumulator);
+        return *this;
+    }
+
+    HashAggregator& HashAggregator::count(const string& as) {
+        return _add(kOpCount, as, "");
+    }
+
+    HashAggregator& HashAggregator::sum(const string& as, const string& path) {
+        return _add(kOpSum, as, path);
+    }
+
+    HashAggregator& HashAggregator::min(const string& as, const string& path) {
+        return _add(kOpMin, as, path);
+    }
+
+    HashAggregator& HashAggregator::max(const string& as, const string& path) {
+        return _add(kOpMax, as, path);
+    }
+
+    HashAggregator& HashAggregator::avg(const string& as, const string& path) {
+        return _add(kOpAvg, as, path);
+    }
+
+    HashAggregator& HashAggregator::distinctCount(const string& as, const string& path) {
+        return _add(kOpDistinctCount, as, path);
+    }
+
+    HashAggregator& HashAggregator::setMaxGroupsInMemory(size_t maxGroups) {
+        _maxGroupsInMemory = maxGroups;
+        return *this;
+    }
+
+    HashAggregator& HashAggregator::setSpillDirectory(const string& directory) {
+        _spillDirectory = directory;
+        return *this;
+    }
+
+    namespace {
+
+        BSONElement extract(const BSONObj& doc, const vector<string>& components) {
+            BSONObj current = doc;
+            for (size_t i = 0; ; i++) {
+                const BSONElement e = current.getField(components[i]);
+                if (i + 1 == components.size())
+                    return e;
+                if (e.type() != Object && e.type() != Array)
+                    return BSONElement();
+                current = e.embeddedObject();
+            }
+        }
+
+    } // namespace
+
+    void HashAggregator::_drain(Worker* worker) {
+        try {
+            BufBuilder keyBuffer(512);
+
+            while (worker->cursor->more()) {
+                const BSONObj doc = worker->cursor->next();
+                worker->documents++;
+
+                keyBuffer.reset();
+                BSONObjBuilder keyBuilder(keyBuffer);
+                for (size_t i = 0; i < _keys.size(); i++) {
+                    const BSONElement e = extract(doc, _keys[i].components);
+                    if (e.eoo())
+                        keyBuilder.appendNull(_keys[i].as);
+                    else
+                        keyBuilder.appendAs(e, _keys[i].as);
+                }
+                keyBuilder.done();
+
+                vector<State>& states =
+                    worker->table.groups[string(keyBuffer.buf(), keyBuffer.len())];
+                states.resize(_accumulators.size());
+
+                for (size_t i = 0; i < _accumulators.size(); i++) {
+                    const Accumulator& accumulator = _accumulators[i];
+                    State& state = states[i];
+
+                    if (accumulator.op == kOpCount) {
+                        state.count++;
+                        continue;
+                    }
+
+                    const BSONElement e = extract(doc, accumulator.path.components);
+                    switch (accumulator.op) {
+                    case kOpSum:
+                    case kOpAvg:
+                        if (!e.isNumber())
+                            break;
+                        if (e.type() == NumberDouble) {
+                            state.doubleSum += e._numberDouble();
+                            state.sawDouble = true;
+                        }
+                        else {
+                            state.longSum += e.numberLong();
+                        }
+                        state.count++;
+                        break;
+                    case kOpMin:
+                    case kOpMax: {
+                        if (e.eoo() || e.isNull())
+                            break;
+                        if (!state.extreme.isEmpty()) {
+                            const int cmp = e.woCompare(state.extreme.firstElement(), false);
+                            if (accumulator.op == kOpMin ? cmp >= 0 : cmp <= 0)
+                                break;
+                        }
+                        state.extreme = e.wrap("");
+                        break;
+                    }
+                    case kOpDistinctCount:
+                        if (!e.eoo())
+                            hllAdd(&state.registers, e);
+                        break;
+                    case kOpCount:
+                        break;
+                    }
+                }
+
+                if (_maxGroupsInMemory > 0 && worker->table.groups.size() > _maxGroupsInMemory)
+                    _spill(worker);
+            }
+        }
+        catch (const DBException& e) {
+            worker->errorCode = e.getCode();
+            worker->error = e.what();
+        }
+        catch (const std::exception& e) {
+            worker->error = e.what();
+        }
+    }
+
+    void HashAggregator::_spill(Worker* worker) {
+        boost::scoped_array<std::ofstream> files(new std::ofstream[kSpillPartitions]);
+        for (int i = 0; i < kSpillPartitions; i++) {
+            files[i].open(worker->spillFiles[i].c_str(),
+                          std::ios::out | std::ios::binary | std::ios::app);
+            uassert(17404, str::stream() << "couldn't open aggregation spill file "
+                                         << worker->spillFiles[i],
+                    files[i].is_open());
+        }
+
+        for (Table::Groups::const_iterator i = worker->table.groups.begin();
+                i != worker->table.groups.end(); ++i) {
+            uint32_t hash;
+            MurmurHash3_x86_32(i->first.data(), i->first.size(), 0, &hash);
+            const int partition = hash % kSpillPartitions;
+
+            BSONObjBuilder record;
+            record.append("k", BSONObj(i->first.data()));
+            BSONArrayBuilder states(record.subarrayStart("a"));
+            for (size_t j = 0; j < i->second.size(); j++) {
+                const State& state = i->second[j];
+                BSONObjBuilder s(states.subobjStart());
+                if (state.count)
+                    s.append("c", state.count);
+                if (state.longSum)
+                    s.append("l", state.longSum);
+                if (state.sawDouble)
+                    s.append("d", state.doubleSum);
+                if (!state.extreme.isEmpty())
+                    s.appendAs(state.extreme.firstElement(), "x");
+                if (!state.registers.empty())
+                    s.appendBinData("r", state.registers.size(), BinDataGeneral,
+                                    state.registers.data());
+                s.done();
+            }
+            states.done();
+
+            writeRecord(files[partition], record.done(), worker->spillFiles[partition]);
+        }
+
+        Table::Groups().swap(worker->table.groups);
+        worker->spills++;
+    }
+
+    void HashAggregator::_mergeInto(Table* into, const string& key, const vector<State>& from) {
+        vector<State>& states = into->groups[key];
+        if (states.empty()) {
+            states = from;
+            return;
+        }
+
+        for (size_t i = 0; i < _accumulators.size(); i++) {
+            State& state = states[i];
+            const State& other = from[i];
+
+            state.count += other.count;
+            state.longSum += other.longSum;
+            state.doubleSum += other.doubleSum;
+            state.sawDouble = state.sawDouble || other.sawDouble;
+
+            if (!other.extreme.isEmpty()) {
+                if (state.extreme.isEmpty()) {
+                    state.extreme = other.extreme;
+                }
+                else {
+                    const int cmp = other.extreme.firstElement().woCompare(
+                        state.extreme.firstElement(), false);
+                    if (_accumulators[i].op == kOpMin ? cmp < 0 : cmp > 0)
+                        state.extreme = other.extreme;
+                }
+            }
+
+            if (!other.registers.empty()) {
+                if (state.registers.empty()) {
+                    state.registers = other.registers;
+                }
+                else {
+                    for (size_t j = 0; j < kHllRegisters; j++)
+                        state.registers[j] = std::max(state.registers[j], other.registers[j]);
+                }
+            }
+        }
+    }
+
+    void HashAggregator::_emit(const Table& table,
+                               const stdx::function<void(const BSONObj&)>& sink) {
+        for (Table::Groups::const_iterator i = table.groups.begin();
+                i != table.groups.end(); ++i) {
+            BSONObjBuilder b;
+            b.append("_id", BSONObj(i->first.data()));
+
+            for (size_t j = 0; j < _accumulators.size(); j++) {
+                const string& as = _accumulators[j].path.as;
+                const State& state = i->second[j];
+
+                switch (_accumulators[j].op) {
+                case kOpCount:
+                    b.append(as, state.count);
+                    break;
+                case kOpSum:
+                    if (state.sawDouble)
+                        b.append(as, state.doubleSum + state.longSum);
+                    else
+                        b.append(as, state.longSum);
+                    break;
+                case kOpMin:
+                case kOpMax:
+                    if (state.extreme.isEmpty())
+                        b.appendNull(as);
+                    else
+                        b.appendAs(state.extreme.firstElement(), as);
+                    break;
+                case kOpAvg:
+                    if (state.count == 0)
+                        b.appendNull(as);
+                    else
+                        b.append(as, (state.doubleSum + state.longSum) / state.count);
+                    break;
+                case kOpDistinctCount:
+                    b.append(as, hllEstimate(state.registers));
+                    break;
+                }
+            }
+
+            sink(b.obj());
+        }
+    }
+
+    namespace {
+
+        // Removes every spill file of a run, whether or not it completed
+        class SpillFileRemover {
+        public:
+            SpillFileRemover(const vector<string>& files) : _files(files) {}
+            ~SpillFileRemover() {
+                for (size_t i = 0; i < _files.size(); i++)
+                    std::remove(_files[i].c_str());
+            }
+        private:
+            const vector<string>& _files;
+        };
+
+        void collect(vector<BSONObj>* results, const BSONObj& obj) {
+            results->push_back(obj);
+        }
+
+    } // namespace
+
+    void HashAggregator::run(const vector<DBClientCursorInterface*>& cursors,
+                             const stdx::function<void(const BSONObj&)>& sink) {
+        uassert(17405, "HashAggregator needs at least one cursor", !cursors.empty());
+
+        _documents = 0;
+        _groups = 0;
+        _spills = 0;
+        _workers = cursors.size();
+
+        const unsigned run = runCounter.fetchAndAdd(1);
+
+        vector<shared_ptr<Worker> > workers;
+        vector<string> allSpillFiles;
+        for (size_t i = 0; i < cursors.size(); i++) {
+            shared_ptr<Worker> worker(new Worker(cursors[i]));
+            for (int p = 0; p < kSpillPartitions; p++) {
+                worker->spillFiles.push_back(str::stream() << _spillDirectory << "/hashagg-"
+                                                           << ProcessId::getCurrent().asLongLong() << "-"
+                                                           << run << "-" << i << "-" << p);
+            }
+            allSpillFiles.insert(allSpillFiles.end(),
+                                 worker->spillFiles.begin(),
+                                 worker->spillFiles.end());
+            workers.push_back(worker);
+        }
+        const SpillFileRemover remover(allSpillFiles);
+
+        if (workers.size() == 1) {
+            _drain(workers[0].get());
+        }
+        else {
+            boost::thread_group threads;
+            for (size_t i = 0; i < workers.size(); i++)
+                threads.create_thread(boost::bind(&HashAggregator::_drain, this,
+                                                  workers[i].get()));
+            threads.join_all();
+        }
+
+        bool spilled = false;
+        for (size_t i = 0; i < workers.size(); i++) {
+            _documents += workers[i]->documents;
+            spilled = spilled || workers[i]->spills > 0;
+        }
+
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (!workers[i]->error.empty()) {
+                uasserted(workers[i]->errorCode ? workers[i]->errorCode : 17406,
+                          str::stream() << "hash aggregation failed reading cursor " << i
+                                        << ": " << workers[i]->error);
+            }
+        }
+
+        if (!spilled) {
+            // Fold every partial table into the largest one
+            size_t largest = 0;
+            for (size_t i = 1; i < workers.size(); i++) {
+                if (workers[i]->table.groups.size() > workers[largest]->table.groups.size())
+                    largest = i;
+            }
+
+            Table& merged = workers[largest]->table;
+            for (size_t i = 0; i < workers.size(); i++) {
+                if (i == largest)
+                    continue;
+                Table::Groups& groups = workers[i]->table.groups;
+                for (Table::Groups::const_iterator j = groups.begin(); j != groups.end(); ++j)
+                    _mergeInto(&merged, j->first, j->second);
+                Table::Groups().swap(groups);
+            }
+
+            _groups = merged.groups.size();
+            _emit(merged, sink);
+            return;
+        }
+
+        // Put all partials on disk so that each partition can be merged on its own
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (!workers[i]->table.groups.empty())
+                _spill(workers[i].get());
+            _spills += workers[i]->spills;
+        }
+
+        vector<char> buffer;
+        vector<State> states(_accumulators.size());
+        for (int p = 0; p < kSpillPartitions; p++) {
+            Table merged;
+
+            for (size_t i = 0; i < workers.size(); i++) {
+                const string& file = workers[i]->spillFiles[p];
+                std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+                if (!in.is_open())
+                    continue;
+
+                while (readRecord(in, &buffer, file)) {
+                    const BSONObj record(&buffer[0]);
+                    const BSONObj key = record["k"].Obj();
+
+                    BSONObjIterator stateIt(record["a"].Obj());
+                    for (size_t j = 0; j < states.size(); j++) {
+                        const BSONObj s = stateIt.next().Obj();
+                        State& state = states[j];
+                        state.count = s["c"].numberLong();
+                        state.longSum = s["l"].numberLong();
+                        state.sawDouble = s.hasField("d");
+                        state.doubleSum = state.sawDouble ? s["d"].Double() : 0;
+                        state.extreme = s.hasField("x") ? s["x"].wrap("") : BSONObj();
+                        state.registers.clear();
+                        if (s.hasField("r")) {
+                            int len = 0;
+                            const char* data = s["r"].binData(len);
+                            state.registers.assign(data, len);
+                        }
+                    }
+
+                    _mergeInto(&merged, string(key.objdata(), key.objsize()), states);
+                }
+            }
+
+            _groups += merged.groups.size();
+            _emit(merged, sink);
+        }
+    }
+
+    vector<BSONObj> HashAggregator::run(const vector<DBClientCursorInterface*>& cursors) {
+        vector<BSONObj> results;
+        run(cursors, boost::bind(&collect, &results, _1));
+        return results;
+    }
+
+    void HashAggregator::appendInfo(BSONObjBuilder& b) const {
+        b.appendNumber("documents", _documents);
+        b.appendNumber("groups", _groups);
+        b.appendNumber("spills", _spills);
+        b.append("workers", _workers);
+    }
+
+} // namespace mongo
@@ -0,0 +1,141 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mongo/client/export_macros.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/stdx/functional.h"
+
+namespace mongo {
+
+    class DBClientCursorInterface;
+
+    /**
+     * Groups the documents of one or more cursors on the client, in the manner of a $group
+     * stage:
+     *
+     *   HashAggregator agg;
+     *   agg.groupBy("region").groupBy("product.sku", "sku")
+     *      .count("orders")
+     *      .sum("revenue", "total")
+     *      .distinctCount("customers", "customerId");
+     *   std::vector<BSONObj> results = agg.run(cursors);
+     *
+     * Each result looks like { _id: { region: ..., sku: ... }, orders: ..., revenue: ... }.
+     *
+     * Every cursor is drained by its own thread into a private hash table, so cursors from
+     * DBClientWithCommands::parallelScan are aggregated in parallel; the partial tables are
+     * merged once all cursors are exhausted. Key and value paths are dotted paths, split once
+     * up front; a missing key field groups as null. Keys compare by their exact BSON
+     * representation, so 1 and 1.0 form different groups.
+     *
+     * When a worker holds more than setMaxGroupsInMemory() groups, its table is written to
+     * hash partitioned spill files and cleared. The merge then proceeds one partition at a
+     * time, so memory is bounded by the size of a partition rather than the key cardinality.
+     *
+     * Not thread safe; run() may be called repeatedly, each run starts from empty tables.
+     */
+    class MONGO_CLIENT_API HashAggregator {
+    public:
+
+        enum Op {
+            kOpCount,
+            kOpSum,
+            kOpMin,
+            kOpMax,
+            kOpAvg,
+
+            // Approximate (HyperLogLog, about 3% standard error) count of distinct values
+            kOpDistinctCount,
+        };
+
+        // Number of spill files per worker
+        static const int kSpillPartitions;
+
+        HashAggregator();
+
+        /** Adds a group key component read from 'path', output under 'as' (default 'path'). */
+        HashAggregator& groupBy(const std::string& path, const std::string& as = "");
+
+        HashAggregator& count(const std::string& as);
+        HashAggregator& sum(const std::string& as, const std::string& path);
+        HashAggregator& min(const std::string& as, const std::string& path);
+        HashAggregator& max(const std::string& as, const std::string& path);
+        HashAggregator& avg(const std::string& as, const std::string& path);
+        HashAggregator& distinctCount(const std::string& as, const std::string& path);
+
+        /**
+         * Sets the number of groups a worker keeps in memory before spilling them to disk.
+         * 0 (the default) never spills.
+         */
+        HashAggregator& setMaxGroupsInMemory(size_t maxGroups);
+
+        /** Sets where spill files go. Defaults to $TMPDIR, or /tmp. */
+        HashAggregator& setSpillDirectory(const std::string& directory);
+
+        /**
+         * Drains 'cursors' and passes every group to 'sink' once all input has been seen.
+         * Groups are not produced in any particular order. Rethrows the first error raised
+         * while reading a cursor.
+         */
+        void run(const std::vector<DBClientCursorInterface*>& cursors,
+                 const stdx::function<void(const BSONObj&)>& sink);
+
+        std::vector<BSONObj> run(const std::vector<DBClientCursorInterface*>& cursors);
+
+        /** Appends counters of the last run: documents, groups, spills and workers. */
+        void appendInfo(BSONObjBuilder& b) const;
+
+    private:
+        struct Path {
+            std::string as;
+            std::vector<std::string> components;
+        };
+
+        struct Accumulator {
+            Op op;
+            Path path;
+        };
+
+        struct Worker;
+        struct State;
+        class Table;
+
+        static Path _compile(const std::string& path, const std::string& as);
+
+        HashAggregator& _add(Op op, const std::string& as, const std::string& path);
+
+        void _drain(Worker* worker);
+        void _spill(Worker* worker);
+        void _mergeInto(Table* into, const std::string& key, const std::vector<State>& from);
+        void _emit(const Table& table, const stdx::function<void(const BSONObj&)>& sink);
+
+        std::vector<Path> _keys;
+        std::vector<Accumulator> _accumulators;
+        size_t _maxGroupsInMemory;
+        std::string _spillDirectory;
+
+        // Counters of the last run
+        long long _documents;
+        long long _groups;
+        long long _spills;
+        int _workers;
+    };
+
+} // namespace mongo
@@ -0,0 +1,203 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+#include <map>
+
+#include "mongo/client/dbclientmockcursor.h"
+#include "mongo/client/hash_aggregator.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using boost::shared_ptr;
+    using mongo::BSONArray;
+    using mongo::BSONArrayBuilder;
+    using mongo::BSONObj;
+    using mongo::BSONObjBuilder;
+    using mongo::DBClientCursorInterface;
+    using mongo::DBClientMockCursor;
+    using mongo::HashAggregator;
+    using std::map;
+    using std::string;
+    using std::vector;
+
+    // Owns a set of mock cursors, one per array of documents. DBClientMockCursor only iterates
+    // over its array, so the arrays are kept here as well.
+    class Cursors {
+    public:
+        void add(const BSONArray& docs) {
+            _arrays.push_back(docs);
+            _owned.push_back(shared_ptr<DBClientMockCursor>(new DBClientMockCursor(docs)));
+            _cursors.push_back(_owned.back().get());
+        }
+
+        const vector<DBClientCursorInterface*>& get() const { return _cursors; }
+
+    private:
+        vector<BSONArray> _arrays;
+        vector<shared_ptr<DBClientMockCursor> > _owned;
+        vector<DBClientCursorInterface*> _cursors;
+    };
+
+    // Indexes results by the single component of their _id.
+    map<string, BSONObj> byKey(const vector<BSONObj>& results, const string& field) {
+        map<string, BSONObj> indexed;
+        for (size_t i = 0; i < results.size(); i++)
+            indexed[results[i]["_id"].Obj()[field].toString(false)] = results[i].getOwned();
+        return indexed;
+    }
+
+    TEST(HashAggregatorTest, Accumulators) {
+        BSONArrayBuilder docs;
+        docs.append(BSON("k" << "a" << "v" << 1));
+        docs.append(BSON("k" << "a" << "v" << 3));
+        docs.append(BSON("k" << "a" << "v" << "not a number"));
+        docs.append(BSON("k" << "b" << "v" << 2.5));
+        docs.append(BSON("k" << "b"));
+
+        Cursors cursors;
+        cursors.add(docs.arr());
+
+        HashAggregator agg;
+        agg.groupBy("k")
+           .count("n")
+           .sum("sum", "v")
+           .avg("avg", "v")
+           .min("min", "v")
+           .max("max", "v");
+
+        map<string, BSONObj> results = byKey(agg.run(cursors.get()), "k");
+        ASSERT_EQUALS(2U, results.size());
+
+        const BSONObj a = results["\"a\""];
+        ASSERT_EQUALS(3, a["n"].numberLong());
+        ASSERT_EQUALS(mongo::NumberLong, a["sum"].type());
+        ASSERT_EQUALS(4, a["sum"].numberLong());
+        ASSERT_EQUALS(2.0, a["avg"].Double());
+        ASSERT_EQUALS(1, a["min"].numberInt());
+        ASSERT_EQUALS("not a number", a["max"].String());
+
+        const BSONObj b = results["\"b\""];
+        ASSERT_EQUALS(2, b["n"].numberLong());
+        ASSERT_EQUALS(mongo::NumberDouble, b["sum"].type());
+        ASSERT_EQUALS(2.5, b["sum"].Double());
+        ASSERT_EQUALS(2.5, b["min"].Double());
+    }
+
+    TEST(HashAggregatorTest, DottedPathsAndMissingKeys) {
+        BSONArrayBuilder docs;
+        docs.append(BSON("product" << BSON("sku" << "x") << "qty" << 2));
+        docs.append(BSON("product" << BSON("sku" << "x") << "qty" << 5));
+        docs.append(BSON("qty" << 7));
+
+        Cursors cursors;
+        cursors.add(docs.arr());
+
+        HashAggregator agg;
+        agg.groupBy("product.sku", "sku").sum("qty", "qty");
+
+        map<string, BSONObj> results = byKey(agg.run(cursors.get()), "sku");
+        ASSERT_EQUALS(2U, results.size());
+        ASSERT_EQUALS(7, results["\"x\""]["qty"].numberLong());
+        ASSERT_EQUALS(7, results["null"]["qty"].numberLong());
+    }
+
+    TEST(HashAggregatorTest, DistinctCountIsApproximate) {
+        BSONArrayBuilder docs;
+        for (int i = 0; i < 20000; i++)
+            docs.append(BSON("v" << i % 5000));
+
+        Cursors cursors;
+        cursors.add(docs.arr());
+
+        HashAggregator agg;
+        agg.distinctCount("distinct", "v");
+
+        const vector<BSONObj> results = agg.run(cursors.get());
+        ASSERT_EQUALS(1U, results.size());
+        const long long estimate = results[0]["distinct"].numberLong();
+        ASSERT_GREATER_THAN(estimate, 4500);
+        ASSERT_LESS_THAN(estimate, 5500);
+    }
+
+    TEST(HashAggregatorTest, MergesParallelCursors) {
+        Cursors cursors;
+        for (int c = 0; c < 4; c++) {
+            BSONArrayBuilder docs;
+            for (int i = 0; i < 1000; i++)
+                docs.append(BSON("k" << i % 10 << "v" << c));
+            cursors.add(docs.arr());
+        }
+
+        HashAggregator agg;
+        agg.groupBy("k").count("n").max("max", "v").distinctCount("cursors", "v");
+
+        const vector<BSONObj> results = agg.run(cursors.get());
+        ASSERT_EQUALS(10U, results.size());
+        for (size_t i = 0; i < results.size(); i++) {
+            ASSERT_EQUALS(400, results[i]["n"].numberLong());
+            ASSERT_EQUALS(3, results[i]["max"].numberInt());
+            ASSERT_EQUALS(4, results[i]["cursors"].numberLong());
+        }
+
+        BSONObjBuilder info;
+        agg.appendInfo(info);
+        const BSONObj infoObj = info.obj();
+        ASSERT_EQUALS(4000, infoObj["documents"].numberLong());
+        ASSERT_EQUALS(10, infoObj["groups"].numberLong());
+        ASSERT_EQUALS(0, infoObj["spills"].numberLong());
+        ASSERT_EQUALS(4, infoObj["workers"].numberInt());
+    }
+
+    TEST(HashAggregatorTest, SpillsAndMergesPartitions) {
+        Cursors cursors;
+        for (int c = 0; c < 2; c++) {
+            BSONArrayBuilder docs;
+            for (int i = 0; i < 3000; i++)
+                docs.append(BSON("k" << i << "v" << i * 2 + c));
+            cursors.add(docs.arr());
+        }
+
+        HashAggregator agg;
+        agg.groupBy("k")
+           .count("n")
+           .sum("sum", "v")
+           .min("min", "v")
+           .distinctCount("distinct", "v")
+           .setMaxGroupsInMemory(100);
+
+        const vector<BSONObj> results = agg.run(cursors.get());
+        ASSERT_EQUALS(3000U, results.size());
+        for (size_t i = 0; i < results.size(); i++) {
+            const int k = results[i]["_id"]["k"].numberInt();
+            ASSERT_EQUALS(2, results[i]["n"].numberLong());
+            ASSERT_EQUALS(4 * k + 1, results[i]["sum"].numberLong());
+            ASSERT_EQUALS(2 * k, results[i]["min"].numberInt());
+            // Both values can land in the same HyperLogLog register
+            const long long distinct = results[i]["distinct"].numberLong();
+            ASSERT_TRUE(distinct == 1 || distinct == 2);
+        }
+
+        BSONObjBuilder info;
+        agg.appendInfo(info);
+        ASSERT_GREATER_THAN(info.obj()["spills"].numberLong(), 2);
+    }
+
+} // namespace
@@ -21,9 +21,12 @@
 
 #include "mongo/base/initializer.h"
 #include "mongo/client/connpool.h"
+#include "mongo/client/operation_trace.h"
 #include "mongo/client/private/options.h"
+#include "mongo/client/query_shape_profiler.h"
 #include "mongo/client/replica_set_monitor.h"
 #include "mongo/util/background.h"
+#include "mongo/util/memory_budget.h"
 
 namespace mongo {
 namespace client {
@@ -56,6 +59,16 @@ namespace client {
         mongo::pool.setName("connection pool");
         mongo::pool.setMaxPoolSize(50);
 
+        MemoryBudget::global()->setLimitBytes(options.memoryBudgetBytes());
+        BSONObjBuilder::setShrinkThreshold(options.bsonShrinkThresholdBytes());
+        OperationTrace::configure(
+            options.operationTraceSampling(),
+            options.slowOperationThresholdMillis() < 0 ?
+                -1 : options.slowOperationThresholdMillis() * 1000LL,
+            options.operationTraceHook());
+        QueryShapeProfiler::configure(options.queryShapeProfiling(),
+                                      options.queryShapeProfilerMaxShapes());
+
         PeriodicTask::startRunningPeriodicTasks();
 
         return Status::OK();
@@ -0,0 +1,191 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/multi_bulk_operation_builder.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+#include "mongo/base/error_codes.h"
+#include "mongo/client/connpool.h"
+#include "mongo/client/exceptions.h"
+#include "mongo/client/write_operation_queue.h"
+#include "mongo/client/write_result.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    namespace {
+
+        // The writes of one namespace and how they went
+        struct NamespaceWrite {
+            NamespaceWrite() : builder(NULL), failed(false), errorCode(0) {}
+
+            BulkOperationBuilder* builder;
+            WriteResult result;
+
+            // Set if the namespace couldn't be written, as opposed to a write failing
+            bool failed;
+            int errorCode;
+            std::string error;
+        };
+
+    } // namespace
+
+    struct MultiBulkOperationBuilder::Execution {
+        Execution(const ConnectionString& server, double socketTimeout,
+                  const WriteConcern* writeConcern)
+            : server(server)
+            , socketTimeout(socketTimeout)
+            , writeConcern(writeConcern)
+            , next(0)
+        {}
+
+        const ConnectionString& server;
+        const double socketTimeout;
+        const WriteConcern* const writeConcern;
+
+        std::vector<NamespaceWrite> writes;
+
+        boost::mutex mutex;
+        size_t next; // the next of 'writes' to start
+    };
+
+    MultiBulkOperationBuilder::MultiBulkOperationBuilder(const ConnectionString& server,
+                                                         bool ordered,
+                                                         double socketTimeout)
+        : _server(server)
+        , _ordered(ordered)
+        , _socketTimeout(socketTimeout)
+        , _maxConcurrency(kDefaultMaxConcurrency)
+        , _coalesceUpdates(false)
+        , _executed(false)
+        , _nextIndex(0)
+    {}
+
+    BulkUpdateBuilder MultiBulkOperationBuilder::find(const std::string& ns,
+                                                      const BSONObj& selector) {
+        return _builderFor(ns).find(selector);
+    }
+
+    void MultiBulkOperationBuilder::insert(const std::string& ns, const BSONObj& doc) {
+        _builderFor(ns).insert(doc);
+    }
+
+    void MultiBulkOperationBuilder::setCoalesceUpdates(bool coalesceUpdates) {
+        _coalesceUpdates = coalesceUpdates;
+    }
+
+    void MultiBulkOperationBuilder::setMaxConcurrency(int maxConcurrency) {
+        uassert(ErrorCodes::BadValue, "bulk concurrency must be at least 1", maxConcurrency >= 1);
+        _maxConcurrency = maxConcurrency;
+    }
+
+    BulkOperationBuilder& MultiBulkOperationBuilder::_builderFor(const std::string& ns) {
+        boost::shared_ptr<BulkOperationBuilder>& builder = _builders[ns];
+        if (!builder) {
+            // Executed later on a pooled connection, see _executeNamespaces
+            builder.reset(new BulkOperationBuilder(NULL, ns, _ordered));
+            builder->_operations->shareBulkIndexes(&_nextIndex);
+        }
+        return *builder;
+    }
+
+    void MultiBulkOperationBuilder::execute(const WriteConcern* writeConcern,
+                                            WriteResult* writeResult) {
+        uassert(0, "Bulk operations cannot be re-executed", !_executed);
+        uassert(0, "Bulk operations cannot be executed without any operations",
+            !_builders.empty());
+
+        _executed = true;
+
+        Execution execution(_server, _socketTimeout, writeConcern);
+        execution.writes.resize(_builders.size());
+        size_t i = 0;
+        for (Builders::const_iterator it = _builders.begin(); it != _builders.end(); ++it, ++i) {
+            it->second->setCoalesceUpdates(_coalesceUpdates);
+            execution.writes[i].builder = it->second.get();
+        }
+
+        const size_t threads = std::min(execution.writes.size(),
+                                        static_cast<size_t>(_maxConcurrency));
+        if (threads == 1) {
+            _executeNamespaces(&execution);
+        }
+        else {
+            boost::thread_group workers;
+            for (size_t t = 0; t < threads; t++)
+                workers.create_thread(boost::bind(_executeNamespaces, &execution));
+            workers.join_all();
+        }
+
+        const NamespaceWrite* failed = NULL;
+        for (size_t w = 0; w < execution.writes.size(); w++) {
+            writeResult->_mergeWriteResult(execution.writes[w].result);
+            if (!failed && execution.writes[w].failed)
+                failed = &execution.writes[w];
+        }
+        writeResult->_sortByIndex();
+
+        if (failed) {
+            uasserted(failed->errorCode,
+                      str::stream() << "bulk write to " << failed->builder->_ns
+                                    << " failed: " << failed->error);
+        }
+        writeResult->_check(true);
+    }
+
+    void MultiBulkOperationBuilder::_executeNamespaces(Execution* execution) {
+        while (true) {
+            NamespaceWrite* write;
+            {
+                boost::lock_guard<boost::mutex> lk(execution->mutex);
+                if (execution->next == execution->writes.size())
+                    return;
+                write = &execution->writes[execution->next++];
+            }
+
+            try {
+                ScopedDbConnection conn(execution->server, execution->socketTimeout);
+                try {
+                    write->builder->_execute(conn.get(), execution->writeConcern,
+                                             &write->result);
+                }
+                catch (const OperationException&) {
+                    // The write errors are in write->result, and the connection is fine
+                }
+                conn.done();
+            }
+            catch (const DBException& e) {
+                write->failed = true;
+                write->errorCode = e.getCode();
+                write->error = e.what();
+            }
+            catch (const std::exception& e) {
+                write->failed = true;
+                write->errorCode = ErrorCodes::UnknownError;
+                write->error = e.what();
+            }
+        }
+    }
+
+} // namespace mongo
@@ -0,0 +1,123 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <map>
+#include <string>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/client/bulk_operation_builder.h"
+#include "mongo/client/dbclientinterface.h"
+#include "mongo/client/export_macros.h"
+
+namespace mongo {
+
+    class WriteConcern;
+    class WriteResult;
+
+    /**
+     * A bulk operation spanning several namespaces, executed concurrently.
+     *
+     * Example Usage:
+     *
+     * MultiBulkOperationBuilder bulk(ConnectionString(...), false);
+     * bulk.insert("app.events", <BSONObj>);
+     * bulk.insert("app.audit", <BSONObj>);
+     * bulk.find("app.users", <BSONObj>).updateOne(<BSONObj>);
+     *
+     * WriteResult result;
+     * bulk.execute(<WriteConcern>, &result);
+     *
+     * Operations may be queued for any namespace in any order. On execute() they are grouped
+     * by namespace, and each namespace's operations are executed like a BulkOperationBuilder
+     * for that namespace would: in order if the bulk is ordered, and batched within the
+     * server's limits. Up to setMaxConcurrency() namespaces are written at the same time,
+     * each on its own connection from the global pool.
+     *
+     * Ordering only holds within a namespace: an error in an ordered bulk stops the remaining
+     * operations of that namespace, while the other namespaces are written to completion.
+     *
+     * The combined WriteResult adds up the counts of every namespace. The "index" of each
+     * upsert and write error is that of the operation in the order it was queued here,
+     * across all namespaces.
+     */
+    class MONGO_CLIENT_API MultiBulkOperationBuilder : boost::noncopyable {
+    public:
+        static const int kDefaultMaxConcurrency = 8;
+
+        /**
+         * @param server The server or replica set to write to.
+         * @param ordered Whether operations on each namespace must be applied in order.
+         * @param socketTimeout For the pooled connections, in seconds. 0 for none.
+         */
+        MultiBulkOperationBuilder(const ConnectionString& server, bool ordered,
+                                  double socketTimeout = 0);
+
+        /**
+         * Supplies a filter selecting documents of 'ns' for the update, replace or remove
+         * operation subsequently chosen on the returned BulkUpdateBuilder.
+         */
+        BulkUpdateBuilder find(const std::string& ns, const BSONObj& selector);
+
+        /** Enqueues an insert of 'doc' into 'ns'. */
+        void insert(const std::string& ns, const BSONObj& doc);
+
+        /** See BulkOperationBuilder::setCoalesceUpdates. Applies to every namespace. */
+        void setCoalesceUpdates(bool coalesceUpdates);
+
+        /**
+         * Set the most namespaces written at the same time.
+         *
+         * Default: kDefaultMaxConcurrency
+         */
+        void setMaxConcurrency(int maxConcurrency);
+
+        /**
+         * Executes the operations of every namespace and combines their results.
+         *
+         * Throws OperationException if any write failed, like BulkOperationBuilder::execute,
+         * or a DBException if a namespace couldn't be written at all, for example because
+         * no connection could be made. In both cases 'writeResult' holds the combined
+         * results of every namespace.
+         *
+         * @param writeConcern The write concern for all the operations. 0 = default.
+         * @param writeResult Where the combined results go.
+         */
+        void execute(const WriteConcern* writeConcern, WriteResult* writeResult);
+
+    private:
+        struct Execution;
+
+        BulkOperationBuilder& _builderFor(const std::string& ns);
+        static void _executeNamespaces(Execution* execution);
+
+        const ConnectionString _server;
+        const bool _ordered;
+        const double _socketTimeout;
+        int _maxConcurrency;
+        bool _coalesceUpdates;
+        bool _executed;
+
+        // The bulk index of the next operation queued, in any namespace
+        size_t _nextIndex;
+
+        typedef std::map<std::string, boost::shared_ptr<BulkOperationBuilder> > Builders;
+        Builders _builders;
+    };
+
+} // namespace mongo
@@ -0,0 +1,116 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/connpool.h"
+#include "mongo/client/dbclientinterface.h"
+#include "mongo/client/multi_bulk_operation_builder.h"
+#include "mongo/client/write_concern.h"
+#include "mongo/client/write_result.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/dbtests/mock/mock_conn_registry.h"
+#include "mongo/dbtests/mock/mock_remote_db_server.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using mongo::BSONObj;
+    using mongo::ConnectionString;
+    using mongo::HostAndPort;
+    using mongo::MockConnRegistry;
+    using mongo::MockRemoteDBServer;
+    using mongo::MultiBulkOperationBuilder;
+    using mongo::OperationException;
+    using mongo::WriteConcern;
+    using mongo::WriteResult;
+
+    const char kHost[] = "$multibulk:27017";
+
+    class MultiBulkTest : public mongo::unittest::Test {
+    protected:
+        MultiBulkTest() : _server(kHost) {}
+
+        void setUp() {
+            // Use write commands
+            _server.setWireVersions(0, 2);
+            MockConnRegistry::get()->addServer(&_server);
+            ConnectionString::setConnectionHook(MockConnRegistry::get()->getConnStrHook());
+        }
+
+        void tearDown() {
+            mongo::ScopedDbConnection::clearPool();
+            MockConnRegistry::get()->removeServer(kHost);
+        }
+
+        ConnectionString server() const {
+            return ConnectionString(HostAndPort(kHost));
+        }
+
+        MockRemoteDBServer _server;
+    };
+
+    TEST_F(MultiBulkTest, NamespacesAreWrittenSeparately) {
+        _server.setCommandReply("insert", BSON("ok" << 1 << "n" << 2));
+
+        MultiBulkOperationBuilder bulk(server(), true);
+        bulk.insert("test.a", BSON("_id" << 0));
+        bulk.insert("test.b", BSON("_id" << 0));
+        bulk.insert("test.a", BSON("_id" << 1));
+        bulk.insert("test.b", BSON("_id" << 1));
+
+        WriteResult result;
+        bulk.execute(&WriteConcern::acknowledged, &result);
+
+        // One insert command for each namespace
+        ASSERT_EQUALS(2U, _server.getCmdCount());
+        ASSERT_EQUALS(4, result.nInserted());
+    }
+
+    TEST_F(MultiBulkTest, ErrorsHaveTheIndexesTheOperationsWereQueuedWith) {
+        _server.setCommandReply("update", BSON("ok" << 1 << "n" << 1 << "nModified" << 1
+            << "writeErrors" << BSON_ARRAY(BSON("index" << 1 << "code" << 2 << "errmsg" << "x"))));
+
+        MultiBulkOperationBuilder bulk(server(), false);
+        bulk.setMaxConcurrency(2);
+        const BSONObj update = BSON("$set" << BSON("status" << "done"));
+        bulk.find("test.a", BSON("_id" << 0)).updateOne(update);
+        bulk.find("test.b", BSON("_id" << 0)).updateOne(update);
+        bulk.find("test.a", BSON("_id" << 1)).updateOne(update);
+        bulk.find("test.b", BSON("_id" << 1)).updateOne(update);
+
+        WriteResult result;
+        ASSERT_THROWS(bulk.execute(&WriteConcern::acknowledged, &result), OperationException);
+
+        // The second update of each namespace failed
+        ASSERT_EQUALS(2, result.nMatched());
+        ASSERT_EQUALS(2U, result.writeErrors().size());
+        ASSERT_EQUALS(2, result.writeErrors()[0]["index"].numberInt());
+        ASSERT_EQUALS(3, result.writeErrors()[1]["index"].numberInt());
+    }
+
+    TEST_F(MultiBulkTest, UnreachableServerFailsTheBulk) {
+        _server.shutdown();
+
+        MultiBulkOperationBuilder bulk(server(), false);
+        bulk.insert("test.a", BSON("_id" << 0));
+        bulk.insert("test.b", BSON("_id" << 0));
+
+        WriteResult result;
+        ASSERT_THROWS(bulk.execute(&WriteConcern::acknowledged, &result), mongo::DBException);
+        ASSERT_EQUALS(0, result.nInserted());
+    }
+
+} // namespace
@@ -0,0 +1,250 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/operation_trace.h"
+
+#include <boost/thread/tss.hpp>
+#include <exception>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/log.h"
+
+namespace mongo {
+
+    namespace {
+
+        // Set once by client::initialize, before any operation runs
+        int sampleEvery = 0;
+        long long slowMicros = -1;
+        OperationTrace::Hook* hook = new OperationTrace::Hook();
+
+        struct ThreadTraces {
+            ThreadTraces() : current(NULL), timer(NULL), operations(0) {
+                for (int i = 0; i < OperationTrace::kNumPhases; i++)
+                    pending[i] = 0;
+            }
+
+            OperationTrace* current;
+            OperationTrace::Timer* timer;      // innermost running phase
+            long long pending[OperationTrace::kNumPhases];   // held for the next operation
+            unsigned operations;
+        };
+
+        boost::thread_specific_ptr<ThreadTraces> threadTraces;
+
+        ThreadTraces* getThreadTraces() {
+            ThreadTraces* traces = threadTraces.get();
+            if (!traces) {
+                traces = new ThreadTraces();
+                threadTraces.reset(traces);
+            }
+            return traces;
+        }
+
+        OperationTrace* currentTrace() {
+            if (!OperationTrace::enabled())
+                return NULL;
+            ThreadTraces* traces = threadTraces.get();
+            return traces ? traces->current : NULL;
+        }
+
+        bool isConnectionPhase(OperationTrace::Phase phase) {
+            return phase == OperationTrace::kCheckout ||
+                   phase == OperationTrace::kConnect ||
+                   phase == OperationTrace::kAuth;
+        }
+
+        void report(const OperationTrace& trace) {
+            if (*hook) {
+                (*hook)(trace);
+            }
+            else if (trace.slow) {
+                log() << "slow operation: " << trace.toBSON() << std::endl;
+            }
+            else {
+                LOG(1) << "sampled operation: " << trace.toBSON() << std::endl;
+            }
+        }
+
+    } // namespace
+
+    const char* OperationTrace::phaseName(Phase phase) {
+        switch (phase) {
+        case kCheckout: return "checkout";
+        case kConnect: return "connect";
+        case kAuth: return "auth";
+        case kSend: return "send";
+        case kServer: return "server";
+        case kReceive: return "receive";
+        case kDecode: return "decode";
+        default: return "unknown";
+        }
+    }
+
+    OperationTrace::OperationTrace()
+        : durationMicros(0)
+        , bytesOut(0)
+        , bytesIn(0)
+        , batches(0)
+        , docs(0)
+        , ok(true)
+        , sampled(false)
+        , slow(false) {
+        for (int i = 0; i < kNumPhases; i++)
+            phaseMicros[i] = 0;
+    }
+
+    BSONObj OperationTrace::toBSON() const {
+        BSONObjBuilder b;
+        b.append("op", op);
+        b.append("ns", ns);
+        b.append("host", host);
+        b.appendDate("start", start);
+        b.append("micros", durationMicros);
+
+        BSONObjBuilder phases(b.subobjStart("phases"));
+        long long phaseTotal = 0;
+        for (int i = 0; i < kNumPhases; i++) {
+            phases.append(phaseName(static_cast<Phase>(i)), phaseMicros[i]);
+            phaseTotal += phaseMicros[i];
+        }
+        phases.append("other", durationMicros - phaseTotal);
+        phases.done();
+
+        b.append("bytesOut", bytesOut);
+        b.append("bytesIn", bytesIn);
+        b.append("batches", batches);
+        b.append("docs", docs);
+        b.append("ok", ok);
+        b.append("sampled", sampled);
+        b.append("slow", slow);
+        return b.obj();
+    }
+
+    void OperationTrace::configure(int newSampleEvery, long long newSlowMicros,
+                                   const Hook& newHook) {
+        sampleEvery = newSampleEvery;
+        slowMicros = newSlowMicros;
+        *hook = newHook;
+    }
+
+    bool OperationTrace::enabled() {
+        return sampleEvery > 0 || slowMicros >= 0;
+    }
+
+    void OperationTrace::noteHost(const std::string& host) {
+        if (OperationTrace* trace = currentTrace())
+            trace->host = host;
+    }
+
+    void OperationTrace::noteBytes(long long out, long long in) {
+        if (OperationTrace* trace = currentTrace()) {
+            trace->bytesOut += out;
+            trace->bytesIn += in;
+        }
+    }
+
+    void OperationTrace::noteBatch(int docs) {
+        OperationTrace* trace = currentTrace();
+        if (trace && docs > 0) {
+            trace->batches++;
+            trace->docs += docs;
+        }
+    }
+
+    OperationTrace::Scope::Scope(const char* op, const StringData& ns)
+        : _trace(NULL)
+        , _startMicros(0) {
+        if (!enabled())
+            return;
+
+        ThreadTraces* traces = getThreadTraces();
+        if (traces->current || (traces->timer && isConnectionPhase(traces->timer->_phase)))
+            return;
+
+        _trace = new OperationTrace();
+        _trace->op = op;
+        _trace->ns = ns.toString();
+        _trace->start = jsTime();
+        _trace->sampled = sampleEvery > 0 && traces->operations++ % sampleEvery == 0;
+        for (int i = 0; i < kNumPhases; i++) {
+            _trace->phaseMicros[i] = traces->pending[i];
+            _trace->durationMicros += traces->pending[i];
+            traces->pending[i] = 0;
+        }
+
+        _startMicros = curTimeMicros64();
+        traces->current = _trace;
+    }
+
+    OperationTrace::Scope::~Scope() {
+        if (!_trace)
+            return;
+
+        getThreadTraces()->current = NULL;
+        _trace->durationMicros += curTimeMicros64() - _startMicros;
+        _trace->ok = !std::uncaught_exception();
+        _trace->slow = slowMicros >= 0 && _trace->durationMicros >= slowMicros;
+
+        if (_trace->sampled || _trace->slow) {
+            DESTRUCTOR_GUARD( report(*_trace); );
+        }
+        delete _trace;
+    }
+
+    OperationTrace::Timer::Timer(Phase phase)
+        : _phase(phase)
+        , _outer(NULL)
+        , _active(false)
+        , _resumed(0)
+        , _elapsedMicros(0) {
+        if (!enabled())
+            return;
+
+        ThreadTraces* traces = getThreadTraces();
+        if (!isConnectionPhase(phase) &&
+            (!traces->current || (traces->timer && isConnectionPhase(traces->timer->_phase))))
+            return;
+
+        _active = true;
+        _resumed = curTimeMicros64();
+        _outer = traces->timer;
+        if (_outer)
+            _outer->_elapsedMicros += _resumed - _outer->_resumed;
+        traces->timer = this;
+    }
+
+    OperationTrace::Timer::~Timer() {
+        if (!_active)
+            return;
+
+        const unsigned long long now = curTimeMicros64();
+        _elapsedMicros += now - _resumed;
+
+        ThreadTraces* traces = getThreadTraces();
+        if (traces->current)
+            traces->current->phaseMicros[_phase] += _elapsedMicros;
+        else
+            traces->pending[_phase] += _elapsedMicros;
+
+        traces->timer = _outer;
+        if (_outer)
+            _outer->_resumed = now;
+    }
+
+} // namespace mongo
@@ -0,0 +1,133 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/function.hpp>
+#include <boost/utility.hpp>
+#include <string>
+
+#include "mongo/base/string_data.h"
+#include "mongo/client/export_macros.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+    class BSONObj;
+
+    /**
+     * Where the time of one driver operation went: a query, a getMore, a command or a write.
+     *
+     * Operations are traced when client::Options::setOperationTraceSampling or
+     * setSlowOperationThresholdMillis is set. Every operation then has its phases timed, which
+     * costs a handful of clock reads, and is reported if it is one of the sampled 1-in-N or
+     * took at least the slow threshold. Reports go to the hook set with
+     * client::Options::setOperationTraceHook; without one, slow operations are logged and
+     * sampled ones logged at verbosity 1.
+     *
+     * Pool checkouts, connects and authentication usually happen before the operation that
+     * needs them starts, so their time is held by the thread and charged to the next operation
+     * it traces. Commands the driver runs on its own behalf, such as the ones authentication
+     * sends, are part of the operation or phase that ran them rather than traced separately.
+     */
+    class MONGO_CLIENT_API OperationTrace {
+    public:
+        enum Phase {
+            kCheckout,      // waiting for and handing out a pooled connection
+            kConnect,       // establishing a new connection
+            kAuth,          // authenticating a connection
+            kSend,          // writing the request to the socket
+            kServer,        // from the request being sent until the reply starts arriving
+            kReceive,       // reading the rest of the reply
+            kDecode,        // processing the reply in the driver
+            kNumPhases
+        };
+
+        static const char* MONGO_CLIENT_FUNC phaseName(Phase phase);
+
+        typedef boost::function<void (const OperationTrace&)> Hook;
+
+        OperationTrace();
+
+        std::string op;             // "query", "getMore", "command", "write" or "writeCommand"
+        std::string ns;
+        std::string host;           // the server the last request went to
+        Date_t start;
+        long long durationMicros;   // including checkout, connect and auth time held over
+        long long phaseMicros[kNumPhases];
+        long long bytesOut;
+        long long bytesIn;
+        int batches;                // replies carrying documents
+        long long docs;
+        bool ok;                    // false if the operation ended with an exception
+        bool sampled;
+        bool slow;
+
+        BSONObj toBSON() const;
+
+        /**
+         * Sets what is traced and where reports go, from client::initialize. 'sampleEvery' of
+         * zero samples nothing, a negative 'slowMicros' reports nothing as slow.
+         */
+        static void MONGO_CLIENT_FUNC configure(int sampleEvery, long long slowMicros,
+                                                const Hook& hook);
+
+        /** @return true if operations are being traced at all. */
+        static bool MONGO_CLIENT_FUNC enabled();
+
+        // Annotations for the operation being traced on this thread, ignored if there is none
+
+        static void MONGO_CLIENT_FUNC noteHost(const std::string& host);
+        static void MONGO_CLIENT_FUNC noteBytes(long long out, long long in);
+        static void MONGO_CLIENT_FUNC noteBatch(int docs);
+
+        /**
+         * Traces the operation the current thread performs while in scope. Operations started
+         * inside another one, or inside a checkout, connect or auth phase, are part of it and
+         * not traced on their own.
+         */
+        class MONGO_CLIENT_API Scope : boost::noncopyable {
+        public:
+            Scope(const char* op, const StringData& ns);
+            ~Scope();
+
+        private:
+            OperationTrace* _trace;
+            unsigned long long _startMicros;
+        };
+
+        /**
+         * Charges the time spent in scope to 'phase' of the current operation. Phases nest:
+         * an inner one pauses the outer one, so a connect made during a checkout is not counted
+         * twice. Send, server, receive and decode time is only recorded inside an operation,
+         * and not at all inside a checkout, connect or auth phase.
+         */
+        class MONGO_CLIENT_API Timer : boost::noncopyable {
+        public:
+            explicit Timer(Phase phase);
+            ~Timer();
+
+        private:
+            friend class Scope;
+
+            const Phase _phase;
+            Timer* _outer;
+            bool _active;
+            unsigned long long _resumed;
+            long long _elapsedMicros;
+        };
+    };
+
+} // namespace mongo
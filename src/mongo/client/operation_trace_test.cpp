@@ -0,0 +1,186 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <boost/bind.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "mongo/client/operation_trace.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/time_support.h"
+
+namespace {
+
+    using mongo::OperationTrace;
+    using mongo::sleepmillis;
+    using std::vector;
+
+    void record(vector<OperationTrace>* reports, const OperationTrace& trace) {
+        reports->push_back(trace);
+    }
+
+    class OperationTraceTest : public mongo::unittest::Test {
+    protected:
+        void configure(int sampleEvery, long long slowMicros) {
+            OperationTrace::configure(sampleEvery, slowMicros,
+                                      boost::bind(record, &reports, _1));
+        }
+
+        void tearDown() {
+            OperationTrace::configure(0, -1, OperationTrace::Hook());
+        }
+
+        vector<OperationTrace> reports;
+    };
+
+    TEST_F(OperationTraceTest, DisabledByDefault) {
+        ASSERT_FALSE(OperationTrace::enabled());
+        {
+            OperationTrace::Scope trace("query", "test.coll");
+            OperationTrace::Timer timer(OperationTrace::kSend);
+        }
+        ASSERT_TRUE(reports.empty());
+    }
+
+    TEST_F(OperationTraceTest, SamplesOneInN) {
+        configure(3, -1);
+        for (int i = 0; i < 6; i++) {
+            OperationTrace::Scope trace("query", "test.coll");
+        }
+        ASSERT_EQUALS(2U, reports.size());
+        ASSERT_TRUE(reports[0].sampled);
+        ASSERT_FALSE(reports[0].slow);
+        ASSERT_EQUALS("query", reports[0].op);
+        ASSERT_EQUALS("test.coll", reports[0].ns);
+    }
+
+    TEST_F(OperationTraceTest, ReportsSlowOperations) {
+        configure(0, 5000);
+        {
+            OperationTrace::Scope trace("command", "admin");
+        }
+        ASSERT_TRUE(reports.empty());
+        {
+            OperationTrace::Scope trace("command", "admin");
+            sleepmillis(10);
+        }
+        ASSERT_EQUALS(1U, reports.size());
+        ASSERT_TRUE(reports[0].slow);
+        ASSERT_FALSE(reports[0].sampled);
+        ASSERT_GREATER_THAN_OR_EQUALS(reports[0].durationMicros, 5000);
+    }
+
+    TEST_F(OperationTraceTest, RecordsPhasesAndAnnotations) {
+        configure(1, -1);
+        {
+            OperationTrace::Scope trace("getMore", "test.coll");
+            {
+                OperationTrace::Timer timer(OperationTrace::kServer);
+                sleepmillis(5);
+            }
+            OperationTrace::noteHost("a:27017");
+            OperationTrace::noteBytes(100, 2000);
+            OperationTrace::noteBatch(10);
+            OperationTrace::noteBatch(0);
+        }
+        ASSERT_EQUALS(1U, reports.size());
+        const OperationTrace& trace = reports[0];
+        ASSERT_GREATER_THAN_OR_EQUALS(trace.phaseMicros[OperationTrace::kServer], 5000);
+        ASSERT_LESS_THAN_OR_EQUALS(trace.phaseMicros[OperationTrace::kServer],
+                                   trace.durationMicros);
+        ASSERT_EQUALS(0, trace.phaseMicros[OperationTrace::kSend]);
+        ASSERT_EQUALS("a:27017", trace.host);
+        ASSERT_EQUALS(100, trace.bytesOut);
+        ASSERT_EQUALS(2000, trace.bytesIn);
+        ASSERT_EQUALS(1, trace.batches);
+        ASSERT_EQUALS(10, trace.docs);
+        ASSERT_TRUE(trace.ok);
+        ASSERT_EQUALS(trace.phaseMicros[OperationTrace::kServer],
+                      trace.toBSON()["phases"]["server"].numberLong());
+    }
+
+    TEST_F(OperationTraceTest, ConnectionPhasesAreChargedToTheNextOperation) {
+        configure(1, -1);
+        {
+            OperationTrace::Timer checkout(OperationTrace::kCheckout);
+            sleepmillis(2);
+            OperationTrace::Timer connect(OperationTrace::kConnect);
+            sleepmillis(20);
+        }
+        ASSERT_TRUE(reports.empty());
+        {
+            OperationTrace::Scope trace("query", "test.coll");
+        }
+        {
+            OperationTrace::Scope trace("query", "test.coll");
+        }
+        ASSERT_EQUALS(2U, reports.size());
+
+        // The connect paused the checkout, so neither includes the other
+        const OperationTrace& first = reports[0];
+        ASSERT_GREATER_THAN_OR_EQUALS(first.phaseMicros[OperationTrace::kConnect], 20000);
+        ASSERT_GREATER_THAN_OR_EQUALS(first.phaseMicros[OperationTrace::kCheckout], 2000);
+        ASSERT_LESS_THAN(first.phaseMicros[OperationTrace::kCheckout], 20000);
+        ASSERT_GREATER_THAN_OR_EQUALS(first.durationMicros, 22000);
+
+        ASSERT_EQUALS(0, reports[1].phaseMicros[OperationTrace::kCheckout]);
+        ASSERT_EQUALS(0, reports[1].phaseMicros[OperationTrace::kConnect]);
+    }
+
+    TEST_F(OperationTraceTest, WorkInsideConnectionPhasesIsNotTracedSeparately) {
+        configure(1, -1);
+        {
+            OperationTrace::Timer auth(OperationTrace::kAuth);
+            OperationTrace::Scope command("command", "admin");
+            OperationTrace::Timer send(OperationTrace::kSend);
+            sleepmillis(2);
+        }
+        ASSERT_TRUE(reports.empty());
+        {
+            OperationTrace::Scope trace("query", "test.coll");
+        }
+        ASSERT_EQUALS(1U, reports.size());
+        ASSERT_GREATER_THAN_OR_EQUALS(reports[0].phaseMicros[OperationTrace::kAuth], 2000);
+        ASSERT_EQUALS(0, reports[0].phaseMicros[OperationTrace::kSend]);
+    }
+
+    TEST_F(OperationTraceTest, NestedOperationsArePartOfTheOuterOne) {
+        configure(1, -1);
+        {
+            OperationTrace::Scope outer("writeCommand", "test.coll");
+            OperationTrace::Scope inner("command", "test");
+            OperationTrace::noteBytes(10, 20);
+        }
+        ASSERT_EQUALS(1U, reports.size());
+        ASSERT_EQUALS("writeCommand", reports[0].op);
+        ASSERT_EQUALS(10, reports[0].bytesOut);
+    }
+
+    TEST_F(OperationTraceTest, FailedOperations) {
+        configure(1, -1);
+        try {
+            OperationTrace::Scope trace("query", "test.coll");
+            throw std::runtime_error("failed");
+        }
+        catch (const std::runtime_error&) {
+        }
+        ASSERT_EQUALS(1U, reports.size());
+        ASSERT_FALSE(reports[0].ok);
+    }
+
+} // namespace
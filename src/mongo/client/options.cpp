@@ -29,6 +29,9 @@ namespace client {
 #if !defined(_MSC_EXTENSIONS)
     const int Options::kDefaultDefaultLocalThresholdMillis;
     const int Options::kDefaultAutoShutdownGracePeriodMillis;
+    const int Options::kDefaultMemoryBackpressureMaxWaitMillis;
+    const int Options::kDefaultInitialConcurrencyLimit;
+    const int Options::kDefaultMaxConcurrencyLimit;
 #endif
 
     void setOptions(const Options& newOptions) {
@@ -45,8 +48,24 @@ namespace client {
         , _sslMode(kSSLDisabled)
         , _useFIPSMode(false)
         , _sslAllowInvalidCertificates(false)
+        , _sslKernelOffload(false)
         , _defaultLocalThresholdMillis(kDefaultDefaultLocalThresholdMillis)
+        , _maxStalenessSeconds(-1)
         , _validateObjects(false)
+        , _memoryBudgetBytes(-1)
+        , _connectionMemoryBudgetBytes(-1)
+        , _memoryBackpressureMaxWaitMillis(kDefaultMemoryBackpressureMaxWaitMillis)
+        , _bsonShrinkThresholdBytes(-1)
+        , _concurrencyLimiting(false)
+        , _initialConcurrencyLimit(kDefaultInitialConcurrencyLimit)
+        , _maxConcurrencyLimit(kDefaultMaxConcurrencyLimit)
+        , _ioUring(false)
+        , _localUnixSocket(false)
+        , _unixSocketPrefix("/tmp")
+        , _operationTraceSampling(0)
+        , _slowOperationThresholdMillis(-1)
+        , _queryShapeProfiling(false)
+        , _queryShapeProfilerMaxShapes(kDefaultQueryShapeProfilerMaxShapes)
     {}
 
     Options& Options::setCallShutdownAtExit(bool value) {
@@ -76,6 +95,150 @@ namespace client {
         return _defaultLocalThresholdMillis;
     }
 
+    Options& Options::setMaxStalenessSeconds(int seconds) {
+        _maxStalenessSeconds = seconds;
+        return *this;
+    }
+
+    int Options::maxStalenessSeconds() const {
+        return _maxStalenessSeconds;
+    }
+
+    Options& Options::setMemoryBudgetBytes(long long bytes) {
+        _memoryBudgetBytes = bytes;
+        return *this;
+    }
+
+    long long Options::memoryBudgetBytes() const {
+        return _memoryBudgetBytes;
+    }
+
+    Options& Options::setConnectionMemoryBudgetBytes(long long bytes) {
+        _connectionMemoryBudgetBytes = bytes;
+        return *this;
+    }
+
+    long long Options::connectionMemoryBudgetBytes() const {
+        return _connectionMemoryBudgetBytes;
+    }
+
+    Options& Options::setMemoryBackpressureMaxWaitMillis(int millis) {
+        _memoryBackpressureMaxWaitMillis = millis;
+        return *this;
+    }
+
+    int Options::memoryBackpressureMaxWaitMillis() const {
+        return _memoryBackpressureMaxWaitMillis;
+    }
+
+    Options& Options::setBSONShrinkThresholdBytes(int bytes) {
+        _bsonShrinkThresholdBytes = bytes;
+        return *this;
+    }
+
+    int Options::bsonShrinkThresholdBytes() const {
+        return _bsonShrinkThresholdBytes;
+    }
+
+    Options& Options::setConcurrencyLimiting(bool value) {
+        _concurrencyLimiting = value;
+        return *this;
+    }
+
+    bool Options::concurrencyLimiting() const {
+        return _concurrencyLimiting;
+    }
+
+    Options& Options::setInitialConcurrencyLimit(int limit) {
+        _initialConcurrencyLimit = limit;
+        return *this;
+    }
+
+    int Options::initialConcurrencyLimit() const {
+        return _initialConcurrencyLimit;
+    }
+
+    Options& Options::setMaxConcurrencyLimit(int limit) {
+        _maxConcurrencyLimit = limit;
+        return *this;
+    }
+
+    int Options::maxConcurrencyLimit() const {
+        return _maxConcurrencyLimit;
+    }
+
+    Options& Options::setIoUring(bool value) {
+        _ioUring = value;
+        return *this;
+    }
+
+    bool Options::ioUring() const {
+        return _ioUring;
+    }
+
+    Options& Options::setLocalUnixSocket(bool value) {
+        _localUnixSocket = value;
+        return *this;
+    }
+
+    bool Options::localUnixSocket() const {
+        return _localUnixSocket;
+    }
+
+    Options& Options::setUnixSocketPrefix(const std::string& prefix) {
+        _unixSocketPrefix = prefix;
+        return *this;
+    }
+
+    const std::string& Options::unixSocketPrefix() const {
+        return _unixSocketPrefix;
+    }
+
+    Options& Options::setOperationTraceSampling(int oneIn) {
+        _operationTraceSampling = oneIn;
+        return *this;
+    }
+
+    int Options::operationTraceSampling() const {
+        return _operationTraceSampling;
+    }
+
+    Options& Options::setSlowOperationThresholdMillis(int millis) {
+        _slowOperationThresholdMillis = millis;
+        return *this;
+    }
+
+    int Options::slowOperationThresholdMillis() const {
+        return _slowOperationThresholdMillis;
+    }
+
+    Options& Options::setOperationTraceHook(const OperationTrace::Hook& hook) {
+        _operationTraceHook = hook;
+        return *this;
+    }
+
+    const OperationTrace::Hook& Options::operationTraceHook() const {
+        return _operationTraceHook;
+    }
+
+    Options& Options::setQueryShapeProfiling(bool value) {
+        _queryShapeProfiling = value;
+        return *this;
+    }
+
+    bool Options::queryShapeProfiling() const {
+        return _queryShapeProfiling;
+    }
+
+    Options& Options::setQueryShapeProfilerMaxShapes(int maxShapes) {
+        _queryShapeProfilerMaxShapes = maxShapes;
+        return *this;
+    }
+
+    int Options::queryShapeProfilerMaxShapes() const {
+        return _queryShapeProfilerMaxShapes;
+    }
+
     Options& Options::setSSLMode(SSLModes sslMode) {
         _sslMode = sslMode;
         return *this;
@@ -139,6 +302,15 @@ namespace client {
         return _sslAllowInvalidCertificates;
     }
 
+    Options& Options::setSSLKernelOffload(bool value) {
+        _sslKernelOffload = value;
+        return *this;
+    }
+
+    bool Options::SSLKernelOffload() const {
+        return _sslKernelOffload;
+    }
+
     Options& Options::setValidateObjects(bool value) {
         _validateObjects = value;
         return *this;
@@ -18,6 +18,7 @@
 #include <string>
 
 #include "mongo/client/export_macros.h"
+#include "mongo/client/operation_trace.h"
 
 namespace mongo {
 namespace client {
@@ -34,6 +35,10 @@ namespace client {
         // factor or mutation of the default.
         static const int kDefaultAutoShutdownGracePeriodMillis = 250;
         static const int kDefaultDefaultLocalThresholdMillis = 15;
+        static const int kDefaultMemoryBackpressureMaxWaitMillis = 1000;
+        static const int kDefaultInitialConcurrencyLimit = 20;
+        static const int kDefaultMaxConcurrencyLimit = 1000;
+        static const int kDefaultQueryShapeProfilerMaxShapes = 1000;
 
         /** Obtains the currently configured options for the driver. This method
          *  must not be called before mongo::client::initialize has completed.
@@ -103,6 +108,178 @@ namespace client {
         Options& setDefaultLocalThresholdMillis(int millis);
         int defaultLocalThresholdMillis() const;
 
+        /** Set how far, in seconds, a secondary may be behind the primary and still be chosen
+         *  for secondary and nearest reads. The replica set monitor learns each member's last
+         *  write from its isMaster reply, or while this is set and the server doesn't report
+         *  it, from the newest entry of its oplog. Members whose lag is unknown stay eligible.
+         *  A negative value disables the bound.
+         *
+         *  Default: -1
+         */
+        Options& setMaxStalenessSeconds(int seconds);
+        int maxStalenessSeconds() const;
+
+
+        //
+        // Memory
+        //
+        // Budgets limit the bytes the driver holds in received replies, cursor putBack
+        // stacks and outgoing write batches. A negative value means no limit. Limits are
+        // advisory: cursors apply backpressure instead of failing when over budget.
+        //
+
+        /** Set the budget shared by all connections in the process.
+         *
+         *  Default: -1 (unlimited)
+         */
+        Options& setMemoryBudgetBytes(long long bytes);
+        long long memoryBudgetBytes() const;
+
+        /** Set the budget applied to each individual connection.
+         *
+         *  Default: -1 (unlimited)
+         */
+        Options& setConnectionMemoryBudgetBytes(long long bytes);
+        long long connectionMemoryBudgetBytes() const;
+
+        /** Set the longest a cursor will wait for memory to be released before issuing a
+         *  getMore while over budget. The request is sent anyway once this elapses.
+         *
+         *  Default: 1000 ms
+         */
+        Options& setMemoryBackpressureMaxWaitMillis(int millis);
+        int memoryBackpressureMaxWaitMillis() const;
+
+        /** Set how many unused bytes a BSONObjBuilder buffer may carry into the object
+         *  returned by obj() before the buffer is shrunk to fit. Worth setting when an
+         *  application retains many built objects. A negative value never shrinks. See
+         *  BSONObjBuilder::setShrinkThreshold.
+         *
+         *  Default: -1
+         */
+        Options& setBSONShrinkThresholdBytes(int bytes);
+        int bsonShrinkThresholdBytes() const;
+
+
+        //
+        // Concurrency limiting
+        //
+        // When enabled, requests in flight to each host are capped by a limit that adapts to
+        // the host's round trip times (see ConcurrencyLimiter). Requests over the limit fail
+        // immediately instead of queueing on an overloaded host.
+        //
+
+        /** Enable or disable adaptive per-host concurrency limiting.
+         *
+         *  Default: false
+         */
+        Options& setConcurrencyLimiting(bool value);
+        bool concurrencyLimiting() const;
+
+        /** Set the limit each host starts with before any round trip has been observed.
+         *
+         *  Default: 20
+         */
+        Options& setInitialConcurrencyLimit(int limit);
+        int initialConcurrencyLimit() const;
+
+        /** Set the most requests that may ever be in flight to one host.
+         *
+         *  Default: 1000
+         */
+        Options& setMaxConcurrencyLimit(int limit);
+        int maxConcurrencyLimit() const;
+
+
+        //
+        // io_uring
+        //
+
+        /** Use io_uring for the sockets of new connections where the kernel supports it
+         *  (Linux 5.5 or later, without SSL). Replies are received ahead into a buffer
+         *  registered with the kernel, and a request is sent together with the read of its
+         *  reply, saving system calls on every round trip. Other systems keep using plain
+         *  socket calls.
+         *
+         *  Default: false
+         */
+        Options& setIoUring(bool value = true);
+        bool ioUring() const;
+
+
+        //
+        // Unix domain sockets
+        //
+
+        /** Connect to servers on "localhost", "127.0.0.1" or "::1" over the unix domain socket
+         *  the server listens on, "<prefix>/mongodb-<port>.sock", when that socket exists and
+         *  is readable and writable, skipping the TCP stack on every round trip. Connections
+         *  fall back to TCP when there is no such socket or it refuses the connection.
+         *  DBClientConnection::usesUnixSocket reports which one a connection uses. Ignored on
+         *  Windows.
+         *
+         *  Default: false
+         */
+        Options& setLocalUnixSocket(bool value = true);
+        bool localUnixSocket() const;
+
+        /** Set the directory local servers create their unix domain sockets in, the
+         *  server's --unixSocketPrefix.
+         *
+         *  Default: "/tmp"
+         */
+        Options& setUnixSocketPrefix(const std::string& prefix);
+        const std::string& unixSocketPrefix() const;
+
+
+        //
+        // Operation tracing
+        //
+        // See mongo::OperationTrace for what is recorded.
+        //
+
+        /** Reports one in every 'oneIn' operations each thread performs, with the time spent
+         *  in each phase. Zero disables sampling.
+         *
+         *  Default: 0
+         */
+        Options& setOperationTraceSampling(int oneIn);
+        int operationTraceSampling() const;
+
+        /** Reports every operation that takes at least 'millis', whether sampled or not.
+         *  A negative value disables the slow operation report.
+         *
+         *  Default: -1
+         */
+        Options& setSlowOperationThresholdMillis(int millis);
+        int slowOperationThresholdMillis() const;
+
+        /** Called with each reported operation, on the thread that performed it. When no hook
+         *  is set, slow operations are logged, and sampled ones logged at verbosity 1.
+         *
+         *  Default: <none>
+         */
+        Options& setOperationTraceHook(const OperationTrace::Hook& hook);
+        const OperationTrace::Hook& operationTraceHook() const;
+
+        /** Aggregates the latency, documents and bytes of queries and commands by their
+         *  shape, the query with its values stripped. The most expensive shapes are
+         *  reported by DBConnectionPool::appendInfo under 'queryShapes', or by
+         *  QueryShapeProfiler::global()->appendInfo.
+         *
+         *  Default: false
+         */
+        Options& setQueryShapeProfiling(bool value = true);
+        bool queryShapeProfiling() const;
+
+        /** The most query shapes the profiler keeps. Once full, new shapes replace the
+         *  cheapest ones.
+         *
+         *  Default: kDefaultQueryShapeProfilerMaxShapes
+         */
+        Options& setQueryShapeProfilerMaxShapes(int maxShapes);
+        int queryShapeProfilerMaxShapes() const;
+
 
         //
         // SSL
@@ -171,6 +348,17 @@ namespace client {
         Options& setSSLAllowInvalidCertificates(bool value = true);
         const bool SSLAllowInvalidCertificates() const;
 
+        /** When set true, the driver asks OpenSSL to hand the session keys to the kernel
+         *  after the handshake (kernel TLS, Linux 4.13 or later with OpenSSL 3.0 built with
+         *  ktls support). Encryption then happens in the kernel and the socket is written
+         *  and read with plain system calls. Connections where the kernel or the negotiated
+         *  cipher doesn't support offload silently keep encrypting in OpenSSL.
+         *
+         *  Default: false
+         */
+        Options& setSSLKernelOffload(bool value = true);
+        bool SSLKernelOffload() const;
+
 
         //
         // Misc
@@ -193,8 +381,25 @@ namespace client {
         std::string _sslPEMKeyPassword;
         std::string _sslCRLFile;
         bool _sslAllowInvalidCertificates;
+        bool _sslKernelOffload;
         int _defaultLocalThresholdMillis;
+        int _maxStalenessSeconds;
         bool _validateObjects;
+        long long _memoryBudgetBytes;
+        long long _connectionMemoryBudgetBytes;
+        int _memoryBackpressureMaxWaitMillis;
+        int _bsonShrinkThresholdBytes;
+        bool _concurrencyLimiting;
+        int _initialConcurrencyLimit;
+        int _maxConcurrencyLimit;
+        bool _ioUring;
+        bool _localUnixSocket;
+        std::string _unixSocketPrefix;
+        int _operationTraceSampling;
+        int _slowOperationThresholdMillis;
+        OperationTrace::Hook _operationTraceHook;
+        bool _queryShapeProfiling;
+        int _queryShapeProfilerMaxShapes;
     };
 
 } // namespace client
@@ -0,0 +1,385 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/query_shape_profiler.h"
+
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+#include <utility>
+#include <vector>
+
+#include "mongo/db/namespace_string.h"
+
+namespace mongo {
+
+    using std::pair;
+    using std::vector;
+
+    namespace {
+
+        // Replaced by configure() from client::initialize, never freed: cursors of other
+        // threads may still be recording
+        QueryShapeProfiler* globalProfiler = NULL;
+
+        const char kValue[] = "?";
+
+        bool isOperatorObject(const BSONObj& obj) {
+            return !obj.isEmpty() && obj.firstElementFieldName()[0] == '$';
+        }
+
+        /** Appends 'filter' with every value replaced, keeping paths and operators. */
+        void appendFilterShape(const BSONObj& filter, BSONObjBuilder* b) {
+            BSONObjIterator it(filter);
+            while (it.more()) {
+                const BSONElement e = it.next();
+                const StringData name = e.fieldNameStringData();
+
+                if ((name == "$and" || name == "$or" || name == "$nor") && e.type() == Array) {
+                    BSONArrayBuilder clauses(b->subarrayStart(name));
+                    BSONObjIterator clauseIt(e.Obj());
+                    while (clauseIt.more()) {
+                        const BSONElement clause = clauseIt.next();
+                        if (!clause.isABSONObj())
+                            continue;
+                        BSONObjBuilder clauseBuilder(clauses.subobjStart());
+                        appendFilterShape(clause.Obj(), &clauseBuilder);
+                        clauseBuilder.done();
+                    }
+                    clauses.done();
+                }
+                else if (e.type() == Object && isOperatorObject(e.Obj())) {
+                    BSONObjBuilder operators(b->subobjStart(name));
+                    BSONObjIterator opIt(e.Obj());
+                    while (opIt.more()) {
+                        const BSONElement op = opIt.next();
+                        const StringData opName = op.fieldNameStringData();
+                        if ((opName == "$elemMatch" || opName == "$not") && op.type() == Object) {
+                            BSONObjBuilder nested(operators.subobjStart(opName));
+                            appendFilterShape(op.Obj(), &nested);
+                            nested.done();
+                        }
+                        else {
+                            operators.append(opName, kValue);
+                        }
+                    }
+                    operators.done();
+                }
+                else {
+                    b->append(name, kValue);
+                }
+            }
+        }
+
+        /**
+         * Appends an aggregation expression with its literals replaced. Field paths ("$a.b")
+         * are part of the shape and kept.
+         */
+        void appendExpressionShape(const BSONElement& e, const StringData& name,
+                                   BSONObjBuilder* b) {
+            if (e.isABSONObj()) {
+                BSONObjBuilder nested(e.type() == Array ?
+                                      b->subarrayStart(name) : b->subobjStart(name));
+                BSONObjIterator it(e.Obj());
+                while (it.more()) {
+                    const BSONElement child = it.next();
+                    appendExpressionShape(child, child.fieldNameStringData(), &nested);
+                }
+                nested.done();
+            }
+            else if (e.type() == String && e.valuestr()[0] == '$') {
+                b->append(name, e.valuestr());
+            }
+            else {
+                b->append(name, kValue);
+            }
+        }
+
+        void appendPipelineShape(const BSONObj& pipeline, BSONObjBuilder* b) {
+            BSONArrayBuilder stages(b->subarrayStart("pipeline"));
+            BSONObjIterator it(pipeline);
+            while (it.more()) {
+                const BSONElement stage = it.next();
+                if (!stage.isABSONObj() || stage.Obj().isEmpty())
+                    continue;
+
+                const BSONElement spec = stage.Obj().firstElement();
+                BSONObjBuilder stageBuilder(stages.subobjStart());
+                if (spec.fieldNameStringData() == "$match" && spec.type() == Object) {
+                    BSONObjBuilder match(stageBuilder.subobjStart("$match"));
+                    appendFilterShape(spec.Obj(), &match);
+                    match.done();
+                }
+                else if (spec.fieldNameStringData() == "$sort") {
+                    stageBuilder.append(spec);
+                }
+                else {
+                    appendExpressionShape(spec, spec.fieldNameStringData(), &stageBuilder);
+                }
+                stageBuilder.done();
+            }
+            stages.done();
+        }
+
+        void appendProjectionShape(const BSONObj& fields, BSONObjBuilder* b) {
+            BSONObjBuilder projection(b->subobjStart("projection"));
+            BSONObjIterator it(fields);
+            while (it.more())
+                projection.append(it.next().fieldNameStringData(), 1);
+            projection.done();
+        }
+
+        int bucketOf(long long micros) {
+            int bucket = 0;
+            while (micros > 0 && bucket < QueryShapeProfiler::kHistogramBuckets - 1) {
+                micros >>= 1;
+                bucket++;
+            }
+            return bucket;
+        }
+
+        bool moreTime(const pair<unsigned long long, long long>& a,
+                      const pair<unsigned long long, long long>& b) {
+            return a.second > b.second;
+        }
+
+    } // namespace
+
+    QueryShapeProfiler::QueryShapeProfiler(int maxShapes)
+        : _maxShapesPerShard(std::max(1, (maxShapes + kShards - 1) / kShards)) {
+    }
+
+    QueryShapeProfiler* QueryShapeProfiler::global() {
+        return globalProfiler;
+    }
+
+    void QueryShapeProfiler::configure(bool enabled, int maxShapes) {
+        globalProfiler = enabled ? new QueryShapeProfiler(maxShapes) : NULL;
+    }
+
+    BSONObj QueryShapeProfiler::shapeOf(const StringData& ns,
+                                        const BSONObj& query,
+                                        const BSONObj* fields) {
+        // Unwrap queries with modifiers, {$query: ..., $orderby: ...} or {query: ...}. Commands
+        // are only wrapped with $query, their own "query" field is a filter.
+        const NamespaceString nss(ns);
+        BSONObj filter = query;
+        BSONElement sort;
+        BSONElement hint;
+        BSONElement wrapped = query["$query"];
+        if (wrapped.eoo() && !nss.isCommand())
+            wrapped = query["query"];
+        if (wrapped.type() == Object) {
+            filter = wrapped.Obj();
+            sort = query["$orderby"];
+            if (sort.eoo())
+                sort = query["orderby"];
+            hint = query["$hint"];
+        }
+
+        BSONObjBuilder b;
+        if (!nss.isCommand()) {
+            b.append("ns", ns);
+            b.append("op", "query");
+            BSONObjBuilder filterBuilder(b.subobjStart("filter"));
+            appendFilterShape(filter, &filterBuilder);
+            filterBuilder.done();
+        }
+        else {
+            const BSONElement command = filter.firstElement();
+            b.append("ns", command.type() == String ?
+                           nss.db().toString() + "." + command.valuestr() : nss.db().toString());
+            b.append("op", command.fieldNameStringData());
+
+            BSONObjIterator it(filter);
+            if (it.more())
+                it.next();
+            while (it.more()) {
+                const BSONElement e = it.next();
+                const StringData name = e.fieldNameStringData();
+                if ((name == "query" || name == "filter" || name == "q") && e.type() == Object) {
+                    BSONObjBuilder filterBuilder(b.subobjStart("filter"));
+                    appendFilterShape(e.Obj(), &filterBuilder);
+                    filterBuilder.done();
+                }
+                else if (name == "pipeline" && e.type() == Array) {
+                    appendPipelineShape(e.Obj(), &b);
+                }
+                else if (name == "sort" && sort.eoo()) {
+                    sort = e;
+                }
+                else if (name == "key" || name == "fields" || name == "hint") {
+                    b.append(e);
+                }
+            }
+        }
+
+        if (sort.isABSONObj() && !sort.Obj().isEmpty())
+            b.appendAs(sort, "sort");
+        if (fields && !fields->isEmpty())
+            appendProjectionShape(*fields, &b);
+        if (!hint.eoo())
+            b.appendAs(hint, "hint");
+        return b.obj();
+    }
+
+    unsigned long long QueryShapeProfiler::keyOf(const BSONObj& shape) {
+        // 64 bit FNV-1a
+        unsigned long long hash = 14695981039346656037ULL;
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(shape.objdata());
+        for (int i = 0; i < shape.objsize(); i++) {
+            hash ^= data[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash ? hash : 1;
+    }
+
+    QueryShapeProfiler::Entry::Entry()
+        : queries(0)
+        , roundTrips(0)
+        , totalMicros(0)
+        , maxMicros(0)
+        , docs(0)
+        , bytes(0) {
+        std::fill(histogram, histogram + kHistogramBuckets, 0);
+    }
+
+    void QueryShapeProfiler::Entry::record(long long micros, long long newDocs,
+                                           long long newBytes) {
+        roundTrips++;
+        totalMicros += micros;
+        maxMicros = std::max(maxMicros, micros);
+        docs += newDocs;
+        bytes += newBytes;
+        histogram[bucketOf(micros)]++;
+    }
+
+    long long QueryShapeProfiler::Entry::percentileMicros(double fraction) const {
+        const long long rank = static_cast<long long>(fraction * roundTrips);
+        long long seen = 0;
+        for (int i = 0; i < kHistogramBuckets; i++) {
+            seen += histogram[i];
+            if (seen > rank) {
+                // The bucket's upper bound, which the slowest round trip may be below
+                const long long upper = i == 0 ? 0 : (1LL << i) - 1;
+                return std::min(upper, maxMicros);
+            }
+        }
+        return maxMicros;
+    }
+
+    void QueryShapeProfiler::recordQuery(unsigned long long key, const BSONObj& shape,
+                                         long long micros, long long docs, long long bytes) {
+        Shard& shard = _shards[key % kShards];
+        boost::lock_guard<boost::mutex> lk(shard.mutex);
+
+        EntryMap::iterator found = shard.entries.find(key);
+        if (found == shard.entries.end()) {
+            if (shard.entries.size() >= _maxShapesPerShard) {
+                EntryMap::iterator cheapest = shard.entries.begin();
+                for (EntryMap::iterator i = shard.entries.begin(); i != shard.entries.end(); ++i) {
+                    if (i->second.totalMicros < cheapest->second.totalMicros)
+                        cheapest = i;
+                }
+                shard.entries.erase(cheapest);
+                shard.evicted++;
+            }
+            found = shard.entries.insert(std::make_pair(key, Entry())).first;
+            found->second.shape = shape.getOwned();
+        }
+
+        found->second.queries++;
+        found->second.record(micros, docs, bytes);
+    }
+
+    void QueryShapeProfiler::recordGetMore(unsigned long long key, long long micros,
+                                           long long docs, long long bytes) {
+        Shard& shard = _shards[key % kShards];
+        boost::lock_guard<boost::mutex> lk(shard.mutex);
+
+        EntryMap::iterator found = shard.entries.find(key);
+        if (found != shard.entries.end())
+            found->second.record(micros, docs, bytes);
+    }
+
+    void QueryShapeProfiler::appendInfo(BSONObjBuilder& b, int topN) const {
+        vector< pair<unsigned long long, long long> > byTime;
+        long long evicted = 0;
+        for (int i = 0; i < kShards; i++) {
+            boost::lock_guard<boost::mutex> lk(_shards[i].mutex);
+            for (EntryMap::const_iterator it = _shards[i].entries.begin();
+                 it != _shards[i].entries.end();
+                 ++it) {
+                byTime.push_back(std::make_pair(it->first, it->second.totalMicros));
+            }
+            evicted += _shards[i].evicted;
+        }
+
+        b.append("shapes", static_cast<int>(byTime.size()));
+        b.append("evicted", evicted);
+
+        const size_t shown = std::min(byTime.size(), static_cast<size_t>(std::max(0, topN)));
+        std::partial_sort(byTime.begin(), byTime.begin() + shown, byTime.end(), moreTime);
+
+        BSONArrayBuilder top(b.subarrayStart("top"));
+        for (size_t i = 0; i < shown; i++) {
+            const unsigned long long key = byTime[i].first;
+            const Shard& shard = _shards[key % kShards];
+
+            Entry entry;
+            {
+                boost::lock_guard<boost::mutex> lk(shard.mutex);
+                EntryMap::const_iterator found = shard.entries.find(key);
+                if (found == shard.entries.end())
+                    continue;   // replaced since the first pass
+                entry = found->second;
+            }
+
+            BSONObjBuilder shapeBuilder(top.subobjStart());
+            shapeBuilder.append("shape", entry.shape);
+            shapeBuilder.append("queries", entry.queries);
+            shapeBuilder.append("roundTrips", entry.roundTrips);
+            shapeBuilder.append("totalMicros", entry.totalMicros);
+            shapeBuilder.append("meanMicros", entry.roundTrips ?
+                                              entry.totalMicros / entry.roundTrips : 0);
+            shapeBuilder.append("p50Micros", entry.percentileMicros(0.5));
+            shapeBuilder.append("p99Micros", entry.percentileMicros(0.99));
+            shapeBuilder.append("maxMicros", entry.maxMicros);
+            shapeBuilder.append("docs", entry.docs);
+            shapeBuilder.append("bytes", entry.bytes);
+
+            // Bucket i counts round trips of [2^(i-1), 2^i) microseconds
+            int used = kHistogramBuckets;
+            while (used > 0 && entry.histogram[used - 1] == 0)
+                used--;
+            BSONArrayBuilder histogram(shapeBuilder.subarrayStart("histogram"));
+            for (int j = 0; j < used; j++)
+                histogram.append(entry.histogram[j]);
+            histogram.done();
+            shapeBuilder.done();
+        }
+        top.done();
+    }
+
+    void QueryShapeProfiler::clear() {
+        for (int i = 0; i < kShards; i++) {
+            boost::lock_guard<boost::mutex> lk(_shards[i].mutex);
+            _shards[i].entries.clear();
+            _shards[i].evicted = 0;
+        }
+    }
+
+} // namespace mongo
@@ -0,0 +1,119 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+#include <map>
+
+#include "mongo/base/string_data.h"
+#include "mongo/client/export_macros.h"
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    /**
+     * Client-side latency and result volume of queries and commands, aggregated by shape.
+     *
+     * A shape is a query or command with its values stripped: the namespace, the command name,
+     * the field paths and operators of the filter, and the sort, projection and hint. So
+     * find({a: 5, b: {$gt: 3}}) and find({a: 7, b: {$gt: 10}}) share a shape, while
+     * find({a: 5}) and find({a: {$in: [5]}}) do not. count, distinct and aggregate commands are
+     * shaped by their filter or pipeline.
+     *
+     * Every round trip of a cursor, its first batch and each getMore, adds to the shape of the
+     * query that opened it. At most 'maxShapes' shapes are kept; when the table is full, a new
+     * shape replaces the one with the least total time in its shard.
+     *
+     * Enabled through client::Options::setQueryShapeProfiling. Thread safety: all methods may
+     * be called concurrently; the table is split into shards, each with its own lock.
+     */
+    class MONGO_CLIENT_API QueryShapeProfiler : boost::noncopyable {
+    public:
+        // Latencies are counted in power of two buckets of microseconds, the last open ended
+        static const int kHistogramBuckets = 25;
+        static const int kShards = 16;
+
+        explicit QueryShapeProfiler(int maxShapes);
+
+        /**
+         * The process wide profiler, or NULL when profiling is disabled through
+         * client::Options::setQueryShapeProfiling.
+         */
+        static QueryShapeProfiler* MONGO_CLIENT_FUNC global();
+
+        /** Replaces the process wide profiler, from client::initialize. */
+        static void MONGO_CLIENT_FUNC configure(bool enabled, int maxShapes);
+
+        /**
+         * @return the shape of 'query', a query on 'ns' or a command if 'ns' is a $cmd
+         *     namespace, with 'fields' as its projection if not NULL.
+         */
+        static BSONObj MONGO_CLIENT_FUNC shapeOf(const StringData& ns,
+                                                 const BSONObj& query,
+                                                 const BSONObj* fields = NULL);
+
+        /** @return a key identifying 'shape' in the table. Never zero. */
+        static unsigned long long MONGO_CLIENT_FUNC keyOf(const BSONObj& shape);
+
+        /** Records the first round trip of a query with 'shape', adding the shape if needed. */
+        void recordQuery(unsigned long long key, const BSONObj& shape,
+                         long long micros, long long docs, long long bytes);
+
+        /**
+         * Records a later round trip of a query. Ignored if the shape was replaced since the
+         * query started.
+         */
+        void recordGetMore(unsigned long long key, long long micros, long long docs,
+                           long long bytes);
+
+        /** Appends the 'topN' shapes with the most total time, most expensive first. */
+        void appendInfo(BSONObjBuilder& b, int topN) const;
+
+        void clear();
+
+    private:
+        struct Entry {
+            Entry();
+
+            BSONObj shape;
+            long long queries;
+            long long roundTrips;
+            long long totalMicros;
+            long long maxMicros;
+            long long docs;
+            long long bytes;
+            long long histogram[kHistogramBuckets];
+
+            void record(long long micros, long long docs, long long bytes);
+            long long percentileMicros(double fraction) const;
+        };
+
+        typedef std::map<unsigned long long, Entry> EntryMap;
+
+        struct Shard {
+            Shard() : evicted(0) {}
+
+            mutable boost::mutex mutex;
+            EntryMap entries;
+            long long evicted;
+        };
+
+        const size_t _maxShapesPerShard;
+        Shard _shards[kShards];
+    };
+
+} // namespace mongo
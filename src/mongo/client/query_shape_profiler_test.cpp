@@ -0,0 +1,170 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/query_shape_profiler.h"
+#include "mongo/db/json.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace {
+
+    using mongo::BSONObj;
+    using mongo::BSONObjBuilder;
+    using mongo::QueryShapeProfiler;
+    using mongo::fromjson;
+
+    BSONObj shape(const char* ns, const char* query) {
+        return QueryShapeProfiler::shapeOf(ns, fromjson(query));
+    }
+
+    TEST(QueryShapeProfilerTest, ValuesAreStripped) {
+        ASSERT_EQUALS(shape("test.c", "{a: 5, b: {$gt: 3, $lt: 9}}"),
+                      shape("test.c", "{a: 'x', b: {$gt: 100, $lt: 200}}"));
+        ASSERT_EQUALS(fromjson("{ns: 'test.c', op: 'query', "
+                               " filter: {a: '?', b: {$gt: '?', $lt: '?'}}}"),
+                      shape("test.c", "{a: 5, b: {$gt: 3, $lt: 9}}"));
+
+        ASSERT_NOT_EQUALS(shape("test.c", "{a: 5}"), shape("test.c", "{a: {$in: [5]}}"));
+        ASSERT_NOT_EQUALS(shape("test.c", "{a: 5}"), shape("test.d", "{a: 5}"));
+    }
+
+    TEST(QueryShapeProfilerTest, LogicalOperatorsAndElemMatch) {
+        ASSERT_EQUALS(fromjson("{ns: 'test.c', op: 'query', filter: "
+                               " {$or: [{a: '?'}, {b: {$elemMatch: {c: '?', d: {$ne: '?'}}}}]}}"),
+                      shape("test.c", "{$or: [{a: 1}, {b: {$elemMatch: {c: 2, d: {$ne: 3}}}}]}"));
+    }
+
+    TEST(QueryShapeProfilerTest, SortProjectionAndHint) {
+        const BSONObj fields = fromjson("{a: 1, _id: 0}");
+        const BSONObj shaped = QueryShapeProfiler::shapeOf(
+            "test.c",
+            fromjson("{$query: {a: 5}, $orderby: {b: -1}, $hint: 'a_1', $maxTimeMS: 50}"),
+            &fields);
+        ASSERT_EQUALS(fromjson("{ns: 'test.c', op: 'query', filter: {a: '?'}, sort: {b: -1}, "
+                               " projection: {a: 1, _id: 1}, hint: 'a_1'}"),
+                      shaped);
+
+        ASSERT_NOT_EQUALS(shaped, shape("test.c", "{query: {a: 5}, orderby: {b: 1}}"));
+    }
+
+    TEST(QueryShapeProfilerTest, Commands) {
+        ASSERT_EQUALS(fromjson("{ns: 'test.c', op: 'count', filter: {a: '?'}}"),
+                      shape("test.$cmd", "{count: 'c', query: {a: 5}, limit: 10}"));
+
+        ASSERT_EQUALS(fromjson("{ns: 'test.c', op: 'distinct', key: 'k'}"),
+                      shape("test.$cmd", "{distinct: 'c', key: 'k'}"));
+
+        ASSERT_EQUALS(
+            fromjson("{ns: 'test.c', op: 'aggregate', pipeline: ["
+                     " {$match: {a: {$gte: '?'}}},"
+                     " {$group: {_id: '$b', n: {$sum: '?'}}},"
+                     " {$sort: {n: -1}},"
+                     " {$limit: '?'}]}"),
+            shape("test.$cmd", "{aggregate: 'c', pipeline: ["
+                               " {$match: {a: {$gte: 7}}},"
+                               " {$group: {_id: '$b', n: {$sum: 1}}},"
+                               " {$sort: {n: -1}},"
+                               " {$limit: 5}]}"));
+
+        // Read preferences wrap commands like query modifiers
+        ASSERT_EQUALS(shape("test.$cmd", "{count: 'c', query: {a: 5}}"),
+                      shape("test.$cmd", "{$query: {count: 'c', query: {a: 6}}, "
+                                         " $readPreference: {mode: 'secondary'}}"));
+
+        ASSERT_EQUALS(fromjson("{ns: 'admin', op: 'ismaster'}"),
+                      shape("admin.$cmd", "{ismaster: 1}"));
+    }
+
+    TEST(QueryShapeProfilerTest, AggregatesByShape) {
+        QueryShapeProfiler profiler(100);
+        const BSONObj fast = shape("test.c", "{a: 1}");
+        const BSONObj slow = shape("test.c", "{b: 1}");
+        const unsigned long long fastKey = QueryShapeProfiler::keyOf(fast);
+        const unsigned long long slowKey = QueryShapeProfiler::keyOf(slow);
+        ASSERT_NOT_EQUALS(fastKey, slowKey);
+
+        for (int i = 0; i < 10; i++)
+            profiler.recordQuery(fastKey, fast, 100, 1, 50);
+        profiler.recordQuery(slowKey, slow, 5000, 101, 10000);
+        profiler.recordGetMore(slowKey, 3000, 50, 4500);
+        profiler.recordGetMore(slowKey, 3000, 50, 4500);
+        profiler.recordGetMore(12345, 3000, 100, 9000);
+
+        BSONObjBuilder b;
+        profiler.appendInfo(b, 1);
+        const BSONObj info = b.obj();
+        ASSERT_EQUALS(2, info["shapes"].numberInt());
+        ASSERT_EQUALS(1, info["top"].Obj().nFields());
+
+        const BSONObj top = info["top"].Obj()["0"].Obj();
+        ASSERT_EQUALS(slow, top["shape"].Obj());
+        ASSERT_EQUALS(1, top["queries"].numberLong());
+        ASSERT_EQUALS(3, top["roundTrips"].numberLong());
+        ASSERT_EQUALS(11000, top["totalMicros"].numberLong());
+        ASSERT_EQUALS(3666, top["meanMicros"].numberLong());
+        ASSERT_EQUALS(5000, top["maxMicros"].numberLong());
+        ASSERT_EQUALS(201, top["docs"].numberLong());
+        ASSERT_EQUALS(19000, top["bytes"].numberLong());
+
+        // 3000us falls in bucket 12, [2048, 4096), and 5000us in bucket 13, [4096, 8192)
+        ASSERT_EQUALS(4095, top["p50Micros"].numberLong());
+        ASSERT_EQUALS(5000, top["p99Micros"].numberLong());
+        const BSONObj histogram = top["histogram"].Obj();
+        ASSERT_EQUALS(14, histogram.nFields());
+        ASSERT_EQUALS(2, histogram["12"].numberLong());
+        ASSERT_EQUALS(1, histogram["13"].numberLong());
+    }
+
+    TEST(QueryShapeProfilerTest, EvictsTheCheapestShapeWhenFull) {
+        // One shape per shard
+        QueryShapeProfiler profiler(QueryShapeProfiler::kShards);
+
+        BSONObj first;
+        unsigned long long firstKey = 0;
+        int added = 0;
+        for (int i = 0; added < 2; i++) {
+            BSONObjBuilder filter;
+            filter.append(std::string(mongoutils::str::stream() << "f" << i), 1);
+            const BSONObj shaped = QueryShapeProfiler::shapeOf("test.c", filter.obj());
+            const unsigned long long key = QueryShapeProfiler::keyOf(shaped);
+            if (firstKey == 0) {
+                first = shaped;
+                firstKey = key;
+                profiler.recordQuery(key, shaped, 100, 0, 0);
+                added++;
+            }
+            else if (key % QueryShapeProfiler::kShards == firstKey % QueryShapeProfiler::kShards) {
+                profiler.recordQuery(key, shaped, 50, 0, 0);
+                added++;
+            }
+        }
+
+        // The newcomer replaced the only shape of its shard, even though it was cheaper
+        BSONObjBuilder b;
+        profiler.appendInfo(b, 10);
+        const BSONObj info = b.obj();
+        ASSERT_EQUALS(1, info["shapes"].numberInt());
+        ASSERT_EQUALS(1, info["evicted"].numberLong());
+        ASSERT_NOT_EQUALS(first, info["top"].Obj()["0"].Obj()["shape"].Obj());
+
+        profiler.clear();
+        BSONObjBuilder cleared;
+        profiler.appendInfo(cleared, 10);
+        ASSERT_EQUALS(0, cleared.obj()["shapes"].numberInt());
+    }
+
+} // namespace
@@ -246,6 +246,35 @@ namespace {
         bool operator() (const Node& node) { return !_hosts.count(node.host); }
         const std::set<HostAndPort>& _hosts;
     };
+
+    /**
+     * Returns isMaster 'reply' with the newest oplog entry of the server on 'conn' added as its
+     * last write, for servers that don't report one. Returns 'reply' unchanged if the oplog
+     * can't be read.
+     */
+    BSONObj withOplogOpTime(DBClientBase* conn, const BSONObj& reply) {
+        try {
+            const BSONObj fields = BSON("ts" << 1);
+            const BSONObj newest = conn->findOne("local.oplog.rs",
+                                                 Query().sort("$natural", -1),
+                                                 &fields,
+                                                 QueryOption_SlaveOk);
+            if (newest["ts"].type() != Timestamp)
+                return reply;
+
+            BSONObjBuilder b;
+            b.appendElements(reply);
+            BSONObjBuilder lastWrite(b.subobjStart("lastWrite"));
+            lastWrite.appendAs(newest["ts"], "opTime");
+            lastWrite.done();
+            return b.obj();
+        }
+        catch (const DBException& e) {
+            LOG(2) << "couldn't read the oplog of " << conn->getServerAddress() << ": "
+                   << e.what();
+            return reply;
+        }
+    }
 } // namespace
 
     // At 1 check every 10 seconds, 30 checks takes 5 minutes
@@ -420,6 +449,7 @@ namespace {
     // TODO move to correct order with non-statics before pushing
     void ReplicaSetMonitor::appendInfo(BSONObjBuilder& bsonObjBuilder) const {
         boost::lock_guard<boost::mutex> lk(_state->mutex);
+        const OpTime referenceOpTime = _state->referenceOpTime();
 
         // NOTE: the format here must be consistent for backwards compatibility
         BSONArrayBuilder hosts(bsonObjBuilder.subarrayStart("hosts"));
@@ -434,6 +464,11 @@ namespace {
             builder.append("secondary", node.isUp && !node.isMaster);
             builder.append("pingTimeMillis", int(node.latencyMicros / 1000));
 
+            const int64_t lagSecs = node.lagSecs(referenceOpTime);
+            if (lagSecs >= 0) {
+                builder.append("lagSecs", static_cast<long long>(lagSecs));
+            }
+
             if (!node.tags.isEmpty()) {
                 builder.append("tags", node.tags);
             }
@@ -743,6 +778,7 @@ namespace {
             case NextStep::CONTACT_HOST: {
                 BSONObj reply; // empty on error
                 int64_t pingMicros = 0;
+                const bool probeOpTime = _set->maxStalenessSecs >= 0;
 
                 DEV _set->checkInvariants();
                 lk.unlock(); // relocked after attempting to call isMaster
@@ -752,6 +788,8 @@ namespace {
                     Timer timer;
                     conn->isMaster(ignoredOutParam, &reply);
                     pingMicros = timer.micros();
+                    if (probeOpTime && !reply["lastWrite"].isABSONObj())
+                        reply = withOplogOpTime(conn.get(), reply);
                     conn.done(); // return to pool on success.
                 }
                 catch (...) {
@@ -801,6 +839,12 @@ namespace {
             }
 
             tags = raw.getObjectField("tags");
+
+            // {opTime: Timestamp} from older servers, {opTime: {ts: Timestamp, t: term}} from
+            // newer ones
+            const BSONElement lastWrite = raw.getObjectField("lastWrite")["opTime"];
+            const BSONElement ts = lastWrite.type() == Object ? lastWrite.Obj()["ts"] : lastWrite;
+            opTime = ts.type() == Timestamp ? ts._opTime() : OpTime();
         } catch (const std::exception& e) {
             ok = false;
             log() << "exception while parsing isMaster reply: " << e.what() << " " << obj;
@@ -849,6 +893,8 @@ namespace {
         if (!tags.binaryEqual(reply.tags))
             tags = reply.tags.getOwned();
 
+        opTime = reply.opTime;
+
         if (reply.latencyMicros >= 0) { // TODO upper bound?
             if (latencyMicros == unknownLatency) {
                 latencyMicros = reply.latencyMicros;
@@ -860,6 +906,12 @@ namespace {
         }
     }
 
+    int64_t Node::lagSecs(const OpTime& reference) const {
+        if (reference.isNull() || opTime.isNull())
+            return -1;
+        return std::max(int64_t(0), int64_t(reference.getSecs()) - int64_t(opTime.getSecs()));
+    }
+
     ReplicaSetMonitor::ConfigChangeHook SetState::configChangeHook;
 
     SetState::SetState(StringData name, const std::set<HostAndPort>& seedNodes)
@@ -867,6 +919,7 @@ namespace {
         , consecutiveFailedScans(0)
         , seedNodes(seedNodes)
         , latencyThresholdMicros(client::Options::current().defaultLocalThresholdMillis() * 1000)
+        , maxStalenessSecs(client::Options::current().maxStalenessSeconds())
         , rand(int64_t(time(0)))
         , roundRobin(0)
     {
@@ -923,13 +976,18 @@ namespace {
         // The difference between these is handled by Node::matches
         case ReadPreference_SecondaryOnly:
         case ReadPreference_Nearest: {
+            const bool boundStaleness = maxStalenessSecs >= 0;
+            const OpTime reference = boundStaleness ? referenceOpTime() : OpTime();
+
             BSONForEach(tagElem, criteria.tags.getTagBSON()) {
                 uassert(16358, "Tags should be a BSON object", tagElem.isABSONObj());
                 BSONObj tag = tagElem.Obj();
 
                 std::vector<const Node*> matchingNodes;
                 for (size_t i = 0; i < nodes.size(); i++ ) {
-                    if (nodes[i].matches(criteria.pref) && nodes[i].matches(tag)) {
+                    // NOTE: unknown lag, -1, is never over the bound
+                    if (nodes[i].matches(criteria.pref) && nodes[i].matches(tag) &&
+                            (!boundStaleness || nodes[i].lagSecs(reference) <= maxStalenessSecs)) {
                         matchingNodes.push_back(&nodes[i]);
                     }
                 }
@@ -990,6 +1048,17 @@ namespace {
         return &(*it);
     }
 
+    OpTime SetState::referenceOpTime() const {
+        OpTime newest;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i].isMaster && !nodes[i].opTime.isNull())
+                return nodes[i].opTime;
+            if (nodes[i].isUp && newest < nodes[i].opTime)
+                newest = nodes[i].opTime;
+        }
+        return newest;
+    }
+
     void SetState::updateNodeIfInNodes(const IsMasterReply& reply) {
         Node* node = findNode(reply.host);
         if (!node) {
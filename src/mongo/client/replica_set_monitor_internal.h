@@ -59,6 +59,7 @@ namespace mongo {
         HostAndPort primary; // empty if not present
         std::set<HostAndPort> normalHosts; // both "hosts" and "passives"
         BSONObj tags;
+        OpTime opTime; // of the last write, from "lastWrite". null if not present
 
         // remaining fields aren't in isMaster reply, but are known to caller.
         HostAndPort host;
@@ -104,6 +105,12 @@ namespace mongo {
              */
             void update(const IsMasterReply& reply);
 
+            /**
+             * Returns how many seconds this node's last write is behind 'reference', or -1 if
+             * either is unknown.
+             */
+            int64_t lagSecs(const OpTime& reference) const;
+
             // Intentionally chosen to compare worse than all known latencies.
             static const int64_t unknownLatency; // = numeric_limits<int64_t>::max()
 
@@ -112,6 +119,7 @@ namespace mongo {
             bool isMaster; // implies isUp
             int64_t latencyMicros; // unknownLatency if unknown
             BSONObj tags; // owned
+            OpTime opTime; // of the last write as of the latest scan. null if unknown
         };
         typedef std::vector<Node> Nodes;
 
@@ -138,6 +146,12 @@ namespace mongo {
          */
         Node* findOrCreateNode(const HostAndPort& host);
 
+        /**
+         * Returns the last write that lag is measured from: the master's if known, otherwise
+         * the newest of any up node. Null if no up node's last write is known.
+         */
+        OpTime referenceOpTime() const;
+
         void updateNodeIfInNodes(const IsMasterReply& reply);
 
         std::string getServerAddress() const;
@@ -167,6 +181,7 @@ namespace mongo {
         Nodes nodes; // maintained sorted and unique by host
         ScanStatePtr currentScan; // NULL if no scan in progress
         int64_t latencyThresholdMicros;
+        int64_t maxStalenessSecs; // secondaries lagging more aren't selected. negative for none
         mutable PseudoRandom rand; // only used for host selection to balance load
         mutable int roundRobin; // used when useDeterministicHostSelection is true
     };
@@ -771,3 +771,76 @@ TEST(ReplicaSetMonitorTests, OutOfBandFailedHost) {
         }
     }
 }
+
+TEST(ReplicaSetMonitorTests, IsMasterReplyLastWrite) {
+    IsMasterReply older(HostAndPort(), -1, BSON(
+            "ok" << 1
+         << "lastWrite" << BSON("opTime" << OpTime(100, 2))
+         ));
+    ASSERT(older.ok);
+    ASSERT_EQUALS(older.opTime, OpTime(100, 2));
+
+    IsMasterReply newer(HostAndPort(), -1, BSON(
+            "ok" << 1
+         << "lastWrite" << BSON("opTime" << BSON("ts" << OpTime(200, 1) << "t" << 3LL)
+                             << "lastWriteDate" << Date_t(200000))
+         ));
+    ASSERT(newer.ok);
+    ASSERT_EQUALS(newer.opTime, OpTime(200, 1));
+
+    IsMasterReply unknown(HostAndPort(), -1, BSON("ok" << 1));
+    ASSERT(unknown.ok);
+    ASSERT(unknown.opTime.isNull());
+}
+
+// Secondaries further behind the primary than maxStalenessSecs aren't selected
+TEST(ReplicaSetMonitorTests, StaleSecondariesAreNotSelected) {
+    SetStatePtr state = boost::make_shared<SetState>("name", basicSeedsSet);
+    ReplicaSetMonitorPtr rsm = boost::make_shared<ReplicaSetMonitor>(state);
+    Refresher refresher = rsm->startOrContinueRefresh();
+
+    for (size_t i = 0; i != basicSeeds.size(); ++i) {
+        NextStep ns = refresher.getNextStep();
+    }
+
+    // a is the primary, b is 10 seconds behind and c 300
+    const unsigned secs[] = { 1000, 990, 700 };
+    for (size_t i = 0; i != basicSeeds.size(); ++i) {
+        bool primary = (i == 0);
+
+        refresher.receivedIsMaster(basicSeeds[i], -1, BSON(
+                "setName" << "name"
+             << "ismaster" << primary
+             << "secondary" << !primary
+             << "hosts" << BSON_ARRAY("a" << "b" << "c")
+             << "lastWrite" << BSON("opTime" << OpTime(secs[i], 1))
+             << "ok" << true
+             ));
+    }
+
+    ASSERT_EQUALS(state->findNode(HostAndPort("a"))->lagSecs(state->referenceOpTime()), 0);
+    ASSERT_EQUALS(state->findNode(HostAndPort("b"))->lagSecs(state->referenceOpTime()), 10);
+    ASSERT_EQUALS(state->findNode(HostAndPort("c"))->lagSecs(state->referenceOpTime()), 300);
+
+    const ReadPreferenceSetting secondaryOnly(ReadPreference_SecondaryOnly, TagSet());
+    const ReadPreferenceSetting secondaryPreferred(ReadPreference_SecondaryPreferred, TagSet());
+
+    state->maxStalenessSecs = 60;
+    for (int i = 0; i < 10; i++)
+        ASSERT_EQUALS(state->getMatchingHost(secondaryOnly), HostAndPort("b"));
+
+    state->maxStalenessSecs = 5;
+    ASSERT(state->getMatchingHost(secondaryOnly).empty());
+    ASSERT_EQUALS(state->getMatchingHost(secondaryPreferred), HostAndPort("a"));
+
+    // Members whose lag is unknown stay eligible
+    state->findNode(HostAndPort("c"))->opTime = OpTime();
+    ASSERT_EQUALS(state->getMatchingHost(secondaryOnly), HostAndPort("c"));
+
+    BSONObjBuilder b;
+    rsm->appendInfo(b);
+    const BSONObj info = b.obj();
+    ASSERT_EQUALS(info["hosts"]["0"]["lagSecs"].numberLong(), 0);
+    ASSERT_EQUALS(info["hosts"]["1"]["lagSecs"].numberLong(), 10);
+    ASSERT(info["hosts"]["2"]["lagSecs"].eoo());
+}
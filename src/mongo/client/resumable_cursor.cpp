@@ -0,0 +1,208 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/resumable_cursor.h"
+
+#include <algorithm>
+
+#include "mongo/base/error_codes.h"
+#include "mongo/client/connpool.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/net/sock.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+    const int ResumableCursor::kDefaultMaxRetries = 5;
+
+    namespace {
+
+        // Pause after the first failure, doubling with each consecutive one up to the maximum
+        const int kInitialRetryMillis = 100;
+        const int kMaxRetryMillis = 5000;
+
+    } // namespace
+
+    ResumableCursor::ResumableCursor(const ConnectionString& host,
+                                     const std::string& ns,
+                                     const BSONObj& filter,
+                                     const std::string& key,
+                                     int queryOptions,
+                                     const BSONObj* fieldsToReturn,
+                                     int batchSize)
+        : _host(host)
+        , _ns(ns)
+        , _filter(filter.getOwned())
+        , _key(queryOptions & QueryOption_OplogReplay ? "ts" : key)
+        , _queryOptions(queryOptions)
+        , _fieldsToReturn(fieldsToReturn ? fieldsToReturn->getOwned() : BSONObj())
+        , _batchSize(batchSize)
+        , _maxRetries(kDefaultMaxRetries)
+        , _resumed(0)
+        , _failures(0)
+        , _exhausted(false)
+        , _skipping(false)
+    {}
+
+    ResumableCursor::~ResumableCursor() {
+        _close(false);
+    }
+
+    bool ResumableCursor::isRetryable(const DBException& e) {
+        if (dynamic_cast<const SocketException*>(&e) != NULL)
+            return true;
+
+        const int code = e.getCode();
+        return ErrorCodes::isNetworkError(static_cast<ErrorCodes::Error>(code))
+            || code == ErrorCodes::CursorNotFound
+            || code == 13127    // getMore: cursor didn't exist on server
+            || code == 10009    // no primary, during a failover
+            || code == 16369;   // no member of the set reachable
+    }
+
+    Query ResumableCursor::_query() const {
+        BSONObj filter = _filter;
+
+        if (!_resumeAfter.isEmpty()) {
+            BSONObjBuilder b;
+            const BSONElement after = _resumeAfter.firstElement();
+            if (_filter.hasField(_key)) {
+                const BSONObj bound = BSON(_key << BSON("$gt" << after));
+                b.append("$and", BSON_ARRAY(_filter << bound));
+            }
+            else {
+                // Kept at the top level, where OplogReplay looks for it
+                b.appendElements(_filter);
+                BSONObjBuilder gt(b.subobjStart(_key));
+                gt.appendAs(after, "$gt");
+                gt.done();
+            }
+            filter = b.obj();
+        }
+
+        Query query(filter);
+        if (!(_queryOptions & QueryOption_OplogReplay))
+            query.sort(_key);
+        return query;
+    }
+
+    void ResumableCursor::_open() {
+        _conn.reset(new ScopedDbConnection(_host));
+        _cursor = (*_conn)->query(_ns,
+                                  _query(),
+                                  0,
+                                  0,
+                                  _fieldsToReturn.isEmpty() ? NULL : &_fieldsToReturn,
+                                  _queryOptions,
+                                  _batchSize);
+        uassert(ErrorCodes::HostUnreachable,
+                str::stream() << "query on " << _ns << " failed on " << _host.toString(),
+                _cursor.get());
+    }
+
+    void ResumableCursor::_close(bool failed) {
+        _cursor.reset();
+        if (!_conn)
+            return;
+
+        if (failed)
+            _conn->kill();
+        else
+            _conn->done();
+        _conn.reset();
+    }
+
+    void ResumableCursor::_rememberLast() {
+        if (_last.isEmpty())
+            return;
+
+        const BSONElement key = _last[_key];
+        uassert(17412,
+                str::stream() << "document without resume key '" << _key << "' in " << _ns,
+                !key.eoo());
+
+        BSONObjBuilder b;
+        b.appendAs(key, _key);
+        _resumeAfter = b.obj();
+        _last = BSONObj();
+    }
+
+    bool ResumableCursor::more() {
+        if (!_pending.isEmpty())
+            return true;
+
+        while (!_exhausted) {
+            try {
+                if (!_cursor.get())
+                    _open();
+
+                // Fetching the next batch frees the current one, save the key while we can
+                if (!_cursor->moreInCurrentBatch())
+                    _rememberLast();
+
+                if (!_cursor->more()) {
+                    _exhausted = true;
+                    _close(false);
+                    return false;
+                }
+                _failures = 0;
+
+                if (!_skipping)
+                    return true;
+
+                // Whatever the server returned up to the resume point was already delivered
+                const BSONObj doc = _cursor->nextSafe();
+                if (doc[_key].woCompare(_resumeAfter.firstElement(), false) > 0) {
+                    _skipping = false;
+                    _pending = doc;
+                    return true;
+                }
+            }
+            catch (const DBException& e) {
+                _close(true);
+                if (!isRetryable(e) || ++_failures > _maxRetries)
+                    throw;
+
+                const int pause =
+                    std::min(kMaxRetryMillis, kInitialRetryMillis << std::min(_failures - 1, 10));
+                warning() << "resuming scan of " << _ns << " after error: " << e.what()
+                          << ", retrying in " << pause << "ms" << std::endl;
+                sleepmillis(pause);
+
+                _resumed++;
+                _skipping = !_resumeAfter.isEmpty();
+            }
+        }
+
+        return false;
+    }
+
+    BSONObj ResumableCursor::next() {
+        if (!_pending.isEmpty()) {
+            _last = _pending;
+            _pending = BSONObj();
+            return _last;
+        }
+
+        uassert(17413, "ResumableCursor::next() called but more() is false", _cursor.get());
+        _last = _cursor->nextSafe();
+        return _last;
+    }
+
+} // namespace mongo
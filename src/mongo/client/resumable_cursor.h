@@ -0,0 +1,112 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/scoped_ptr.hpp>
+#include <memory>
+#include <string>
+
+#include "mongo/client/dbclientcursor.h"
+#include "mongo/client/dbclientinterface.h"
+#include "mongo/client/export_macros.h"
+
+namespace mongo {
+
+    class DBException;
+    class ScopedDbConnection;
+
+    /**
+     * A cursor over a long scan that survives losing its connection:
+     *
+     *   ResumableCursor cursor(ConnectionString::parse("set/a,b,c", errmsg),
+     *                          "db.coll", BSON("status" << "active"));
+     *   while (cursor.more())
+     *       export(cursor.next());
+     *
+     * The query is sorted on a unique key, "_id" unless told otherwise. The key of the last
+     * document returned is remembered, and when fetching more fails with a network error, or
+     * because the server cursor is gone, the query is issued again on a fresh connection with
+     * a $gt bound on that key. Nothing is returned twice, and the scan carries on where it
+     * stopped rather than starting over.
+     *
+     * Oplog reads (QueryOption_OplogReplay) keep their $natural order and resume on "ts".
+     * Replica sets are reached through the connection pool, so a resumed query goes to
+     * whichever member the ReplicaSetMonitor selects at that point.
+     *
+     * Each failure is followed by a growing pause; after setMaxRetries() consecutive failures
+     * the error is thrown. Documents are valid until the following call to more(), like
+     * those of DBClientCursor. Projections must include the key.
+     */
+    class MONGO_CLIENT_API ResumableCursor : public DBClientCursorInterface {
+    public:
+        static const int kDefaultMaxRetries;
+
+        ResumableCursor(const ConnectionString& host,
+                        const std::string& ns,
+                        const BSONObj& filter,
+                        const std::string& key = "_id",
+                        int queryOptions = 0,
+                        const BSONObj* fieldsToReturn = NULL,
+                        int batchSize = 0);
+
+        virtual ~ResumableCursor();
+
+        virtual bool more();
+        virtual BSONObj next();
+
+        /** Consecutive failures tolerated before giving up. */
+        void setMaxRetries(int retries) { _maxRetries = retries; }
+
+        /** Number of times the query was resumed. */
+        int resumed() const { return _resumed; }
+
+        /** True for the errors a scan is resumed after. */
+        static bool isRetryable(const DBException& e);
+
+    private:
+        void _open();
+        void _close(bool failed);
+        void _rememberLast();
+        Query _query() const;
+
+        const ConnectionString _host;
+        const std::string _ns;
+        const BSONObj _filter;
+        const std::string _key;
+        const int _queryOptions;
+        const BSONObj _fieldsToReturn;
+        const int _batchSize;
+
+        int _maxRetries;
+        int _resumed;
+        int _failures;
+
+        boost::scoped_ptr<ScopedDbConnection> _conn;
+        std::auto_ptr<DBClientCursor> _cursor;
+        bool _exhausted;
+
+        // The last document returned, until its key has been saved
+        BSONObj _last;
+
+        // { <key>: <value> } of the last document returned
+        BSONObj _resumeAfter;
+
+        // Set after resuming, until a document past _resumeAfter has been seen
+        bool _skipping;
+        BSONObj _pending;
+    };
+
+} // namespace mongo
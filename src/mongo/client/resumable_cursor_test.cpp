@@ -0,0 +1,204 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/resumable_cursor.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <deque>
+#include <vector>
+
+#include "mongo/client/connpool.h"
+#include "mongo/dbtests/mock/mock_dbclient_connection.h"
+#include "mongo/dbtests/mock/mock_dbclient_cursor.h"
+#include "mongo/dbtests/mock/mock_remote_db_server.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/net/sock.h"
+
+namespace {
+
+    using mongo::BSONArray;
+    using mongo::BSONArrayBuilder;
+    using mongo::BSONObj;
+    using mongo::ConnectionString;
+    using mongo::DBClientBase;
+    using mongo::DBClientCursor;
+    using mongo::MockDBClientConnection;
+    using mongo::MockDBClientCursor;
+    using mongo::MockRemoteDBServer;
+    using mongo::Query;
+    using mongo::ResumableCursor;
+    using mongo::SocketException;
+    using mongo::UserException;
+    using std::auto_ptr;
+    using std::string;
+
+    const char kHost[] = "$resumable:27017";
+    const char kNs[] = "test.export";
+
+    // A cursor whose connection drops after a number of documents
+    class FailingCursor : public MockDBClientCursor {
+    public:
+        FailingCursor(DBClientBase* client, const BSONArray& results, int failAfter)
+            : MockDBClientCursor(client, results), _left(failAfter) {}
+
+        bool more() {
+            if (_left == 0)
+                throw SocketException(SocketException::RECV_ERROR, kHost);
+            return MockDBClientCursor::more();
+        }
+
+        BSONObj next() {
+            if (_left > 0)
+                _left--;
+            return MockDBClientCursor::next();
+        }
+
+    private:
+        int _left;
+    };
+
+    // Fails each query after the next number of documents in 'failures', and records the
+    // queries it was sent. The mock server ignores filters, so resumed queries return every
+    // document again.
+    class FailingConnection : public MockDBClientConnection {
+    public:
+        FailingConnection(MockRemoteDBServer* server,
+                          std::deque<int>* failures,
+                          std::vector<BSONObj>* queries)
+            : MockDBClientConnection(server), _failures(failures), _queries(queries) {}
+
+        auto_ptr<DBClientCursor> query(const string& ns,
+                                       Query query,
+                                       int nToReturn,
+                                       int nToSkip,
+                                       const BSONObj* fieldsToReturn,
+                                       int queryOptions,
+                                       int batchSize) {
+            _queries->push_back(query.obj.getOwned());
+
+            auto_ptr<DBClientCursor> cursor = MockDBClientConnection::query(
+                ns, query, nToReturn, nToSkip, fieldsToReturn, queryOptions, batchSize);
+            BSONArrayBuilder results;
+            while (cursor->more())
+                results.append(cursor->next());
+
+            int failAfter = -1;
+            if (!_failures->empty()) {
+                failAfter = _failures->front();
+                _failures->pop_front();
+            }
+            return auto_ptr<DBClientCursor>(new FailingCursor(this, results.arr(), failAfter));
+        }
+
+    private:
+        std::deque<int>* const _failures;
+        std::vector<BSONObj>* const _queries;
+    };
+
+    class ResumableCursorTest : public mongo::unittest::Test,
+                                public ConnectionString::ConnectionHook {
+    protected:
+        void setUp() {
+            _server.reset(new MockRemoteDBServer(kHost));
+            for (int i = 0; i < 10; i++)
+                _server->insert(kNs, BSON("_id" << i));
+            ConnectionString::setConnectionHook(this);
+        }
+
+        void tearDown() {
+            mongo::ScopedDbConnection::clearPool();
+            ConnectionString::setConnectionHook(NULL);
+            _server.reset();
+        }
+
+        DBClientBase* connect(const ConnectionString&, string&, double) {
+            return new FailingConnection(_server.get(), &_failures, &_queries);
+        }
+
+        ConnectionString host() {
+            string errmsg;
+            return ConnectionString::parse(kHost, errmsg);
+        }
+
+        boost::scoped_ptr<MockRemoteDBServer> _server;
+        std::deque<int> _failures;
+        std::vector<BSONObj> _queries;
+    };
+
+    TEST_F(ResumableCursorTest, ResumesAfterTheLastDocument) {
+        // Fail after _id 3, then after _id 6: the second query skips 0-3 again
+        _failures.push_back(4);
+        _failures.push_back(7);
+
+        ResumableCursor cursor(host(), kNs, BSON("x" << 1));
+        for (int i = 0; i < 10; i++) {
+            ASSERT_TRUE(cursor.more());
+            ASSERT_EQUALS(i, cursor.next()["_id"].numberInt());
+        }
+        ASSERT_FALSE(cursor.more());
+        ASSERT_EQUALS(2, cursor.resumed());
+
+        ASSERT_EQUALS(3U, _queries.size());
+        ASSERT_EQUALS(BSON("query" << BSON("x" << 1) << "orderby" << BSON("_id" << 1)),
+                      _queries[0]);
+        ASSERT_EQUALS(BSON("query" << BSON("x" << 1 << "_id" << BSON("$gt" << 3))
+                                   << "orderby" << BSON("_id" << 1)),
+                      _queries[1]);
+        ASSERT_EQUALS(BSON("x" << 1 << "_id" << BSON("$gt" << 6)), _queries[2]["query"].Obj());
+    }
+
+    TEST_F(ResumableCursorTest, FilterOnTheKeyIsCombined) {
+        _failures.push_back(2);
+
+        ResumableCursor cursor(host(), kNs, BSON("_id" << BSON("$gte" << 0)));
+        for (int i = 0; i < 10; i++) {
+            ASSERT_TRUE(cursor.more());
+            ASSERT_EQUALS(i, cursor.next()["_id"].numberInt());
+        }
+        ASSERT_FALSE(cursor.more());
+
+        ASSERT_EQUALS(2U, _queries.size());
+        ASSERT_EQUALS(BSON("$and" << BSON_ARRAY(BSON("_id" << BSON("$gte" << 0))
+                                                << BSON("_id" << BSON("$gt" << 1)))),
+                      _queries[1]["query"].Obj());
+    }
+
+    TEST_F(ResumableCursorTest, GivesUpAfterMaxRetries) {
+        _failures.push_back(2);
+        _failures.push_back(0);
+        _failures.push_back(0);
+
+        ResumableCursor cursor(host(), kNs, BSONObj());
+        cursor.setMaxRetries(1);
+
+        ASSERT_TRUE(cursor.more());
+        cursor.next();
+        ASSERT_TRUE(cursor.more());
+        cursor.next();
+        ASSERT_THROWS(cursor.more(), SocketException);
+    }
+
+    TEST_F(ResumableCursorTest, DocumentsMustHaveTheKey) {
+        _failures.push_back(1);
+
+        ResumableCursor cursor(host(), kNs, BSONObj(), "missing");
+        ASSERT_TRUE(cursor.more());
+        cursor.next();
+        ASSERT_THROWS(cursor.more(), UserException);
+    }
+
+} // namespace
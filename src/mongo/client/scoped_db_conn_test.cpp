@@ -19,6 +19,7 @@
 #include "mongo/db/dbmessage.h"
 #include "mongo/platform/cstdint.h"
 #include "mongo/util/fail_point_service.h"
+#include "mongo/util/operation_deadline.h"
 #include "mongo/util/time_support.h"
 #include "mongo/util/timer.h"
 #include "mongo/unittest/unittest.h"
@@ -340,6 +341,7 @@ namespace mongo {
 
             ~DummyServerFixture() {
                 mongo::pool.setMaxPoolSize(_maxPoolSizePerHost);
+                mongo::pool.setMaxInUsePerHost(mongo::PoolForHost::kPoolSizeUnlimited);
                 mongo::ScopedDbConnection::clearPool();
 
                 _server->stop();
@@ -528,4 +530,75 @@ namespace mongo {
 
         conn1Again.done();
     }
+
+    TEST_F(DummyServerFixture, TrafficClassMaxInUse) {
+        mongo::TrafficClassOptions batch;
+        batch.maxInUse = 1;
+        batch.maxWaitMillis = 10;
+        mongo::pool.setTrafficClass("limitedBatch", batch);
+
+        ScopedDbConnection conn1(TARGET_HOST, 0, "limitedBatch");
+        ASSERT_THROWS(ScopedDbConnection(TARGET_HOST, 0, "limitedBatch"),
+                      mongo::UserException);
+
+        // Other classes are not affected by the batch limit
+        ScopedDbConnection other(TARGET_HOST);
+
+        conn1.done();
+        ScopedDbConnection conn2(TARGET_HOST, 0, "limitedBatch");
+        conn2.kill();
+        ScopedDbConnection conn3(TARGET_HOST, 0, "limitedBatch");
+
+        conn3.done();
+        other.done();
+        mongo::pool.setTrafficClass("limitedBatch", mongo::TrafficClassOptions());
+    }
+
+    TEST_F(DummyServerFixture, TrafficClassReservation) {
+        mongo::TrafficClassOptions interactive;
+        interactive.reserved = 1;
+        mongo::pool.setTrafficClass("reservedInteractive", interactive);
+
+        mongo::TrafficClassOptions batch;
+        batch.maxWaitMillis = 10;
+        mongo::pool.setTrafficClass("borrowingBatch", batch);
+
+        mongo::pool.setMaxInUsePerHost(2);
+
+        ScopedDbConnection batch1(TARGET_HOST, 0, "borrowingBatch");
+        // The second connection is held back for the interactive class
+        ASSERT_THROWS(ScopedDbConnection(TARGET_HOST, 0, "borrowingBatch"),
+                      mongo::UserException);
+
+        ScopedDbConnection interactive1(TARGET_HOST, 0, "reservedInteractive");
+
+        mongo::BSONObjBuilder info;
+        mongo::pool.appendInfo(info);
+        const mongo::BSONObj infoObj = info.obj();
+        ASSERT_EQUALS(2, infoObj["totalInUse"].numberInt());
+
+        interactive1.done();
+        batch1.done();
+        mongo::pool.setTrafficClass("reservedInteractive", mongo::TrafficClassOptions());
+        mongo::pool.setTrafficClass("borrowingBatch", mongo::TrafficClassOptions());
+    }
+
+    TEST_F(DummyServerFixture, PoolWaitHonorsOperationDeadline) {
+        mongo::TrafficClassOptions batch;
+        batch.maxInUse = 1;
+        batch.maxWaitMillis = 60 * 1000;
+        mongo::pool.setTrafficClass("deadlineBatch", batch);
+
+        ScopedDbConnection conn1(TARGET_HOST, 0, "deadlineBatch");
+        {
+            mongo::OperationDeadline deadline(20);
+            mongo::Timer timer;
+            ASSERT_THROWS(ScopedDbConnection(TARGET_HOST, 0, "deadlineBatch"),
+                          mongo::UserException);
+            ASSERT_LESS_THAN(timer.millis(), 10 * 1000);
+        }
+
+        conn1.done();
+        mongo::pool.setTrafficClass("deadlineBatch", mongo::TrafficClassOptions());
+    }
 }
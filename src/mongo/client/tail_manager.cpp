@@ -0,0 +1,413 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/tail_manager.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+#include "mongo/client/connpool.h"
+#include "mongo/client/dbclientcursor.h"
+#include "mongo/util/log.h"
+#include "mongo/util/net/message.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+    const size_t TailManager::kDefaultMaxQueuedDocuments = 100000;
+    const int TailManager::kDefaultRetryIntervalMillis = 100;
+
+    /**
+     * Documents received in one reply. When the reply buffer could be taken over from the
+     * cursor, the documents point into it; otherwise they own copies.
+     */
+    struct TailManager::Batch {
+        Batch() : receivedMillis(curTimeMillis64()) {}
+
+        boost::scoped_ptr<Message> reply;
+        std::vector<BSONObj> documents;
+        const unsigned long long receivedMillis;
+    };
+
+    struct TailManager::Tail {
+        Tail(const std::string& host_,
+             const std::string& ns_,
+             const BSONObj& filter_,
+             int queryOptions_,
+             int retryIntervalMillis_)
+            : host(host_)
+            , ns(ns_)
+            , filter(filter_.getOwned())
+            , queryOptions(queryOptions_)
+            , retryIntervalMillis(retryIntervalMillis_)
+            , stopping(false)
+            , batches(0)
+            , documents(0)
+            , queries(0)
+            , errors(0)
+            , overruns(0)
+        {}
+
+        void run();
+        Query query(const BSONElement& after) const;
+        void publish(const boost::shared_ptr<const Batch>& batch);
+        bool waitToRetry();
+
+        const std::string host;
+        const std::string ns;
+        const BSONObj filter;
+        const int queryOptions;
+        const int retryIntervalMillis;
+
+        boost::scoped_ptr<boost::thread> thread;
+
+        boost::mutex mutex;
+        boost::condition_variable changed;
+
+        // Guarded by mutex
+        std::vector<TailSubscription*> subscribers;
+        bool stopping;
+        long long batches;
+        long long documents;
+        long long queries;
+        long long errors;
+        long long overruns;
+    };
+
+    namespace {
+
+        std::string tailKey(const std::string& ns, const BSONObj& filter, int queryOptions) {
+            return ns + '\0' + std::string(reinterpret_cast<const char*>(&queryOptions),
+                                           sizeof(queryOptions))
+                + std::string(filter.objdata(), filter.objsize());
+        }
+
+        void stop(TailManager::Tail* tail) {
+            boost::lock_guard<boost::mutex> lk(tail->mutex);
+            tail->stopping = true;
+            tail->changed.notify_all();
+        }
+
+    } // namespace
+
+    Query TailManager::Tail::query(const BSONElement& after) const {
+        if (after.eoo())
+            return Query(filter);
+
+        // Keep the resume field at the top level where it can be used by OplogReplay, and
+        // only fall back to $and when the filter already constrains it
+        BSONObjBuilder b;
+        if (filter.hasField(after.fieldName())) {
+            const BSONObj resume = BSON(after.fieldName() << BSON("$gt" << after));
+            b.append("$and", BSON_ARRAY(filter << resume));
+        }
+        else {
+            b.appendElements(filter);
+            BSONObjBuilder gt(b.subobjStart(after.fieldName()));
+            gt.appendAs(after, "$gt");
+            gt.done();
+        }
+        return Query(b.obj());
+    }
+
+    void TailManager::Tail::publish(const boost::shared_ptr<const Batch>& batch) {
+        const size_t n = batch->documents.size();
+
+        boost::lock_guard<boost::mutex> lk(mutex);
+        batches++;
+        documents += n;
+
+        for (size_t i = 0; i < subscribers.size(); ) {
+            TailSubscription* const subscriber = subscribers[i];
+
+            if (subscriber->_queued + n > subscriber->_maxQueued) {
+                warning() << "detaching a subscriber to the tail of " << ns << " that fell "
+                          << subscriber->_queued << " entries behind" << std::endl;
+                subscriber->_overrun = true;
+                overruns++;
+                subscribers.erase(subscribers.begin() + i);
+                continue;
+            }
+
+            subscriber->_batches.push_back(batch);
+            subscriber->_queued += n;
+            i++;
+        }
+
+        if (subscribers.empty())
+            stopping = true;
+        changed.notify_all();
+    }
+
+    bool TailManager::Tail::waitToRetry() {
+        boost::unique_lock<boost::mutex> lk(mutex);
+        if (!stopping)
+            changed.timed_wait(lk, boost::posix_time::milliseconds(retryIntervalMillis));
+        return !stopping;
+    }
+
+    void TailManager::Tail::run() {
+        const char* const resumeField = queryOptions & QueryOption_OplogReplay ? "ts" : "_id";
+        const int options = queryOptions | QueryOption_CursorTailable | QueryOption_AwaitData;
+
+        // The resume field of the last entry received
+        BSONObj last;
+
+        while (true) {
+            {
+                boost::lock_guard<boost::mutex> lk(mutex);
+                if (stopping)
+                    return;
+                queries++;
+            }
+
+            bool received = false;
+            try {
+                ScopedDbConnection conn(host);
+                std::auto_ptr<DBClientCursor> cursor =
+                    conn->query(ns, query(last.firstElement()), 0, 0, NULL, options);
+
+                while (cursor.get()) {
+                    {
+                        boost::lock_guard<boost::mutex> lk(mutex);
+                        if (stopping)
+                            break;
+                    }
+
+                    if (!cursor->more()) {
+                        if (cursor->isDead())
+                            break;
+                        // AwaitData timed out with nothing new
+                        continue;
+                    }
+
+                    boost::shared_ptr<Batch> batch(new Batch);
+                    do {
+                        batch->documents.push_back(cursor->nextSafe());
+                    } while (cursor->moreInCurrentBatch());
+
+                    // Take the reply over from the cursor, which would otherwise free it when
+                    // fetching the next batch
+                    Message* const reply = cursor->getMessage();
+                    if (reply != NULL && reply->doIFreeIt()) {
+                        batch->reply.reset(new Message());
+                        *batch->reply = *reply;
+                    }
+                    else {
+                        for (size_t i = 0; i < batch->documents.size(); i++)
+                            batch->documents[i] = batch->documents[i].getOwned();
+                    }
+
+                    const BSONElement resume = batch->documents.back()[resumeField];
+                    if (!resume.eoo()) {
+                        BSONObjBuilder b;
+                        b.appendAs(resume, resumeField);
+                        last = b.obj();
+                    }
+
+                    received = true;
+                    publish(batch);
+                }
+
+                cursor.reset();
+                conn.done();
+            }
+            catch (const DBException& e) {
+                warning() << "error tailing " << ns << " on " << host << ": " << e.what()
+                          << std::endl;
+                boost::lock_guard<boost::mutex> lk(mutex);
+                errors++;
+                received = false;
+            }
+
+            // A cursor that died after returning entries is simply reopened
+            if (!received && !waitToRetry())
+                return;
+        }
+    }
+
+    TailManager::TailManager(const std::string& host)
+        : _host(host)
+        , _maxQueuedDocuments(kDefaultMaxQueuedDocuments)
+        , _retryIntervalMillis(kDefaultRetryIntervalMillis)
+    {}
+
+    TailManager::~TailManager() {
+        std::vector<boost::shared_ptr<Tail> > tails(_retired);
+        for (std::map<std::string, boost::shared_ptr<Tail> >::const_iterator it = _tails.begin();
+             it != _tails.end(); ++it)
+            tails.push_back(it->second);
+
+        for (size_t i = 0; i < tails.size(); i++)
+            stop(tails[i].get());
+        for (size_t i = 0; i < tails.size(); i++)
+            tails[i]->thread->join();
+    }
+
+    void TailManager::setMaxQueuedDocuments(size_t documents) {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        _maxQueuedDocuments = documents;
+    }
+
+    void TailManager::setRetryIntervalMillis(int millis) {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        _retryIntervalMillis = millis;
+    }
+
+    boost::shared_ptr<TailSubscription> TailManager::subscribe(const std::string& ns,
+                                                               const BSONObj& filter,
+                                                               int queryOptions) {
+        const std::string key = tailKey(ns, filter, queryOptions);
+
+        boost::lock_guard<boost::mutex> lk(_mutex);
+
+        // Forget retired tails whose thread is done
+        for (size_t i = 0; i < _retired.size(); ) {
+            if (_retired[i]->thread->timed_join(boost::posix_time::milliseconds(0))) {
+                _retired.erase(_retired.begin() + i);
+                continue;
+            }
+            i++;
+        }
+
+        boost::shared_ptr<Tail>& tail = _tails[key];
+        if (tail) {
+            boost::shared_ptr<TailSubscription> subscription(
+                new TailSubscription(tail, _maxQueuedDocuments));
+            boost::lock_guard<boost::mutex> tailLock(tail->mutex);
+            if (!tail->stopping) {
+                tail->subscribers.push_back(subscription.get());
+                return subscription;
+            }
+            _retired.push_back(tail);
+        }
+
+        tail.reset(new Tail(_host, ns, filter, queryOptions, _retryIntervalMillis));
+        boost::shared_ptr<TailSubscription> subscription(
+            new TailSubscription(tail, _maxQueuedDocuments));
+        tail->subscribers.push_back(subscription.get());
+        tail->thread.reset(new boost::thread(boost::bind(&Tail::run, tail)));
+        return subscription;
+    }
+
+    void TailManager::appendInfo(BSONObjBuilder& b) const {
+        const unsigned long long now = curTimeMillis64();
+
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        BSONArrayBuilder tails(b.subarrayStart("tails"));
+        for (std::map<std::string, boost::shared_ptr<Tail> >::const_iterator it = _tails.begin();
+             it != _tails.end(); ++it) {
+            Tail& tail = *it->second;
+            boost::lock_guard<boost::mutex> tailLock(tail.mutex);
+            if (tail.stopping)
+                continue;
+
+            BSONObjBuilder info(tails.subobjStart());
+            info.append("ns", tail.ns);
+            info.append("filter", tail.filter);
+            info.append("queryOptions", tail.queryOptions);
+            info.append("batches", tail.batches);
+            info.append("documents", tail.documents);
+            info.append("queries", tail.queries);
+            info.append("errors", tail.errors);
+            info.append("overruns", tail.overruns);
+
+            // How far each subscriber is behind the cursor
+            BSONArrayBuilder subscribers(info.subarrayStart("subscribers"));
+            for (size_t i = 0; i < tail.subscribers.size(); i++) {
+                const TailSubscription& subscriber = *tail.subscribers[i];
+                BSONObjBuilder lag(subscribers.subobjStart());
+                lag.append("queued", static_cast<long long>(subscriber._queued));
+                lag.append("lagMillis", subscriber._batches.empty() ? 0LL :
+                           static_cast<long long>(now - subscriber._batches.front()->receivedMillis));
+                lag.done();
+            }
+            subscribers.done();
+            info.done();
+        }
+        tails.done();
+    }
+
+    TailSubscription::TailSubscription(const boost::shared_ptr<TailManager::Tail>& tail,
+                                       size_t maxQueued)
+        : _tail(tail)
+        , _maxQueued(maxQueued)
+        , _queued(0)
+        , _overrun(false)
+        , _position(0)
+    {}
+
+    TailSubscription::~TailSubscription() {
+        boost::lock_guard<boost::mutex> lk(_tail->mutex);
+        std::vector<TailSubscription*>& subscribers = _tail->subscribers;
+        std::vector<TailSubscription*>::iterator it =
+            std::find(subscribers.begin(), subscribers.end(), this);
+        if (it == subscribers.end())
+            return;
+
+        subscribers.erase(it);
+        if (subscribers.empty()) {
+            _tail->stopping = true;
+            _tail->changed.notify_all();
+        }
+    }
+
+    bool TailSubscription::next(BSONObj* doc, int timeoutMillis) {
+        if (_current && _position < _current->documents.size()) {
+            *doc = _current->documents[_position++];
+            return true;
+        }
+
+        // Let go of the batch before waiting, it may be the last reference to it
+        _current.reset();
+        _position = 0;
+
+        const boost::system_time deadline =
+            boost::get_system_time() + boost::posix_time::milliseconds(timeoutMillis);
+
+        boost::unique_lock<boost::mutex> lk(_tail->mutex);
+        while (_batches.empty()) {
+            if (_overrun || _tail->stopping)
+                return false;
+            if (!_tail->changed.timed_wait(lk, deadline) && _batches.empty())
+                return false;
+        }
+
+        _current = _batches.front();
+        _batches.pop_front();
+        _queued -= _current->documents.size();
+        lk.unlock();
+
+        *doc = _current->documents[_position++];
+        return true;
+    }
+
+    bool TailSubscription::overrun() const {
+        boost::lock_guard<boost::mutex> lk(_tail->mutex);
+        return _overrun;
+    }
+
+    size_t TailSubscription::queued() const {
+        boost::lock_guard<boost::mutex> lk(_tail->mutex);
+        return _queued + (_current ? _current->documents.size() - _position : 0);
+    }
+
+} // namespace mongo
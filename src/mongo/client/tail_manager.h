@@ -0,0 +1,149 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mongo/client/export_macros.h"
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    class TailSubscription;
+
+    /**
+     * Shares tailable cursors between the components of a process:
+     *
+     *   TailManager tails("localhost:27017");
+     *   boost::shared_ptr<TailSubscription> sub = tails.subscribe("local.oplog.rs",
+     *                                                             BSON("op" << "i"),
+     *                                                             QueryOption_OplogReplay);
+     *   BSONObj entry;
+     *   while (sub->next(&entry, 1000)) {
+     *       ...
+     *   }
+     *
+     * Each distinct (ns, filter, options) is tailed by one thread with one AwaitData cursor,
+     * however many subscribers it has. Every batch received is handed to all subscribers
+     * without copying the documents; the batch is freed once the last of them moves past it.
+     *
+     * Subscribers can join and leave at any time. A new subscriber sees the entries received
+     * after it joined. Each subscriber queues at most setMaxQueuedDocuments() documents; one
+     * that falls further behind is detached and its subscription reports overrun(), so a
+     * stalled consumer can not hold the others back or make memory grow without bound.
+     *
+     * When the cursor dies, the collection is queried again for entries after the last one
+     * received, by "ts" for oplog tails (QueryOption_OplogReplay) and by "_id" otherwise.
+     * Network errors are retried the same way after setRetryIntervalMillis().
+     *
+     * Thread safety: all methods may be called concurrently. The destructor waits for the
+     * cursor threads, which may take as long as an AwaitData getMore.
+     */
+    class MONGO_CLIENT_API TailManager : boost::noncopyable {
+    public:
+        static const size_t kDefaultMaxQueuedDocuments;
+        static const int kDefaultRetryIntervalMillis;
+
+        explicit TailManager(const std::string& host);
+        ~TailManager();
+
+        /** Documents a subscription may hold before it is detached, for new subscriptions. */
+        void setMaxQueuedDocuments(size_t documents);
+
+        /** Pause before querying again after an error or a cursor that returned nothing. */
+        void setRetryIntervalMillis(int millis);
+
+        /**
+         * Subscribes to the entries of 'ns' matching 'filter', starting the cursor if this is
+         * the first subscriber. 'queryOptions' are added to CursorTailable and AwaitData.
+         * Unsubscribe by releasing the returned subscription.
+         */
+        boost::shared_ptr<TailSubscription> subscribe(const std::string& ns,
+                                                      const BSONObj& filter,
+                                                      int queryOptions = 0);
+
+        /** Appends the state of each cursor and its subscribers. */
+        void appendInfo(BSONObjBuilder& b) const;
+
+        // Defined in tail_manager.cpp
+        struct Batch;
+        struct Tail;
+
+    private:
+        const std::string _host;
+
+        mutable boost::mutex _mutex;
+        size_t _maxQueuedDocuments;
+        int _retryIntervalMillis;
+        std::map<std::string, boost::shared_ptr<Tail> > _tails;
+
+        // Tails whose subscribers all left, until their thread has finished
+        std::vector<boost::shared_ptr<Tail> > _retired;
+    };
+
+    /**
+     * One consumer's view of a shared tailable cursor, from TailManager::subscribe().
+     *
+     * A subscription is meant to be read by one thread at a time.
+     */
+    class MONGO_CLIENT_API TailSubscription : boost::noncopyable {
+    public:
+        ~TailSubscription();
+
+        /**
+         * Waits up to 'timeoutMillis' for the next entry.
+         *
+         * Like DBClientCursor::next(), the returned document refers to a buffer shared with
+         * the other subscribers and stays valid until the following call to next(), or until
+         * the subscription is released; use getOwned() to keep it longer.
+         *
+         * @return false on timeout, or once the queued entries are exhausted after an overrun
+         *         or after the TailManager was destroyed.
+         */
+        bool next(BSONObj* doc, int timeoutMillis);
+
+        /** True if this subscription fell too far behind and was detached. */
+        bool overrun() const;
+
+        /** Entries received but not yet returned by next(). */
+        size_t queued() const;
+
+    private:
+        friend class TailManager;
+        friend struct TailManager::Tail;
+
+        TailSubscription(const boost::shared_ptr<TailManager::Tail>& tail, size_t maxQueued);
+
+        const boost::shared_ptr<TailManager::Tail> _tail;
+        const size_t _maxQueued;
+
+        // Guarded by the tail's mutex
+        std::deque<boost::shared_ptr<const TailManager::Batch> > _batches;
+        size_t _queued;
+        bool _overrun;
+
+        // The batch next() is reading from
+        boost::shared_ptr<const TailManager::Batch> _current;
+        size_t _position;
+    };
+
+} // namespace mongo
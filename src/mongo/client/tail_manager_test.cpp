@@ -0,0 +1,145 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/tail_manager.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "mongo/client/connpool.h"
+#include "mongo/client/dbclientinterface.h"
+#include "mongo/dbtests/mock/mock_conn_registry.h"
+#include "mongo/dbtests/mock/mock_remote_db_server.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using boost::shared_ptr;
+    using mongo::BSONObj;
+    using mongo::BSONObjBuilder;
+    using mongo::ConnectionString;
+    using mongo::MockConnRegistry;
+    using mongo::MockRemoteDBServer;
+    using mongo::TailManager;
+    using mongo::TailSubscription;
+
+    const char kHost[] = "$tail:27017";
+    const char kNs[] = "test.capped";
+
+    // The mock server ignores the resume filter, so its tailable cursors deliver the whole
+    // collection over and over again.
+    class TailManagerTest : public mongo::unittest::Test {
+    protected:
+        void setUp() {
+            _server.reset(new MockRemoteDBServer(kHost));
+            MockConnRegistry::get()->addServer(_server.get());
+            ConnectionString::setConnectionHook(MockConnRegistry::get()->getConnStrHook());
+        }
+
+        void tearDown() {
+            mongo::ScopedDbConnection::clearPool();
+            MockConnRegistry::get()->removeServer(kHost);
+            _server.reset();
+        }
+
+        void insert(int n) {
+            for (int i = 0; i < n; i++)
+                _server->insert(kNs, BSON("_id" << i));
+        }
+
+        BSONObj info(const TailManager& tails) {
+            BSONObjBuilder b;
+            tails.appendInfo(b);
+            return b.obj();
+        }
+
+        boost::scoped_ptr<MockRemoteDBServer> _server;
+    };
+
+    TEST_F(TailManagerTest, SubscribersShareOneCursor) {
+        TailManager tails(kHost);
+        shared_ptr<TailSubscription> a = tails.subscribe(kNs, BSONObj());
+        shared_ptr<TailSubscription> b = tails.subscribe(kNs, BSONObj());
+        shared_ptr<TailSubscription> other = tails.subscribe(kNs, BSON("x" << 1));
+
+        const std::vector<mongo::BSONElement> cursors = info(tails)["tails"].Array();
+        ASSERT_EQUALS(2U, cursors.size());
+        ASSERT_EQUALS(3U, cursors[0]["subscribers"].Array().size() +
+                          cursors[1]["subscribers"].Array().size());
+
+        insert(3);
+
+        // Both see the same entries, in the same buffers
+        for (int i = 0; i < 10; i++) {
+            BSONObj fromA;
+            BSONObj fromB;
+            ASSERT_TRUE(a->next(&fromA, 10000));
+            ASSERT_TRUE(b->next(&fromB, 10000));
+            if (i == 0)
+                ASSERT_EQUALS(0, fromA["_id"].numberInt());
+            ASSERT_EQUALS(fromA.objdata(), fromB.objdata());
+        }
+    }
+
+    TEST_F(TailManagerTest, SlowSubscriberIsDetached) {
+        TailManager tails(kHost);
+        tails.setMaxQueuedDocuments(10);
+        shared_ptr<TailSubscription> slow = tails.subscribe(kNs, BSONObj());
+        tails.setMaxQueuedDocuments(10 * 1000 * 1000);
+        shared_ptr<TailSubscription> fast = tails.subscribe(kNs, BSONObj());
+
+        insert(3);
+
+        BSONObj doc;
+        while (!slow->overrun())
+            ASSERT_TRUE(fast->next(&doc, 10000));
+        ASSERT_FALSE(fast->overrun());
+
+        // What was queued before the overrun is still delivered
+        size_t drained = 0;
+        while (slow->next(&doc, 10000))
+            drained++;
+        ASSERT_LESS_THAN_OR_EQUALS(drained, 10U);
+        ASSERT_EQUALS(0U, slow->queued());
+
+        ASSERT_TRUE(fast->next(&doc, 10000));
+        ASSERT_EQUALS(1, info(tails)["tails"].Array()[0]["overruns"].numberInt());
+    }
+
+    TEST_F(TailManagerTest, SubscribersComeAndGo) {
+        insert(1);
+
+        shared_ptr<TailSubscription> survivor;
+        {
+            TailManager tails(kHost);
+            tails.subscribe(kNs, BSONObj()).reset();
+            ASSERT_EQUALS(0U, info(tails)["tails"].Array().size());
+
+            // A new subscriber restarts the tail
+            survivor = tails.subscribe(kNs, BSONObj());
+            BSONObj doc;
+            ASSERT_TRUE(survivor->next(&doc, 10000));
+            ASSERT_EQUALS(0, doc["_id"].numberInt());
+        }
+
+        // Once the manager is gone, only what was already queued is left
+        BSONObj doc;
+        while (survivor->next(&doc, 10000)) {}
+        ASSERT_FALSE(survivor->overrun());
+    }
+
+} // namespace
@@ -35,6 +35,10 @@ namespace mongo {
 
         virtual void appendSelfToBSONObj(BSONObjBuilder* obj) const;
 
+        const BSONObj& selector() const { return _selector; }
+        const BSONObj& update() const { return _update; }
+        int flags() const { return _flags; }
+
     private:
         const BSONObj _selector;
         const BSONObj _update;
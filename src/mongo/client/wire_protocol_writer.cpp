@@ -16,6 +16,7 @@
 #include "mongo/client/wire_protocol_writer.h"
 
 #include "mongo/client/dbclientinterface.h"
+#include "mongo/client/operation_trace.h"
 #include "mongo/client/write_result.h"
 #include "mongo/db/namespace_string.h"
 
@@ -31,6 +32,8 @@ namespace mongo {
         const WriteConcern* writeConcern,
         WriteResult* writeResult
     ) {
+        const OperationTrace::Scope trace("write", ns);
+
         // Effectively a map of batch relative indexes to WriteOperations
         std::vector<WriteOperation*> batchOps;
 
@@ -90,6 +93,11 @@ namespace mongo {
                 batch_iter = next;
             }
 
+            // The builder and the request copied from it are both held until the write is
+            // acknowledged, so account for them while the request is in flight.
+            const MemoryBudget::Charge inFlight(
+                _client->getMemoryBudget().get(), builder.getSize() + builder.len());
+
             // Issue the complete command.
             BSONObj batchResult = _send(batchOpType, builder, writeConcern, ns);
 
@@ -110,6 +110,12 @@ namespace mongo {
          * The index of this WriteOperation in the context of a larger bulk operation.
          */
         virtual size_t getBulkIndex() const = 0;
+
+        /**
+         * The operations this one replaces when several queued operations were coalesced into
+         * it, or NULL when it was queued as is.
+         */
+        virtual const std::vector<WriteOperation*>* coalescedFrom() const { return NULL; }
     };
 
 } // namespace mongo
@@ -0,0 +1,337 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/client/write_operation_queue.h"
+
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "mongo/bson/oid.h"
+#include "mongo/client/delete_write_operation.h"
+#include "mongo/client/insert_write_operation.h"
+#include "mongo/client/update_write_operation.h"
+#include "mongo/client/write_options.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/platform/unordered_map.h"
+#include "mongo/platform/unordered_set.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    namespace {
+
+        // Chunks start small so that single writes stay cheap, and double up to the maximum
+        const size_t kInitialChunkSize = 4 * 1024;
+        const size_t kMaxChunkSize = 1024 * 1024;
+
+        // Enough for any of the WriteOperation subclasses and the BSONObjs they hold
+        const size_t kAlignment = 2 * sizeof(void*);
+
+        // Type byte, "_id" and an OID
+        const int kIdElementSize = 1 + 4 + OID::kOIDSize;
+
+        inline size_t align(size_t size) {
+            return (size + kAlignment - 1) & ~(kAlignment - 1);
+        }
+
+        // Upper bound on the values folded into one $in selector
+        const size_t kMaxCoalescedValues = 1000;
+
+        inline bool compare(WriteOperation* const lhs, WriteOperation* const rhs) {
+            return lhs->operationType() > rhs->operationType();
+        }
+
+        class CoalescedUpdateWriteOperation : public UpdateWriteOperation {
+        public:
+            CoalescedUpdateWriteOperation(const BSONObj& selector,
+                                          const BSONObj& update,
+                                          const std::vector<WriteOperation*>& from)
+                : UpdateWriteOperation(selector, update, UpdateOption_Multi)
+                , _from(from)
+            {}
+
+            virtual const std::vector<WriteOperation*>* coalescedFrom() const {
+                return &_from;
+            }
+
+        private:
+            const std::vector<WriteOperation*> _from;
+        };
+
+        bool coalescable(const UpdateWriteOperation* op) {
+            if (op->flags() & UpdateOption_Upsert)
+                return false;
+
+            if (op->update().isEmpty() || op->update().firstElementFieldName()[0] != '$')
+                return false;
+
+            if (op->selector().nFields() != 1)
+                return false;
+
+            const BSONElement e = op->selector().firstElement();
+            if (e.fieldName()[0] == '$')
+                return false;
+
+            if (!(op->flags() & UpdateOption_Multi) &&
+                    !mongoutils::str::equals(e.fieldName(), "_id"))
+                return false;
+
+            // These don't mean plain equality, inside an $in or otherwise
+            switch (e.type()) {
+            case Object:
+            case Array:
+            case RegEx:
+            case Undefined:
+            case jstNULL:
+                return false;
+            default:
+                return true;
+            }
+        }
+
+        // Equal values get equal keys; numbers of different types can be equal
+        std::string valueKey(const BSONElement& e) {
+            if (e.isNumber()) {
+                const double d = e.numberDouble();
+                return std::string(1, 'n')
+                    + std::string(reinterpret_cast<const char*>(&d), sizeof(d));
+            }
+            return std::string(1, static_cast<char>(e.type()))
+                + std::string(e.value(), e.valuesize());
+        }
+
+        std::string groupKey(const UpdateWriteOperation* op) {
+            const int flags = op->flags();
+            return std::string(reinterpret_cast<const char*>(&flags), sizeof(flags))
+                + op->selector().firstElementFieldName() + '\0'
+                + std::string(op->update().objdata(), op->update().objsize());
+        }
+
+    } // namespace
+
+    WriteOperationQueue::WriteOperationQueue(bool copyDocuments)
+        : _copyDocuments(copyDocuments)
+        , _next(NULL)
+        , _end(NULL)
+        , _chunkSize(kInitialChunkSize)
+        , _arenaBytes(0)
+        , _sharedIndex(NULL)
+    {}
+
+    WriteOperationQueue::~WriteOperationQueue() {
+        for (size_t i = 0; i < _operations.size(); i++)
+            _operations[i]->~WriteOperation();
+
+        for (size_t i = 0; i < _replaced.size(); i++)
+            _replaced[i]->~WriteOperation();
+
+        for (size_t i = 0; i < _chunks.size(); i++)
+            std::free(_chunks[i]);
+    }
+
+    void* WriteOperationQueue::_allocate(size_t size) {
+        size = align(size);
+
+        if (static_cast<size_t>(_end - _next) >= size) {
+            char* const allocated = _next;
+            _next += size;
+            return allocated;
+        }
+
+        // Large documents get a chunk of their own, leaving the current one in use
+        if (size > _chunkSize / 4) {
+            char* const chunk = static_cast<char*>(std::malloc(size));
+            if (chunk == NULL)
+                msgasserted(17407, "out of memory allocating write operation arena");
+            _chunks.push_back(chunk);
+            _arenaBytes += size;
+            return chunk;
+        }
+
+        char* const chunk = static_cast<char*>(std::malloc(_chunkSize));
+        if (chunk == NULL)
+            msgasserted(17407, "out of memory allocating write operation arena");
+        _chunks.push_back(chunk);
+        _arenaBytes += _chunkSize;
+
+        _next = chunk + size;
+        _end = chunk + _chunkSize;
+        _chunkSize = std::min(_chunkSize * 2, kMaxChunkSize);
+        return chunk;
+    }
+
+    BSONObj WriteOperationQueue::_store(const BSONObj& obj) {
+        return _copyDocuments ? _copy(obj) : BSONObj(obj.objdata());
+    }
+
+    BSONObj WriteOperationQueue::_copy(const BSONObj& obj) {
+        char* const copy = static_cast<char*>(_allocate(obj.objsize()));
+        std::memcpy(copy, obj.objdata(), obj.objsize());
+        return BSONObj(copy);
+    }
+
+    void WriteOperationQueue::_push(WriteOperation* operation) {
+        operation->setBulkIndex(_sharedIndex ? (*_sharedIndex)++ : _operations.size());
+        _operations.push_back(operation);
+    }
+
+    void WriteOperationQueue::insert(const BSONObj& doc) {
+        BSONObj stored;
+
+        if (doc.hasField("_id")) {
+            stored = _store(doc);
+        }
+        else {
+            // Lay the document down once with a generated _id in front, as
+            // InsertWriteOperation would otherwise build a separate copy to add it
+            const int size = doc.objsize() + kIdElementSize;
+            char* const data = static_cast<char*>(_allocate(size));
+            char* p = data;
+
+            std::memcpy(p, &size, sizeof(size));
+            p += sizeof(size);
+            *p++ = static_cast<char>(jstOID);
+            std::memcpy(p, "_id", 4);
+            p += 4;
+            const OID id = OID::gen();
+            std::memcpy(p, id.getData(), OID::kOIDSize);
+            p += OID::kOIDSize;
+            std::memcpy(p, doc.objdata() + sizeof(int), doc.objsize() - sizeof(int));
+
+            stored = BSONObj(data);
+        }
+
+        _push(new (_allocate(sizeof(InsertWriteOperation))) InsertWriteOperation(stored));
+    }
+
+    void WriteOperationQueue::update(const BSONObj& selector, const BSONObj& update, int flags) {
+        const BSONObj storedSelector = _store(selector);
+        const BSONObj storedUpdate = _store(update);
+        _push(new (_allocate(sizeof(UpdateWriteOperation)))
+              UpdateWriteOperation(storedSelector, storedUpdate, flags));
+    }
+
+    void WriteOperationQueue::remove(const BSONObj& selector, int flags) {
+        const BSONObj storedSelector = _store(selector);
+        _push(new (_allocate(sizeof(DeleteWriteOperation)))
+              DeleteWriteOperation(storedSelector, flags));
+    }
+
+    void WriteOperationQueue::shareBulkIndexes(size_t* next) {
+        _sharedIndex = next;
+    }
+
+    void WriteOperationQueue::groupByType() {
+        std::stable_sort(_operations.begin(), _operations.end(), compare);
+    }
+
+    size_t WriteOperationQueue::coalesceUpdates(int maxSelectorSize) {
+        struct Group {
+            Group() : bytes(0) {}
+            std::vector<WriteOperation*> members;
+            unordered_set<std::string> values;
+            int bytes;
+        };
+
+        std::vector<boost::shared_ptr<Group> > groups;
+        unordered_map<std::string, size_t> openGroups;
+
+        // Group each operation belongs to, or -1
+        std::vector<int> groupOf(_operations.size(), -1);
+
+        for (size_t i = 0; i < _operations.size(); i++) {
+            if (_operations[i]->operationType() != dbWriteUpdate)
+                continue;
+
+            const UpdateWriteOperation* const op =
+                static_cast<const UpdateWriteOperation*>(_operations[i]);
+            if (!coalescable(op))
+                continue;
+
+            const BSONElement value = op->selector().firstElement();
+            const std::string key = groupKey(op);
+
+            unordered_map<std::string, size_t>::iterator open = openGroups.find(key);
+            if (open != openGroups.end()) {
+                const Group& group = *groups[open->second];
+                if (group.members.size() >= kMaxCoalescedValues ||
+                        group.bytes + value.size() > maxSelectorSize)
+                    openGroups.erase(open);
+            }
+
+            open = openGroups.find(key);
+            if (open == openGroups.end()) {
+                open = openGroups.insert(std::make_pair(key, groups.size())).first;
+                groups.push_back(boost::shared_ptr<Group>(new Group));
+            }
+
+            Group& group = *groups[open->second];
+            if (!group.values.insert(valueKey(value)).second)
+                continue;
+
+            group.members.push_back(_operations[i]);
+            group.bytes += value.size();
+            groupOf[i] = open->second;
+        }
+
+        std::vector<WriteOperation*> operations;
+        size_t replaced = 0;
+
+        for (size_t i = 0; i < _operations.size(); i++) {
+            if (groupOf[i] < 0 || groups[groupOf[i]]->members.size() < 2) {
+                operations.push_back(_operations[i]);
+                continue;
+            }
+
+            const Group& group = *groups[groupOf[i]];
+            _replaced.push_back(_operations[i]);
+            replaced++;
+
+            // The coalesced operation takes the place of the group's first member
+            if (group.members.front() != _operations[i])
+                continue;
+
+            const UpdateWriteOperation* const first =
+                static_cast<const UpdateWriteOperation*>(group.members.front());
+
+            BSONObjBuilder selector;
+            {
+                BSONObjBuilder field(
+                    selector.subobjStart(first->selector().firstElementFieldName()));
+                BSONArrayBuilder in(field.subarrayStart("$in"));
+                for (size_t j = 0; j < group.members.size(); j++)
+                    in.append(static_cast<const UpdateWriteOperation*>(group.members[j])
+                              ->selector().firstElement());
+            }
+
+            WriteOperation* const coalesced =
+                new (_allocate(sizeof(CoalescedUpdateWriteOperation)))
+                CoalescedUpdateWriteOperation(
+                    _copy(selector.obj()), first->update(), group.members);
+            coalesced->setBulkIndex(first->getBulkIndex());
+            operations.push_back(coalesced);
+        }
+
+        _operations.swap(operations);
+        return replaced;
+    }
+
+} // namespace mongo
@@ -0,0 +1,104 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/client/write_operation.h"
+
+namespace mongo {
+
+    /**
+     * An append-only sequence of WriteOperations, as handed to a DBClientWriter.
+     *
+     * The operations and the documents they describe live in a chunked arena owned by the
+     * queue rather than in one heap allocation (plus a reference to a shared buffer) per
+     * operation, so queueing millions of writes costs a handful of allocations, and the
+     * writers walk memory that was laid down in order.
+     *
+     * A queue that copies documents may outlive the BSONObjs it was given; one constructed
+     * with copyDocuments false only refers to them, so they must outlive the queue. Inserted
+     * documents without an _id are always built in the arena with a generated one.
+     */
+    class WriteOperationQueue : boost::noncopyable {
+    public:
+        explicit WriteOperationQueue(bool copyDocuments = true);
+        ~WriteOperationQueue();
+
+        void insert(const BSONObj& doc);
+        void update(const BSONObj& selector, const BSONObj& update, int flags);
+        void remove(const BSONObj& selector, int flags);
+
+        /**
+         * Numbers the operations queued from now on '*next', '*next' + 1, ... instead of by
+         * their position in this queue, so that queues filled in turn share one sequence of
+         * bulk indexes. 'next' must outlive the queueing.
+         */
+        void shareBulkIndexes(size_t* next);
+
+        /**
+         * Groups the operations by type, keeping the relative order of operations of the same
+         * type. Bulk indexes are those of the original order.
+         */
+        void groupByType();
+
+        /**
+         * Rewrites non-upsert updates that apply the same modifier document to different
+         * values of the same field into multi-updates with an $in selector. Only valid for
+         * unordered execution.
+         *
+         * Single document updates qualify only when selecting on _id, as that is what makes
+         * them equivalent to a multi-update. A value repeated under the same update stays a
+         * separate operation so that it is still applied twice. Each $in holds at most 1000
+         * values and 'maxSelectorSize' bytes.
+         *
+         * Returns the number of operations that were replaced.
+         */
+        size_t coalesceUpdates(int maxSelectorSize);
+
+        const std::vector<WriteOperation*>& operations() const { return _operations; }
+
+        bool empty() const { return _operations.empty(); }
+        size_t size() const { return _operations.size(); }
+
+        /** Bytes allocated for the arena. */
+        size_t arenaBytes() const { return _arenaBytes; }
+
+    private:
+        void* _allocate(size_t size);
+        BSONObj _copy(const BSONObj& obj);
+        BSONObj _store(const BSONObj& obj);
+        void _push(WriteOperation* operation);
+
+        const bool _copyDocuments;
+
+        std::vector<char*> _chunks;
+        char* _next;
+        char* _end;
+        size_t _chunkSize;
+        size_t _arenaBytes;
+
+        size_t* _sharedIndex; // NULL unless shareBulkIndexes was called
+
+        std::vector<WriteOperation*> _operations;
+
+        // Operations replaced by coalesceUpdates, kept for the coalesced ones to refer to
+        std::vector<WriteOperation*> _replaced;
+    };
+
+} // namespace mongo
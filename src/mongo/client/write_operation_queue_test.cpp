@@ -0,0 +1,190 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <string>
+
+#include "mongo/client/write_operation_queue.h"
+#include "mongo/client/write_options.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using mongo::BSONObj;
+    using mongo::BSONObjBuilder;
+    using mongo::WriteOperation;
+    using mongo::WriteOperationQueue;
+    using std::string;
+
+    BSONObj describe(const WriteOperation* operation) {
+        BSONObjBuilder b;
+        operation->appendSelfToBSONObj(&b);
+        return b.obj();
+    }
+
+    TEST(WriteOperationQueueTest, GroupByTypeIsStable) {
+        WriteOperationQueue queue;
+        queue.insert(BSON("_id" << 0));
+        queue.update(BSON("_id" << 1), BSON("$set" << BSON("x" << 1)), 0);
+        queue.insert(BSON("_id" << 2));
+        queue.remove(BSON("_id" << 3), 0);
+        queue.insert(BSON("_id" << 4));
+        queue.update(BSON("_id" << 5), BSON("$set" << BSON("x" << 1)), 0);
+
+        queue.groupByType();
+
+        const size_t expected[] = { 3, 0, 2, 4, 1, 5 };
+        ASSERT_EQUALS(6U, queue.size());
+        for (size_t i = 0; i < queue.size(); i++)
+            ASSERT_EQUALS(expected[i], queue.operations()[i]->getBulkIndex());
+    }
+
+    TEST(WriteOperationQueueTest, CopiesDocuments) {
+        WriteOperationQueue queue;
+        {
+            BSONObjBuilder selector;
+            selector.append("_id", 1);
+            BSONObjBuilder update;
+            update.append("$inc", BSON("n" << 1));
+            queue.update(selector.obj(), update.obj(), mongo::UpdateOption_Upsert);
+        }
+
+        const BSONObj described = describe(queue.operations()[0]);
+        ASSERT_EQUALS(BSON("_id" << 1), described["q"].Obj());
+        ASSERT_EQUALS(BSON("$inc" << BSON("n" << 1)), described["u"].Obj());
+        ASSERT_TRUE(described["upsert"].trueValue());
+    }
+
+    TEST(WriteOperationQueueTest, GeneratesIdInArena) {
+        WriteOperationQueue queue(false);
+        queue.insert(BSON("a" << 1 << "b" << "two"));
+
+        const BSONObj doc = describe(queue.operations()[0]);
+        ASSERT_EQUALS(3, doc.nFields());
+        ASSERT_EQUALS(string("_id"), doc.firstElementFieldName());
+        ASSERT_EQUALS(mongo::jstOID, doc.firstElement().type());
+        ASSERT_EQUALS(1, doc["a"].numberInt());
+        ASSERT_EQUALS("two", doc["b"].String());
+        ASSERT_EQUALS(doc.objsize(), queue.operations()[0]->incrementalSize());
+    }
+
+    TEST(WriteOperationQueueTest, ReferencesDocumentsWhenNotCopying) {
+        const BSONObj doc = BSON("_id" << 1 << "payload" << string(64 * 1024, 'x'));
+
+        WriteOperationQueue referencing(false);
+        referencing.insert(doc);
+        WriteOperationQueue copying;
+        copying.insert(doc);
+
+        ASSERT_LESS_THAN(referencing.arenaBytes(), static_cast<size_t>(doc.objsize()));
+        ASSERT_GREATER_THAN_OR_EQUALS(copying.arenaBytes(), static_cast<size_t>(doc.objsize()));
+        ASSERT_EQUALS(doc, describe(copying.operations()[0]));
+    }
+
+    TEST(WriteOperationQueueTest, ManyOperations) {
+        WriteOperationQueue queue;
+        for (int i = 0; i < 100000; i++) {
+            if (i % 1000 == 0)
+                queue.insert(BSON("_id" << i << "big" << string(16 * 1024, 'y')));
+            else
+                queue.insert(BSON("_id" << i));
+        }
+
+        ASSERT_EQUALS(100000U, queue.size());
+        for (size_t i = 0; i < queue.size(); i++) {
+            ASSERT_EQUALS(i, queue.operations()[i]->getBulkIndex());
+            ASSERT_EQUALS(static_cast<int>(i), describe(queue.operations()[i])["_id"].numberInt());
+        }
+    }
+
+    TEST(WriteOperationQueueTest, CoalescesUpdatesById) {
+        const BSONObj done = BSON("$set" << BSON("status" << "done"));
+
+        WriteOperationQueue queue;
+        queue.update(BSON("_id" << 1), done, 0);
+        queue.insert(BSON("_id" << 100));
+        queue.update(BSON("_id" << 2), done, 0);
+        queue.update(BSON("_id" << 3), BSON("$set" << BSON("status" << "failed")), 0);
+        queue.update(BSON("_id" << 3LL), done, 0);
+
+        ASSERT_EQUALS(3U, queue.coalesceUpdates(16 * 1024 * 1024));
+        ASSERT_EQUALS(3U, queue.size());
+
+        // The coalesced update takes the place and bulk index of the first one
+        const WriteOperation* coalesced = queue.operations()[0];
+        ASSERT_EQUALS(0U, coalesced->getBulkIndex());
+        ASSERT_EQUALS(3U, coalesced->coalescedFrom()->size());
+        ASSERT_EQUALS(2U, (*coalesced->coalescedFrom())[1]->getBulkIndex());
+
+        const BSONObj described = describe(coalesced);
+        ASSERT_EQUALS(BSON("_id" << BSON("$in" << BSON_ARRAY(1 << 2 << 3LL))),
+                      described["q"].Obj());
+        ASSERT_EQUALS(done, described["u"].Obj());
+        ASSERT_TRUE(described["multi"].trueValue());
+
+        ASSERT_EQUALS(1U, queue.operations()[1]->getBulkIndex());
+        ASSERT_EQUALS(3U, queue.operations()[2]->getBulkIndex());
+        ASSERT_TRUE(queue.operations()[2]->coalescedFrom() == NULL);
+    }
+
+    TEST(WriteOperationQueueTest, CoalescesOnlyEquivalentUpdates) {
+        const BSONObj inc = BSON("$inc" << BSON("n" << 1));
+
+        WriteOperationQueue queue;
+
+        // Single document updates on other fields could match more documents as a multi
+        queue.update(BSON("a" << 1), inc, 0);
+        queue.update(BSON("a" << 2), inc, 0);
+
+        // Upserts, replacements, operators and non equality values are left alone
+        queue.update(BSON("_id" << 1), inc, mongo::UpdateOption_Upsert);
+        queue.update(BSON("_id" << 2), inc, mongo::UpdateOption_Upsert);
+        queue.update(BSON("_id" << 3), BSON("n" << 1), 0);
+        queue.update(BSON("_id" << 4), BSON("n" << 1), 0);
+        queue.update(BSON("_id" << BSON("$gt" << 5)), inc, 0);
+        queue.update(BSON("_id" << BSON("$gt" << 6)), inc, 0);
+
+        // Repeating a value must still apply the update twice
+        queue.update(BSON("b" << 1), inc, mongo::UpdateOption_Multi);
+        queue.update(BSON("b" << 1.0), inc, mongo::UpdateOption_Multi);
+
+        ASSERT_EQUALS(0U, queue.coalesceUpdates(16 * 1024 * 1024));
+        ASSERT_EQUALS(10U, queue.size());
+    }
+
+    TEST(WriteOperationQueueTest, CoalescedSelectorsAreBounded) {
+        const BSONObj done = BSON("$set" << BSON("status" << "done"));
+
+        WriteOperationQueue queue;
+        for (int i = 0; i < 2500; i++)
+            queue.update(BSON("_id" << i), done, 0);
+
+        ASSERT_EQUALS(2500U, queue.coalesceUpdates(16 * 1024 * 1024));
+        ASSERT_EQUALS(3U, queue.size());
+        ASSERT_EQUALS(1000U, queue.operations()[0]->coalescedFrom()->size());
+        ASSERT_EQUALS(500U, queue.operations()[2]->coalescedFrom()->size());
+
+        WriteOperationQueue small;
+        for (int i = 0; i < 10; i++)
+            small.update(BSON("_id" << i), done, 0);
+
+        // Each int _id element takes 9 bytes
+        ASSERT_EQUALS(10U, small.coalesceUpdates(36));
+        ASSERT_EQUALS(3U, small.size());
+    }
+
+} // namespace
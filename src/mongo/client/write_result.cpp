@@ -17,6 +17,8 @@
 
 #include "mongo/client/write_result.h"
 
+#include <algorithm>
+
 #include "mongo/client/exceptions.h"
 #include "mongo/client/write_operation.h"
 #include "mongo/db/jsobj.h"
@@ -27,6 +29,10 @@ namespace mongo {
     namespace {
         const int kUnknownError = 8;
         const int kWriteConcernErrorCode = 64;
+
+        bool lowerIndex(const BSONObj& lhs, const BSONObj& rhs) {
+            return lhs["index"].numberLong() < rhs["index"].numberLong();
+        }
     } // namespace
 
     WriteResult::WriteResult()
@@ -135,6 +141,27 @@ namespace mongo {
         }
     }
 
+    void WriteResult::_mergeWriteResult(const WriteResult& other) {
+        _nInserted += other._nInserted;
+        _nUpserted += other._nUpserted;
+        _nMatched += other._nMatched;
+        _nModified += other._nModified;
+        _nRemoved += other._nRemoved;
+        _hasModifiedCount = _hasModifiedCount && other._hasModifiedCount;
+
+        _upserted.insert(_upserted.end(), other._upserted.begin(), other._upserted.end());
+        _writeErrors.insert(_writeErrors.end(),
+                            other._writeErrors.begin(), other._writeErrors.end());
+        _writeConcernErrors.insert(_writeConcernErrors.end(),
+                                   other._writeConcernErrors.begin(),
+                                   other._writeConcernErrors.end());
+    }
+
+    void WriteResult::_sortByIndex() {
+        std::stable_sort(_upserted.begin(), _upserted.end(), lowerIndex);
+        std::stable_sort(_writeErrors.begin(), _writeErrors.end(), lowerIndex);
+    }
+
     void WriteResult::_mergeGleResult(
         const std::vector<WriteOperation*>& ops,
         const BSONObj& result
@@ -267,15 +294,29 @@ namespace mongo {
 
     void WriteResult::_createWriteError(const BSONObj& error, const std::vector<WriteOperation*>& ops) {
         int batchIndex = _getIntOrDefault(error, "index");
+
+        // There's no telling which of the operations coalesced into a failed one were applied,
+        // so the error is reported for each of them.
+        const std::vector<WriteOperation*>* coalesced = ops[batchIndex]->coalescedFrom();
+        if (coalesced) {
+            for (size_t i = 0; i < coalesced->size(); i++)
+                _createWriteError(error, (*coalesced)[i]);
+        }
+        else {
+            _createWriteError(error, ops[batchIndex]);
+        }
+    }
+
+    void WriteResult::_createWriteError(const BSONObj& error, const WriteOperation* op) {
         int code = _getIntOrDefault(error, "code", kUnknownError);
 
         BSONObjBuilder bob;
-        bob.append("index", static_cast<long long>(ops[batchIndex]->getBulkIndex()));
+        bob.append("index", static_cast<long long>(op->getBulkIndex()));
         bob.append("code", code);
         bob.append("errmsg", error.getStringField("errmsg"));
 
         BSONObjBuilder builder;
-        ops[batchIndex]->appendSelfToBSONObj(&builder);
+        op->appendSelfToBSONObj(&builder);
         bob.append("op", builder.obj());
 
         if (error.hasField("errInfo"))
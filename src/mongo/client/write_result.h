@@ -35,6 +35,7 @@ namespace mongo {
         friend class WireProtocolWriter;
         friend class CommandWriter;
         friend class BulkOperationBuilder;
+        friend class MultiBulkOperationBuilder;
 
     public:
 
@@ -144,6 +145,8 @@ namespace mongo {
     private:
         void _mergeCommandResult(const std::vector<WriteOperation*>& ops, const BSONObj& result);
         void _mergeGleResult(const std::vector<WriteOperation*>& ops, const BSONObj& result);
+        void _mergeWriteResult(const WriteResult& other);
+        void _sortByIndex();
 
         void _check(bool throwSoftErrors);
         void _setModified(const BSONObj& result);
@@ -152,6 +155,7 @@ namespace mongo {
         int _createUpserts(const BSONElement& upsert, const std::vector<WriteOperation*>& ops);
         void _createUpsert(const BSONElement& upsert, const std::vector<WriteOperation*>& ops);
         void _createWriteError(const BSONObj& error, const std::vector<WriteOperation*>& ops);
+        void _createWriteError(const BSONObj& error, const WriteOperation* op);
         void _createWriteConcernError(const BSONObj& error);
 
         int _nInserted;
@@ -33,6 +33,7 @@ namespace mongo {
             _isFailed(false),
             _sockCreationTime(mongo::curTimeMicros64()),
             _autoReconnect(autoReconnect) {
+        setWireVersions(remoteServer->getMinWireVersion(), remoteServer->getMaxWireVersion());
     }
 
     MockDBClientConnection::~MockDBClientConnection() {
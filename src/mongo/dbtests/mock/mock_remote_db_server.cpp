@@ -52,6 +52,8 @@ namespace mongo {
             _isRunning(true),
             _hostAndPort(hostAndPort),
             _delayMilliSec(0),
+            _minWireVersion(0),
+            _maxWireVersion(0),
             _cmdCount(0),
             _queryCount(0),
             _instanceID(0),
@@ -67,6 +69,12 @@ namespace mongo {
         _delayMilliSec = milliSec;
     }
 
+    void MockRemoteDBServer::setWireVersions(int minWireVersion, int maxWireVersion) {
+        boost::lock_guard<boost::mutex> sLock(_lock);
+        _minWireVersion = minWireVersion;
+        _maxWireVersion = maxWireVersion;
+    }
+
     void MockRemoteDBServer::shutdown() {
         boost::lock_guard<boost::mutex> sLock(_lock);
         _isRunning = false;
@@ -200,6 +208,16 @@ namespace mongo {
         return mongo::ConnectionString::CUSTOM;
     }
 
+    int MockRemoteDBServer::getMinWireVersion() const {
+        boost::lock_guard<boost::mutex> sLock(_lock);
+        return _minWireVersion;
+    }
+
+    int MockRemoteDBServer::getMaxWireVersion() const {
+        boost::lock_guard<boost::mutex> sLock(_lock);
+        return _maxWireVersion;
+    }
+
     size_t MockRemoteDBServer::getCmdCount() const {
         boost::lock_guard<boost::mutex> sLock(_lock);
         return _cmdCount;
@@ -75,6 +75,12 @@ namespace mongo {
          */
         void setDelay(long long milliSec);
 
+        /**
+         * Sets the wire versions connections to this server report, 0 and 0 by default.
+         * A max of 2 or more has bulk writes use write commands.
+         */
+        void setWireVersions(int minWireVersion, int maxWireVersion);
+
         /**
          * Shuts down this server. Any operations on this server with an InstanceID
          * less than or equal to the current one will throw a mongo::SocketException.
@@ -158,6 +164,8 @@ namespace mongo {
         InstanceID getInstanceID() const;
         mongo::ConnectionString::ConnectionType type() const;
         double getSoTimeout() const;
+        int getMinWireVersion() const;
+        int getMaxWireVersion() const;
 
         /**
          * @return the exact string address passed to hostAndPort parameter of the
@@ -206,6 +214,8 @@ namespace mongo {
 
         const std::string _hostAndPort;
         long long _delayMilliSec;
+        int _minWireVersion;
+        int _maxWireVersion;
 
         //
         // Mock replies
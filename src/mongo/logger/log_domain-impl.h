@@ -16,10 +16,14 @@
 #pragma once
 
 #include <algorithm>
+#include <boost/thread/locks.hpp>
 #include <cstdlib>
+#include <sstream>
 
 #include "mongo/base/status.h"
 #include "mongo/logger/message_log_domain.h"
+#include "mongo/util/concurrency/thread_name.h"
+#include "mongo/util/time_support.h"
 
 /*
  * Implementation of LogDomain<E>.  Include this in cpp files to instantiate new LogDomain types.
@@ -31,7 +35,10 @@ namespace logger {
 
     template <typename E>
         LogDomain<E>::LogDomain() 
-        : _minimumLoggedSeverity(LogSeverity::Log()), _abortOnFailure(false) 
+        : _minimumLoggedSeverity(LogSeverity::Log().toInt()),
+          _abortOnFailure(false),
+          _maxMessagesPerCallSite(0),
+          _rateLimitPeriodMillis(0)
     {}
 
     template <typename E>
@@ -57,6 +64,37 @@ namespace logger {
         return Status::OK();
     }
 
+    template <typename E>
+    bool LogDomain<E>::_admit(const char* callSite) {
+        const unsigned long long now = curTimeMillis64();
+        long long suppressed = 0;
+        {
+            boost::lock_guard<boost::mutex> lk(_callSitesMutex);
+            CallSite& site = _callSites[callSite];
+
+            if (now - site.periodStart >= static_cast<unsigned long long>(_rateLimitPeriodMillis)) {
+                site.periodStart = now;
+                site.messages = 0;
+                suppressed = site.suppressed;
+                site.suppressed = 0;
+            }
+
+            if (site.messages >= _maxMessagesPerCallSite) {
+                site.suppressed++;
+                return false;
+            }
+            site.messages++;
+        }
+
+        if (suppressed > 0) {
+            std::ostringstream message;
+            message << "suppressed " << suppressed << " similar messages from " << callSite;
+            const std::string text = message.str();
+            append(E(now, LogSeverity::Log(), getThreadName(), text));
+        }
+        return true;
+    }
+
     template <typename E>
     typename LogDomain<E>::AppenderHandle LogDomain<E>::attachAppender(
             typename LogDomain<E>::AppenderAutoPtr appender) {
@@ -16,6 +16,7 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #include <memory>
 #include <string>
 #include <vector>
@@ -23,6 +24,8 @@
 #include "mongo/base/disallow_copying.h"
 #include "mongo/logger/appender.h"
 #include "mongo/logger/log_severity.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/platform/unordered_map.h"
 
 namespace mongo {
 namespace logger {
@@ -86,18 +89,35 @@ namespace logger {
         /**
          * Predicate that answers the question, "Should I, the caller, append to you, the log
          * domain, messages of the given severity?"  True means yes.
+         *
+         * This is on the path of every disabled LOG(n), so it is a single relaxed load.
+         */
+        bool shouldLog(LogSeverity severity) {
+            return severity.toInt() <= _minimumLoggedSeverity.loadRelaxed();
+        }
+
+        /**
+         * Like shouldLog(severity), also counting the message against the rate limit of its call
+         * site when the answer is yes. The call site is identified by the address of
+         * "callSite", which must be a string literal, like the "file:line" MONGO_LOG passes.
          */
-        bool shouldLog(LogSeverity severity) { return severity >= _minimumLoggedSeverity; }
+        bool shouldLog(LogSeverity severity, const char* callSite) {
+            return shouldLog(severity) && (_maxMessagesPerCallSite == 0 || _admit(callSite));
+        }
 
         /**
          * Gets the minimum severity of messages that should be sent to this LogDomain.
          */
-        LogSeverity getMinimumLogSeverity() { return _minimumLoggedSeverity; }
+        LogSeverity getMinimumLogSeverity() {
+            return LogSeverity::cast(_minimumLoggedSeverity.loadRelaxed());
+        }
 
         /**
          * Sets the minimum severity of messages that should be sent to this LogDomain.
          */
-        void setMinimumLoggedSeverity(LogSeverity severity) { _minimumLoggedSeverity = severity; }
+        void setMinimumLoggedSeverity(LogSeverity severity) {
+            _minimumLoggedSeverity.store(severity.toInt());
+        }
 
         /**
          * Gets the state of the abortOnFailure flag.
@@ -109,6 +129,20 @@ namespace logger {
          */
         void setAbortOnFailure(bool abortOnFailure) { _abortOnFailure = abortOnFailure; }
 
+        /**
+         * Limits the messages logged from any one call site of MONGO_LOG to "maxMessages" every
+         * "periodMillis", so that a message repeated in a storm doesn't cost formatting and
+         * appending each time. The others are dropped before being formatted, and counted: the
+         * first message let through from the call site in a later period is preceded by one
+         * saying how many were suppressed. 0 messages, the default, for no limit.
+         *
+         * Must be synchronized with calls to "append", like the configuration methods below.
+         */
+        void setCallSiteRateLimit(int maxMessages, int periodMillis) {
+            _maxMessagesPerCallSite = maxMessages;
+            _rateLimitPeriodMillis = periodMillis;
+        }
+
         //
         // Configuration methods.  Must be synchronized with each other and calls to "append" by the
         // caller.
@@ -135,9 +169,30 @@ namespace logger {
     private:
         typedef std::vector<EventAppender*> AppenderVector;
 
-        LogSeverity _minimumLoggedSeverity;
+        // The messages of a call site in its current period
+        struct CallSite {
+            CallSite() : periodStart(0), messages(0), suppressed(0) {}
+
+            unsigned long long periodStart;
+            int messages;
+            long long suppressed;
+        };
+
+        typedef unordered_map<const char*, CallSite> CallSiteMap;
+
+        // Whether a message from "callSite" fits in its rate limit
+        bool _admit(const char* callSite);
+
+        // The LogSeverity::toInt() of the minimum severity, which may be changed while other
+        // threads are logging
+        AtomicInt32 _minimumLoggedSeverity;
         AppenderVector _appenders;
         bool _abortOnFailure;
+
+        int _maxMessagesPerCallSite;
+        int _rateLimitPeriodMillis;
+        boost::mutex _callSitesMutex;
+        CallSiteMap _callSites;
     };
 
 }  // namespace logger
@@ -28,6 +28,7 @@
 #include "mongo/unittest/unittest.h"
 #include "mongo/util/concurrency/thread_name.h"
 #include "mongo/util/log.h"
+#include "mongo/util/time_support.h"
 
 using namespace mongo::logger;
 
@@ -134,6 +135,40 @@ namespace {
         ASSERT_EQUALS(std::string("Logging A() -- Golly! -- done!\n"), _logLines[1]);
     }
 
+    int formatted = 0;
+
+    std::string formatting() {
+        ++formatted;
+        return "storm";
+    }
+
+    void logStorm(int messages) {
+        for (int i = 0; i < messages; i++)
+            LOG(0) << formatting();
+    }
+
+    TEST_F(LogTest, CallSiteRateLimit) {
+        globalLogDomain()->setCallSiteRateLimit(2, 50);
+        formatted = 0;
+
+        logStorm(5);
+        ASSERT_EQUALS(2U, _logLines.size());
+        ASSERT_EQUALS(2, formatted);
+
+        // Other call sites have limits of their own
+        LOG(0) << "elsewhere";
+        ASSERT_EQUALS(3U, _logLines.size());
+
+        sleepmillis(60);
+        logStorm(1);
+        globalLogDomain()->setCallSiteRateLimit(0, 0);
+
+        ASSERT_EQUALS(5U, _logLines.size());
+        ASSERT_NOT_EQUALS(_logLines[3].find("suppressed 3 similar messages from "),
+                          std::string::npos);
+        ASSERT_EQUALS(std::string("storm\n"), _logLines[4]);
+    }
+
     //
     // Instantiating this object is a basic test of static-initializer-time logging.
     //
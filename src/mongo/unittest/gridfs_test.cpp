@@ -20,6 +20,7 @@
 
 #include "mongo/unittest/integration_test.h"
 #include "mongo/client/dbclient.h"
+#include "mongo/util/md5.hpp"
 
 using boost::scoped_ptr;
 using std::auto_ptr;
@@ -245,4 +246,73 @@ namespace {
         ASSERT_EQUALS(gf.getNumChunks(), DATA_LEN);
     }
 
+    TEST_F(GridFSTest, DeduplicatedFileReadsBack) {
+        const char repetitive[] = "abcdabcdabcdxy";
+        const int repetitive_len = sizeof(repetitive) - 1;
+        _gfs->setChunkSize(4);
+        _gfs->setDeduplicateChunks(true);
+        BSONObj result = _gfs->storeFile(repetitive, repetitive_len, DATA_NAME);
+
+        // "abcd" is stored once for its three chunks
+        ASSERT_EQUALS(_conn->count(TEST_DB + ".fs.blobs"), 2U);
+        ASSERT_EQUALS(result["md5"].String(), md5simpledigest(repetitive, repetitive_len));
+
+        GridFile gf = _gfs->findFileByName(DATA_NAME);
+        ASSERT_EQUALS(gf.getNumChunks(), 4);
+        stringstream ss;
+        gf.write(ss);
+        ASSERT_EQUALS(ss.str(), repetitive);
+    }
+
+    TEST_F(GridFSTest, DeduplicatedChunksAreSharedAcrossFiles) {
+        _gfs->setDeduplicateChunks(true);
+        GridFileBuilder gfb(_gfs.get());
+        gfb.appendChunk(DATA, DATA_LEN);
+        gfb.buildFile(DATA_NAME);
+        _gfs->storeFile(DATA, DATA_LEN, OTHER_NAME);
+        ASSERT_EQUALS(_conn->count(TEST_DB + ".fs.blobs"), 1U);
+
+        _gfs->removeFile(DATA_NAME);
+
+        GridFile gf = _gfs->findFileByName(OTHER_NAME);
+        stringstream ss;
+        gf.write(ss);
+        ASSERT_EQUALS(ss.str(), DATA);
+    }
+
+#ifdef MONGO_HAVE_ZLIB
+    TEST_F(GridFSTest, CompressedFileReadsBack) {
+        const string text(3 * UDEFAULT_CHUNK_SIZE / 2, 'x');
+        _gfs->setCompressChunks(true);
+        BSONObj result = _gfs->storeFile(text.data(), text.size(), DATA_NAME);
+        ASSERT_EQUALS(result["md5"].String(), md5simpledigest(text));
+
+        BSONObj chunk = _conn->findOne(TEST_DB + ".fs.chunks", QUERY("n" << 0));
+        ASSERT_EQUALS(chunk["compression"].String(), "zlib");
+        int len;
+        chunk["data"].binDataClean(len);
+        ASSERT_LESS_THAN(len, DEFAULT_CHUNK_SIZE);
+
+        GridFile gf = _gfs->findFileByName(DATA_NAME);
+        ASSERT_EQUALS(gf.getContentLength(), text.size());
+        ASSERT_EQUALS(gf.getNumChunks(), 2);
+        stringstream ss;
+        gf.write(ss);
+        ASSERT_EQUALS(ss.str(), text);
+    }
+
+    TEST_F(GridFSTest, IncompressibleChunksAreStoredAsTheyAre) {
+        _gfs->setCompressChunks(true);
+        _gfs->storeFile(DATA, DATA_LEN, DATA_NAME);
+
+        BSONObj chunk = _conn->findOne(TEST_DB + ".fs.chunks", BSONObj());
+        ASSERT_FALSE(chunk.hasField("compression"));
+
+        GridFile gf = _gfs->findFileByName(DATA_NAME);
+        stringstream ss;
+        gf.write(ss);
+        ASSERT_EQUALS(ss.str(), DATA);
+    }
+#endif
+
 } // namespace
@@ -26,6 +26,7 @@
 
 #include "mongo/stdx/functional.h"
 #include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/concurrency/task_executor.h"
 #include "mongo/util/concurrency/thread_name.h"
 #include "mongo/util/debug_util.h"
 #include "mongo/util/log.h"
@@ -39,29 +40,31 @@ namespace mongo {
 
     namespace {
 
-        class PeriodicTaskRunner : public BackgroundJob {
+        class PeriodicTaskRunner {
         public:
 
             PeriodicTaskRunner()
                 : _mutex()
-                , _shutdownRequested(false) {}
+                , _started(false)
+                , _shutdownRequested(false)
+                , _tickPending(false)
+                , _timer(0) {}
 
             void add( PeriodicTask* task );
             void remove( PeriodicTask* task );
 
+            void start();
             Status stop( int gracePeriodMillis );
 
         private:
 
-            virtual std::string name() const {
-                return "PeriodicTaskRunner";
-            }
-
-            virtual void run();
-
-            // Returns true if shutdown has been requested.  You must hold _mutex to call this
+            // Schedules the next _tick on the task executor. You must hold _mutex to call this
             // function.
-            bool _isShutdownRequested() const;
+            void _scheduleTick();
+
+            // Runs all registered tasks, then schedules the next run unless shutdown has been
+            // requested. Called by the task executor.
+            void _tick();
 
             // Runs all registered tasks. You must hold _mutex to call this function.
             void _runTasks();
@@ -70,17 +73,22 @@ namespace mongo {
             // to call this function.
             void _runTask( PeriodicTask* task );
 
-            // _mutex protects the _shutdownRequested flag and the _tasks vector.
+            // _mutex protects the flags, the timer and the _tasks vector.
             boost::mutex _mutex;
 
-            // The condition variable is used to sleep for the interval between task
-            // executions, and is notified when the _shutdownRequested flag is toggled.
-            boost::condition_variable _cond;
+            // Notified when _tickPending becomes false after shutdown has been requested.
+            boost::condition_variable _stopped;
 
-            // Used to break the loop. You should notify _cond after changing this to true
-            // so that shutdown proceeds promptly.
+            bool _started;
+
+            // Stops the ticks. You should notify _stopped when a tick sees this, so that
+            // shutdown proceeds promptly.
             bool _shutdownRequested;
 
+            // Whether a _tick is scheduled or running, and the timer it's scheduled with.
+            bool _tickPending;
+            TaskExecutor::TimerId _timer;
+
             // The PeriodicTasks contained in this vector are NOT owned by the
             // PeriodicTaskRunner, and are not deleted. The vector never shrinks, removed Tasks
             // have their entry overwritten with NULL.
@@ -136,15 +144,18 @@ namespace mongo {
 
     BackgroundJob::~BackgroundJob() {}
 
-    void BackgroundJob::jobBody() {
+    void BackgroundJob::jobBody( bool ownThread ) {
 
         const string threadName = name();
+        const string previousThreadName = getThreadName();
         if( ! threadName.empty() )
             setThreadName( threadName.c_str() );
 
         LOG(1) << "BackgroundJob starting: " << threadName << endl;
 
         try {
+            // Jobs generally wait, and the executor mustn't be left without a thread for others
+            TaskExecutor::BlockingSection blocking;
             run();
         }
         catch ( std::exception& e ) {
@@ -165,14 +176,20 @@ namespace mongo {
             _status->done.notify_all();
         }
 
+        if ( !ownThread ) {
+            // The thread goes on running the executor's tasks
+            setThreadName( previousThreadName );
+        }
+        else {
 #ifdef MONGO_SSL
-        // TODO(sverch): Allow people who use the BackgroundJob to also specify cleanup tasks.
-        // Currently the networking code depends on this class and this class depends on the
-        // networking code because of this ad hoc cleanup.
-        SSLManagerInterface* manager = getSSLManager();
-        if (manager)
-            manager->cleanupThreadLocals();
+            // TODO(sverch): Allow people who use the BackgroundJob to also specify cleanup tasks.
+            // Currently the networking code depends on this class and this class depends on the
+            // networking code because of this ad hoc cleanup.
+            SSLManagerInterface* manager = getSSLManager();
+            if (manager)
+                manager->cleanupThreadLocals();
 #endif
+        }
 
         if( selfDelete )
             delete this;
@@ -187,9 +204,14 @@ namespace mongo {
         // If the job is already 'done', for instance because it was cancelled or already
         // finished, ignore additional requests to run the job.
         if (_status->state == NotStarted) {
-            boost::thread t( stdx::bind( &BackgroundJob::jobBody , this ) );
+            const Status scheduled = TaskExecutor::global()->schedule(
+                stdx::bind( &BackgroundJob::jobBody, this, false ) );
+            if ( !scheduled.isOK() ) {
+                // The executor is backed up, don't make the job wait behind its tasks
+                boost::thread t( stdx::bind( &BackgroundJob::jobBody, this, true ) );
+                t.detach();
+            }
             _status->state = Running;
-            t.detach();
         }
     }
 
@@ -210,6 +232,10 @@ namespace mongo {
 
     bool BackgroundJob::wait( unsigned msTimeOut ) {
         verify( !_selfDelete ); // you cannot call wait on a self-deleting job
+
+        // The job may be queued behind the task calling this
+        TaskExecutor::BlockingSection blocking;
+
         boost::unique_lock<boost::mutex> l( _status->mutex );
         while ( _status->state != Done ) {
             if ( msTimeOut ) {
@@ -263,7 +289,7 @@ namespace mongo {
         if ( !runner )
             runner = new PeriodicTaskRunner;
 
-        runner->go();
+        runner->start();
     }
 
     Status PeriodicTask::stopRunningPeriodicTasks( int gracePeriodMillis ) {
@@ -273,7 +299,6 @@ namespace mongo {
         if ( runnerDestroyed || !runner )
             return status;
 
-        runner->cancel();
         status = runner->stop( gracePeriodMillis );
 
         if ( status.isOK() ) {
@@ -299,37 +324,55 @@ namespace mongo {
         }
     }
 
-    Status PeriodicTaskRunner::stop( int gracePeriodMillis ) {
-        {
-            boost::lock_guard<boost::mutex> lock( _mutex );
-            _shutdownRequested = true;
-            _cond.notify_one();
-        }
+    void PeriodicTaskRunner::start() {
+        boost::lock_guard<boost::mutex> lock( _mutex );
+        if ( _started || _shutdownRequested )
+            return;
+
+        _started = true;
+        _scheduleTick();
+    }
 
-        if ( !wait( gracePeriodMillis ) ) {
-            return Status( ErrorCodes::ExceededTimeLimit,
-                           "Grace period expired while waiting for PeriodicTasks to terminate" );
+    Status PeriodicTaskRunner::stop( int gracePeriodMillis ) {
+        boost::unique_lock<boost::mutex> lock( _mutex );
+        _shutdownRequested = true;
+
+        // Unless the tick is already running or about to, it can simply be dropped.
+        if ( _tickPending && TaskExecutor::global()->cancel( _timer ) )
+            _tickPending = false;
+
+        const boost::system_time deadline =
+            boost::get_system_time() + boost::posix_time::milliseconds( gracePeriodMillis );
+        while ( _tickPending ) {
+            if ( !_stopped.timed_wait( lock, deadline ) ) {
+                return Status( ErrorCodes::ExceededTimeLimit,
+                               "Grace period expired while waiting for PeriodicTasks to terminate" );
+            }
         }
         return Status::OK();
     }
 
-    void PeriodicTaskRunner::run() {
+    void PeriodicTaskRunner::_scheduleTick() {
         // Use a shorter cycle time in debug mode to help catch race conditions.
-        const size_t waitMillis = (debug ? 5 : 60) * 1000;
+        const int waitMillis = (debug ? 5 : 60) * 1000;
 
-        const stdx::function<bool()> predicate =
-            stdx::bind( &PeriodicTaskRunner::_isShutdownRequested, this );
+        _timer = TaskExecutor::global()->scheduleAfter(
+            waitMillis, stdx::bind( &PeriodicTaskRunner::_tick, this ) );
+        _tickPending = true;
+    }
 
-        boost::unique_lock<boost::mutex> lock( _mutex );
-        while ( !predicate() ) {
-            const boost::xtime deadline = incxtimemillis( waitMillis );
-            if ( !_cond.timed_wait( lock, deadline, predicate ) )
-                _runTasks();
+    void PeriodicTaskRunner::_tick() {
+        boost::lock_guard<boost::mutex> lock( _mutex );
+        if ( !_shutdownRequested )
+            _runTasks();
+
+        if ( _shutdownRequested ) {
+            _tickPending = false;
+            _stopped.notify_all();
+            return;
         }
-    }
 
-    bool PeriodicTaskRunner::_isShutdownRequested() const {
-        return _shutdownRequested;
+        _scheduleTick();
     }
 
     void PeriodicTaskRunner::_runTasks() {
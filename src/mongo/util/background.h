@@ -30,6 +30,9 @@ namespace mongo {
      *  Background thread dispatching.
      *  subclass and define run()
      *
+     *  Jobs run on the threads of TaskExecutor::global(), which are shared, rather than on a
+     *  thread each. run() may block as long as it needs to.
+     *
      *  It is not possible to run the job more than once. An attempt to call 'go' while the
      *  task is running will fail. Calling 'go' after the task has finished are ignored and
      *  will not start the job again.
@@ -117,7 +120,8 @@ namespace mongo {
         struct JobStatus;
         const boost::scoped_ptr<JobStatus> _status;
 
-        void jobBody();
+        // Runs the job, on a thread of the task executor unless "ownThread"
+        void jobBody( bool ownThread );
     };
 
     /**
@@ -138,19 +142,18 @@ namespace mongo {
         virtual std::string taskName() const = 0;
 
         /**
-         *  Starts the BackgroundJob that runs PeriodicTasks. You may call this multiple times,
-         *  from multiple threads, and the BackgroundJob will be started only once. Please note
-         *  that since this method starts threads, it is not appropriate to call it from within
-         *  a mongo initializer. Calling this method after calling 'stopRunningPeriodicTasks'
-         *  does not re-start the background job.
+         *  Starts running PeriodicTasks, on a timer of TaskExecutor::global(). You may call
+         *  this multiple times, from multiple threads, and the timer will be started only once.
+         *  Please note that since this method starts threads, it is not appropriate to call it
+         *  from within a mongo initializer. Calling this method after calling
+         *  'stopRunningPeriodicTasks' does not re-start the timer.
          */
         static void startRunningPeriodicTasks();
 
         /**
-         *  Waits 'gracePeriodMillis' for the BackgroundJob responsible for PeriodicTask
-         *  execution to finish any running tasks, then destroys it. If the BackgroundJob was
-         *  never started, returns Status::OK right away. If the BackgroundJob does not
-         *  terminate within the grace period, returns an invalid status. It is safe to call
+         *  Stops the timer running PeriodicTasks, waiting 'gracePeriodMillis' for any running
+         *  tasks to finish. If the timer was never started, returns Status::OK right away. If
+         *  the running tasks do not finish within the grace period, returns an invalid status. It is safe to call
          *  this method repeatedly from one thread if the grace period is overshot. It is not
          *  safe to call this method from multiple threads, or in a way that races with
          *  'startRunningPeriodicTasks'.
@@ -0,0 +1,359 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/util/concurrency/task_executor.h"
+
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+
+#include "mongo/base/error_codes.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/util/concurrency/thread_name.h"
+#include "mongo/util/log.h"
+#include "mongo/util/net/ssl_manager.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+    namespace {
+
+        // The extra threads started for blocking sections exit after this long without a task
+        const int kExtraThreadIdleMillis = 10 * 1000;
+
+        boost::once_flag globalExecutorOnce = BOOST_ONCE_INIT;
+        TaskExecutor* globalExecutor;
+
+        void createGlobalExecutor() {
+            globalExecutor = new TaskExecutor();
+        }
+
+    } // namespace
+
+    struct TaskExecutor::Worker {
+        Worker(TaskExecutor* executor, bool hasDeque)
+            : executor(executor)
+            , hasDeque(hasDeque) {}
+
+        TaskExecutor* const executor;
+
+        // False for the extra threads, which only steal. The worker takes from the back of its
+        // deque, others from the front.
+        const bool hasDeque;
+        boost::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    boost::thread_specific_ptr<TaskExecutor::Worker> TaskExecutor::_currentWorker;
+
+    TaskExecutor::TaskExecutor(int workers, int maxQueuedPerWorker)
+        : _maxQueuedPerWorker(maxQueuedPerWorker)
+        , _shutdown(false)
+        , _threads(0)
+        , _extraThreads(0)
+        , _blocked(0)
+        , _extraThreadsStarted(0)
+        , _timerThreadStarted(false)
+        , _nextTimerId(0) {
+
+        if (workers == 0)
+            workers = std::max(2U, boost::thread::hardware_concurrency());
+
+        for (int i = 0; i < workers; i++)
+            _workers.push_back(new Worker(this, true));
+
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        for (int i = 0; i < workers; i++)
+            _startThread(_workers[i]);
+    }
+
+    TaskExecutor::~TaskExecutor() {
+        {
+            boost::unique_lock<boost::mutex> lk(_mutex);
+            _shutdown = true;
+            _taskQueued.notify_all();
+            _timersChanged.notify_all();
+            while (_threads > 0)
+                _threadsExited.wait(lk);
+        }
+
+        for (size_t i = 0; i < _workers.size(); i++)
+            delete _workers[i];
+    }
+
+    TaskExecutor* TaskExecutor::global() {
+        boost::call_once(createGlobalExecutor, globalExecutorOnce);
+        return globalExecutor;
+    }
+
+    Status TaskExecutor::schedule(const Task& task) {
+        return _schedule(task, true);
+    }
+
+    Status TaskExecutor::_schedule(const Task& task, bool bounded) {
+        Worker* worker = _currentWorker.get();
+        const bool fromOwnWorker = worker && worker->executor == this && worker->hasDeque;
+        if (!fromOwnWorker)
+            worker = _workers[_nextWorker.fetchAndAdd(1) % _workers.size()];
+
+        {
+            boost::lock_guard<boost::mutex> lk(worker->mutex);
+            if (bounded && worker->tasks.size() >= _maxQueuedPerWorker)
+                return Status(ErrorCodes::Overflow, "the task queue is full");
+            if (fromOwnWorker)
+                worker->tasks.push_back(task);
+            else
+                worker->tasks.push_front(task);
+        }
+
+        // A thread about to wait counts itself idle before it checks _queued, so either it
+        // sees this task or this sees it idle
+        _queued.fetchAndAdd(1);
+        if (_idle.load() > 0) {
+            boost::lock_guard<boost::mutex> lk(_mutex);
+            _taskQueued.notify_one();
+        }
+        return Status::OK();
+    }
+
+    TaskExecutor::TimerId TaskExecutor::scheduleAfter(int delayMillis, const Task& task) {
+        const unsigned long long due = curTimeMillis64() + delayMillis;
+
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        if (!_timerThreadStarted) {
+            boost::thread t(stdx::bind(&TaskExecutor::_timerBody, this));
+            t.detach();
+            _timerThreadStarted = true;
+            _threads++;
+        }
+
+        const TimerId id = ++_nextTimerId;
+        if (_timers.empty() || due < _timers.begin()->first.first)
+            _timersChanged.notify_one();
+        _timers[std::make_pair(due, id)] = task;
+        return id;
+    }
+
+    bool TaskExecutor::cancel(TimerId id) {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+
+        // There are only ever a few timers
+        for (Timers::iterator it = _timers.begin(); it != _timers.end(); ++it) {
+            if (it->first.second == id) {
+                _timers.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void TaskExecutor::appendInfo(BSONObjBuilder& b) {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        b.append("workers", static_cast<int>(_workers.size()));
+        b.append("extraThreads", _extraThreads);
+        b.appendNumber("extraThreadsStarted", _extraThreadsStarted);
+        b.append("blocked", _blocked);
+        b.append("idle", _idle.load());
+        b.append("queued", _queued.load());
+        b.append("timers", static_cast<int>(_timers.size()));
+        b.appendNumber("tasksRun", _tasksRun.load());
+        b.appendNumber("tasksStolen", _tasksStolen.load());
+    }
+
+    bool TaskExecutor::_takeTask(Worker* own, Task* task) {
+        while (true) {
+            if (own->hasDeque) {
+                boost::lock_guard<boost::mutex> lk(own->mutex);
+                if (!own->tasks.empty()) {
+                    *task = own->tasks.back();
+                    own->tasks.pop_back();
+                    _queued.subtractAndFetch(1);
+                    return true;
+                }
+            }
+
+            if (_steal(own, task))
+                return true;
+
+            boost::unique_lock<boost::mutex> lk(_mutex);
+            if (_shutdown && _queued.load() == 0) {
+                if (!own->hasDeque)
+                    _extraThreads--;
+                return false;
+            }
+
+            bool timedOut = false;
+            _idle.fetchAndAdd(1);
+            if (_queued.load() == 0 && !_shutdown) {
+                if (own->hasDeque) {
+                    _taskQueued.wait(lk);
+                }
+                else {
+                    timedOut = !_taskQueued.timed_wait(
+                        lk, boost::posix_time::milliseconds(kExtraThreadIdleMillis));
+                }
+            }
+            _idle.subtractAndFetch(1);
+
+            if (timedOut && _queued.load() == 0) {
+                _extraThreads--;
+                return false;
+            }
+        }
+    }
+
+    bool TaskExecutor::_steal(Worker* own, Task* task) {
+        if (_queued.load() == 0)
+            return false;
+
+        // Start from a different victim each time, so they are drained evenly
+        const size_t start = _nextWorker.loadRelaxed();
+        for (size_t i = 0; i < _workers.size(); i++) {
+            Worker* const victim = _workers[(start + i) % _workers.size()];
+            if (victim == own)
+                continue;
+
+            boost::lock_guard<boost::mutex> lk(victim->mutex);
+            if (victim->tasks.empty())
+                continue;
+
+            *task = victim->tasks.front();
+            victim->tasks.pop_front();
+            _queued.subtractAndFetch(1);
+            _tasksStolen.fetchAndAdd(1);
+            return true;
+        }
+        return false;
+    }
+
+    void TaskExecutor::_workerBody(Worker* own) {
+        Worker extra(this, false);
+        if (!own)
+            own = &extra;
+
+        _currentWorker.reset(own);
+        setThreadName("TaskExecutor");
+
+        Task task;
+        while (_takeTask(own, &task)) {
+            try {
+                task();
+            }
+            catch (const std::exception& e) {
+                error() << "task failed: " << e.what() << std::endl;
+            }
+            catch (...) {
+                error() << "task failed with an unknown error" << std::endl;
+            }
+
+            // Let go of what the task holds before waiting for the next one
+            task = Task();
+            _tasksRun.fetchAndAdd(1);
+        }
+
+        // The worker isn't the thread's to delete
+        _currentWorker.release();
+
+#ifdef MONGO_SSL
+        // Like a BackgroundJob with a thread of its own, see BackgroundJob::jobBody
+        SSLManagerInterface* manager = getSSLManager();
+        if (manager)
+            manager->cleanupThreadLocals();
+#endif
+
+        _threadExited();
+    }
+
+    void TaskExecutor::_timerBody() {
+        setThreadName("TaskExecutorTimer");
+
+        boost::unique_lock<boost::mutex> lk(_mutex);
+        while (!_shutdown) {
+            if (_timers.empty()) {
+                _timersChanged.wait(lk);
+                continue;
+            }
+
+            const Timers::iterator next = _timers.begin();
+            const unsigned long long now = curTimeMillis64();
+            if (next->first.first > now) {
+                _timersChanged.timed_wait(
+                    lk, boost::posix_time::milliseconds(next->first.first - now));
+                continue;
+            }
+
+            const Task task = next->second;
+            _timers.erase(next);
+
+            lk.unlock();
+            // Not bounded: a timer that is due isn't dropped for the workers being busy
+            _schedule(task, false);
+            lk.lock();
+        }
+
+        lk.unlock();
+        _threadExited();
+    }
+
+    void TaskExecutor::_startThread(Worker* own) {
+        try {
+            boost::thread t(stdx::bind(&TaskExecutor::_workerBody, this, own));
+            t.detach();
+        }
+        catch (const boost::thread_resource_error& e) {
+            warning() << "couldn't start a task executor thread: " << e.what() << std::endl;
+            return;
+        }
+
+        _threads++;
+        if (!own) {
+            _extraThreads++;
+            _extraThreadsStarted++;
+        }
+    }
+
+    void TaskExecutor::_threadExited() {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        _threads--;
+        _threadsExited.notify_all();
+    }
+
+    TaskExecutor::BlockingSection::BlockingSection()
+        : _executor(_currentWorker.get() ? _currentWorker->executor : NULL) {
+
+        if (!_executor)
+            return;
+
+        boost::lock_guard<boost::mutex> lk(_executor->_mutex);
+        _executor->_blocked++;
+
+        // Whatever this waits for may need a thread to run on
+        if (_executor->_idle.load() == 0 && !_executor->_shutdown)
+            _executor->_startThread(NULL);
+    }
+
+    TaskExecutor::BlockingSection::~BlockingSection() {
+        if (!_executor)
+            return;
+
+        boost::lock_guard<boost::mutex> lk(_executor->_mutex);
+        _executor->_blocked--;
+    }
+
+} // namespace mongo
@@ -0,0 +1,161 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/utility.hpp>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "mongo/base/status.h"
+#include "mongo/client/export_macros.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/functional.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /**
+     * A pool of worker threads shared by the driver, which runs the BackgroundJobs and
+     * PeriodicTasks that used to have a thread each, and short tasks of parallel work.
+     *
+     * Every worker has its own deque of tasks. A worker takes tasks from the back of its deque
+     * and, once that is empty, steals from the front of another's. The tasks a task schedules
+     * go to the back of its worker's deque, so they stay with that worker unless another one
+     * is idle. Tasks scheduled from other threads are spread over the fronts of the deques, so
+     * each worker runs those in the order they came. A deque holds at most maxQueuedPerWorker
+     * tasks: beyond that, schedule() fails instead of letting work pile up.
+     *
+     * A task that may block for long, on the network or on other tasks, must do so inside a
+     * BlockingSection. If no thread is idle, that starts another to take its place, so that
+     * workers waiting on queued tasks can't all be blocked at once. These extra threads exit
+     * once they have been idle for a while.
+     *
+     * scheduleAfter() runs a task once a delay has passed: a timer thread hands it to the
+     * workers when it is due.
+     *
+     * Thread safety: all methods may be called concurrently, but not once destruction began.
+     */
+    class MONGO_CLIENT_API TaskExecutor : boost::noncopyable {
+    public:
+        typedef stdx::function<void()> Task;
+        typedef unsigned long long TimerId;
+
+        static const int kDefaultMaxQueuedPerWorker = 1024;
+
+        /**
+         * Starts "workers" threads, one per core if 0.
+         */
+        explicit TaskExecutor(int workers = 0,
+                              int maxQueuedPerWorker = kDefaultMaxQueuedPerWorker);
+
+        /**
+         * Waits for the tasks already scheduled to run, and drops the timers that are not due.
+         */
+        ~TaskExecutor();
+
+        /**
+         * The executor of the driver, created the first time it is needed and never destroyed.
+         */
+        static TaskExecutor* MONGO_CLIENT_FUNC global();
+
+        /**
+         * Queues "task" to run on a worker, on the worker calling this if there is one. Fails
+         * with Overflow, without queueing it, if the deque it would go to is full.
+         *
+         * A task should not throw: anything it throws is logged and ignored.
+         */
+        Status schedule(const Task& task);
+
+        /**
+         * Runs "task" on a worker once "delayMillis" have passed. Returns an id for cancel().
+         */
+        TimerId scheduleAfter(int delayMillis, const Task& task);
+
+        /**
+         * Drops the task of the timer "id". Returns true if it won't run, false if it is already
+         * running or queued to, or has run.
+         */
+        bool cancel(TimerId id);
+
+        int workers() const { return _workers.size(); }
+
+        void appendInfo(BSONObjBuilder& b);
+
+        /**
+         * Marks a part of a task that may block for long, see above. Does nothing on threads
+         * that are not the executor's.
+         */
+        class MONGO_CLIENT_API BlockingSection : boost::noncopyable {
+        public:
+            BlockingSection();
+            ~BlockingSection();
+
+        private:
+            TaskExecutor* const _executor;
+        };
+
+    private:
+        struct Worker;
+
+        // Timers by when they are due, then by id so that ids are unique keys
+        typedef std::map<std::pair<unsigned long long, TimerId>, Task> Timers;
+
+        Status _schedule(const Task& task, bool bounded);
+
+        // Takes the next task for the thread of "own", NULL for the extra threads. Returns
+        // false when the thread should exit.
+        bool _takeTask(Worker* own, Task* task);
+        bool _steal(Worker* own, Task* task);
+
+        void _workerBody(Worker* own);
+        void _timerBody();
+
+        void _startThread(Worker* own);
+        void _threadExited();
+
+        // The worker the current thread is, if it is an executor's
+        static boost::thread_specific_ptr<Worker> _currentWorker;
+
+        std::vector<Worker*> _workers;
+        const size_t _maxQueuedPerWorker;
+
+        AtomicUInt32 _nextWorker;     // the deque of the next task scheduled from outside
+        AtomicInt32 _queued;          // the tasks in all deques
+        AtomicInt32 _idle;            // the threads waiting for a task
+        AtomicInt64 _tasksRun;
+        AtomicInt64 _tasksStolen;
+
+        // Guards the state below, and is held by threads waiting for a task
+        boost::mutex _mutex;
+        boost::condition_variable _taskQueued;
+        boost::condition_variable _threadsExited;
+        bool _shutdown;
+        int _threads;                 // running, counting the extra and timer threads
+        int _extraThreads;
+        int _blocked;
+        long long _extraThreadsStarted;
+        bool _timerThreadStarted;
+        boost::condition_variable _timersChanged;
+        Timers _timers;
+        TimerId _nextTimerId;
+    };
+
+} // namespace mongo
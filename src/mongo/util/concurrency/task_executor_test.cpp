@@ -0,0 +1,164 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <boost/thread/thread.hpp>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/functional.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/background.h"
+#include "mongo/util/concurrency/synchronization.h"
+#include "mongo/util/concurrency/task_executor.h"
+
+namespace {
+
+    using mongo::AtomicInt32;
+    using mongo::BackgroundJob;
+    using mongo::BSONObj;
+    using mongo::BSONObjBuilder;
+    using mongo::Notification;
+    using mongo::TaskExecutor;
+    using mongo::stdx::bind;
+
+    void increment(AtomicInt32* counter) {
+        counter->fetchAndAdd(1);
+    }
+
+    void sleepAndIncrement(AtomicInt32* counter) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        counter->fetchAndAdd(1);
+    }
+
+    void fork(TaskExecutor* executor, AtomicInt32* counter, int tasks) {
+        for (int i = 0; i < tasks; i++)
+            ASSERT_OK(executor->schedule(bind(sleepAndIncrement, counter)));
+    }
+
+    void waitFor(Notification* started, Notification* release) {
+        started->notifyOne();
+        release->waitToBeNotified();
+    }
+
+    void waitBlocking(Notification* started, Notification* release) {
+        started->notifyOne();
+        TaskExecutor::BlockingSection blocking;
+        release->waitToBeNotified();
+    }
+
+    void notify(Notification* notification) {
+        notification->notifyOne();
+    }
+
+    BSONObj info(TaskExecutor* executor) {
+        BSONObjBuilder b;
+        executor->appendInfo(b);
+        return b.obj();
+    }
+
+    TEST(TaskExecutorTest, ScheduledTasksRunBeforeDestruction) {
+        AtomicInt32 counter;
+        {
+            TaskExecutor executor(4);
+            for (int i = 0; i < 1000; i++)
+                ASSERT_OK(executor.schedule(bind(increment, &counter)));
+        }
+        ASSERT_EQUALS(1000, counter.load());
+    }
+
+    TEST(TaskExecutorTest, IdleWorkersStealTasksScheduledByATask) {
+        AtomicInt32 counter;
+        TaskExecutor executor(4);
+        ASSERT_OK(executor.schedule(bind(fork, &executor, &counter, 100)));
+        while (counter.load() < 100)
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+
+        // All of them went to the deque of the worker that ran fork
+        ASSERT_GREATER_THAN(info(&executor)["tasksStolen"].numberLong(), 0);
+    }
+
+    TEST(TaskExecutorTest, FullQueuesRejectTasks) {
+        Notification started;
+        Notification release;
+        AtomicInt32 counter;
+        TaskExecutor executor(1, 2);
+        ASSERT_OK(executor.schedule(bind(waitFor, &started, &release)));
+        started.waitToBeNotified();
+
+        ASSERT_OK(executor.schedule(bind(increment, &counter)));
+        ASSERT_OK(executor.schedule(bind(increment, &counter)));
+        ASSERT_EQUALS(mongo::ErrorCodes::Overflow,
+                      executor.schedule(bind(increment, &counter)).code());
+
+        release.notifyOne();
+    }
+
+    TEST(TaskExecutorTest, TimersRunUnlessCancelled) {
+        Notification ran;
+        AtomicInt32 counter;
+        TaskExecutor executor(2);
+        const TaskExecutor::TimerId cancelled =
+            executor.scheduleAfter(10, bind(increment, &counter));
+        executor.scheduleAfter(20, bind(notify, &ran));
+
+        ASSERT_TRUE(executor.cancel(cancelled));
+        ran.waitToBeNotified();
+        ASSERT_EQUALS(0, counter.load());
+        ASSERT_FALSE(executor.cancel(cancelled));
+    }
+
+    TEST(TaskExecutorTest, BlockingSectionsStartAnotherThread) {
+        Notification started;
+        Notification release;
+        TaskExecutor executor(1);
+
+        // The only worker waits for a task queued behind it
+        ASSERT_OK(executor.schedule(bind(waitBlocking, &started, &release)));
+        started.waitToBeNotified();
+        ASSERT_OK(executor.schedule(bind(notify, &release)));
+
+        while (info(&executor)["tasksRun"].numberLong() < 2)
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        ASSERT_EQUALS(1, info(&executor)["extraThreadsStarted"].numberLong());
+    }
+
+    class CountingJob : public BackgroundJob {
+    public:
+        explicit CountingJob(AtomicInt32* counter) : _counter(counter) {}
+
+        virtual std::string name() const { return "CountingJob"; }
+        virtual void run() { _counter->fetchAndAdd(1); }
+
+    private:
+        AtomicInt32* const _counter;
+    };
+
+    TEST(TaskExecutorTest, BackgroundJobsRunOnTheGlobalExecutor) {
+        AtomicInt32 counter;
+        const long long tasksRun = info(TaskExecutor::global())["tasksRun"].numberLong();
+
+        CountingJob job(&counter);
+        job.go();
+        ASSERT_TRUE(job.wait());
+        ASSERT_EQUALS(1, counter.load());
+        ASSERT_EQUALS(BackgroundJob::Done, job.getState());
+
+        while (info(TaskExecutor::global())["tasksRun"].numberLong() == tasksRun)
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+} // namespace
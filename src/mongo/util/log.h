@@ -73,8 +73,34 @@ namespace logger {
     }
 
 
+    /**
+     * LOG(n) statements with a debug level above MONGO_LOG_MAX_DEBUG_LEVEL are compiled out of
+     * optimized builds, so that verbose logging in hot paths costs nothing unless it was asked
+     * for when building. Define it when compiling, e.g. with --log-max-debug-level=1; by default
+     * every level is compiled in and only checked at runtime.
+     */
+#if !defined(MONGO_LOG_MAX_DEBUG_LEVEL)
+#define MONGO_LOG_MAX_DEBUG_LEVEL 0x7fffffff
+#endif
+
+namespace logger {
+    inline bool isCompiledIn(int level) { return level <= MONGO_LOG_MAX_DEBUG_LEVEL; }
+    inline bool isCompiledIn(LogSeverity severity) {
+        return severity.toInt() <= MONGO_LOG_MAX_DEBUG_LEVEL;
+    }
+    inline bool isCompiledIn(const LabeledLevel& level) {
+        return level.getLevel() <= MONGO_LOG_MAX_DEBUG_LEVEL;
+    }
+}  // namespace logger
+
+#define MONGO_LOG_STRINGIFY(X) #X
+#define MONGO_LOG_CALL_SITE_AT(LINE) __FILE__ ":" MONGO_LOG_STRINGIFY(LINE)
+
+    // The call site is checked against any rate limit before the message is formatted, see
+    // LogDomain::setCallSiteRateLimit
 #define MONGO_LOG(DLEVEL) \
-    if (!(::mongo::logger::globalLogDomain())->shouldLog(::mongo::LogstreamBuilder::severityCast(DLEVEL))) {} \
+    if (!::mongo::logger::isCompiledIn(DLEVEL) || \
+        !(::mongo::logger::globalLogDomain())->shouldLog(::mongo::LogstreamBuilder::severityCast(DLEVEL), MONGO_LOG_CALL_SITE_AT(__LINE__))) {} \
     else LogstreamBuilder(::mongo::logger::globalLogDomain(), getThreadName(), ::mongo::LogstreamBuilder::severityCast(DLEVEL))
 
 #define LOG MONGO_LOG
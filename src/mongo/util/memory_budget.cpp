@@ -0,0 +1,85 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/util/memory_budget.h"
+
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    const long long MemoryBudget::kUnlimited(-1);
+
+    MemoryBudget::MemoryBudget(const boost::shared_ptr<MemoryBudget>& parent,
+                               long long limitBytes)
+        : _parent(parent)
+        , _limit(limitBytes) {
+    }
+
+    const boost::shared_ptr<MemoryBudget>& MemoryBudget::global() {
+        // we "new" this so it is still around when other automatic global vars
+        // are being destructed during termination.
+        static const boost::shared_ptr<MemoryBudget>& globalBudget =
+            *(new boost::shared_ptr<MemoryBudget>(new MemoryBudget()));
+        return globalBudget;
+    }
+
+    void MemoryBudget::charge(long long bytes) {
+        for (MemoryBudget* b = this; b; b = b->_parent.get()) {
+            const long long now = b->_used.addAndFetch(bytes);
+
+            // Racy, but a peak that is off by a concurrent charge is good enough for metrics.
+            long long peak = b->_peak.loadRelaxed();
+            while (now > peak) {
+                const long long seen = b->_peak.compareAndSwap(peak, now);
+                if (seen == peak)
+                    break;
+                peak = seen;
+            }
+        }
+    }
+
+    void MemoryBudget::release(long long bytes) {
+        for (MemoryBudget* b = this; b; b = b->_parent.get()) {
+            b->_used.fetchAndSubtract(bytes);
+        }
+    }
+
+    long long MemoryBudget::available() const {
+        long long result = kUnlimited;
+        for (const MemoryBudget* b = this; b; b = b->_parent.get()) {
+            const long long limit = b->getLimitBytes();
+            if (limit < 0)
+                continue;
+
+            long long left = limit - b->used();
+            if (left < 0)
+                left = 0;
+            if (result == kUnlimited || left < result)
+                result = left;
+        }
+        return result;
+    }
+
+    void MemoryBudget::appendInfo(BSONObjBuilder& b) const {
+        b.appendNumber("limitBytes", getLimitBytes());
+        b.appendNumber("usedBytes", used());
+        b.appendNumber("peakBytes", peak());
+        b.appendNumber("throttledRequests", _throttled.loadRelaxed());
+        b.appendNumber("shrunkBatches", _shrunk.loadRelaxed());
+    }
+
+} // namespace mongo
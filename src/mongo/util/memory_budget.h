@@ -0,0 +1,114 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include "mongo/client/export_macros.h"
+#include "mongo/platform/atomic_word.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /**
+     * Accounts for memory the driver holds on behalf of the application: received reply
+     * buffers, objects stashed by DBClientCursor::putBack and write batches being sent.
+     *
+     * Budgets form a tree. Every connection owns a budget whose parent is the global budget,
+     * so a charge against a connection is also visible in the process wide totals. Each level
+     * may carry a limit; limits are advisory and are enforced by callers (for example
+     * DBClientCursor throttles and shrinks getMore requests) rather than by failing
+     * allocations.
+     *
+     * Thread safety: all methods may be called concurrently.
+     */
+    class MONGO_CLIENT_API MemoryBudget : boost::noncopyable {
+    public:
+
+        // Sentinel value indicating that a budget has no limit
+        static const long long kUnlimited;
+
+        explicit MemoryBudget(const boost::shared_ptr<MemoryBudget>& parent =
+                                  boost::shared_ptr<MemoryBudget>(),
+                              long long limitBytes = kUnlimited);
+
+        /**
+         * The process wide budget. Its limit is configured through
+         * client::Options::setMemoryBudgetBytes.
+         */
+        static const boost::shared_ptr<MemoryBudget>& MONGO_CLIENT_FUNC global();
+
+        long long getLimitBytes() const { return _limit.loadRelaxed(); }
+        void setLimitBytes(long long limitBytes) { _limit.store(limitBytes); }
+
+        /** Records 'bytes' as in use here and in every ancestor. Never fails. */
+        void charge(long long bytes);
+
+        /** Returns 'bytes' previously passed to charge(). */
+        void release(long long bytes);
+
+        long long used() const { return _used.loadRelaxed(); }
+        long long peak() const { return _peak.loadRelaxed(); }
+
+        /**
+         * @return the number of bytes that may still be charged before this budget or one of
+         *     its ancestors reaches its limit, kUnlimited if no limit applies, or zero once
+         *     a limit has been reached.
+         */
+        long long available() const;
+
+        bool isOverBudget() const {
+            return available() == 0;
+        }
+
+        /** Called by consumers that delayed or shrank work because of this budget. */
+        void noteThrottled() { _throttled.fetchAndAdd(1); }
+        void noteShrunk() { _shrunk.fetchAndAdd(1); }
+
+        void appendInfo(BSONObjBuilder& b) const;
+
+        /**
+         * Holds a charge for the lifetime of the object. The budget must outlive the Charge.
+         */
+        class Charge : boost::noncopyable {
+        public:
+            Charge(MemoryBudget* budget, long long bytes) : _budget(budget), _bytes(bytes) {
+                if (_budget)
+                    _budget->charge(_bytes);
+            }
+
+            ~Charge() {
+                if (_budget)
+                    _budget->release(_bytes);
+            }
+
+        private:
+            MemoryBudget* const _budget;
+            const long long _bytes;
+        };
+
+    private:
+        const boost::shared_ptr<MemoryBudget> _parent;
+        AtomicInt64 _limit;
+        AtomicInt64 _used;
+        AtomicInt64 _peak;
+        AtomicInt64 _throttled;
+        AtomicInt64 _shrunk;
+    };
+
+} // namespace mongo
@@ -0,0 +1,120 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/db/jsobj.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/memory_budget.h"
+#include "mongo/util/net/message.h"
+
+namespace {
+
+    using boost::shared_ptr;
+    using mongo::BSONObj;
+    using mongo::BSONObjBuilder;
+    using mongo::Message;
+    using mongo::MemoryBudget;
+
+    TEST(MemoryBudgetTest, UnlimitedByDefault) {
+        MemoryBudget budget;
+        ASSERT_EQUALS(MemoryBudget::kUnlimited, budget.available());
+        budget.charge(1000);
+        ASSERT_EQUALS(MemoryBudget::kUnlimited, budget.available());
+        ASSERT_FALSE(budget.isOverBudget());
+        budget.release(1000);
+        ASSERT_EQUALS(0, budget.used());
+        ASSERT_EQUALS(1000, budget.peak());
+    }
+
+    TEST(MemoryBudgetTest, ChargesPropagateToParent) {
+        shared_ptr<MemoryBudget> parent(new MemoryBudget());
+        MemoryBudget child(parent, 100);
+
+        child.charge(60);
+        ASSERT_EQUALS(60, child.used());
+        ASSERT_EQUALS(60, parent->used());
+        ASSERT_EQUALS(40, child.available());
+
+        child.charge(60);
+        ASSERT_EQUALS(0, child.available());
+        ASSERT_TRUE(child.isOverBudget());
+        ASSERT_FALSE(parent->isOverBudget());
+
+        child.release(120);
+        ASSERT_EQUALS(0, parent->used());
+        ASSERT_EQUALS(120, parent->peak());
+    }
+
+    TEST(MemoryBudgetTest, TightestLimitWins) {
+        shared_ptr<MemoryBudget> parent(new MemoryBudget(shared_ptr<MemoryBudget>(), 50));
+        MemoryBudget child(parent, 100);
+        MemoryBudget sibling(parent);
+
+        sibling.charge(30);
+        ASSERT_EQUALS(20, child.available());
+
+        parent->setLimitBytes(MemoryBudget::kUnlimited);
+        ASSERT_EQUALS(100, child.available());
+        sibling.release(30);
+    }
+
+    TEST(MemoryBudgetTest, ScopedCharge) {
+        MemoryBudget budget;
+        {
+            const MemoryBudget::Charge charge(&budget, 512);
+            ASSERT_EQUALS(512, budget.used());
+        }
+        ASSERT_EQUALS(0, budget.used());
+    }
+
+    TEST(MemoryBudgetTest, MessageReleasesChargeOnReset) {
+        shared_ptr<MemoryBudget> budget(new MemoryBudget());
+        const char text[] = "hello";
+
+        Message m;
+        m.setData(mongo::dbMsg, text);
+        m.chargeTo(budget, 1024);
+        ASSERT_EQUALS(1024, budget->used());
+
+        // Ownership, and with it the charge, moves on assignment.
+        Message other;
+        other = m;
+        ASSERT_EQUALS(1024, budget->used());
+        m.reset();
+        ASSERT_EQUALS(1024, budget->used());
+
+        other.reset();
+        ASSERT_EQUALS(0, budget->used());
+    }
+
+    TEST(MemoryBudgetTest, AppendInfo) {
+        MemoryBudget budget(shared_ptr<MemoryBudget>(), 10);
+        budget.charge(4);
+        budget.noteThrottled();
+        budget.noteShrunk();
+
+        BSONObjBuilder b;
+        budget.appendInfo(b);
+        const BSONObj info = b.obj();
+        ASSERT_EQUALS(10, info["limitBytes"].numberLong());
+        ASSERT_EQUALS(4, info["usedBytes"].numberLong());
+        ASSERT_EQUALS(4, info["peakBytes"].numberLong());
+        ASSERT_EQUALS(1, info["throttledRequests"].numberLong());
+        ASSERT_EQUALS(1, info["shrunkBatches"].numberLong());
+        budget.release(4);
+    }
+
+} // namespace
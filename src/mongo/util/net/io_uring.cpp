@@ -0,0 +1,373 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/util/net/io_uring.h"
+
+#include <algorithm>
+#include <boost/scoped_ptr.hpp>
+#include <cstring>
+#include <memory>
+
+#ifdef MONGO_HAVE_LINUX_IO_URING
+# include <errno.h>
+# include <linux/io_uring.h>
+# include <stdlib.h>
+# include <sys/mman.h>
+# include <sys/socket.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+# include <unistd.h>
+#endif
+
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+    const int IoUring::kBufferBytes = 64 * 1024;
+
+#ifdef MONGO_HAVE_LINUX_IO_URING
+
+    namespace {
+
+        // A send, a read and the read's timeout is the most ever queued
+        const unsigned kEntries = 4;
+
+        enum Operation { kSend = 1, kRead, kReadTimeout };
+
+        int ioUringSetup(unsigned entries, io_uring_params* params) {
+            return syscall(__NR_io_uring_setup, entries, params);
+        }
+
+        int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete) {
+            return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                           IORING_ENTER_GETEVENTS, NULL, 0);
+        }
+
+        int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned args) {
+            return syscall(__NR_io_uring_register, fd, opcode, arg, args);
+        }
+
+    } // namespace
+
+    struct IoUring::Rings {
+        Rings() : fd(-1), ring(MAP_FAILED), ringBytes(0), sqes(NULL), sqesBytes(0) {}
+
+        ~Rings() {
+            if (sqes)
+                munmap(sqes, sqesBytes);
+            if (ring != MAP_FAILED)
+                munmap(ring, ringBytes);
+            if (fd >= 0)
+                close(fd);
+        }
+
+        io_uring_sqe* nextSqe() {
+            const unsigned index = sqTail & sqMask;
+            sqArray[index] = index;
+            sqTail++;
+
+            io_uring_sqe* sqe = &sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+
+        int fd;
+        void* ring;
+        size_t ringBytes;
+        io_uring_sqe* sqes;
+        size_t sqesBytes;
+
+        unsigned* sqTailShared;
+        unsigned* sqArray;
+        unsigned sqMask;
+        unsigned sqTail;
+
+        unsigned* cqHead;
+        unsigned* cqTail;
+        unsigned cqMask;
+        io_uring_cqe* cqes;
+
+        // Reads use the registered buffer unless registering failed (RLIMIT_MEMLOCK)
+        bool fixedBuffer;
+
+        // Kept here until completion, the kernel reads them on submit
+        msghdr message;
+        std::vector<iovec> iov;
+        iovec readIov;
+        __kernel_timespec timeout;
+
+        // Results of the last submission
+        int sendResult;
+        int readResult;
+        int timeoutResult;
+    };
+
+    IoUring::IoUring()
+        : _fd(-1),
+          _rings(NULL),
+          _buffer(NULL),
+          _begin(0),
+          _end(0),
+          _haveReadResult(false),
+          _readResult(0),
+          _enterCalls(0) {
+    }
+
+    IoUring::~IoUring() {
+        delete _rings;
+        free(_buffer);
+    }
+
+    IoUring* IoUring::create(int fd) {
+        std::auto_ptr<IoUring> ring(new IoUring());
+        ring->_fd = fd;
+
+        Rings* r = new Rings();
+        ring->_rings = r;
+
+        // Completions only need handling when we wait for them (5.19+)
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_COOP_TASKRUN;
+        r->fd = ioUringSetup(kEntries, &params);
+        if (r->fd < 0 && errno == EINVAL) {
+            memset(&params, 0, sizeof(params));
+            r->fd = ioUringSetup(kEntries, &params);
+        }
+        if (r->fd < 0)
+            return NULL;
+
+        // Stable submissions and linked timeouts came with 5.5, single mmap with 5.4
+        if (!(params.features & IORING_FEAT_SUBMIT_STABLE) ||
+            !(params.features & IORING_FEAT_SINGLE_MMAP))
+            return NULL;
+
+        r->ringBytes = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        r->ring = mmap(NULL, r->ringBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       r->fd, IORING_OFF_SQ_RING);
+        if (r->ring == MAP_FAILED)
+            return NULL;
+
+        r->sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(NULL, r->sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          r->fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return NULL;
+        r->sqes = static_cast<io_uring_sqe*>(sqes);
+
+        char* base = static_cast<char*>(r->ring);
+        r->sqTailShared = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        r->sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        r->sqMask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        r->sqTail = *r->sqTailShared;
+        r->cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        r->cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        r->cqMask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        r->cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+        void* buffer;
+        if (posix_memalign(&buffer, 4096, kBufferBytes) != 0)
+            return NULL;
+        ring->_buffer = static_cast<char*>(buffer);
+
+        iovec registered;
+        registered.iov_base = buffer;
+        registered.iov_len = kBufferBytes;
+        r->fixedBuffer = ioUringRegister(r->fd, IORING_REGISTER_BUFFERS, &registered, 1) == 0;
+
+        return ring.release();
+    }
+
+    bool IoUring::isSupported() {
+        static const bool supported = boost::scoped_ptr<IoUring>(create(-1)).get() != NULL;
+        return supported;
+    }
+
+    size_t IoUring::take(char* buf, size_t len) {
+        const size_t n = std::min(len, buffered());
+        memcpy(buf, _buffer + _begin, n);
+        _begin += n;
+        return n;
+    }
+
+    unsigned IoUring::_queueRead(double timeoutSecs) {
+        if (_begin == _end)
+            _begin = _end = 0;
+
+        io_uring_sqe* sqe = _rings->nextSqe();
+        sqe->fd = _fd;
+        sqe->user_data = kRead;
+        if (_rings->fixedBuffer) {
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->addr = reinterpret_cast<unsigned long>(_buffer + _end);
+            sqe->len = kBufferBytes - _end;
+            sqe->buf_index = 0;
+        }
+        else {
+            _rings->readIov.iov_base = _buffer + _end;
+            _rings->readIov.iov_len = kBufferBytes - _end;
+            sqe->opcode = IORING_OP_READV;
+            sqe->addr = reinterpret_cast<unsigned long>(&_rings->readIov);
+            sqe->len = 1;
+        }
+
+        if (timeoutSecs <= 0)
+            return 1;
+
+        // SO_RCVTIMEO doesn't apply to io_uring reads
+        sqe->flags |= IOSQE_IO_LINK;
+        _rings->timeout.tv_sec = static_cast<long long>(timeoutSecs);
+        _rings->timeout.tv_nsec =
+            static_cast<long long>((timeoutSecs - _rings->timeout.tv_sec) * 1e9);
+
+        io_uring_sqe* timeout = _rings->nextSqe();
+        timeout->opcode = IORING_OP_LINK_TIMEOUT;
+        timeout->fd = -1;
+        timeout->addr = reinterpret_cast<unsigned long>(&_rings->timeout);
+        timeout->len = 1;
+        timeout->user_data = kReadTimeout;
+        return 2;
+    }
+
+    int IoUring::_submitAndWait(unsigned count) {
+        _rings->sendResult = 0;
+        _rings->readResult = 0;
+        _rings->timeoutResult = 0;
+        __atomic_store_n(_rings->sqTailShared, _rings->sqTail, __ATOMIC_RELEASE);
+
+        unsigned toSubmit = count;
+        unsigned completed = 0;
+        while (completed < count) {
+            const int ret = ioUringEnter(_rings->fd, toSubmit, count - completed);
+            _enterCalls++;
+            if (ret < 0) {
+                if (errno == EINTR)
+                    continue;
+                return -errno;
+            }
+            toSubmit -= std::min(toSubmit, static_cast<unsigned>(ret));
+
+            unsigned head = *_rings->cqHead;
+            const unsigned tail = __atomic_load_n(_rings->cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++, completed++) {
+                const io_uring_cqe& cqe = _rings->cqes[head & _rings->cqMask];
+                if (cqe.user_data == kSend)
+                    _rings->sendResult = cqe.res;
+                else if (cqe.user_data == kRead)
+                    _rings->readResult = cqe.res;
+                else
+                    _rings->timeoutResult = cqe.res;
+            }
+            __atomic_store_n(_rings->cqHead, head, __ATOMIC_RELEASE);
+        }
+
+        if (_rings->readResult > 0)
+            _end += _rings->readResult;
+        else if (_rings->readResult == -ECANCELED && _rings->timeoutResult == -ETIME)
+            _rings->readResult = -EAGAIN;
+        return 0;
+    }
+
+    int IoUring::fill(double timeoutSecs) {
+        if (_haveReadResult) {
+            _haveReadResult = false;
+            return _readResult;
+        }
+
+        const int ret = _submitAndWait(_queueRead(timeoutSecs));
+        return ret < 0 ? ret : _rings->readResult;
+    }
+
+    int IoUring::sendAndFill(const std::vector< std::pair< char *, int > >& data,
+                             double timeoutSecs) {
+        verify(buffered() == 0 && !_haveReadResult);
+
+        size_t total = 0;
+        _rings->iov.clear();
+        for (std::vector< std::pair< char *, int > >::const_iterator i = data.begin();
+             i != data.end(); ++i) {
+            if (i->second <= 0)
+                continue;
+            iovec v;
+            v.iov_base = i->first;
+            v.iov_len = i->second;
+            _rings->iov.push_back(v);
+            total += i->second;
+        }
+        if (_rings->iov.empty())
+            return 0;
+
+        memset(&_rings->message, 0, sizeof(_rings->message));
+        _rings->message.msg_iov = &_rings->iov[0];
+        _rings->message.msg_iovlen = _rings->iov.size();
+
+        io_uring_sqe* sqe = _rings->nextSqe();
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = _fd;
+        sqe->addr = reinterpret_cast<unsigned long>(&_rings->message);
+        sqe->len = 1;
+        // WAITALL makes a short send break the link, otherwise the read would wait forever
+        // on a reply to a request the server never got all of
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = kSend;
+
+        const int ret = _submitAndWait(1 + _queueRead(timeoutSecs));
+        if (ret < 0)
+            return ret;
+
+        // Data read is already in the buffer, only a failure needs reporting
+        if (_rings->sendResult == static_cast<int>(total) && _rings->readResult <= 0) {
+            _haveReadResult = true;
+            _readResult = _rings->readResult;
+        }
+        return _rings->sendResult;
+    }
+
+#else // MONGO_HAVE_LINUX_IO_URING
+
+    struct IoUring::Rings {};
+
+    IoUring::IoUring() {}
+
+    IoUring::~IoUring() {}
+
+    IoUring* IoUring::create(int fd) {
+        return NULL;
+    }
+
+    bool IoUring::isSupported() {
+        return false;
+    }
+
+    size_t IoUring::take(char* buf, size_t len) {
+        return 0;
+    }
+
+    int IoUring::fill(double timeoutSecs) {
+        return 0;
+    }
+
+    int IoUring::sendAndFill(const std::vector< std::pair< char *, int > >& data,
+                             double timeoutSecs) {
+        return 0;
+    }
+
+#endif // MONGO_HAVE_LINUX_IO_URING
+
+} // namespace mongo
@@ -0,0 +1,92 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/utility.hpp>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace mongo {
+
+    /**
+     * An io_uring instance driving the reads, and optionally the sends, of one blocking
+     * socket. Data is received ahead into a buffer registered with the kernel, so a message
+     * header and body usually arrive in one read, and a request can be sent with the read of
+     * its reply linked behind it: one io_uring_enter for a round trip that would otherwise
+     * take a sendmsg and two recvs.
+     *
+     * Built only on Linux when <linux/io_uring.h> is available (MONGO_HAVE_LINUX_IO_URING);
+     * create() returns NULL elsewhere, or when the running kernel lacks the features used.
+     * Not thread safe, like Socket.
+     */
+    class IoUring : boost::noncopyable {
+    public:
+        static const int kBufferBytes;
+
+        /** A ring for 'fd', or NULL if io_uring can't be used. */
+        static IoUring* create(int fd);
+
+        /** True if create() can succeed in this process, checked once. */
+        static bool isSupported();
+
+        ~IoUring();
+
+        /** Bytes received ahead and not yet taken. */
+        size_t buffered() const { return _end - _begin; }
+
+        /** Moves up to 'len' buffered bytes into 'buf', returns how many. */
+        size_t take(char* buf, size_t len);
+
+        /**
+         * Waits until some data is buffered. Returns the bytes read, 0 if the peer closed the
+         * connection, or -errno; a read cut short by 'timeoutSecs' fails with -EAGAIN.
+         */
+        int fill(double timeoutSecs);
+
+        /**
+         * Sends all of 'data', and if that succeeds reads into the buffer, with a single
+         * io_uring_enter. Returns the bytes sent or -errno; a short count means the send must
+         * be finished by the caller. The outcome of the read is returned by the next fill().
+         */
+        int sendAndFill(const std::vector< std::pair< char *, int > >& data, double timeoutSecs);
+
+        /** io_uring_enter calls made, for comparing with plain socket syscalls. */
+        long long enterCalls() const { return _enterCalls; }
+
+    private:
+        IoUring();
+
+        struct Rings;
+
+        // Queues a read of the free part of the buffer, with a timeout when 'timeoutSecs' > 0
+        unsigned _queueRead(double timeoutSecs);
+        int _submitAndWait(unsigned count);
+
+        int _fd;
+        Rings* _rings;
+        char* _buffer;
+        size_t _begin;
+        size_t _end;
+
+        // Failure of a read started by sendAndFill(), returned by the next fill()
+        bool _haveReadResult;
+        int _readResult;
+
+        long long _enterCalls;
+    };
+
+} // namespace mongo
@@ -17,11 +17,13 @@
 
 #pragma once
 
+#include <boost/shared_ptr.hpp>
 #include <vector>
 
 #include "mongo/platform/atomic_word.h"
 #include "mongo/platform/cstdint.h"
 #include "mongo/util/goodies.h"
+#include "mongo/util/memory_budget.h"
 #include "mongo/util/net/hostandport.h"
 #include "mongo/util/net/operation.h"
 #include "mongo/util/net/sock.h"
@@ -143,12 +145,12 @@ namespace mongo {
     class Message {
     public:
         // we assume here that a vector with initial size 0 does no allocation (0 is the default, but wanted to make it explicit).
-        Message() : _buf( 0 ), _data( 0 ), _freeIt( false ) {}
+        Message() : _buf( 0 ), _data( 0 ), _freeIt( false ), _charged( 0 ) {}
         Message( void * data , bool freeIt ) :
-            _buf( 0 ), _data( 0 ), _freeIt( false ) {
+            _buf( 0 ), _data( 0 ), _freeIt( false ), _charged( 0 ) {
             _setData( reinterpret_cast< MsgData* >( data ), freeIt );
         };
-        Message(Message& r) : _buf( 0 ), _data( 0 ), _freeIt( false ) {
+        Message(Message& r) : _buf( 0 ), _data( 0 ), _freeIt( false ), _charged( 0 ) {
             *this = r;
         }
         ~Message() {
@@ -220,6 +222,9 @@ namespace mongo {
             }
             r._freeIt = false;
             _freeIt = true;
+            _budget.swap( r._budget );
+            _charged = r._charged;
+            r._charged = 0;
             return *this;
         }
 
@@ -236,6 +241,25 @@ namespace mongo {
             _buf = 0;
             _data.clear();
             _freeIt = false;
+            if ( _charged ) {
+                _budget->release( _charged );
+                _budget.reset();
+                _charged = 0;
+            }
+        }
+
+        /**
+         * Accounts 'bytes' against 'budget' until this message is reset or destroyed. Used
+         * for buffers allocated on receive so the driver knows how much reply data it holds.
+         */
+        void chargeTo( const boost::shared_ptr<MemoryBudget>& budget, long long bytes ) {
+            verify( !_charged );
+            if ( !budget || bytes <= 0 ) {
+                return;
+            }
+            budget->charge( bytes );
+            _budget = budget;
+            _charged = bytes;
         }
 
         // use to add a buffer
@@ -282,6 +306,16 @@ namespace mongo {
         }
 
         void send( MessagingPort &p, const char *context );
+
+        // adds this message's buffers to 'buffers', for sending several messages at once
+        void appendBuffers( std::vector< std::pair< char *, int > > &buffers ) const {
+            if ( _buf ) {
+                buffers.push_back( std::make_pair( (char*)_buf, _buf->len ) );
+            }
+            else {
+                buffers.insert( buffers.end(), _data.begin(), _data.end() );
+            }
+        }
         
         std::string toString() const;
 
@@ -296,6 +330,9 @@ namespace mongo {
         typedef std::vector< std::pair< char*, int > > MsgVec;
         MsgVec _data;
         bool _freeIt;
+        // memory accounting for buffers we own, see chargeTo()
+        boost::shared_ptr<MemoryBudget> _budget;
+        long long _charged;
     };
 
 
@@ -25,6 +25,7 @@
 #include <set>
 #include <time.h>
 
+#include "mongo/client/operation_trace.h"
 #include "mongo/client/options.h"
 #include "mongo/util/background.h"
 #include "mongo/util/goodies.h"
@@ -46,9 +47,12 @@ namespace mongo {
     using std::dec;
     using std::endl;
     using std::hex;
+    using std::make_pair;
+    using std::pair;
     using std::set;
     using std::string;
     using std::stringstream;
+    using std::vector;
 
 // if you want trace output:
 #define mmm(x)
@@ -60,6 +64,9 @@ namespace mongo {
 
     /* messagingport -------------------------------------------------------------- */
 
+    const int MessagingPort::kCorkCopyBytes = 16 * 1024;
+    const int MessagingPort::kCorkBufferBytes = 64 * 1024;
+
     class PiggyBackData {
     public:
         PiggyBackData( MessagingPort * port ) {
@@ -95,6 +102,9 @@ namespace mongo {
 
         int len() const { return _cur - _buf; }
 
+        const char* data() const { return _buf; }
+        void clear() { _cur = _buf; }
+
     private:
         MessagingPort* _port;
         char * _buf;
@@ -133,18 +143,20 @@ namespace mongo {
     }
 
     MessagingPort::MessagingPort(int fd, const SockAddr& remote) 
-        : psock( new Socket( fd , remote ) ) , piggyBackData(0) {
+        : psock( new Socket( fd , remote ) ) , piggyBackData(0), _corked(false),
+          _memoryBudget( MemoryBudget::global() ) {
         ports.insert(this);
     }
 
     MessagingPort::MessagingPort( double timeout, logger::LogSeverity ll ) 
-        : psock( new Socket( timeout, ll ) ) {
+        : psock( new Socket( timeout, ll ) ), _corked( false ),
+          _memoryBudget( MemoryBudget::global() ) {
         ports.insert(this);
         piggyBackData = 0;
     }
 
     MessagingPort::MessagingPort( boost::shared_ptr<Socket> sock )
-        : psock( sock ), piggyBackData( 0 ) {
+        : psock( sock ), piggyBackData( 0 ), _corked( false ), _memoryBudget( MemoryBudget::global() ) {
         ports.insert(this);
     }
 
@@ -157,6 +169,7 @@ namespace mongo {
     }
 
     MessagingPort::~MessagingPort() {
+        DESTRUCTOR_GUARD( _sendCorked( false ); );
         if ( piggyBackData )
             delete( piggyBackData );
         shutdown();
@@ -165,11 +178,19 @@ namespace mongo {
     
     bool MessagingPort::recv(Message& m) {
         try {
+            {
+                // whatever was held back is what we are waiting on a reply to
+                OperationTrace::Timer sendTimer( OperationTrace::kSend );
+                _sendCorked( false );
+            }
 again:
             //mmm( log() << "*  recv() sock:" << this->sock << endl; )
             MSGHEADER header;
             int headerLen = sizeof(MSGHEADER);
-            psock->recv( (char *)&header, headerLen );
+            {
+                OperationTrace::Timer serverTimer( OperationTrace::kServer );
+                psock->recv( (char *)&header, headerLen );
+            }
             int len = header.messageLength; 
 
             if ( len == 542393671 ) {
@@ -227,10 +248,14 @@ again:
             memcpy(md, &header, headerLen);
             int left = len - headerLen;
 
-            psock->recv( (char *)&md->_data, left );
+            {
+                OperationTrace::Timer receiveTimer( OperationTrace::kReceive );
+                psock->recv( (char *)&md->_data, left );
+            }
 
             guard.Dismiss();
             m.setData(md, true);
+            m.chargeTo(_memoryBudget, z);
             return true;
 
         }
@@ -254,7 +279,19 @@ again:
 
     bool MessagingPort::call(Message& toSend, Message& response) {
         mmm( log() << "*call()" << endl; )
-        say(toSend);
+        if ( psock->usesIoUring() && !_corked && !( piggyBackData && piggyBackData->len() ) ) {
+            // lets the socket read the reply in the same system call
+            toSend.header()->id = nextMessageId();
+            toSend.header()->responseTo = 0;
+
+            vector< pair< char *, int > > buffers;
+            toSend.appendBuffers( buffers );
+            OperationTrace::Timer sendTimer( OperationTrace::kSend );
+            psock->sendExpectingReply( buffers, "call" );
+        }
+        else {
+            say(toSend);
+        }
         return recv( toSend , response );
     }
 
@@ -287,6 +324,12 @@ again:
         mmm( log() << "*  say()  thr:" << GetCurrentThreadId() << endl; )
         toSend.header()->id = nextMessageId();
         toSend.header()->responseTo = responseTo;
+        OperationTrace::Timer sendTimer( OperationTrace::kSend );
+
+        if ( _corked ) {
+            _sayCorked( toSend );
+            return;
+        }
 
         if ( piggyBackData && piggyBackData->len() ) {
             mmm( log() << "*     have piggy back" << endl; )
@@ -306,7 +349,7 @@ again:
 
     void MessagingPort::piggyBack( Message& toSend , int responseTo ) {
 
-        if ( toSend.header()->len > 1300 ) {
+        if ( _corked || toSend.header()->len > 1300 ) {
             // not worth saving because its almost an entire packet
             say( toSend );
             return;
@@ -322,6 +365,75 @@ again:
         piggyBackData->append( toSend );
     }
 
+    void MessagingPort::_sayCorked( Message& toSend ) {
+        // lazy killCursors queued before corking go first, like they would uncorked
+        if ( piggyBackData && piggyBackData->len() ) {
+            _corkBuffer.insert( _corkBuffer.end(),
+                                piggyBackData->data(),
+                                piggyBackData->data() + piggyBackData->len() );
+            piggyBackData->clear();
+        }
+
+        vector< pair< char *, int > > buffers;
+        toSend.appendBuffers( buffers );
+
+        if ( toSend.size() > kCorkCopyBytes ) {
+            // not worth copying, send it behind what is held in the same call
+            if ( !_corkBuffer.empty() ) {
+                buffers.insert( buffers.begin(),
+                                make_pair( &_corkBuffer[0], int( _corkBuffer.size() ) ) );
+            }
+            _corkBuffer.clear();
+            psock->send( buffers, "say" );
+            return;
+        }
+
+        if ( _corkBuffer.size() + toSend.size() > size_t( kCorkBufferBytes ) ) {
+            // this message stays held, so a later send pushes out any partial packet
+            _sendCorked( true );
+        }
+
+        if ( _corkBuffer.capacity() == 0 )
+            _corkBuffer.reserve( kCorkBufferBytes );
+        for ( vector< pair< char *, int > >::const_iterator i = buffers.begin();
+              i != buffers.end(); ++i ) {
+            _corkBuffer.insert( _corkBuffer.end(), i->first, i->first + i->second );
+        }
+    }
+
+    void MessagingPort::_sendCorked( bool more ) {
+        if ( _corkBuffer.empty() )
+            return;
+
+        vector< pair< char *, int > > buffers;
+        buffers.push_back( make_pair( &_corkBuffer[0], int( _corkBuffer.size() ) ) );
+
+        try {
+            psock->send( buffers, "flush", more );
+        }
+        catch ( ... ) {
+            // a failed send leaves the connection unusable, don't try again later
+            _corkBuffer.clear();
+            throw;
+        }
+        _corkBuffer.clear();
+    }
+
+    void MessagingPort::flush() {
+        _sendCorked( false );
+    }
+
+    void MessagingPort::uncork() {
+        _corked = false;
+        _sendCorked( false );
+    }
+
+    ScopedCork::~ScopedCork() {
+        if ( !_wasCorked ) {
+            DESTRUCTOR_GUARD( _port.uncork(); );
+        }
+    }
+
     HostAndPort MessagingPort::remote() const {
         if ( ! _remoteParsed.hasPort() )
             _remoteParsed = HostAndPort( psock->remoteAddr() );
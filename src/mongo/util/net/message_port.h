@@ -80,6 +80,14 @@ namespace mongo {
 
         void setSocketTimeout(double timeout);
 
+        /**
+         * Budget charged for the buffers of messages received on this port. Defaults to
+         * MemoryBudget::global().
+         */
+        void setMemoryBudget(const boost::shared_ptr<MemoryBudget>& budget) {
+            _memoryBudget = budget;
+        }
+
         void shutdown();
 
         /* it's assumed if you reuse a message object, that it doesn't cross MessagingPort's.
@@ -105,6 +113,21 @@ namespace mongo {
 
         void piggyBack( Message& toSend , int responseTo = 0 );
 
+        /**
+         * Holds back messages said on this port until flush(), uncork() or the next recv(),
+         * then sends them with one call, so a pipelined run of small messages costs one
+         * syscall and a few packets rather than one of each per message. Messages larger
+         * than kCorkCopyBytes are not copied: they go out at once, gathered with those held.
+         * Send errors surface from the call that flushes.
+         */
+        void cork() { _corked = true; }
+        void uncork();
+        void flush();
+        bool isCorked() const { return _corked; }
+
+        static const int kCorkCopyBytes;
+        static const int kCorkBufferBytes;
+
         unsigned remotePort() const { return psock->remotePort(); }
         virtual HostAndPort remote() const;
         virtual SockAddr remoteAddr() const;
@@ -143,9 +166,17 @@ namespace mongo {
         }
 
     private:
-        
+        void _sayCorked( Message& toSend );
+        void _sendCorked( bool more );
+
         PiggyBackData * piggyBackData;
 
+        // Messages held while corked
+        bool _corked;
+        std::vector<char> _corkBuffer;
+
+        boost::shared_ptr<MemoryBudget> _memoryBudget;
+
         // this is the parsed version of remote
         // mutable because its initialized only on call to remote()
         mutable HostAndPort _remoteParsed; 
@@ -156,5 +187,19 @@ namespace mongo {
         friend class PiggyBackData;
     };
 
+    /** Corks a port for the lifetime of this object, see MessagingPort::cork(). */
+    class ScopedCork : boost::noncopyable {
+    public:
+        explicit ScopedCork( MessagingPort& port ) : _port( port ), _wasCorked( port.isCorked() ) {
+            _port.cork();
+        }
+
+        ~ScopedCork();
+
+    private:
+        MessagingPort& _port;
+        const bool _wasCorked;
+    };
+
 
 } // namespace mongo
@@ -21,6 +21,7 @@
 
 #if !defined(_WIN32)
 # include <sys/socket.h>
+# include <sys/stat.h>
 # include <sys/types.h>
 # include <sys/un.h>
 # include <netinet/in.h>
@@ -28,6 +29,7 @@
 # include <arpa/inet.h>
 # include <errno.h>
 # include <netdb.h>
+# include <unistd.h>
 # if defined(__openbsd__)
 #  include <sys/uio.h>
 # endif
@@ -38,9 +40,11 @@
 #include "mongo/util/debug_util.h"
 #include "mongo/util/fail_point_service.h"
 #include "mongo/util/mongoutils/str.h"
+#include "mongo/util/net/io_uring.h"
 #include "mongo/util/net/message.h"
 #include "mongo/util/net/ssl_manager.h"
 #include "mongo/util/net/socket_poll.h"
+#include "mongo/util/operation_deadline.h"
 
 namespace mongo {
 
@@ -334,6 +338,24 @@ namespace mongo {
             return addr;
     }
    
+    string localUnixSocketPath(const string& host, int port, const string& prefix) {
+#ifdef _WIN32
+        return "";
+#else
+        if (host != "localhost" && host != "127.0.0.1" && host != "::1")
+            return "";
+
+        const string path = mongoutils::str::stream() << prefix << "/mongodb-" << port << ".sock";
+        struct stat st;
+        if (path.size() >= sizeof(sockaddr_un().sun_path) ||
+            ::stat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode) ||
+            ::access(path.c_str(), R_OK | W_OK) != 0) {
+            return "";
+        }
+        return path;
+#endif
+    }
+
     //  --- my --
 
     string getHostName() {
@@ -413,6 +435,8 @@ namespace mongo {
     void Socket::_init() {
         _bytesOut = 0;
         _bytesIn = 0;
+        _sendCalls = 0;
+        _recvCalls = 0;
         _awaitingHandshake = true;
 #ifdef MONGO_SSL
         _sslManager = 0;
@@ -439,6 +463,19 @@ namespace mongo {
             closesocket( _fd );
             _fd = -1;
         }
+        _ring.reset();
+    }
+
+    bool Socket::enableIoUring() {
+#ifdef MONGO_SSL
+        if ( _sslConnection.get() )
+            return false;
+#endif
+        if ( _fd < 0 )
+            return false;
+        if ( !_ring )
+            _ring.reset( IoUring::create( _fd ) );
+        return _ring.get() != NULL;
     }
 
 #ifdef MONGO_SSL
@@ -448,11 +485,21 @@ namespace mongo {
             return false;
         }
         _sslManager = mgr;
+        // reads must go through SSL from now on
+        _ring.reset();
         _sslConnection.reset(_sslManager->connect(this));
         mgr->parseAndValidatePeerCertificate(_sslConnection.get(), remoteHost);
         return true;
     }
 
+    bool Socket::usesKernelTLSSend() const {
+        return _sslConnection.get() && _sslConnection->kernelSend;
+    }
+
+    bool Socket::usesKernelTLSRecv() const {
+        return _sslConnection.get() && _sslConnection->kernelRecv;
+    }
+
     void Socket::secureAccepted( SSLManagerInterface* ssl ) { 
         _sslManager = ssl;
     }
@@ -503,7 +550,12 @@ namespace mongo {
             setTimeout( _timeout );
         }
 
-        static const unsigned int connectTimeoutMillis = 5000;
+        unsigned int connectTimeoutMillis = 5000;
+        const long long deadlineMillis = OperationDeadline::remainingMillis();
+        if ( deadlineMillis >= 0 && deadlineMillis < connectTimeoutMillis ) {
+            connectTimeoutMillis = std::max( 1LL, deadlineMillis );
+        }
+
         ConnectBG bg(_fd, remote);
         bg.go();
         if ( bg.wait(connectTimeoutMillis) ) {
@@ -545,8 +597,9 @@ namespace mongo {
 
     // throws if SSL_write or send fails 
     int Socket::_send( const char * data , int len, const char * context ) {
+        _sendCalls++;
 #ifdef MONGO_SSL
-        if ( _sslConnection.get() ) {
+        if ( _sslConnection.get() && !_sslConnection->kernelSend ) {
             return _sslManager->SSL_write( _sslConnection.get() , data , len );
         }
 #endif
@@ -595,10 +648,11 @@ namespace mongo {
     /** sends all data or throws an exception
      * @param context descriptive for logging
      */
-    void Socket::send( const vector< pair< char *, int > > &data, const char *context ) {
+    void Socket::send( const vector< pair< char *, int > > &data, const char *context,
+                       bool more ) {
 
 #ifdef MONGO_SSL
-        if ( _sslConnection.get() ) {
+        if ( _sslConnection.get() && !_sslConnection->kernelSend ) {
             _send( data , context );
             return;
         }
@@ -625,6 +679,12 @@ namespace mongo {
         meta.msg_iov = &d[ 0 ];
         meta.msg_iovlen = d.size();
 
+        int flags = portSendFlags;
+#ifdef MSG_MORE
+        if ( more )
+            flags |= MSG_MORE;
+#endif
+
         while( meta.msg_iovlen > 0 ) {
             int ret = -1;
             if (MONGO_FAIL_POINT(throwSockExcep)) {
@@ -635,7 +695,8 @@ namespace mongo {
 #endif
             }
             else {
-                ret = ::sendmsg(_fd, &meta, portSendFlags);
+                _sendCalls++;
+                ret = ::sendmsg(_fd, &meta, flags);
             }
 
             if (ret == -1) {
@@ -669,6 +730,47 @@ namespace mongo {
 #endif
     }
 
+    void Socket::sendExpectingReply( const vector< pair< char *, int > > &data,
+                                     const char *context ) {
+        int len = 0;
+        for ( vector< pair< char *, int > >::const_iterator i = data.begin();
+              i != data.end(); ++i ) {
+            len += i->second;
+        }
+
+        // Bigger requests might not fit in the socket buffer, and the read timeout doesn't
+        // bound a blocked io_uring send
+        if ( !_ring || _ring->buffered() || len > IoUring::kBufferBytes ||
+             MONGO_FAIL_POINT(throwSockExcep) ) {
+            send( data, context );
+            return;
+        }
+
+        _sendCalls++;
+        const int ret = _ring->sendAndFill( data, _timeout );
+        if ( ret < 0 ) {
+            errno = -ret;
+            handleSendError( -1, context );
+        }
+        _bytesOut += ret;
+
+        if ( ret < len ) {
+            // the read was cancelled with the rest of the link, send what's left normally
+            vector< pair< char *, int > > rest;
+            int skip = ret;
+            for ( vector< pair< char *, int > >::const_iterator i = data.begin();
+                  i != data.end(); ++i ) {
+                if ( skip >= i->second ) {
+                    skip -= i->second;
+                    continue;
+                }
+                rest.push_back( std::make_pair( i->first + skip, i->second - skip ) );
+                skip = 0;
+            }
+            send( rest, context );
+        }
+    }
+
     void Socket::recv( char * buf , int len ) {
         while( len > 0 ) {
             int ret = -1;
@@ -701,8 +803,33 @@ namespace mongo {
 
     // throws if SSL_read fails or recv returns an error
     int Socket::_recv( char *buf, int max ) {
+        if ( _ring ) {
+            if ( !_ring->buffered() ) {
+                _recvCalls++;
+                const int ret = _ring->fill( _timeout );
+                if ( ret <= 0 ) {
+                    errno = -ret;
+                    handleRecvError( ret, max );
+                    return 0;
+                }
+            }
+            return _ring->take( buf, max );
+        }
+
+        _recvCalls++;
 #ifdef MONGO_SSL
         if ( _sslConnection.get() ){
+            if ( _sslConnection->kernelRecv && ::SSL_pending( _sslConnection->ssl ) == 0 ) {
+                const int ret = ::recv( _fd , buf , max , portRecvFlags );
+                if ( ret > 0 )
+                    return ret;
+                // EIO is a record other than application data, such as a session ticket,
+                // which only OpenSSL can take off the socket
+                if ( ret == 0 || errno != EIO ) {
+                    handleRecvError( ret, max );
+                    return 0;
+                }
+            }
             return _sslManager->SSL_read( _sslConnection.get() , buf , max );
         }
 #endif
@@ -770,6 +897,7 @@ namespace mongo {
     }
 
     void Socket::setTimeout( double secs ) {
+        _timeout = secs;
         setSockTimeouts( _fd, secs );
     }
 
@@ -53,6 +53,8 @@ namespace mongo {
     class SSLConnection;
 #endif
 
+    class IoUring;
+
     extern const int portSendFlags;
     extern const int portRecvFlags;
 
@@ -85,6 +87,14 @@ namespace mongo {
     // in, look up its ip and return that.  Returns "" on failure.
     std::string hostbyname(const char *hostname);
 
+    /**
+     * @return the unix domain socket a server on this machine listening on 'port' creates
+     *     under 'prefix', if 'host' names the loopback interface and that socket exists and
+     *     is readable and writable by this process, or "" otherwise.
+     */
+    std::string localUnixSocketPath(const std::string& host, int port,
+                                    const std::string& prefix);
+
     void enableIPv6(bool state=true);
     bool IPv6Enabled();
     void setSockTimeouts(int sock, double secs);
@@ -201,7 +211,21 @@ namespace mongo {
         bool connect(SockAddr& farEnd);
         void close();
         void send( const char * data , int len, const char *context );
-        void send( const std::vector< std::pair< char *, int > > &data, const char *context );
+
+        /**
+         * Sends all the buffers with a single sendmsg where available. If 'more' is set, tells
+         * the kernel more data follows shortly so it can hold back a partial packet (MSG_MORE,
+         * Linux only).
+         */
+        void send( const std::vector< std::pair< char *, int > > &data, const char *context,
+                   bool more = false );
+
+        /**
+         * Sends a request that is answered by the next data received. With the io_uring
+         * backend small requests go out with the read of the reply, in one system call.
+         */
+        void sendExpectingReply( const std::vector< std::pair< char *, int > > &data,
+                                 const char *context );
 
         // recv len or throw SocketException
         void recv( char * data , int len );
@@ -216,14 +240,24 @@ namespace mongo {
 
         SockAddr localAddr() const { return _local; }
 
-        void clearCounters() { _bytesIn = 0; _bytesOut = 0; }
+        void clearCounters() { _bytesIn = 0; _bytesOut = 0; _sendCalls = 0; _recvCalls = 0; }
         long long getBytesIn() const { return _bytesIn; }
         long long getBytesOut() const { return _bytesOut; }
+        long long getSendCalls() const { return _sendCalls; }
+        long long getRecvCalls() const { return _recvCalls; }
         int rawFD() const { return _fd; }
 
         void setTimeout( double secs );
         bool isStillConnected();
 
+        /**
+         * Moves receiving, and sending of requests that expect a reply, to io_uring (Linux
+         * 5.5+). Returns false, leaving the socket as it was, where io_uring isn't available
+         * or the socket uses SSL. Securing the socket later switches back.
+         */
+        bool enableIoUring();
+        bool usesIoUring() const { return _ring.get() != NULL; }
+
         void setHandshakeReceived() {
             _awaitingHandshake = false;
         }
@@ -240,6 +274,13 @@ namespace mongo {
         bool secure( SSLManagerInterface* ssl, const std::string& remoteHost);
 
         void secureAccepted( SSLManagerInterface* ssl );
+
+        /**
+         * True if the session was handed to the kernel (Options::setSSLKernelOffload), so
+         * sends, or receives, are plain socket calls.
+         */
+        bool usesKernelTLSSend() const;
+        bool usesKernelTLSRecv() const;
 #endif
         
         /**
@@ -285,6 +326,8 @@ namespace mongo {
 
         long long _bytesIn;
         long long _bytesOut;
+        long long _sendCalls;
+        long long _recvCalls;
         time_t _lastValidityCheckAtSecs;
 
 #ifdef MONGO_SSL
@@ -292,6 +335,9 @@ namespace mongo {
         SSLManagerInterface* _sslManager;
 #endif
         logger::LogSeverity _logLevel; // passed to log() when logging errors
+
+        // Set by enableIoUring()
+        boost::scoped_ptr<IoUring> _ring;
  
         /** true until the first packet has been received or an outgoing connect has been made */
         bool _awaitingHandshake;
@@ -20,15 +20,20 @@
 #include <boost/thread.hpp>
 
 #ifndef _WIN32
+#include <fcntl.h>
 #include <netdb.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
 #endif
 
 #include "mongo/unittest/unittest.h"
 #include "mongo/util/concurrency/synchronization.h"
 #include "mongo/util/fail_point_service.h"
 #include "mongo/util/log.h"
+#include "mongo/util/net/io_uring.h"
+#include "mongo/util/net/message_port.h"
 
 namespace {
 
@@ -331,5 +336,232 @@ namespace {
         ASSERT_TRUE(tryRecv());
     }
 
+    class CorkedPortTest : public unittest::Test {
+    public:
+        CorkedPortTest() : _sockets(socketPair(SOCK_STREAM)), _port(_sockets.first) {}
+
+        void say(int bytes) {
+            Message m;
+            m.setData(dbMsg, std::string(bytes, 'x').c_str());
+            _port.say(m);
+        }
+
+        // Reads the next message from the peer and returns its length
+        int peerRecv() {
+            MSGHEADER header;
+            _sockets.second->recv(reinterpret_cast<char*>(&header), sizeof(header));
+            std::vector<char> body(header.messageLength - sizeof(header));
+            _sockets.second->recv(&body[0], body.size());
+            return header.messageLength;
+        }
+
+        long long sendCalls() const { return _sockets.first->getSendCalls(); }
+
+        const SocketPair _sockets;
+        MessagingPort _port;
+    };
+
+    TEST_F(CorkedPortTest, FlushSendsHeldMessagesTogether) {
+        _port.cork();
+        for (int i = 0; i < 10; i++)
+            say(100);
+        ASSERT_EQUALS(0, sendCalls());
+
+        _port.flush();
+        ASSERT_EQUALS(1, sendCalls());
+        for (int i = 0; i < 10; i++)
+            ASSERT_EQUALS(117, peerRecv());
+
+        // still corked
+        say(100);
+        ASSERT_EQUALS(1, sendCalls());
+        _port.uncork();
+        ASSERT_EQUALS(2, sendCalls());
+        ASSERT_EQUALS(117, peerRecv());
+
+        say(100);
+        ASSERT_EQUALS(3, sendCalls());
+        ASSERT_EQUALS(117, peerRecv());
+    }
+
+    TEST_F(CorkedPortTest, RecvFlushes) {
+        Message reply;
+        reply.setData(opReply, "reply");
+        _sockets.second->send(reinterpret_cast<char*>(reply.singleData()), reply.size(), "reply");
+
+        ScopedCork cork(_port);
+        say(10);
+        ASSERT_EQUALS(0, sendCalls());
+
+        Message received;
+        ASSERT_TRUE(_port.recv(received));
+        ASSERT_EQUALS(opReply, received.operation());
+        ASSERT_EQUALS(1, sendCalls());
+        ASSERT_EQUALS(27, peerRecv());
+    }
+
+    TEST_F(CorkedPortTest, LargeMessagesAreSentRightAway) {
+        _port.cork();
+        say(100);
+        say(MessagingPort::kCorkCopyBytes);
+        ASSERT_EQUALS(1, sendCalls());
+        ASSERT_EQUALS(117, peerRecv());
+        ASSERT_EQUALS(MessagingPort::kCorkCopyBytes + 17, peerRecv());
+
+        // a full buffer is sent and the message that didn't fit is held
+        const int perMessage = 1000 + 17;
+        const int fit = MessagingPort::kCorkBufferBytes / perMessage;
+        for (int i = 0; i <= fit; i++)
+            say(1000);
+        ASSERT_EQUALS(2, sendCalls());
+        _port.flush();
+        ASSERT_EQUALS(3, sendCalls());
+        for (int i = 0; i <= fit; i++)
+            ASSERT_EQUALS(perMessage, peerRecv());
+    }
+
+    TEST_F(CorkedPortTest, ScopedCorkUncorksOnExit) {
+        {
+            ScopedCork cork(_port);
+            say(10);
+            ASSERT_EQUALS(0, sendCalls());
+        }
+        ASSERT_FALSE(_port.isCorked());
+        ASSERT_EQUALS(1, sendCalls());
+        ASSERT_EQUALS(27, peerRecv());
+    }
+
+    class IoUringSocketTest : public unittest::Test {
+    public:
+        IoUringSocketTest() : _sockets(socketPair(SOCK_STREAM)) {}
+
+        void setUp() {
+            _enabled = _sockets.first->enableIoUring();
+            ASSERT_EQUALS(IoUring::isSupported(), _enabled);
+        }
+
+        void peerSay(const std::string& text) {
+            Message m;
+            m.setData(opReply, text.c_str());
+            _sockets.second->send(reinterpret_cast<char*>(m.singleData()), m.size(), "peer");
+        }
+
+        const SocketPair _sockets;
+        bool _enabled;
+    };
+
+    TEST_F(IoUringSocketTest, RecvReadsAhead) {
+        if (!_enabled)
+            return;
+
+        peerSay("first");
+        peerSay("second");
+
+        MessagingPort port(_sockets.first);
+        Message first;
+        ASSERT_TRUE(port.recv(first));
+        ASSERT_EQUALS(std::string("first"), first.singleData()->_data);
+        Message second;
+        ASSERT_TRUE(port.recv(second));
+        ASSERT_EQUALS(std::string("second"), second.singleData()->_data);
+
+        // headers and bodies of both were read at once
+        ASSERT_EQUALS(1, _sockets.first->getRecvCalls());
+    }
+
+    TEST_F(IoUringSocketTest, CallReadsReplyWithTheSend) {
+        if (!_enabled)
+            return;
+
+        _sockets.first->setHandshakeReceived();
+        MessagingPort port(_sockets.first);
+        Message request;
+        request.setData(dbQuery, "request");
+
+        // the reply has to be queued first since the peer is this thread, so borrow the id
+        // the request will get
+        const MSGID id = nextMessageId() + 1;
+        Message reply;
+        reply.setData(opReply, "reply");
+        reply.header()->responseTo = id;
+        _sockets.second->send(reinterpret_cast<char*>(reply.singleData()), reply.size(), "peer");
+
+        Message response;
+        ASSERT_TRUE(port.call(request, response));
+        ASSERT_EQUALS(std::string("reply"), response.singleData()->_data);
+        ASSERT_EQUALS(1, _sockets.first->getSendCalls());
+        ASSERT_EQUALS(0, _sockets.first->getRecvCalls());
+
+        char received[64];
+        _sockets.second->recv(received, request.size());
+        ASSERT_EQUALS(0, memcmp(received, request.singleData(), request.size()));
+    }
+
+    TEST_F(IoUringSocketTest, RecvTimesOut) {
+        if (!_enabled)
+            return;
+
+        _sockets.first->setTimeout(0.05);
+        char byte;
+        try {
+            _sockets.first->recv(&byte, 1);
+            FAIL() << "expected a timeout";
+        }
+        catch (const SocketException& e) {
+            ASSERT_EQUALS(SocketException::RECV_TIMEOUT, e._type);
+        }
+    }
+
+    TEST_F(IoUringSocketTest, RecvSeesClose) {
+        if (!_enabled)
+            return;
+
+        _sockets.second->close();
+        char byte;
+        try {
+            _sockets.first->recv(&byte, 1);
+            FAIL() << "expected the connection to be closed";
+        }
+        catch (const SocketException& e) {
+            ASSERT_EQUALS(SocketException::CLOSED, e._type);
+        }
+    }
+
+#if !defined(_WIN32)
+    TEST(LocalUnixSocketPath, FindsTheSocketOfALoopbackServer) {
+        char dir[] = "/tmp/sock_test_XXXXXX";
+        ASSERT_TRUE(::mkdtemp(dir));
+        const std::string prefix = dir;
+        const std::string path = prefix + "/mongodb-27999.sock";
+
+        // No socket yet
+        ASSERT_EQUALS("", localUnixSocketPath("localhost", 27999, prefix));
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+        ASSERT_EQUALS(0, ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+
+        ASSERT_EQUALS(path, localUnixSocketPath("localhost", 27999, prefix));
+        ASSERT_EQUALS(path, localUnixSocketPath("127.0.0.1", 27999, prefix));
+        ASSERT_EQUALS(path, localUnixSocketPath("::1", 27999, prefix));
+        ASSERT_EQUALS("", localUnixSocketPath("db.example.com", 27999, prefix));
+        ASSERT_EQUALS("", localUnixSocketPath("localhost", 27998, prefix));
+
+        ::close(fd);
+        ::unlink(path.c_str());
+
+        // Only sockets count
+        const int file = ::open(path.c_str(), O_CREAT | O_WRONLY, 0600);
+        ASSERT_GREATER_THAN_OR_EQUALS(file, 0);
+        ::close(file);
+        ASSERT_EQUALS("", localUnixSocketPath("localhost", 27999, prefix));
+
+        ::unlink(path.c_str());
+        ::rmdir(dir);
+    }
+#endif
 
 } // namespace
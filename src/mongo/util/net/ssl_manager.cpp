@@ -140,7 +140,8 @@ namespace mongo {
                    const std::string& crlfile = "",
                    bool weakCertificateValidation = false,
                    bool allowInvalidCertificates = false,
-                   bool fipsMode = false) :
+                   bool fipsMode = false,
+                   bool kernelOffload = false) :
                 pemfile(pemfile),
                 pempwd(pempwd),
                 clusterfile(clusterfile),
@@ -149,7 +150,8 @@ namespace mongo {
                 crlfile(crlfile),
                 weakCertificateValidation(weakCertificateValidation),
                 allowInvalidCertificates(allowInvalidCertificates),
-                fipsMode(fipsMode) {};
+                fipsMode(fipsMode),
+                kernelOffload(kernelOffload) {};
 
             std::string pemfile;
             std::string pempwd;
@@ -160,6 +162,7 @@ namespace mongo {
             bool weakCertificateValidation;
             bool allowInvalidCertificates;
             bool fipsMode;
+            bool kernelOffload;
         };
 
         class SSLManager : public SSLManagerInterface {
@@ -208,6 +211,7 @@ namespace mongo {
             bool _validateCertificates;
             bool _weakValidation;
             bool _allowInvalidCertificates;
+            bool _kernelOffload;
             std::string _serverSubjectName;
             std::string _clientSubjectName;
 
@@ -298,7 +302,8 @@ namespace mongo {
                 options.SSLCRLFile(),
                 false, // server only parameter
                 options.SSLAllowInvalidCertificates(),
-                options.FIPSMode());
+                options.FIPSMode(),
+                options.SSLKernelOffload());
             theSSLManager = new SSLManager(params, isSSLServer);
         }
         return Status::OK();
@@ -337,7 +342,12 @@ namespace mongo {
     SSLConnection::SSLConnection(SSL_CTX* context, 
                                  Socket* sock, 
                                  const char* initialBytes, 
-                                 int len) : socket(sock) {
+                                 int len) :
+        networkBIO(NULL),
+        internalBIO(NULL),
+        socket(sock),
+        kernelSend(false),
+        kernelRecv(false) {
         // This just ensures that SSL multithreading support is set up for this thread,
         // if it's not already.
         SSLThreadInfo::get();
@@ -360,6 +370,27 @@ namespace mongo {
         }
     }
 
+    SSLConnection::SSLConnection(SSL_CTX* context, Socket* sock) :
+        networkBIO(NULL),
+        internalBIO(NULL),
+        socket(sock),
+        kernelSend(false),
+        kernelRecv(false) {
+        SSLThreadInfo::get();
+
+        ssl = SSL_new(context);
+
+        std::string sslErr = NULL != getSSLManager() ?
+            getSSLManager()->getSSLErrorMessage(ERR_get_error()) : "";
+        massert(17414, "Error creating new SSL object " + sslErr, ssl);
+
+        // OpenSSL only moves a session into the kernel when it owns the socket BIO
+        SSL_set_fd(ssl, sock->rawFD());
+#ifdef SSL_OP_ENABLE_KTLS
+        SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif
+    }
+
     SSLConnection::~SSLConnection() {
         if (ssl) {   // The internalBIO is automatically freed as part of SSL_free
             SSL_free(ssl);
@@ -374,7 +405,8 @@ namespace mongo {
     SSLManager::SSLManager(const Params& params, bool isServer) :
         _validateCertificates(false),
         _weakValidation(params.weakCertificateValidation),
-        _allowInvalidCertificates(params.allowInvalidCertificates) {
+        _allowInvalidCertificates(params.allowInvalidCertificates),
+        _kernelOffload(params.kernelOffload) {
 
         SSL_library_init();
         SSL_load_error_strings();
@@ -735,6 +767,21 @@ namespace mongo {
 
     bool SSLManager::_doneWithSSLOp(SSLConnection* conn, int status) {
         int sslErr = SSL_get_error(conn, status);
+        if (!conn->networkBIO) {
+            // OpenSSL reads and writes the blocking socket itself, so wanting to read or
+            // write again means the call was interrupted or the socket timed out
+            switch (sslErr) {
+                case SSL_ERROR_WANT_READ:
+                    conn->socket->handleRecvError(-1, 0);  // throws unless EINTR
+                    return false;
+                case SSL_ERROR_WANT_WRITE:
+                    if (errno != EINTR)
+                        conn->socket->handleSendError(-1, "");
+                    return false;
+                default:
+                    return true;
+            }
+        }
         switch (sslErr) {
             case SSL_ERROR_NONE:
                 _flushNetworkBIO(conn);     // success, flush network BIO before leaving
@@ -749,7 +796,9 @@ namespace mongo {
     }
 
     SSLConnection* SSLManager::connect(Socket* socket) {
-        SSLConnection* sslConn = new SSLConnection(_clientContext, socket, NULL, 0);
+        SSLConnection* sslConn = _kernelOffload ?
+            new SSLConnection(_clientContext, socket) :
+            new SSLConnection(_clientContext, socket, NULL, 0);
         ScopeGuard sslGuard = MakeGuard(::SSL_free, sslConn->ssl);
         ScopeGuard bioGuard = MakeGuard(::BIO_free, sslConn->networkBIO);
  
@@ -760,6 +809,16 @@ namespace mongo {
  
         if (ret != 1)
             _handleSSLError(SSL_get_error(sslConn, ret), ret);
+
+        if (_kernelOffload) {
+#ifdef SSL_OP_ENABLE_KTLS
+            sslConn->kernelSend = BIO_get_ktls_send(SSL_get_wbio(sslConn->ssl));
+            sslConn->kernelRecv = BIO_get_ktls_recv(SSL_get_rbio(sslConn->ssl));
+#endif
+            LOG(1) << "kernel TLS for " << socket->remoteString() << ": send "
+                   << (sslConn->kernelSend ? "on" : "off") << ", receive "
+                   << (sslConn->kernelRecv ? "on" : "off") << endl;
+        }
  
         sslGuard.Dismiss();
         bioGuard.Dismiss();
@@ -46,8 +46,19 @@ namespace mongo {
         BIO* internalBIO;
         Socket* socket;
 
+        // Set when OpenSSL handed the session to the kernel (kernel TLS), so the socket can
+        // be written or read directly
+        bool kernelSend;
+        bool kernelRecv;
+
         SSLConnection(SSL_CTX* ctx, Socket* sock, const char* initialBytes, int len); 
 
+        /**
+         * A connection on which OpenSSL reads and writes the socket itself rather than a BIO
+         * pair, as it must to enable kernel TLS; networkBIO and internalBIO are NULL.
+         */
+        SSLConnection(SSL_CTX* ctx, Socket* sock);
+
         ~SSLConnection();
     };
 
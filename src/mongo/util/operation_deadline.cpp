@@ -0,0 +1,91 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/util/operation_deadline.h"
+
+#include <algorithm>
+
+#include "mongo/base/error_codes.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/concurrency/threadlocal.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+    namespace {
+
+        // Absolute deadline of the current thread in curTimeMicros64() units, 0 if none
+        ThreadLocalValue<unsigned long long> currentDeadline;
+
+    } // namespace
+
+    OperationDeadline::OperationDeadline(long long millis)
+        : _previous(currentDeadline.get()) {
+        const unsigned long long deadline =
+            curTimeMicros64() + static_cast<unsigned long long>(std::max(0LL, millis)) * 1000;
+        if (_previous == 0 || deadline < _previous)
+            currentDeadline.set(deadline);
+    }
+
+    OperationDeadline::~OperationDeadline() {
+        currentDeadline.set(_previous);
+    }
+
+    bool OperationDeadline::active() {
+        return currentDeadline.get() != 0;
+    }
+
+    long long OperationDeadline::remainingMicros() {
+        const unsigned long long deadline = currentDeadline.get();
+        if (deadline == 0)
+            return -1;
+
+        const unsigned long long now = curTimeMicros64();
+        return now >= deadline ? 0 : static_cast<long long>(deadline - now);
+    }
+
+    long long OperationDeadline::remainingMillis() {
+        const long long micros = remainingMicros();
+        return micros < 0 ? -1 : (micros + 999) / 1000;
+    }
+
+    bool OperationDeadline::expired() {
+        return remainingMicros() == 0;
+    }
+
+    void OperationDeadline::check(const char* context) {
+        if (expired()) {
+            uasserted(ErrorCodes::ExceededTimeLimit,
+                      mongoutils::str::stream() << "operation deadline exceeded before "
+                                                << context);
+        }
+    }
+
+    double OperationDeadline::clampTimeout(double timeoutSecs) {
+        const long long micros = remainingMicros();
+        if (micros < 0)
+            return timeoutSecs;
+
+        // A zero socket timeout means none at all, so never go below a millisecond
+        const double remainingSecs = std::max(micros, 1000LL) / 1000000.0;
+        if (timeoutSecs <= 0 || remainingSecs < timeoutSecs)
+            return remainingSecs;
+        return timeoutSecs;
+    }
+
+} // namespace mongo
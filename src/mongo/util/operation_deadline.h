@@ -0,0 +1,75 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/utility.hpp>
+
+#include "mongo/client/export_macros.h"
+
+namespace mongo {
+
+    /**
+     * A time budget for everything the current thread does through the driver while the
+     * object is in scope:
+     *
+     *   {
+     *       OperationDeadline deadline(50);
+     *       ScopedDbConnection conn(host);
+     *       auto_ptr<DBClientCursor> cursor = conn->query(ns, query);
+     *       ...
+     *   }
+     *
+     * Pool checkouts wait at most until the deadline, connects and socket reads and writes
+     * time out when it passes, and queries and commands carry the remaining time to the server
+     * as maxTimeMS. Once it has passed, operations fail with ErrorCodes::ExceededTimeLimit; a
+     * connection that timed out waiting for a reply is marked failed.
+     *
+     * Deadlines nest: an inner deadline never extends an outer one.
+     */
+    class MONGO_CLIENT_API OperationDeadline : boost::noncopyable {
+    public:
+        explicit OperationDeadline(long long millis);
+        ~OperationDeadline();
+
+        /** @return true if a deadline is in effect on this thread. */
+        static bool MONGO_CLIENT_FUNC active();
+
+        /**
+         * @return the microseconds left before the current deadline, zero once it has passed,
+         *     or -1 if there is none.
+         */
+        static long long MONGO_CLIENT_FUNC remainingMicros();
+
+        /** Like remainingMicros(), rounded up to whole milliseconds. */
+        static long long MONGO_CLIENT_FUNC remainingMillis();
+
+        /** @return true if a deadline is in effect and has passed. */
+        static bool MONGO_CLIENT_FUNC expired();
+
+        /** Throws ExceededTimeLimit, mentioning 'context', if the deadline has passed. */
+        static void MONGO_CLIENT_FUNC check(const char* context);
+
+        /**
+         * @return the smaller of 'timeoutSecs' (0 meaning no timeout) and the time left before
+         *     the deadline, for use as a socket timeout.
+         */
+        static double MONGO_CLIENT_FUNC clampTimeout(double timeoutSecs);
+
+    private:
+        const unsigned long long _previous;
+    };
+
+} // namespace mongo
@@ -0,0 +1,75 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/operation_deadline.h"
+#include "mongo/util/time_support.h"
+
+namespace {
+
+    using mongo::OperationDeadline;
+
+    TEST(OperationDeadlineTest, NoDeadline) {
+        ASSERT_FALSE(OperationDeadline::active());
+        ASSERT_EQUALS(-1, OperationDeadline::remainingMicros());
+        ASSERT_FALSE(OperationDeadline::expired());
+        ASSERT_EQUALS(2.5, OperationDeadline::clampTimeout(2.5));
+        ASSERT_EQUALS(0.0, OperationDeadline::clampTimeout(0));
+        OperationDeadline::check("test");
+    }
+
+    TEST(OperationDeadlineTest, ClampsTimeouts) {
+        OperationDeadline deadline(1000);
+        ASSERT_TRUE(OperationDeadline::active());
+        ASSERT_LESS_THAN_OR_EQUALS(OperationDeadline::remainingMillis(), 1000);
+        ASSERT_GREATER_THAN(OperationDeadline::remainingMillis(), 0);
+
+        ASSERT_EQUALS(0.5, OperationDeadline::clampTimeout(0.5));
+        ASSERT_LESS_THAN_OR_EQUALS(OperationDeadline::clampTimeout(0), 1.0);
+        ASSERT_GREATER_THAN(OperationDeadline::clampTimeout(0), 0.0);
+        ASSERT_LESS_THAN_OR_EQUALS(OperationDeadline::clampTimeout(30), 1.0);
+    }
+
+    TEST(OperationDeadlineTest, InnerDeadlineCannotExtend) {
+        OperationDeadline outer(100);
+        {
+            OperationDeadline inner(10000);
+            ASSERT_LESS_THAN_OR_EQUALS(OperationDeadline::remainingMillis(), 100);
+        }
+        {
+            OperationDeadline inner(10);
+            ASSERT_LESS_THAN_OR_EQUALS(OperationDeadline::remainingMillis(), 10);
+        }
+        ASSERT_GREATER_THAN(OperationDeadline::remainingMillis(), 10);
+    }
+
+    TEST(OperationDeadlineTest, Expires) {
+        {
+            OperationDeadline deadline(1);
+            mongo::sleepmillis(5);
+            ASSERT_TRUE(OperationDeadline::expired());
+            ASSERT_EQUALS(0, OperationDeadline::remainingMicros());
+            ASSERT_THROWS(OperationDeadline::check("test"), mongo::UserException);
+
+            // An expired deadline still never yields a zero (unlimited) socket timeout
+            ASSERT_GREATER_THAN(OperationDeadline::clampTimeout(0), 0.0);
+        }
+        ASSERT_FALSE(OperationDeadline::active());
+    }
+
+} // namespace